@@ -0,0 +1,158 @@
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <set>
+#include "BatchDependencies.hpp"
+#include "../Exporter/DependencyManifest.hpp"
+
+namespace
+{
+  // Files changed this recently could change again within the mtime resolution without
+  // the cache noticing, so they aren't cached
+  const int64_t kRacyMtimeSeconds = 2;
+
+  bool stat_file(const std::string& filename, uint64_t& size, int64_t& mtime)
+  {
+#ifdef _WIN32
+    struct __stat64 st;
+    if (_stat64(filename.c_str(), &st) != 0) {
+      return false;
+    }
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+      return false;
+    }
+#endif
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+  }
+}
+
+bool FileHashCache::load(const std::string& filename)
+{
+  std::ifstream file(filename.c_str());
+  if (!file) {
+    return false;
+  }
+  // [hash, size, mtime, path], with the path being the rest of the line
+  Entry entry;
+  std::string path;
+  while (file >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.mtime && std::getline(file, path)) {
+    if (path.size() > 1) {
+      entries_[path.substr(1)] = entry;
+    }
+  }
+  return true;
+}
+
+bool FileHashCache::save(const std::string& filename) const
+{
+  std::ofstream file(filename.c_str());
+  for (Entries::const_iterator it = entries_.begin(); it != entries_.end(); ++it) {
+    file << std::hex << it->second.hash << std::dec << " " << it->second.size << " " << it->second.mtime
+      << " " << it->first << "\n";
+  }
+  return !!file;
+}
+
+void FileHashCache::hash_files(std::vector<uint64_t>& hashes, const std::vector<std::string>& filenames,
+                               const uint32_t thread_count)
+{
+  hashes.resize(filenames.size());
+  std::vector<std::string> changed;
+  std::vector<uint32_t> changed_idx;
+  std::vector<Entry> changed_entries;
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    Entry entry;
+    if (!stat_file(filenames[i], entry.size, entry.mtime)) {
+      hashes[i] = kMissingFileHash;
+      continue;
+    }
+    Entries::const_iterator it = entries_.find(filenames[i]);
+    if (it != entries_.end() && it->second.size == entry.size && it->second.mtime == entry.mtime) {
+      hashes[i] = it->second.hash;
+      ++hits_;
+      continue;
+    }
+    changed.push_back(filenames[i]);
+    changed_idx.push_back((uint32_t)i);
+    changed_entries.push_back(entry);
+  }
+
+  std::vector<uint64_t> changed_hashes;
+  ::hash_files(changed_hashes, changed, thread_count);
+  misses_ += (uint32_t)changed.size();
+
+  const int64_t now = time(NULL);
+  for (size_t i = 0; i < changed.size(); ++i) {
+    hashes[changed_idx[i]] = changed_hashes[i];
+    Entry& entry = changed_entries[i];
+    entry.hash = changed_hashes[i];
+    if (entry.hash != kMissingFileHash && now - entry.mtime >= kRacyMtimeSeconds) {
+      entries_[changed[i]] = entry;
+    } else {
+      entries_.erase(changed[i]);
+    }
+  }
+}
+
+uint32_t find_up_to_date(std::vector<BatchJob>& jobs, FileHashCache& cache, const std::string& exporter,
+                         const std::string& options, const uint32_t thread_count)
+{
+  // read the manifests of the existing outputs
+  std::vector<DependencyManifest> manifests(jobs.size());
+  std::vector<bool> has_manifest(jobs.size(), false);
+  std::set<std::string> unique_files;
+  unique_files.insert(exporter);
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    uint64_t size;
+    int64_t mtime;
+    if (!stat_file(jobs[i].output, size, mtime) || !read_manifest(manifests[i], manifest_filename(jobs[i].output).c_str())) {
+      continue;
+    }
+    has_manifest[i] = true;
+    unique_files.insert(jobs[i].scene);
+    for (size_t j = 0; j < manifests[i].inputs.size(); ++j) {
+      if (manifests[i].inputs[j].kind == Dependency::kTexture) {
+        unique_files.insert(manifests[i].inputs[j].path);
+      }
+    }
+  }
+
+  // hash every input once, however many scenes share it
+  const std::vector<std::string> files(unique_files.begin(), unique_files.end());
+  std::vector<uint64_t> hashes;
+  cache.hash_files(hashes, files, thread_count);
+  std::map<std::string, uint64_t> hash_by_file;
+  for (size_t i = 0; i < files.size(); ++i) {
+    hash_by_file[files[i]] = hashes[i];
+  }
+
+  const uint64_t exporter_hash = hash_by_file[exporter];
+  const uint64_t options_hash = hash_bytes(options.data(), options.size(), 0);
+  uint32_t up_to_date = 0;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (!has_manifest[i]) {
+      continue;
+    }
+    const DependencyManifest& manifest = manifests[i];
+    const Dependency* scene = manifest.find(Dependency::kScene);
+    const Dependency* exporter_dep = manifest.find(Dependency::kExporter);
+    const Dependency* settings = manifest.find(Dependency::kSettings);
+    const uint64_t scene_hash = hash_by_file[jobs[i].scene];
+    bool match = scene && exporter_dep && settings && scene_hash != kMissingFileHash && scene->hash == scene_hash &&
+      exporter_hash != kMissingFileHash && exporter_dep->hash == exporter_hash && settings->hash == options_hash;
+    for (size_t j = 0; match && j < manifest.inputs.size(); ++j) {
+      const Dependency& dep = manifest.inputs[j];
+      match = dep.kind != Dependency::kTexture || dep.hash == hash_by_file[dep.path];
+    }
+    if (match) {
+      jobs[i].status = BatchJob::kUpToDate;
+      ++up_to_date;
+    }
+  }
+  return up_to_date;
+}
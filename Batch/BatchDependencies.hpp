@@ -0,0 +1,50 @@
+#ifndef BATCH_DEPENDENCIES_HPP
+#define BATCH_DEPENDENCIES_HPP
+
+/**
+ * Finds the scenes of a batch that don't have to be exported again: the ones whose output
+ * exists, and whose dependency manifest (see Exporter/DependencyManifest.hpp) matches the
+ * current scene, textures, exporter and settings.
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include "BatchScheduler.hpp"
+
+// Content hashes of files by path, size and modification time, so only the files that
+// changed since the last batch are read again
+class FileHashCache
+{
+public:
+  FileHashCache() : hits_(0), misses_(0) {}
+
+  bool load(const std::string& filename);
+  bool save(const std::string& filename) const;
+
+  // Hashes the files that aren't cached on thread_count threads
+  void hash_files(std::vector<uint64_t>& hashes, const std::vector<std::string>& filenames, const uint32_t thread_count);
+
+  uint32_t hits() const { return hits_; }
+  uint32_t misses() const { return misses_; }
+
+private:
+  struct Entry
+  {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+  };
+  typedef std::map<std::string, Entry> Entries;
+  Entries entries_;
+  uint32_t hits_;
+  uint32_t misses_;
+};
+
+// Marks the jobs that are up to date with kUpToDate, and returns their number. The exporter
+// is the file the manifests hash as the exporter, and the options are from
+// format_exporter_options
+uint32_t find_up_to_date(std::vector<BatchJob>& jobs, FileHashCache& cache, const std::string& exporter,
+  const std::string& options, const uint32_t thread_count);
+
+#endif
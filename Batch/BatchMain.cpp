@@ -0,0 +1,353 @@
+/**
+ * ReduxBatch: exports a list of scenes without the Maya UI, for build farms.
+ *
+ *   ReduxBatch -scenes list.txt -out dir [-options "name=value;..."] [-jobs n] [-timeout s]
+ *              [-report file] [-cache dir] [-force] [-fake]
+ *
+ * The list has one scene per line, and blank lines and lines starting with # are skipped.
+ * The options are the same as the ones ReduxExporter.mel passes to the stub. Each scene is
+ * exported by a worker process, which is this executable again with -worker, so a crashing
+ * or hanging scene only takes down its own worker. Up to -jobs workers run at a time (the
+ * number of cores by default), and workers running for longer than -timeout seconds are
+ * killed. Each scene is written to dir/<scene name>.rdx with its log next to it, and the
+ * timings and failures go to dir/batch_report.json. Exits with 1 if any scene failed.
+ *
+ * The exporter writes a dependency manifest next to each output, and scenes whose scene file,
+ * textures, exporter dll and options still match their manifest are skipped, unless -force is
+ * given. The inputs are hashed in parallel, and the hashes are cached in the -cache directory
+ * (dir/cache by default), so files that haven't changed since the last batch aren't read.
+ *
+ * With -fake the workers don't load Maya, but sleep for a while and write a dummy file, which
+ * exercises the scheduler on machines without Maya. A fake scene with "fail" in its name exits
+ * with an error, "crash" aborts and "hang" never finishes. The "texture <path>" lines of a
+ * fake scene file are its textures, and the batch executable stands in for the exporter dll.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "BatchDependencies.hpp"
+#include "BatchScheduler.hpp"
+#include "../Exporter/DependencyManifest.hpp"
+#include "../Stub/exporter_settings.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "BatchWorker.hpp"
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+  struct BatchArgs
+  {
+    BatchArgs() : jobs(0), timeout_s(0), force(false), fake(false), worker(false) {}
+    string scenes;
+    string out_dir;
+    string options;
+    string report;
+    string cache_dir;
+    uint32_t jobs;
+    double timeout_s;
+    bool force;
+    bool fake;
+    bool worker;
+    vector<string> worker_files;    // scene and output
+  };
+
+  void usage()
+  {
+    cout << "usage: ReduxBatch -scenes list.txt -out dir [-options \"name=value;...\"] [-jobs n] "
+      "[-timeout seconds] [-report file] [-cache dir] [-force] [-fake]" << endl;
+  }
+
+  bool parse_args(BatchArgs& args, const int argc, char** argv)
+  {
+    for (int i = 1; i < argc; ++i) {
+      const string arg(argv[i]);
+      const bool has_value = i + 1 < argc;
+      if (arg == "-fake") {
+        args.fake = true;
+      } else if (arg == "-force") {
+        args.force = true;
+      } else if (arg == "-worker") {
+        args.worker = true;
+      } else if (arg == "-scenes" && has_value) {
+        args.scenes = argv[++i];
+      } else if (arg == "-out" && has_value) {
+        args.out_dir = argv[++i];
+      } else if (arg == "-options" && has_value) {
+        args.options = argv[++i];
+      } else if (arg == "-report" && has_value) {
+        args.report = argv[++i];
+      } else if (arg == "-cache" && has_value) {
+        args.cache_dir = argv[++i];
+      } else if (arg == "-jobs" && has_value) {
+        args.jobs = (uint32_t)atoi(argv[++i]);
+      } else if (arg == "-timeout" && has_value) {
+        args.timeout_s = atof(argv[++i]);
+      } else if (args.worker && arg[0] != '-') {
+        args.worker_files.push_back(arg);
+      } else {
+        cout << "unknown argument " << arg << endl;
+        return false;
+      }
+    }
+    return args.worker ? args.worker_files.size() == 2 : !args.scenes.empty() && !args.out_dir.empty();
+  }
+
+  uint32_t core_count()
+  {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#endif
+  }
+
+  string executable_path(const char* argv0)
+  {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    if (GetModuleFileNameA(NULL, path, MAX_PATH)) {
+      return path;
+    }
+#else
+    char path[4096];
+    const ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0) {
+      return string(path, len);
+    }
+#endif
+    return argv0;
+  }
+
+  bool make_dir(const string& dir)
+  {
+#ifdef _WIN32
+    return CreateDirectoryA(dir.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    return mkdir(dir.c_str(), 0755) == 0 || (stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+  }
+
+  // The file name without directory and extension
+  string scene_stem(const string& scene)
+  {
+    const size_t slash = scene.find_last_of("\\/");
+    const string name(slash == string::npos ? scene : scene.substr(slash + 1));
+    const size_t dot = name.find_last_of('.');
+    return dot == string::npos || dot == 0 ? name : name.substr(0, dot);
+  }
+
+  bool read_scene_list(vector<string>& scenes, const string& filename)
+  {
+    ifstream file(filename.c_str());
+    if (!file) {
+      return false;
+    }
+    string line;
+    while (getline(file, line)) {
+      const size_t start = line.find_first_not_of(" \t\r");
+      if (start == string::npos || line[start] == '#') {
+        continue;
+      }
+      const size_t end = line.find_last_not_of(" \t\r");
+      scenes.push_back(line.substr(start, end - start + 1));
+    }
+    return true;
+  }
+
+  // The exporter dll is in plug-ins next to the executable, as in the Maya bin directory
+  string exporter_path(const string& exe, const bool fake)
+  {
+    return fake ? exe : exe.substr(0, exe.find_last_of("\\/") + 1) + "plug-ins/ReduxExporter.dll";
+  }
+
+  // Writes the manifest the exporter would write for the fake scene
+  bool write_fake_manifest(const string& scene, const string& output, const string& exe,
+                           const ExporterSettings& settings)
+  {
+    vector<string> files;
+    files.push_back(scene);
+    files.push_back(exporter_path(exe, true));
+    ifstream scene_file(scene.c_str());
+    string line;
+    while (getline(scene_file, line)) {
+      if (line.compare(0, 8, "texture ") == 0) {
+        files.push_back(line.substr(8));
+      }
+    }
+    vector<uint64_t> hashes;
+    hash_files(hashes, files, 1);
+
+    DependencyManifest manifest;
+    manifest.add(Dependency::kScene, files[0], hashes[0]);
+    manifest.add(Dependency::kExporter, files[1], hashes[1]);
+    for (size_t i = 2; i < files.size(); ++i) {
+      manifest.add(Dependency::kTexture, files[i], hashes[i]);
+    }
+    const string options(format_exporter_options(settings));
+    manifest.add(Dependency::kSettings, options, hash_bytes(options.data(), options.size(), 0));
+    return write_manifest(manifest_filename(output).c_str(), manifest);
+  }
+
+  // Stands in for a real export, with a run time that depends on the scene name
+  int fake_export(const string& scene, const string& output, const string& exe, const ExporterSettings& settings)
+  {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < scene.size(); ++i) {
+      hash = (hash ^ (uint8_t)scene[i]) * 16777619u;
+    }
+    cout << "fake export of " << scene << endl;
+    batch_sleep_ms(20 + hash % 180);
+
+    if (scene.find("crash") != string::npos) {
+      abort();
+    } else if (scene.find("hang") != string::npos) {
+      for (;;) {
+        batch_sleep_ms(1000);
+      }
+    } else if (scene.find("fail") != string::npos) {
+      cerr << "[ERROR] fake failure" << endl;
+      return 1;
+    }
+
+    FILE* file = fopen(output.c_str(), "wb");
+    if (file == NULL) {
+      cerr << "[ERROR] Unable to open " << output << endl;
+      return 1;
+    }
+    fwrite(&hash, sizeof(hash), 1, file);
+    fclose(file);
+    return write_fake_manifest(scene, output, exe, settings) ? 0 : 1;
+  }
+
+  int run_worker(const BatchArgs& args, const char* argv0)
+  {
+    ExporterSettings settings;
+    if (!parse_exporter_options(settings, args.options)) {
+      return 1;
+    }
+    const string& scene = args.worker_files[0];
+    const string& output = args.worker_files[1];
+    if (args.fake) {
+      return fake_export(scene, output, executable_path(argv0), settings);
+    }
+#ifdef _WIN32
+    return export_scene(argv0, scene.c_str(), output.c_str(), settings);
+#else
+    cerr << "[ERROR] Exporting Maya scenes is only supported on Windows, use -fake" << endl;
+    return 1;
+#endif
+  }
+}
+
+int main(int argc, char** argv)
+{
+  BatchArgs args;
+  if (!parse_args(args, argc, argv)) {
+    usage();
+    return 1;
+  }
+
+  if (args.worker) {
+    return run_worker(args, argv[0]);
+  }
+
+  // check the options here, instead of failing every scene on a typo
+  ExporterSettings settings;
+  if (!parse_exporter_options(settings, args.options)) {
+    return 1;
+  }
+
+  vector<string> scenes;
+  if (!read_scene_list(scenes, args.scenes)) {
+    cerr << "[ERROR] Unable to read " << args.scenes << endl;
+    return 1;
+  }
+  if (!make_dir(args.out_dir)) {
+    cerr << "[ERROR] Unable to create " << args.out_dir << endl;
+    return 1;
+  }
+
+  const string exe = executable_path(argv[0]);
+  map<string, uint32_t> stem_counts;
+  vector<BatchJob> jobs(scenes.size());
+  for (size_t i = 0; i < scenes.size(); ++i) {
+    BatchJob& job = jobs[i];
+    job.scene = scenes[i];
+
+    // scenes from different directories can share a name
+    string stem = scene_stem(scenes[i]);
+    const uint32_t count = ++stem_counts[stem];
+    if (count > 1) {
+      char suffix[16];
+      sprintf(suffix, "_%u", count);
+      stem += suffix;
+    }
+    job.output = args.out_dir + "/" + stem + (settings.load_in_place ? ".rdi" : ".rdx");
+    job.log = job.output + ".log";
+
+    job.args.push_back(exe);
+    job.args.push_back("-worker");
+    job.args.push_back(job.scene);
+    job.args.push_back(job.output);
+    if (!args.options.empty()) {
+      job.args.push_back("-options");
+      job.args.push_back(args.options);
+    }
+    if (args.fake) {
+      job.args.push_back("-fake");
+    }
+  }
+
+  const uint32_t workers = args.jobs ? args.jobs : core_count();
+  const double start = batch_time_ms();
+  uint32_t up_to_date = 0;
+  if (!args.force) {
+    const string cache_dir = args.cache_dir.empty() ? args.out_dir + "/cache" : args.cache_dir;
+    const string cache_file = cache_dir + "/file_hashes.txt";
+    FileHashCache cache;
+    cache.load(cache_file);
+    up_to_date = find_up_to_date(jobs, cache, exporter_path(exe, args.fake), format_exporter_options(settings), core_count());
+    if (!make_dir(cache_dir) || !cache.save(cache_file)) {
+      cerr << "[ERROR] Unable to write " << cache_file << endl;
+    }
+    printf("%u of %u scenes are up to date, %u of %u inputs hashed in %.2f s\n", up_to_date, (uint32_t)jobs.size(),
+      cache.misses(), cache.hits() + cache.misses(), (batch_time_ms() - start) / 1000);
+  }
+
+  cout << "exporting " << jobs.size() - up_to_date << " scenes with " << workers << " workers" << endl;
+  const uint32_t failed = run_batch(jobs, workers, args.timeout_s * 1000);
+  const double total_ms = batch_time_ms() - start;
+
+  const string report = args.report.empty() ? args.out_dir + "/batch_report.json" : args.report;
+  if (!write_batch_report(report.c_str(), jobs, workers, total_ms)) {
+    cerr << "[ERROR] Unable to write " << report << endl;
+  }
+
+  printf("%u of %u scenes exported, %u up to date, in %.2f s, report in %s\n",
+    (uint32_t)jobs.size() - up_to_date - failed, (uint32_t)jobs.size() - up_to_date, up_to_date, total_ms / 1000,
+    report.c_str());
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    if (jobs[i].status != BatchJob::kSucceeded && jobs[i].status != BatchJob::kUpToDate) {
+      printf("  %s: %s, see %s\n", jobs[i].scene.c_str(), status_name(jobs[i].status), jobs[i].log.c_str());
+    }
+  }
+  return failed ? 1 : 0;
+}
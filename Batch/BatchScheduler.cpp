@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <string.h>
+#include "BatchScheduler.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+namespace
+{
+  const uint32_t kPollMs = 10;
+
+  std::string escape_json(const std::string& str)
+  {
+    std::string res;
+    res.reserve(str.length());
+    for (size_t i = 0; i < str.length(); ++i) {
+      const char ch = str[i];
+      if (ch == '"' || ch == '\\') {
+        res += '\\';
+      }
+      res += ch;
+    }
+    return res;
+  }
+
+#ifdef _WIN32
+  typedef HANDLE ProcessHandle;
+
+  // Quotes an argument so CommandLineToArgv gives it back as is
+  std::string quote_arg(const std::string& arg)
+  {
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+      return arg;
+    }
+    std::string res("\"");
+    uint32_t backslashes = 0;
+    for (size_t i = 0; i < arg.size(); ++i) {
+      if (arg[i] == '\\') {
+        ++backslashes;
+        continue;
+      }
+      // backslashes are only special in front of a quote
+      res.append(arg[i] == '"' ? 2 * backslashes + 1 : backslashes, '\\');
+      backslashes = 0;
+      res += arg[i];
+    }
+    res.append(2 * backslashes, '\\');
+    return res + "\"";
+  }
+
+  bool start_process(ProcessHandle& process, const std::vector<std::string>& args, const std::string& log)
+  {
+    std::string command_line;
+    for (size_t i = 0; i < args.size(); ++i) {
+      command_line += (i ? " " : "") + quote_arg(args[i]);
+    }
+
+    SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE log_file = CreateFileA(log.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (log_file == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+
+    STARTUPINFOA si;
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = log_file;
+    si.hStdError = log_file;
+    PROCESS_INFORMATION pi;
+    std::vector<char> buf(command_line.begin(), command_line.end());
+    buf.push_back(0);
+    const BOOL res = CreateProcessA(NULL, &buf[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+    CloseHandle(log_file);
+    if (!res) {
+      return false;
+    }
+    CloseHandle(pi.hThread);
+    process = pi.hProcess;
+    return true;
+  }
+
+  // Returns true once the process has exited
+  bool poll_process(ProcessHandle process, int& exit_code)
+  {
+    if (WaitForSingleObject(process, 0) != WAIT_OBJECT_0) {
+      return false;
+    }
+    DWORD code = 0;
+    GetExitCodeProcess(process, &code);
+    CloseHandle(process);
+    exit_code = (int)code;
+    return true;
+  }
+
+  void kill_process(ProcessHandle process)
+  {
+    TerminateProcess(process, 1);
+    WaitForSingleObject(process, INFINITE);
+    CloseHandle(process);
+  }
+#else
+  typedef pid_t ProcessHandle;
+
+  bool start_process(ProcessHandle& process, const std::vector<std::string>& args, const std::string& log)
+  {
+    const int log_file = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log_file < 0) {
+      return false;
+    }
+
+    std::vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i) {
+      argv.push_back(const_cast<char*>(args[i].c_str()));
+    }
+    argv.push_back(NULL);
+
+    process = fork();
+    if (process == 0) {
+      dup2(log_file, STDOUT_FILENO);
+      dup2(log_file, STDERR_FILENO);
+      close(log_file);
+      execv(argv[0], &argv[0]);
+      _exit(127);
+    }
+    close(log_file);
+    return process > 0;
+  }
+
+  bool poll_process(ProcessHandle process, int& exit_code)
+  {
+    int status = 0;
+    const pid_t res = waitpid(process, &status, WNOHANG);
+    if (res == 0 || (res < 0 && errno == EINTR)) {
+      return false;
+    }
+    // a crash is reported like a shell does, as 128 + the signal
+    exit_code = res < 0 ? -1 : WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return true;
+  }
+
+  void kill_process(ProcessHandle process)
+  {
+    kill(process, SIGKILL);
+    int status = 0;
+    waitpid(process, &status, 0);
+  }
+#endif
+
+  struct RunningJob
+  {
+    ProcessHandle process;
+    uint32_t job;
+  };
+}
+
+double batch_time_ms()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, now;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&now);
+  return 1000.0 * now.QuadPart / (double)frequency.QuadPart;
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1000.0 * now.tv_sec + now.tv_nsec / 1000000.0;
+#endif
+}
+
+void batch_sleep_ms(const uint32_t ms)
+{
+#ifdef _WIN32
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+}
+
+const char* status_name(const BatchJob::Status status)
+{
+  switch (status) {
+    case BatchJob::kPending: return "pending";
+    case BatchJob::kSucceeded: return "succeeded";
+    case BatchJob::kFailed: return "failed";
+    case BatchJob::kTimedOut: return "timed_out";
+    case BatchJob::kLaunchFailed: return "launch_failed";
+    case BatchJob::kUpToDate: return "up_to_date";
+  }
+  return "unknown";
+}
+
+uint32_t run_batch(std::vector<BatchJob>& jobs, const uint32_t max_workers, const double timeout_ms)
+{
+  const double start = batch_time_ms();
+  std::vector<RunningJob> running;
+  uint32_t next_job = 0;
+  uint32_t failed = 0;
+  while (next_job < jobs.size() || !running.empty()) {
+    // fill the free worker slots from the queue
+    while (next_job < jobs.size() && running.size() < (max_workers ? max_workers : 1)) {
+      BatchJob& job = jobs[next_job];
+      if (job.status != BatchJob::kPending) {
+        ++next_job;
+        continue;
+      }
+      RunningJob worker;
+      worker.job = next_job++;
+      job.start_ms = batch_time_ms() - start;
+      if (!start_process(worker.process, job.args, job.log)) {
+        printf("[%u/%u] %s: unable to start the worker\n", worker.job + 1, (uint32_t)jobs.size(), job.scene.c_str());
+        job.status = BatchJob::kLaunchFailed;
+        ++failed;
+        continue;
+      }
+      running.push_back(worker);
+    }
+
+    batch_sleep_ms(kPollMs);
+    for (size_t i = 0; i < running.size(); ) {
+      BatchJob& job = jobs[running[i].job];
+      const double now = batch_time_ms() - start;
+      int exit_code = 0;
+      if (poll_process(running[i].process, exit_code)) {
+        job.exit_code = exit_code;
+        job.status = exit_code == 0 ? BatchJob::kSucceeded : BatchJob::kFailed;
+      } else if (timeout_ms > 0 && now - job.start_ms > timeout_ms) {
+        kill_process(running[i].process);
+        job.status = BatchJob::kTimedOut;
+      } else {
+        ++i;
+        continue;
+      }
+
+      job.ms = now - job.start_ms;
+      failed += job.status != BatchJob::kSucceeded ? 1 : 0;
+      printf("[%u/%u] %s: %s in %.2f s\n", running[i].job + 1, (uint32_t)jobs.size(), job.scene.c_str(),
+        status_name(job.status), job.ms / 1000.0);
+      running.erase(running.begin() + i);
+    }
+  }
+  return failed;
+}
+
+bool write_batch_report(const char* filename, const std::vector<BatchJob>& jobs, const uint32_t max_workers,
+                        const double total_ms)
+{
+  FILE* file = fopen(filename, "wt");
+  if (file == NULL) {
+    return false;
+  }
+
+  uint32_t succeeded = 0;
+  uint32_t up_to_date = 0;
+  double busy_ms = 0;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    succeeded += jobs[i].status == BatchJob::kSucceeded ? 1 : 0;
+    up_to_date += jobs[i].status == BatchJob::kUpToDate ? 1 : 0;
+    busy_ms += jobs[i].ms;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "\t\"workers\" : %u,\n", max_workers);
+  fprintf(file, "\t\"total_ms\" : %.3f,\n", total_ms);
+  // the average number of busy workers, which shows how well the queue kept them fed
+  fprintf(file, "\t\"utilization\" : %.3f,\n", total_ms > 0 ? busy_ms / (total_ms * (max_workers ? max_workers : 1)) : 0);
+  fprintf(file, "\t\"succeeded\" : %u,\n", succeeded);
+  fprintf(file, "\t\"up_to_date\" : %u,\n", up_to_date);
+  fprintf(file, "\t\"failed\" : %u,\n", (uint32_t)jobs.size() - succeeded - up_to_date);
+  fprintf(file, "\t\"scenes\" : [\n");
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const BatchJob& job = jobs[i];
+    fprintf(file, "\t\t{ \"scene\" : \"%s\", \"output\" : \"%s\", \"log\" : \"%s\", \"status\" : \"%s\", "
+      "\"exit_code\" : %d, \"start_ms\" : %.3f, \"ms\" : %.3f }%s\n",
+      escape_json(job.scene).c_str(), escape_json(job.output).c_str(), escape_json(job.log).c_str(),
+      status_name(job.status), job.exit_code, job.start_ms, job.ms, i + 1 < jobs.size() ? "," : "");
+  }
+  fprintf(file, "\t]\n");
+  fprintf(file, "}\n");
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,54 @@
+#ifndef BATCH_SCHEDULER_HPP
+#define BATCH_SCHEDULER_HPP
+
+/**
+ * Runs the jobs of a batch export as worker processes, at most max_workers at a time, in the
+ * order they are queued. A worker that exits with 0 has succeeded, and a worker still running
+ * after the timeout is killed. Each worker's stdout and stderr go to the job's log file.
+ * Doesn't depend on Maya, and builds on both Windows and POSIX, so the scheduler can be run
+ * anywhere with the fake scene mode of ReduxBatch.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct BatchJob
+{
+  enum Status
+  {
+    kPending,
+    kSucceeded,
+    kFailed,          // the worker exited with an error, or crashed
+    kTimedOut,
+    kLaunchFailed,
+    kUpToDate,        // skipped, as its inputs haven't changed since it was exported
+  };
+
+  BatchJob() : status(kPending), exit_code(0), start_ms(0), ms(0) {}
+
+  std::string scene;
+  std::string output;
+  std::string log;
+  std::vector<std::string> args;    // the worker's command line, starting with the executable
+
+  Status status;
+  int exit_code;
+  double start_ms;                  // from the start of the batch
+  double ms;
+};
+
+// Runs the pending jobs, and returns the number that didn't succeed. A timeout of 0 waits forever
+uint32_t run_batch(std::vector<BatchJob>& jobs, const uint32_t max_workers, const double timeout_ms);
+
+// Writes the per scene timings and failures as JSON
+bool write_batch_report(const char* filename, const std::vector<BatchJob>& jobs, const uint32_t max_workers,
+  const double total_ms);
+
+const char* status_name(const BatchJob::Status status);
+
+// Milliseconds from an arbitrary start
+double batch_time_ms();
+void batch_sleep_ms(const uint32_t ms);
+
+#endif
@@ -0,0 +1,62 @@
+#include <windows.h>
+#include <iostream>
+#include <string>
+#include <maya/MGlobal.h>
+#include <maya/MLibrary.h>
+#include <maya/MFileIO.h>
+#include "BatchWorker.hpp"
+
+using namespace std;
+
+namespace
+{
+  typedef bool(*ExportMainFn)(const char*, const ExporterSettings&);
+
+  int export_with_dll(const char* scene, const char* output, const ExporterSettings& settings)
+  {
+    MStatus status = MFileIO::open(scene, NULL, true);
+    if (!status) {
+      cerr << "[ERROR] Unable to open " << scene << ": " << status.errorString().asChar() << endl;
+      return 1;
+    }
+
+    // the exporter dll lives in plug-ins next to the executable, as it does for the stub
+    char exe_path[MAX_PATH];
+    GetModuleFileNameA(NULL, exe_path, MAX_PATH);
+    std::string dll_path(exe_path);
+    dll_path = dll_path.substr(0, dll_path.find_last_of("\\/") + 1) + "plug-ins/ReduxExporter.dll";
+
+    HMODULE exporter_dll = LoadLibraryA(dll_path.c_str());
+    if (NULL == exporter_dll) {
+      cerr << "[ERROR] Could not load " << dll_path << endl;
+      return 1;
+    }
+
+    ExportMainFn export_main = reinterpret_cast<ExportMainFn>(GetProcAddress(exporter_dll, "export_main"));
+    if (NULL == export_main) {
+      cerr << "[ERROR] Unable to find export_main function" << endl;
+      FreeLibrary(exporter_dll);
+      return 1;
+    }
+
+    const bool res = export_main(output, settings);
+    FreeLibrary(exporter_dll);
+    return res ? 0 : 1;
+  }
+}
+
+int export_scene(const char* argv0, const char* scene, const char* output, const ExporterSettings& settings)
+{
+  MStatus status = MLibrary::initialize(true, const_cast<char*>(argv0), true);
+  if (!status) {
+    cerr << "[ERROR] Unable to initialize Maya: " << status.errorString().asChar() << endl;
+    return 1;
+  }
+
+  const int exit_code = export_with_dll(scene, output, settings);
+  cout << scene << (exit_code == 0 ? " exported to " : " failed to export to ") << output << endl;
+
+  // doesn't return, cleanup exits the process with the code
+  MLibrary::cleanup(exit_code);
+  return exit_code;
+}
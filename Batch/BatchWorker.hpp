@@ -0,0 +1,15 @@
+#ifndef BATCH_WORKER_HPP
+#define BATCH_WORKER_HPP
+
+/**
+ * The worker side of ReduxBatch: runs Maya as a library, opens one scene and exports it with
+ * export_main from ReduxExporter.dll, like the stub does from inside Maya.
+ * Only available on Windows, where the exporter is built.
+ */
+
+#include "../Stub/exporter_settings.hpp"
+
+// Returns the process exit code, 0 on success
+int export_scene(const char* argv0, const char* scene, const char* output, const ExporterSettings& settings);
+
+#endif
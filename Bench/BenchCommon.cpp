@@ -0,0 +1,74 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include "BenchCommon.hpp"
+
+void add_result(Results& results, const std::string& key, const StageScope& scope)
+{
+  StageResult& result = results[key];
+  result.ms += scope.timer_.elapsed_ms();
+  result.peak_bytes = std::max<size_t>(result.peak_bytes, scope.peak_bytes());
+  result.allocations += scope.allocations();
+}
+
+std::string make_key(const char* generator, const uint32_t triangles, const char* stage)
+{
+  char buf[256];
+  sprintf_s(buf, sizeof(buf), "%s/%u/%s", generator, triangles, stage);
+  return buf;
+}
+
+bool save_file(const char* filename, const uint8_t* buf, const uint32_t len)
+{
+  FILE* file = NULL;
+  if (fopen_s(&file, filename, "wb") != 0) {
+    return false;
+  }
+  const bool res = fwrite(buf, 1, len, file) == len;
+  fclose(file);
+  return res;
+}
+
+bool load_file(const char* filename, std::vector<uint8_t>& buf)
+{
+  FILE* file = NULL;
+  if (fopen_s(&file, filename, "rb") != 0) {
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  buf.resize(ftell(file));
+  fseek(file, 0, SEEK_SET);
+  const bool res = buf.empty() || fread(&buf[0], 1, buf.size(), file) == buf.size();
+  fclose(file);
+  return res;
+}
+
+RdxChunk writer_chunk(const RdxWriter& writer, const uint32_t idx)
+{
+  RdxChunk chunk;
+  chunk.id = writer.chunk_entry(idx).id;
+  chunk.data = writer.chunk_data(idx);
+  chunk.size = writer.chunk_entry(idx).size;
+  return chunk;
+}
+
+// Smooth color ramps with some noise, and when with_alpha a cut out checker in the alpha
+void make_texture(TextureImage& image, const uint32_t width, const uint32_t height, const bool with_alpha,
+                  const uint32_t seed)
+{
+  image.width = width;
+  image.height = height;
+  image.rgba.resize(width * height * 4);
+  uint32_t state = seed * 747796405u + 1;
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      state = state * 1664525u + 1013904223u;
+      const int noise = (int)(state >> 28) - 8;
+      uint8_t* p = &image.rgba[(y * width + x) * 4];
+      p[0] = (uint8_t)std::min<int>(std::max<int>(255 * x / width + noise, 0), 255);
+      p[1] = (uint8_t)std::min<int>(std::max<int>(255 * y / height + noise, 0), 255);
+      p[2] = (uint8_t)(128 + 100 * sinf((x + y + seed) * 0.05f));
+      p[3] = with_alpha && ((x / 32 + y / 32) & 1) ? 0 : 255;
+    }
+  }
+}
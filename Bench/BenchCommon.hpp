@@ -0,0 +1,121 @@
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+/**
+ * What the GeometryBench cases share: the stage timing and heap tracking, the results and the
+ * table of cases main runs. Each area's cases are in their own file.
+ */
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "MeshGenerators.hpp"
+#include "../Exporter/RdxWriter.hpp"
+#include "../Exporter/TextureProcessing.hpp"
+#include "../Reader/RdxReader.hpp"
+
+const uint32_t kTriangleCounts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+const uint32_t kNumTriangleCounts = sizeof(kTriangleCounts) / sizeof(kTriangleCounts[0]);
+
+const uint32_t kNodeCounts[] = { 1000, 10000, 100000 };
+const uint32_t kNumNodeCounts = sizeof(kNodeCounts) / sizeof(kNodeCounts[0]);
+
+// Heap usage, tracked by the operator new/delete in GeometryBench.cpp
+extern size_t g_current_bytes;
+extern size_t g_peak_bytes;
+extern uint32_t g_allocations;
+
+// Whether the mesh stages draw their temporaries from an Arena, "-arena 0" runs them on the heap
+extern bool g_use_arena;
+
+struct Timer
+{
+  Timer() { QueryPerformanceFrequency(&frequency_); QueryPerformanceCounter(&start_); }
+  double elapsed_ms() const
+  {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000.0 * (now.QuadPart - start_.QuadPart) / (double)frequency_.QuadPart;
+  }
+  LARGE_INTEGER frequency_;
+  LARGE_INTEGER start_;
+};
+
+// Tracks the time, peak heap growth and heap allocation count of a single stage
+struct StageScope
+{
+  StageScope() : start_bytes_(g_current_bytes), start_allocations_(g_allocations) { g_peak_bytes = g_current_bytes; }
+  size_t peak_bytes() const { return g_peak_bytes - start_bytes_; }
+  uint32_t allocations() const { return g_allocations - start_allocations_; }
+  Timer timer_;
+  size_t start_bytes_;
+  uint32_t start_allocations_;
+};
+
+struct StageResult
+{
+  StageResult() : ms(0), peak_bytes(0), allocations(0), hash(0) {}
+  double  ms;
+  size_t  peak_bytes;
+  uint32_t allocations;
+  // Hash of the stage's output, 0 for the stages that don't check theirs against the baseline
+  uint64_t hash;
+};
+
+// Results keyed by "generator/triangles/stage"
+typedef std::map<std::string, StageResult> Results;
+
+void add_result(Results& results, const std::string& key, const StageScope& scope);
+std::string make_key(const char* generator, const uint32_t triangles, const char* stage);
+
+bool save_file(const char* filename, const uint8_t* buf, const uint32_t len);
+bool load_file(const char* filename, std::vector<uint8_t>& buf);
+
+// The chunk idx of the writer, as RdxReader returns it
+RdxChunk writer_chunk(const RdxWriter& writer, const uint32_t idx);
+
+// Smooth color ramps with some noise, and when with_alpha a cut out checker in the alpha
+void make_texture(TextureImage& image, const uint32_t width, const uint32_t height, const bool with_alpha,
+                  const uint32_t seed);
+
+struct BenchOptions
+{
+  uint32_t max_triangles;
+  uint32_t max_nodes;
+};
+
+// Runs the cases of a generator at its sizes, and returns false when any of their checks fails
+typedef bool (*BenchCaseFn)(Results& results, const BenchOptions& options);
+
+struct BenchCase
+{
+  const char* name;
+  BenchCaseFn fn;
+};
+
+extern const BenchCase kBenchCases[];
+extern const uint32_t kNumBenchCases;
+
+// MeshBench.cpp
+void run_mesh_case(Results& results, const MeshGenerator& generator, const uint32_t target_triangles);
+bool run_codec_cases(Results& results, const BenchOptions& options);
+// DeformBench.cpp
+bool run_morph_cases(Results& results, const BenchOptions& options);
+bool run_skinning_cases(Results& results, const BenchOptions& options);
+// SceneBench.cpp
+bool run_scene_cases(Results& results, const BenchOptions& options);
+bool run_load_cases(Results& results, const BenchOptions& options);
+bool run_camera_cases(Results& results, const BenchOptions& options);
+bool run_materials_cases(Results& results, const BenchOptions& options);
+// LayoutBench.cpp
+bool run_spatial_cases(Results& results, const BenchOptions& options);
+bool run_cells_cases(Results& results, const BenchOptions& options);
+bool run_batching_cases(Results& results, const BenchOptions& options);
+bool run_determinism_cases(Results& results, const BenchOptions& options);
+bool run_patch_cases(Results& results, const BenchOptions& options);
+// TextureBench.cpp
+bool run_texture_cases(Results& results, const BenchOptions& options);
+
+#endif
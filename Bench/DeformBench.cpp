@@ -0,0 +1,367 @@
+/**
+ * The "morph" generator adds local blend shape targets to the meshes of every generator, with
+ * coincident points that move apart, maps them onto the welded and reordered vertices, and
+ * checks the sparse deltas read back against the dense ones of every corner. The "skinning"
+ * generator weights the meshes of every generator to a synthetic skeleton, welds them with the
+ * quantized influences, splits them into bone palettes, and checks the packed vertices of every
+ * part against the source weights.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "BenchCommon.hpp"
+#include "../Exporter/MorphTargets.hpp"
+#include "../Exporter/Skinning.hpp"
+
+namespace
+{
+  // Each target moves the points within a fraction of the mesh's size of a center point, like
+  // the local shapes of a facial rig
+  const uint32_t kMorphTargets = 32;
+  const float kMorphRadius = 0.1f;
+  // Every kMorphSplitStride-th point gets a coincident copy, which moves apart from it in the
+  // targets, as the two sides of a cut do
+  const uint32_t kMorphSplitStride = 16;
+
+  // Joints spread over the skinned meshes, with each point weighted by more of them than the
+  // vertex format keeps
+  const uint32_t kSkinJoints = 200;
+  const uint32_t kSkinPointInfluences = 6;
+  const uint32_t kSkinPaletteJoints = 64;
+
+  bool run_morph_case(Results& results, const MeshGenerator& generator, const uint32_t target_triangles)
+  {
+    SourceMesh mesh;
+    generator.fn(mesh, target_triangles);
+    // every other corner of a split point uses its copy
+    const uint32_t source_point_count = (uint32_t)mesh.positions.size();
+    std::vector<uint32_t> point_copies(source_point_count, kRdxInvalidIndex);
+    for (size_t i = 0; i < mesh.sub_meshes.size(); ++i) {
+      std::vector<Corner>& corners = mesh.sub_meshes[i].corners;
+      for (size_t j = 1; j < corners.size(); j += 2) {
+        const uint32_t point = corners[j].position_index;
+        if (point % kMorphSplitStride == 0) {
+          if (point_copies[point] == kRdxInvalidIndex) {
+            point_copies[point] = (uint32_t)mesh.positions.size();
+            mesh.positions.push_back(mesh.positions[point]);
+          }
+          corners[j].position_index = point_copies[point];
+        }
+      }
+    }
+    MayaArrays arrays;
+    make_maya_arrays(arrays, mesh);
+    MeshStreams streams;
+    convert_maya_arrays(streams, arrays);
+
+    Aabb aabb;
+    compute_aabb(aabb, &mesh.positions[0].x, (uint32_t)mesh.positions.size(), sizeof(D3DXVECTOR3));
+    const D3DXVECTOR3 extent(aabb.max - aabb.min);
+    const float radius = kMorphRadius * D3DXVec3Length(&extent);
+    const uint32_t point_count = (uint32_t)mesh.positions.size();
+
+    // the targets as Maya point deltas, converted like MeshExporter::get_morph_targets does
+    std::vector<SoaStream> point_deltas(kMorphTargets);
+    for (uint32_t t = 0; t < kMorphTargets; ++t) {
+      const D3DXVECTOR3& center = mesh.positions[(t * 7919) % point_count];
+      const D3DXVECTOR3 direction(cosf((float)t), 1, sinf((float)t));
+      std::vector<double> raw_deltas(4 * point_count, 0.0);
+      for (uint32_t i = 0; i < point_count; ++i) {
+        const D3DXVECTOR3 offset(mesh.positions[i] - center);
+        const float falloff = 1 - D3DXVec3Length(&offset) / radius;
+        if (falloff > 0) {
+          for (uint32_t j = 0; j < 3; ++j) {
+            raw_deltas[4 * i + j] = 0.05 * radius * falloff * falloff * direction[j];
+          }
+        }
+        if (i >= source_point_count) {
+          for (uint32_t j = 0; j < 3; ++j) {
+            raw_deltas[4 * i + j] += 0.01 * radius * direction[j];
+          }
+        }
+      }
+      convert_points(point_deltas[t], &raw_deltas[0], point_count);
+    }
+
+    MorphTargets morphs;
+    // the morphed sub meshes, and the vertex of each of their corners
+    std::vector<uint32_t> morph_sub_meshes;
+    std::vector<IndexBuffer> corner_vertices;
+    VertexBuffer candidates;
+    candidates.format = make_vertex_format(streams, false);
+    for (size_t i = 0; i < mesh.sub_meshes.size(); ++i) {
+      const SourceSubMesh& sub_mesh = mesh.sub_meshes[i];
+      if (sub_mesh.triangles.empty()) {
+        continue;
+      }
+      gather_candidates(candidates, streams, sub_mesh.corners, sub_mesh.stream_indices);
+      VertexBuffer super_verts;
+      IndexBuffer weld_keys, vertex_mapping, indices, new_index;
+      gather_morph_weld_keys(weld_keys, sub_mesh.corners);
+      weld_vertices(super_verts, vertex_mapping, candidates, &weld_keys);
+      remap_indices(indices, sub_mesh.triangles, vertex_mapping, false);
+      reorder_vertices(super_verts, indices, &new_index);
+
+      // the same mapping as MeshExporter::write_vertex_data
+      IndexBuffer vertex_points(super_verts.size(), kRdxInvalidIndex);
+      morph_sub_meshes.push_back((uint32_t)i);
+      corner_vertices.push_back(IndexBuffer(vertex_mapping.size()));
+      for (size_t j = 0; j < vertex_mapping.size(); ++j) {
+        corner_vertices.back()[j] = new_index[vertex_mapping[j]];
+        vertex_points[corner_vertices.back()[j]] = sub_mesh.corners[j].position_index;
+      }
+
+      StageScope scope;
+      add_morph_mesh(morphs, (uint32_t)i, super_verts.size());
+      for (uint32_t t = 0; t < kMorphTargets; ++t) {
+        add_morph_target(morphs, t, point_deltas[t], vertex_points);
+      }
+      add_result(results, make_key(generator.name, target_triangles, "morph"), scope);
+    }
+
+    RdxWriter writer;
+    writer.init_writer(0);
+    bool ok = false;
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::MorphTargets);
+      ok = write_morph_targets(writer, morphs);
+    }
+
+    // every corner's delta, stored or dropped, is within the quantization error of its point's
+    RdxMorphTargetsView view;
+    ok = ok && read_morph_targets(view, writer_chunk(writer, 0)) && view.meshes.count == morph_sub_meshes.size();
+    float worst = 0;
+    for (uint32_t m = 0; ok && m < view.meshes.count; ++m) {
+      const RdxMorphMesh& morph_mesh = view.meshes[m];
+      const std::vector<Corner>& corners = mesh.sub_meshes[morph_sub_meshes[m]].corners;
+      for (uint32_t t = 0; t < morph_mesh.target_count; ++t) {
+        const RdxMorphTarget& target = view.targets[morph_mesh.first_target + t];
+        std::vector<float> decoded(3 * morph_mesh.vertex_count, 0.0f);
+        for (uint32_t i = target.first_delta; i < target.first_delta + target.delta_count; ++i) {
+          for (uint32_t j = 0; j < 3; ++j) {
+            decoded[3 * view.vertex_indices[i] + j] = view.deltas[i].position[j] / 32767.0f * target.scale;
+          }
+        }
+        for (size_t c = 0; c < corners.size(); ++c) {
+          const uint32_t v = corner_vertices[m][c];
+          for (uint32_t j = 0; j < 3; ++j) {
+            const float expected = point_deltas[target.name].component(j)[corners[c].position_index];
+            const float tolerance = target.scale / 32767 + kMinMorphDelta;
+            worst = std::max(worst, fabsf(decoded[3 * v + j] - expected) / tolerance);
+          }
+        }
+      }
+    }
+    ok = ok && worst <= 1;
+
+    const double dense_bytes = (double)morphs.dense_deltas * 3 * sizeof(float);
+    printf("%-16s %10u tris  %6u targets  %5.1f%% of deltas stored  dense %8.2f MB  sparse %8.2f MB  %s\n",
+      generator.name, mesh.triangle_count(), (uint32_t)morphs.targets.size(),
+      100.0 * morphs.deltas.size() / std::max<double>((double)morphs.dense_deltas, 1), dense_bytes / (1024.0 * 1024.0),
+      morph_targets_size(morphs) / (1024.0 * 1024.0), ok ? "morphs valid" : "morphs invalid");
+    const StageResult& result = results[make_key(generator.name, target_triangles, "morph")];
+    printf("    %-14s %10.2f ms  %8.2f Mdelta/s  peak %8.2f MB  %8u allocs\n", "morph", result.ms,
+      morphs.dense_deltas / std::max<double>(result.ms, 1e-6) / 1000.0, result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    return ok;
+  }
+
+  // Influences holding squared distances, nearest first
+  bool closer(const Influence& lhs, const Influence& rhs)
+  {
+    return lhs.weight < rhs.weight;
+  }
+
+  // The order the exporter picks the influences in
+  bool heavier_influence(const Influence& lhs, const Influence& rhs)
+  {
+    if (lhs.weight != rhs.weight) {
+      return lhs.weight > rhs.weight;
+    }
+    return lhs.bone_index < rhs.bone_index;
+  }
+
+  bool run_skinning_case(Results& results, const MeshGenerator& generator, const uint32_t target_triangles)
+  {
+    SourceMesh mesh;
+    generator.fn(mesh, target_triangles);
+    MayaArrays arrays;
+    make_maya_arrays(arrays, mesh);
+    MeshStreams streams;
+    convert_maya_arrays(streams, arrays);
+
+    // joints at points spread over the mesh, each point weighted by the inverse distance to
+    // its kSkinPointInfluences nearest joints, so the top 4 selection has something to drop
+    const uint32_t point_count = (uint32_t)mesh.positions.size();
+    std::vector<D3DXVECTOR3> joint_positions(kSkinJoints);
+    for (uint32_t j = 0; j < kSkinJoints; ++j) {
+      joint_positions[j] = mesh.positions[(j * 7919) % point_count];
+    }
+    ArenaVector<Influences>::Type influences(point_count);
+    std::vector<Influence> nearest;
+    for (uint32_t i = 0; i < point_count; ++i) {
+      nearest.clear();
+      for (uint32_t j = 0; j < kSkinJoints; ++j) {
+        const D3DXVECTOR3 offset(mesh.positions[i] - joint_positions[j]);
+        nearest.push_back(Influence(j, D3DXVec3LengthSq(&offset)));
+      }
+      std::partial_sort(nearest.begin(), nearest.begin() + kSkinPointInfluences, nearest.end(), closer);
+      for (uint32_t k = 0; k < kSkinPointInfluences; ++k) {
+        influences[i].push_back(Influence(nearest[k].bone_index, 1 / (sqrtf(nearest[k].weight) + 1e-3f)));
+      }
+    }
+
+    std::vector<SkinWeights> weights;
+    IndexBuffer point_weights;
+    {
+      StageScope scope;
+      quantize_skin_weights(weights, point_weights, influences);
+      add_result(results, make_key(generator.name, target_triangles, "quantize"), scope);
+    }
+
+    Skins skins;
+    std::vector<RdxSkinJoint> joints(kSkinJoints);
+    for (uint32_t j = 0; j < kSkinJoints; ++j) {
+      const double translation[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 },
+        { -joint_positions[j].x, -joint_positions[j].y, -joint_positions[j].z, 1 } };
+      joints[j].name = j;
+      convert_matrix(joints[j].inverse_bind, translation);
+    }
+
+    bool ok = true;
+    uint32_t part_count = 0;
+    uint32_t welded_vertices = 0;
+    uint32_t part_vertices = 0;
+    float worst = 0;
+    VertexBuffer candidates;
+    candidates.format = make_vertex_format(streams, false);
+    candidates.format.skinned = true;
+    for (size_t i = 0; i < mesh.sub_meshes.size(); ++i) {
+      const SourceSubMesh& sub_mesh = mesh.sub_meshes[i];
+      if (sub_mesh.triangles.empty()) {
+        continue;
+      }
+      VertexBuffer super_verts;
+      IndexBuffer vertex_mapping, indices;
+      {
+        StageScope scope;
+        gather_candidates(candidates, streams, sub_mesh.corners, sub_mesh.stream_indices);
+        gather_skin_weights(candidates, sub_mesh.corners, point_weights);
+        weld_vertices(super_verts, vertex_mapping, candidates);
+        remap_indices(indices, sub_mesh.triangles, vertex_mapping, false);
+        add_result(results, make_key(generator.name, target_triangles, "weld"), scope);
+      }
+      welded_vertices += super_verts.size();
+
+      // the welder only merges corners with the same weights
+      const uint32_t skin_offset = super_verts.format.skin_offset();
+      for (size_t j = 0; j < vertex_mapping.size(); ++j) {
+        uint32_t weight_idx;
+        memcpy(&weight_idx, super_verts.vertex(vertex_mapping[j]) + skin_offset, sizeof(weight_idx));
+        ok &= weight_idx == point_weights[sub_mesh.corners[j].position_index];
+      }
+
+      std::vector<SkinPart> parts;
+      {
+        StageScope scope;
+        split_skin_palettes(parts, super_verts, indices, weights, kSkinPaletteJoints);
+        add_result(results, make_key(generator.name, target_triangles, "palettes"), scope);
+      }
+
+      size_t part_index_count = 0;
+      for (size_t p = 0; p < parts.size(); ++p) {
+        VertexBuffer part_verts;
+        IndexBuffer part_indices, part_sources;
+        {
+          StageScope scope;
+          make_skin_part(part_verts, part_indices, part_sources, super_verts, parts[p], weights);
+          add_result(results, make_key(generator.name, target_triangles, "parts"), scope);
+        }
+        add_skin(skins, (uint32_t)part_count++, parts[p], joints);
+        part_vertices += part_verts.size();
+        part_index_count += part_indices.size();
+        ok &= parts[p].palette.size() <= kSkinPaletteJoints;
+
+        // the packed weights sum to 255, and through the palette give the source influences
+        for (uint32_t v = 0; v < part_verts.size(); ++v) {
+          uint8_t packed[2][kRdxMaxInfluences];
+          memcpy(packed, part_verts.vertex(v) + skin_offset, sizeof(packed));
+          uint32_t weight_idx;
+          memcpy(&weight_idx, super_verts.vertex(part_sources[v]) + skin_offset, sizeof(weight_idx));
+
+          uint32_t sum = 0;
+          for (uint32_t k = 0; k < kRdxMaxInfluences; ++k) {
+            sum += packed[1][k];
+            if (packed[1][k]) {
+              ok &= packed[0][k] < parts[p].palette.size() &&
+                parts[p].palette[packed[0][k]] == weights[weight_idx].joints[k];
+            }
+          }
+          ok &= sum == 255;
+        }
+      }
+      ok &= part_index_count == indices.size();
+    }
+
+    // the quantized weights against the normalized top 4 influences of each point
+    for (uint32_t i = 0; i < point_count; ++i) {
+      std::vector<Influence> sorted(influences[i].begin(), influences[i].end());
+      std::sort(sorted.begin(), sorted.end(), heavier_influence);
+      float total = 0;
+      for (uint32_t k = 0; k < kRdxMaxInfluences; ++k) {
+        total += sorted[k].weight;
+      }
+      const SkinWeights& w = weights[point_weights[i]];
+      for (uint32_t k = 0; k < kRdxMaxInfluences; ++k) {
+        ok &= w.weights[k] == 0 || w.joints[k] == sorted[k].bone_index;
+        worst = std::max(worst, fabsf(w.weights[k] / 255.0f - sorted[k].weight / total));
+      }
+    }
+    ok &= worst <= 2.5f / 255;
+
+    RdxWriter writer;
+    writer.init_writer(0);
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Skins);
+      ok &= write_skins(writer, skins);
+    }
+    RdxSkinsView view;
+    ok = ok && read_skins(view, writer_chunk(writer, 0)) && view.skins.count == part_count &&
+      view.joints.count == skins.joints.size();
+
+    printf("%-16s %10u tris  %4u parts  %6.1f joints/part  verts %8u -> %8u (+%4.1f%%)  weight error %.4f  %s\n",
+      generator.name, mesh.triangle_count(), part_count, (double)skins.joints.size() / std::max<uint32_t>(part_count, 1),
+      welded_vertices, part_vertices, 100.0 * (part_vertices - welded_vertices) / std::max<uint32_t>(welded_vertices, 1),
+      worst, ok ? "skins valid" : "skins invalid");
+    const char* stages[] = { "quantize", "weld", "palettes", "parts" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key(generator.name, target_triangles, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f Mtri/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        mesh.triangle_count() / std::max<double>(result.ms, 1e-6) / 1000.0, result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+    return ok;
+  }
+}
+
+bool run_morph_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumMeshGenerators; ++i) {
+    for (uint32_t j = 0; j < kNumTriangleCounts && kTriangleCounts[j] <= std::min<uint32_t>(options.max_triangles, 100000); ++j) {
+      ok = run_morph_case(results, kMeshGenerators[i], kTriangleCounts[j]) && ok;
+    }
+  }
+  return ok;
+}
+
+bool run_skinning_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumMeshGenerators; ++i) {
+    for (uint32_t j = 0; j < kNumTriangleCounts && kTriangleCounts[j] <= std::min<uint32_t>(options.max_triangles, 100000); ++j) {
+      ok = run_skinning_case(results, kMeshGenerators[i], kTriangleCounts[j]) && ok;
+    }
+  }
+  return ok;
+}
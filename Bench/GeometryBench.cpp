@@ -0,0 +1,216 @@
+/**
+ * Geometry pipeline benchmark
+ *
+ * Runs the Maya independent stages of the exporter over synthetic input, and reports time, peak
+ * heap usage and allocation counts for each stage. The mesh generators of MeshGenerators.cpp run
+ * the mesh stages, see MeshBench.cpp, and "-arena 0" runs them on the heap instead of an Arena to
+ * compare allocation counts. The other generators are the cases in kBenchCases, with their
+ * areas' files describing them: MeshBench.cpp (codec), DeformBench.cpp (morph, skinning),
+ * SceneBench.cpp (scene, load, camera, materials), LayoutBench.cpp (spatial, cells, batching,
+ * determinism, patch) and TextureBench.cpp (textures). -generator runs one generator by name.
+ *
+ * The process exits with 1 when any of the checks fails.
+ *
+ * usage: GeometryBench [-generator name] [-max_triangles n] [-max_nodes n] [-arena 0|1]
+ *                      [-save_baseline file] [-baseline file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include "BenchCommon.hpp"
+
+// Heap usage, tracked by the operator new/delete below
+size_t g_current_bytes = 0;
+size_t g_peak_bytes = 0;
+uint32_t g_allocations = 0;
+
+bool g_use_arena = true;
+
+namespace
+{
+  bool save_baseline(const char* filename, const Results& results)
+  {
+    FILE* file = NULL;
+    if (fopen_s(&file, filename, "wt") != 0) {
+      return false;
+    }
+    for (Results::const_iterator it = results.begin(); it != results.end(); ++it) {
+      fprintf(file, "%s %f %Iu %08x%08x\n", it->first.c_str(), it->second.ms, it->second.peak_bytes,
+        (uint32_t)(it->second.hash >> 32), (uint32_t)it->second.hash);
+    }
+    fclose(file);
+    return true;
+  }
+
+  bool load_baseline(const char* filename, Results& results)
+  {
+    FILE* file = NULL;
+    if (fopen_s(&file, filename, "rt") != 0) {
+      return false;
+    }
+    // baselines saved before the output hashes have three fields
+    char line[512];
+    char key[256];
+    while (fgets(line, sizeof(line), file)) {
+      StageResult result;
+      uint32_t hi = 0, lo = 0;
+      const int fields = sscanf_s(line, "%255s %lf %Iu %8x%8x", key, sizeof(key), &result.ms, &result.peak_bytes, &hi, &lo);
+      if (fields < 3) {
+        break;
+      }
+      result.hash = (uint64_t)hi << 32 | lo;
+      results[key] = result;
+    }
+    fclose(file);
+    return true;
+  }
+
+  // Returns false when the output of a stage hashes differently than in the baseline
+  bool compare_baseline(const Results& baseline, const Results& results)
+  {
+    bool ok = true;
+    printf("\nComparison against baseline (positive is slower)\n");
+    for (Results::const_iterator it = results.begin(); it != results.end(); ++it) {
+      Results::const_iterator base = baseline.find(it->first);
+      if (base == baseline.end()) {
+        continue;
+      }
+      if (base->second.hash && it->second.hash && base->second.hash != it->second.hash) {
+        printf("  %-40s output changed\n", it->first.c_str());
+        ok = false;
+      }
+      if (base->second.ms <= 0) {
+        continue;
+      }
+      printf("  %-40s %10.2f ms -> %10.2f ms  %+7.1f%%\n", it->first.c_str(), base->second.ms, it->second.ms,
+        100.0 * (it->second.ms - base->second.ms) / base->second.ms);
+    }
+    return ok;
+  }
+}
+
+const BenchCase kBenchCases[] = {
+  { "scene", &run_scene_cases },
+  { "spatial", &run_spatial_cases },
+  { "cells", &run_cells_cases },
+  { "batching", &run_batching_cases },
+  { "camera", &run_camera_cases },
+  { "morph", &run_morph_cases },
+  { "skinning", &run_skinning_cases },
+  { "codec", &run_codec_cases },
+  { "textures", &run_texture_cases },
+  { "load", &run_load_cases },
+  { "determinism", &run_determinism_cases },
+  { "patch", &run_patch_cases },
+  { "materials", &run_materials_cases },
+};
+const uint32_t kNumBenchCases = sizeof(kBenchCases) / sizeof(kBenchCases[0]);
+
+// Track heap usage. The size is stored in front of each block, which keeps the blocks 16 byte aligned.
+void* operator new(size_t size)
+{
+  size_t* ptr = (size_t*)malloc(size + 16);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  *ptr = size;
+  ++g_allocations;
+  g_current_bytes += size;
+  g_peak_bytes = std::max<size_t>(g_peak_bytes, g_current_bytes);
+  return (uint8_t*)ptr + 16;
+}
+
+void operator delete(void* ptr)
+{
+  if (ptr == NULL) {
+    return;
+  }
+  size_t* block = (size_t*)((uint8_t*)ptr - 16);
+  g_current_bytes -= *block;
+  free(block);
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete[](void* ptr)
+{
+  operator delete(ptr);
+}
+
+int main(int argc, char** argv)
+{
+  const char* generator_filter = NULL;
+  const char* save_baseline_filename = NULL;
+  const char* baseline_filename = NULL;
+  uint32_t max_triangles = kTriangleCounts[kNumTriangleCounts - 1];
+  uint32_t max_nodes = kNodeCounts[kNumNodeCounts - 1];
+
+  for (int i = 1; i < argc - 1; i += 2) {
+    if (!strcmp(argv[i], "-generator")) {
+      generator_filter = argv[i + 1];
+    } else if (!strcmp(argv[i], "-max_triangles")) {
+      max_triangles = (uint32_t)atoi(argv[i + 1]);
+    } else if (!strcmp(argv[i], "-arena")) {
+      g_use_arena = atoi(argv[i + 1]) != 0;
+    } else if (!strcmp(argv[i], "-max_nodes")) {
+      max_nodes = (uint32_t)atoi(argv[i + 1]);
+    } else if (!strcmp(argv[i], "-save_baseline")) {
+      save_baseline_filename = argv[i + 1];
+    } else if (!strcmp(argv[i], "-baseline")) {
+      baseline_filename = argv[i + 1];
+    } else {
+      printf("unknown option: %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  // whether every check passed, the process fails otherwise
+  bool ok = true;
+  Results results;
+  for (uint32_t i = 0; i < kNumMeshGenerators; ++i) {
+    const MeshGenerator& generator = kMeshGenerators[i];
+    if (generator_filter && strcmp(generator_filter, generator.name)) {
+      continue;
+    }
+    for (uint32_t j = 0; j < kNumTriangleCounts && kTriangleCounts[j] <= max_triangles; ++j) {
+      try {
+        run_mesh_case(results, generator, kTriangleCounts[j]);
+      } catch (const std::bad_alloc&) {
+        printf("%-16s %10u tris  out of memory\n", generator.name, kTriangleCounts[j]);
+      }
+    }
+  }
+
+  const BenchOptions options = { max_triangles, max_nodes };
+  for (uint32_t i = 0; i < kNumBenchCases; ++i) {
+    if (!generator_filter || !strcmp(generator_filter, kBenchCases[i].name)) {
+      ok = kBenchCases[i].fn(results, options) && ok;
+    }
+  }
+
+  if (baseline_filename) {
+    Results baseline;
+    if (!load_baseline(baseline_filename, baseline)) {
+      printf("Unable to load baseline: %s\n", baseline_filename);
+      return 1;
+    }
+    ok = compare_baseline(baseline, results) && ok;
+  }
+
+  if (save_baseline_filename && !save_baseline(save_baseline_filename, results)) {
+    printf("Unable to save baseline: %s\n", save_baseline_filename);
+    return 1;
+  }
+
+  if (!ok) {
+    printf("\nSome checks failed\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,761 @@
+/**
+ * The "spatial" generator builds the SpatialIndex over 1K to 100K mesh bounds, and compares box
+ * queries through it against testing every mesh, and how many contiguous runs of meshes a query
+ * reads in export order and in leaf order. The "cells" generator runs the streaming cell export
+ * over 10K to 250K stand-in box meshes, and reads every cell back to check the partition. The
+ * "batching" generator merges 1K to 50K stand-in box meshes with a few materials into draw call
+ * batches, and checks every merged range against its source mesh. The "determinism" generator
+ * exports a stand-in scene with colliding mesh names through the exporter's mesh layout
+ * (batches, cells and a spatial index), and its textures, three times, the last with the
+ * textures processed in parallel, and checks that the outputs hash the same, and the same as in
+ * the -baseline file when it has them. The "patch" generator exports a scene, a version with one
+ * mesh moved and one with a mesh added as well, in the default block layout, with smaller
+ * blocks and in the patch layout, and measures the block hash patches between them against
+ * those of the whole file as one zlib stream.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <zlib.h>
+#include "BenchCommon.hpp"
+#include "../Exporter/BlockManifest.hpp"
+#include "../Exporter/DependencyManifest.hpp"
+#include "../Exporter/MeshBatching.hpp"
+#include "../Exporter/MeshLayout.hpp"
+#include "../Exporter/SpatialIndex.hpp"
+#include "../Exporter/StreamingCells.hpp"
+#include "../Exporter/StringTable.hpp"
+
+namespace
+{
+  // Box queries against the spatial index, each around a random mesh
+  const uint32_t kSpatialQueries = 1000;
+  const float kSpatialQuerySize = 100;
+
+  const uint32_t kCellMeshCounts[] = { 10000, 100000, 250000 };
+  const uint32_t kNumCellMeshCounts = sizeof(kCellMeshCounts) / sizeof(kCellMeshCounts[0]);
+  const float kCellSize = 128;
+
+  const uint32_t kBatchMeshCounts[] = { 1000, 10000, 50000 };
+  const uint32_t kNumBatchMeshCounts = sizeof(kBatchMeshCounts) / sizeof(kBatchMeshCounts[0]);
+  const uint32_t kBatchMaterials = 8;
+
+  // The scene exported repeatedly to check the output doesn't change, with a copy of every
+  // kDeterminismCopyStride-th mesh and a few textures. Every kDeterminismNameShare meshes get
+  // the same name candidate, as meshes whose paths sanitize to the same name do. Every
+  // kDeterminismStaticStride-th mesh is static, so the batches and the cells both get meshes
+  const uint32_t kDeterminismMeshCounts[] = { 1000, 10000 };
+  const uint32_t kNumDeterminismMeshCounts = sizeof(kDeterminismMeshCounts) / sizeof(kDeterminismMeshCounts[0]);
+  const uint32_t kDeterminismCopyStride = 7;
+  const uint32_t kDeterminismNameShare = 3;
+  const uint32_t kDeterminismStaticStride = 2;
+  const uint32_t kDeterminismTextures = 4;
+  const uint32_t kDeterminismTextureSize = 256;
+
+  // A scene and its edited version are exported in each layout, to compare the patches
+  const uint32_t kPatchMeshCounts[] = { 1000, 10000, 50000 };
+  const uint32_t kNumPatchMeshCounts = sizeof(kPatchMeshCounts) / sizeof(kPatchMeshCounts[0]);
+
+  // The layouts the patch generator compares
+  struct PatchLayout
+  {
+    const char* name;
+    uint32_t block_size;
+    bool patch_layout;
+  };
+
+  const PatchLayout kPatchLayouts[] = {
+    { "default", kRdxDefaultBlockSize, false },
+    { "small_blocks", kRdxPatchBlockSize, false },
+    { "patch_layout", kRdxPatchBlockSize, true },
+  };
+  const uint32_t kNumPatchLayouts = sizeof(kPatchLayouts) / sizeof(kPatchLayouts[0]);
+
+  bool overlaps(const Aabb& a, const float* min, const float* max)
+  {
+    return a.min.x <= max[0] && a.max.x >= min[0] && a.min.y <= max[1] && a.max.y >= min[1] &&
+      a.min.z <= max[2] && a.max.z >= min[2];
+  }
+
+  // Number of contiguous runs in a set of positions, which is the number of reads a loader
+  // streaming in the meshes would make
+  uint32_t count_runs(std::vector<uint32_t>& positions)
+  {
+    std::sort(positions.begin(), positions.end());
+    uint32_t runs = 0;
+    for (size_t i = 0; i < positions.size(); ++i) {
+      if (i == 0 || positions[i] != positions[i - 1] + 1) {
+        ++runs;
+      }
+    }
+    return runs;
+  }
+
+  // Appends the leaf positions of the items overlapping the query box
+  void query_index(std::vector<uint32_t>& hits, const SpatialIndex& index, const std::vector<Aabb>& bounds, const Aabb& query)
+  {
+    uint32_t stack[256];
+    uint32_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+      const BvhNode& node = index.nodes[stack[--depth]];
+      if (!overlaps(query, node.min, node.max)) {
+        continue;
+      }
+      if (node.count > 0) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+          if (overlaps(bounds[index.items[i]], query.min, query.max)) {
+            hits.push_back(i);
+          }
+        }
+      } else {
+        stack[depth++] = node.offset;
+        stack[depth++] = (uint32_t)(&node - &index.nodes[0]) + 1;
+      }
+    }
+  }
+
+  bool run_spatial_case(Results& results, const uint32_t mesh_count)
+  {
+    std::vector<Aabb> bounds;
+    make_mesh_bounds(bounds, mesh_count);
+
+    std::vector<Aabb> queries(kSpatialQueries);
+    uint32_t seed = mesh_count;
+    for (uint32_t i = 0; i < kSpatialQueries; ++i) {
+      seed = seed * 1664525 + 1013904223;
+      const Aabb& box = bounds[(seed >> 8) % mesh_count];
+      const D3DXVECTOR3 center(0.5f * (box.min + box.max));
+      const D3DXVECTOR3 half(0.5f * kSpatialQuerySize, 0.5f * kSpatialQuerySize, 0.5f * kSpatialQuerySize);
+      queries[i].min = center - half;
+      queries[i].max = center + half;
+    }
+
+    SpatialIndex index;
+    {
+      StageScope scope;
+      index.build(bounds);
+      add_result(results, make_key("spatial", mesh_count, "bvh_build"), scope);
+    }
+
+    uint64_t brute_hits = 0;
+    uint32_t export_order_runs = 0;
+    {
+      StageScope scope;
+      std::vector<uint32_t> hits;
+      for (uint32_t i = 0; i < kSpatialQueries; ++i) {
+        hits.clear();
+        for (uint32_t j = 0; j < mesh_count; ++j) {
+          if (overlaps(bounds[j], queries[i].min, queries[i].max)) {
+            hits.push_back(j);
+          }
+        }
+        brute_hits += hits.size();
+        export_order_runs += count_runs(hits);
+      }
+      add_result(results, make_key("spatial", mesh_count, "brute_query"), scope);
+    }
+
+    uint64_t bvh_hits = 0;
+    uint32_t leaf_order_runs = 0;
+    {
+      StageScope scope;
+      std::vector<uint32_t> hits;
+      for (uint32_t i = 0; i < kSpatialQueries; ++i) {
+        hits.clear();
+        query_index(hits, index, bounds, queries[i]);
+        bvh_hits += hits.size();
+        leaf_order_runs += count_runs(hits);
+      }
+      add_result(results, make_key("spatial", mesh_count, "bvh_query"), scope);
+    }
+
+    printf("%-16s %10u meshes  %8u nodes  sah cost %8.2f  %s\n", "spatial", mesh_count, (uint32_t)index.nodes.size(),
+      index.sah_cost(), brute_hits == bvh_hits ? "queries match" : "queries differ");
+    printf("    %.1f meshes per query, %.1f runs in export order, %.1f runs in leaf order\n",
+      (double)bvh_hits / kSpatialQueries, (double)export_order_runs / kSpatialQueries, (double)leaf_order_runs / kSpatialQueries);
+    const char* stages[] = { "bvh_build", "brute_query", "bvh_query" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("spatial", mesh_count, stages[i])];
+      printf("    %-14s %10.2f ms  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+    return brute_hits == bvh_hits;
+  }
+
+  // Writes a box mesh filling each aabb, with normals and a uv set like an exported mesh
+  void write_box_meshes(RdxWriter& writer, std::vector<uint32_t>& mesh_chunks, const std::vector<Aabb>& bounds)
+  {
+    StringTable strings;
+    VertexBuffer vertices;
+    vertices.resize(8);
+    IndexBuffer indices;
+    const uint32_t faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+    for (int i = 0; i < 6; ++i) {
+      const uint32_t tris[6] = { faces[i][0], faces[i][1], faces[i][2], faces[i][0], faces[i][2], faces[i][3] };
+      indices.insert(indices.end(), tris, tris + 6);
+    }
+
+    char name[32];
+    for (size_t i = 0; i < bounds.size(); ++i) {
+      const Aabb& box = bounds[i];
+      for (uint32_t j = 0; j < 8; ++j) {
+        float* v = vertices.vertex(j);
+        const D3DXVECTOR3 corner((j & 1) ? box.max.x : box.min.x, (j & 2) ? box.max.y : box.min.y, (j & 4) ? box.max.z : box.min.z);
+        D3DXVECTOR3 normal(corner - 0.5f * (box.min + box.max));
+        D3DXVec3Normalize(&normal, &normal);
+        memcpy(v, &corner, sizeof(corner));
+        memcpy(v + 3, &normal, sizeof(normal));
+        v[6] = (j & 1) ? 1.0f : 0.0f;
+        v[7] = (j & 2) ? 1.0f : 0.0f;
+      }
+      Bounds mesh_bounds;
+      compute_bounds(mesh_bounds, vertices.vertex(0), vertices.size(), vertices.stride(), Bounds::kAabbOnly, false);
+
+      sprintf_s(name, sizeof(name), "mesh_%u", (uint32_t)i);
+      mesh_chunks.push_back(writer.chunk_count());
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Mesh);
+      writer.write_generic<uint32_t>(strings.intern(name));
+      writer.write_generic<uint32_t>(0);
+      write_element_desc(writer, strings, vertices.format);
+      write_vertex_buffers(writer, vertices, indices);
+      write_bounds(writer, mesh_bounds);
+    }
+  }
+
+  // Reads back every cell, and checks that its meshes are centered in it and covered by its
+  // bounds and spatial index
+  bool check_cells(const std::vector<uint8_t>& pack, const std::vector<RdxCell>& manifest, uint32_t& mesh_count)
+  {
+    mesh_count = 0;
+    for (size_t i = 0; i < manifest.size(); ++i) {
+      const RdxCell& cell = manifest[i];
+      RdxFile file;
+      if (cell.offset % kRdxCellAlignment || cell.offset + cell.size > pack.size() ||
+        !file.open_memory(&pack[(size_t)cell.offset], cell.size)) {
+        return false;
+      }
+
+      uint32_t cell_meshes = 0;
+      RdxSpatialIndexView index;
+      for (uint32_t j = 0; j < file.chunk_count(); ++j) {
+        RdxChunk chunk;
+        if (!file.get_chunk(chunk, j)) {
+          return false;
+        }
+        if (chunk.id == RdxChunkId::SpatialIndex) {
+          if (!read_spatial_index(index, chunk)) {
+            return false;
+          }
+          continue;
+        }
+        RdxMeshView mesh;
+        if (chunk.id != RdxChunkId::Mesh || !read_mesh(mesh, chunk)) {
+          return false;
+        }
+        const float x = 0.5f * (mesh.aabb->min[0] + mesh.aabb->max[0]);
+        const float z = 0.5f * (mesh.aabb->min[2] + mesh.aabb->max[2]);
+        if (floorf(x / kCellSize) != cell.x || floorf(z / kCellSize) != cell.z) {
+          return false;
+        }
+        for (int k = 0; k < 3; ++k) {
+          if (mesh.aabb->min[k] < cell.bounds.min[k] || mesh.aabb->max[k] > cell.bounds.max[k]) {
+            return false;
+          }
+        }
+        ++cell_meshes;
+      }
+      if (cell_meshes != cell.mesh_count || index.mesh_ids.count != cell_meshes) {
+        return false;
+      }
+      mesh_count += cell_meshes;
+    }
+    return true;
+  }
+
+  bool run_cells_case(Results& results, const uint32_t mesh_count)
+  {
+    std::vector<Aabb> bounds;
+    make_mesh_bounds(bounds, mesh_count);
+    RdxWriter writer;
+    writer.init_writer(0);
+    std::vector<uint32_t> mesh_chunks;
+    write_box_meshes(writer, mesh_chunks, bounds);
+
+    CellPartition partition;
+    {
+      StageScope scope;
+      partition.build(bounds, kCellSize);
+      add_result(results, make_key("cells", mesh_count, "partition"), scope);
+    }
+
+    std::vector<uint8_t> pack;
+    std::vector<RdxCell> manifest;
+    bool ok = false;
+    {
+      StageScope scope;
+      ok = write_cell_pack(pack, manifest, partition, bounds, writer, mesh_chunks, kRdxDefaultBlockSize);
+      add_result(results, make_key("cells", mesh_count, "write_pack"), scope);
+    }
+
+    uint32_t cell_mesh_count = 0;
+    {
+      StageScope scope;
+      ok = ok && check_cells(pack, manifest, cell_mesh_count);
+      add_result(results, make_key("cells", mesh_count, "read_cells"), scope);
+    }
+
+    uint32_t largest = 0;
+    for (size_t i = 0; i < manifest.size(); ++i) {
+      largest = std::max<uint32_t>(largest, manifest[i].size);
+    }
+    printf("%-16s %10u meshes  %6u cells  %6u shared  pack %8.2f MB  largest cell %8.2f KB  %s\n", "cells", mesh_count,
+      (uint32_t)manifest.size(), (uint32_t)partition.shared.size(), pack.size() / (1024.0 * 1024.0), largest / 1024.0,
+      ok && cell_mesh_count + partition.shared.size() == mesh_count ? "cells valid" : "cells invalid");
+    const char* stages[] = { "partition", "write_pack", "read_cells" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("cells", mesh_count, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f Kmesh/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        mesh_count / std::max<double>(result.ms, 1e-6), result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+    return ok && cell_mesh_count + partition.shared.size() == mesh_count;
+  }
+
+  // The triangles of the index range as vertex data, each rotated to start at its smallest
+  // vertex and the list sorted, so ranges with reordered triangles compare equal
+  void sorted_triangles(std::vector<std::vector<float> >& triangles, const std::vector<float>& vertices,
+                        const uint32_t* indices, const uint32_t index_count, const uint32_t vertex_floats)
+  {
+    triangles.resize(index_count / 3);
+    for (uint32_t i = 0; i < index_count / 3; ++i) {
+      std::vector<const float*> corners(3);
+      for (uint32_t j = 0; j < 3; ++j) {
+        corners[j] = &vertices[indices[3 * i + j] * vertex_floats];
+      }
+      uint32_t first = 0;
+      for (uint32_t j = 1; j < 3; ++j) {
+        if (std::lexicographical_compare(corners[j], corners[j] + vertex_floats, corners[first], corners[first] + vertex_floats)) {
+          first = j;
+        }
+      }
+      triangles[i].clear();
+      for (uint32_t j = 0; j < 3; ++j) {
+        const float* v = corners[(first + j) % 3];
+        triangles[i].insert(triangles[i].end(), v, v + vertex_floats);
+      }
+    }
+    std::sort(triangles.begin(), triangles.end());
+  }
+
+  // Checks that each range of the batch mesh holds the triangles of its source mesh
+  bool check_batch(const RdxWriter& writer, const uint32_t batch_chunk, const MeshBatch& batch,
+                   const std::vector<BatchSource>& sources, const RdxMeshBatchRange* ranges)
+  {
+    RdxMeshView batch_mesh;
+    std::vector<float> batch_vertices;
+    std::vector<uint32_t> batch_indices;
+    if (!read_mesh(batch_mesh, writer_chunk(writer, batch_chunk)) ||
+      !decode_mesh(batch_vertices, batch_indices, batch_mesh) || batch_mesh.vertex_count > kMaxBatchVertices) {
+      return false;
+    }
+    const uint32_t vertex_floats = batch_mesh.vertex_size / sizeof(float);
+    std::vector<std::vector<float> > expected, actual;
+    for (size_t i = 0; i < batch.sources.size(); ++i) {
+      const RdxMeshBatchRange& range = ranges[i];
+      RdxMeshView mesh;
+      std::vector<float> vertices;
+      std::vector<uint32_t> indices;
+      if (!read_mesh(mesh, writer_chunk(writer, sources[batch.sources[i]].chunk)) ||
+        !decode_mesh(vertices, indices, mesh) || mesh.name != range.name ||
+        sources[batch.sources[i]].material != sources[batch.sources[0]].material ||
+        range.first_index + range.index_count > batch_indices.size() || range.index_count != indices.size() ||
+        memcmp(&range.aabb, mesh.aabb, sizeof(range.aabb))) {
+        return false;
+      }
+      for (uint32_t j = range.first_index; j < range.first_index + range.index_count; ++j) {
+        if (batch_indices[j] < range.first_vertex || batch_indices[j] >= range.first_vertex + range.vertex_count) {
+          return false;
+        }
+      }
+      sorted_triangles(expected, vertices, indices.empty() ? NULL : &indices[0], (uint32_t)indices.size(), vertex_floats);
+      sorted_triangles(actual, batch_vertices, &batch_indices[range.first_index], range.index_count, vertex_floats);
+      if (expected != actual) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool run_batching_case(Results& results, const uint32_t mesh_count)
+  {
+    std::vector<Aabb> bounds;
+    make_mesh_bounds(bounds, mesh_count);
+    RdxWriter writer;
+    writer.init_writer(0);
+    std::vector<uint32_t> mesh_chunks;
+    write_box_meshes(writer, mesh_chunks, bounds);
+
+    std::vector<BatchSource> sources(mesh_count);
+    for (uint32_t i = 0; i < mesh_count; ++i) {
+      sources[i].chunk = mesh_chunks[i];
+      sources[i].material = i % kBatchMaterials;
+      sources[i].aabb = bounds[i];
+    }
+
+    std::vector<MeshBatch> batches;
+    bool ok = false;
+    {
+      StageScope scope;
+      ok = plan_mesh_batches(batches, sources, writer, kMaxBatchVertices);
+      add_result(results, make_key("batching", mesh_count, "plan"), scope);
+    }
+
+    StringTable strings;
+    std::vector<RdxMeshBatch> batch_entries;
+    std::vector<RdxMeshBatchRange> ranges;
+    const uint32_t first_batch_chunk = writer.chunk_count();
+    {
+      StageScope scope;
+      for (size_t i = 0; ok && i < batches.size(); ++i) {
+        RdxMeshBatch entry = { (uint32_t)i, (uint32_t)ranges.size(), (uint32_t)batches[i].sources.size(), 0 };
+        batch_entries.push_back(entry);
+        Bounds batch_bounds;
+        ok = write_batch_mesh(writer, strings, batch_bounds, ranges, batches[i], sources, entry.mesh,
+          Bounds::kAabbOnly, false, true, false);
+      }
+      add_result(results, make_key("batching", mesh_count, "merge"), scope);
+    }
+
+    // the MeshBatches chunk reads back, and every range matches its source
+    RdxWriter batches_writer;
+    batches_writer.init_writer(0);
+    {
+      SCOPED_RDX_CHUNK(batches_writer, RdxChunkId::MeshBatches);
+      ok = ok && write_mesh_batches(batches_writer, batch_entries, ranges);
+    }
+    RdxMeshBatchesView view;
+    uint32_t merged = 0;
+    double extent = 0;
+    {
+      StageScope scope;
+      ok = ok && read_mesh_batches(view, writer_chunk(batches_writer, 0)) && view.batches.count == batches.size();
+      for (uint32_t i = 0; ok && i < view.batches.count; ++i) {
+        const RdxMeshBatch& batch = view.batches[i];
+        ok = check_batch(writer, first_batch_chunk + i, batches[i], sources, &view.ranges[batch.first_range]);
+        merged += batch.range_count;
+        RdxMeshView mesh;
+        read_mesh(mesh, writer_chunk(writer, first_batch_chunk + i));
+        const D3DXVECTOR3 size(mesh.aabb->max[0] - mesh.aabb->min[0], mesh.aabb->max[1] - mesh.aabb->min[1],
+          mesh.aabb->max[2] - mesh.aabb->min[2]);
+        extent += D3DXVec3Length(&size);
+      }
+      add_result(results, make_key("batching", mesh_count, "check"), scope);
+    }
+
+    const uint32_t draws = mesh_count - merged + (uint32_t)batches.size();
+    printf("%-16s %10u meshes  %6u batches  %8u draws  mean batch extent %8.1f  %s\n", "batching", mesh_count,
+      (uint32_t)batches.size(), draws, batches.empty() ? 0.0 : extent / batches.size(),
+      ok ? "batches valid" : "batches invalid");
+    const char* stages[] = { "plan", "merge", "check" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("batching", mesh_count, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f Kmesh/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        mesh_count / std::max<double>(result.ms, 1e-6), result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+    return ok;
+  }
+
+  // Exports a stand-in scene of box meshes with a few materials through layout_meshes, with the
+  // batches, the streaming cells and the spatial order on, as ReduxExporter runs it, then processes
+  // the scene's textures on thread_count threads. The hash covers the block compressed .rdx, the
+  // cell pack and the .rtx files
+  bool export_determinism_scene(uint64_t& hash, const std::vector<Aabb>& bounds, const uint32_t thread_count)
+  {
+    RdxWriter writer;
+    writer.init_writer(kRdxDefaultBlockSize);
+    std::vector<uint32_t> mesh_chunks;
+    write_box_meshes(writer, mesh_chunks, bounds);
+
+    // the names belong to this export, as ReduxExporter::mesh_names_ do
+    std::set<std::string> mesh_names;
+    StringTable strings;
+    char name[32];
+    uint32_t materials[kBatchMaterials];
+    for (uint32_t i = 0; i < kBatchMaterials; ++i) {
+      sprintf_s(name, sizeof(name), "material_%u", i);
+      materials[i] = strings.intern(name);
+    }
+    // the meshes that aren't static go to the cells
+    std::vector<BatchSource> sources;
+    std::vector<MeshBounds> mesh_bounds;
+    for (size_t i = 0; i < bounds.size(); ++i) {
+      sprintf_s(name, sizeof(name), "mesh_%u", (uint32_t)(i / kDeterminismNameShare));
+      strings.intern(make_unique_name(mesh_names, name));
+      mesh_bounds.push_back(MeshBounds(mesh_chunks[i], bounds[i]));
+      if (i % kDeterminismStaticStride == 0) {
+        BatchSource source;
+        source.chunk = mesh_chunks[i];
+        source.material = materials[i % kBatchMaterials];
+        source.aabb = bounds[i];
+        sources.push_back(source);
+      }
+    }
+
+    ExporterSettings settings;
+    settings.bounds_mode = Bounds::kAabbOnly;
+    settings.compute_bounding_box = false;
+    settings.encode_meshes = true;
+    settings.batch_meshes = true;
+    settings.stream_cell_size = kCellSize;
+    settings.spatial_order = true;
+    settings.compress = true;
+    MeshLayout layout;
+    bool ok = layout_meshes(layout, writer, strings, mesh_names, mesh_bounds, sources, mesh_chunks[0],
+      "determinism.cells", settings);
+    ok = ok && !layout.batches.empty() && !layout.manifest.empty() && layout.reordered;
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::StringTable);
+      ok = ok && strings.write(writer);
+    }
+    ok = ok && writer.end_of_data();
+    uint8_t* buf = NULL;
+    uint32_t len = 0;
+    writer.get_buffer(buf, len);
+    hash = hash_bytes(buf, len, 0);
+    hash = hash_bytes(layout.pack.empty() ? NULL : &layout.pack[0], layout.pack.size(), hash);
+
+    std::vector<TextureJob> jobs(kDeterminismTextures);
+    for (uint32_t i = 0; i < kDeterminismTextures; ++i) {
+      make_texture(jobs[i].image, kDeterminismTextureSize, kDeterminismTextureSize, (i & 1) != 0, i);
+      sprintf_s(name, sizeof(name), "determinism_%u.rtx", i);
+      jobs[i].filename = name;
+    }
+    process_textures(jobs, TextureFilter::kBox, true, thread_count);
+    for (uint32_t i = 0; i < kDeterminismTextures; ++i) {
+      std::vector<uint8_t> blob;
+      ok = ok && jobs[i].ok && load_file(jobs[i].filename.c_str(), blob);
+      hash = hash_bytes(blob.empty() ? NULL : &blob[0], blob.size(), hash);
+      remove(jobs[i].filename.c_str());
+    }
+    return ok;
+  }
+
+  // Names the meshes of two exports with candidates that collide with each other and with the
+  // suffixed names, and checks both exports get the expected names
+  bool check_unique_names()
+  {
+    const char* candidates[] = { "mesh_0", "mesh_0", "mesh_0a", "batch_0", "mesh_0", "batch_0" };
+    const char* expected[] = { "mesh_0", "mesh_0a", "mesh_0aa", "batch_0", "mesh_0aaa", "batch_0a" };
+    for (uint32_t export_idx = 0; export_idx < 2; ++export_idx) {
+      std::set<std::string> names;
+      for (uint32_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i) {
+        if (make_unique_name(names, candidates[i]) != expected[i]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Exports the same scene twice on one thread, as a second export in the same session would,
+  // and once with the textures processed in parallel, and checks the outputs are identical. Only
+  // the texture processing runs on more than one thread in the exporter
+  bool run_determinism_case(Results& results, const uint32_t mesh_count)
+  {
+    std::vector<Aabb> bounds;
+    make_mesh_bounds(bounds, mesh_count);
+    // copies of some meshes, so the spatial index has coincident centroids to break ties between
+    for (uint32_t i = 0; i < mesh_count; i += kDeterminismCopyStride) {
+      bounds.push_back(bounds[i]);
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const char* stages[] = { "first", "second", "parallel_textures" };
+    const uint32_t thread_counts[] = { 1, 1, std::max<uint32_t>(info.dwNumberOfProcessors, 2) };
+    uint64_t hashes[3] = { 0 };
+    bool ok = check_unique_names();
+    for (uint32_t i = 0; i < 3; ++i) {
+      StageScope scope;
+      ok = export_determinism_scene(hashes[i], bounds, thread_counts[i]) && ok;
+      add_result(results, make_key("determinism", mesh_count, stages[i]), scope);
+      results[make_key("determinism", mesh_count, stages[i])].hash = hashes[i];
+    }
+
+    ok = ok && hashes[0] == hashes[1] && hashes[0] == hashes[2];
+    printf("%-16s %10u meshes  hash %08x%08x  %s\n", "determinism", (uint32_t)bounds.size(),
+      (uint32_t)(hashes[0] >> 32), (uint32_t)hashes[0], ok ? "outputs identical" : "outputs differ");
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("determinism", mesh_count, stages[i])];
+      printf("    %-17s %10.2f ms  %2u threads  peak %8.2f MB  %8u allocs\n", stages[i], result.ms, thread_counts[i],
+        result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+    return ok;
+  }
+
+  // Box meshes in the leaf order of their spatial index, as a spatial order export writes them
+  void write_patch_scene(std::vector<uint8_t>& file, const std::vector<Aabb>& bounds, const PatchLayout& layout)
+  {
+    RdxWriter writer;
+    writer.init_writer(layout.block_size, layout.patch_layout);
+    std::vector<uint32_t> mesh_chunks;
+    write_box_meshes(writer, mesh_chunks, bounds);
+    SpatialIndex index;
+    index.build(bounds);
+    const std::vector<uint32_t> order(index.items);
+    std::vector<uint32_t> mesh_ids(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+      mesh_ids[order[i]] = i;
+    }
+    index.remap_items(mesh_ids);
+    writer.reorder_chunks(0, order);
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::SpatialIndex);
+      index.write(writer);
+    }
+    writer.end_of_data();
+    uint8_t* buf = NULL;
+    uint32_t len = 0;
+    writer.get_buffer(buf, len);
+    file.assign(buf, buf + len);
+  }
+
+  // Whether the files hold the same chunks
+  bool same_chunks(const std::vector<uint8_t>& lhs, const std::vector<uint8_t>& rhs)
+  {
+    RdxFile lhs_file, rhs_file;
+    if (!lhs_file.open_memory(&lhs[0], (uint32_t)lhs.size()) || !rhs_file.open_memory(&rhs[0], (uint32_t)rhs.size()) ||
+      lhs_file.chunk_count() != rhs_file.chunk_count()) {
+      return false;
+    }
+    for (uint32_t i = 0; i < lhs_file.chunk_count(); ++i) {
+      RdxChunk lhs_chunk, rhs_chunk;
+      if (!lhs_file.get_chunk(lhs_chunk, i) || !rhs_file.get_chunk(rhs_chunk, i) || lhs_chunk.id != rhs_chunk.id ||
+        lhs_chunk.size != rhs_chunk.size || memcmp(lhs_chunk.data, rhs_chunk.data, lhs_chunk.size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The patch from the old file to the new one: the pieces of the new file the old one doesn't have
+  uint64_t file_patch_size(const std::vector<uint8_t>& old_file, const std::vector<uint8_t>& new_file)
+  {
+    BlockManifest old_blocks, new_blocks;
+    hash_blocks(old_blocks, &old_file[0], (uint32_t)old_file.size());
+    hash_blocks(new_blocks, &new_file[0], (uint32_t)new_file.size());
+    return patch_size(old_blocks, new_blocks);
+  }
+
+  // Exports a scene and two lightly edited versions of it, one with a mesh moved and one with
+  // a mesh added as well, and measures the patches to them in each layout. The whole file as
+  // one zlib stream is the worst case
+  bool run_patch_case(Results& results, const uint32_t mesh_count)
+  {
+    std::vector<Aabb> versions[3];
+    make_mesh_bounds(versions[0], mesh_count);
+    const D3DXVECTOR3 offset(1, 0, 1);
+    versions[1] = versions[0];
+    versions[1][mesh_count / 2].min += offset;
+    versions[1][mesh_count / 2].max += offset;
+    versions[2] = versions[1];
+    Aabb added = versions[0][mesh_count / 3];
+    added.min += 5.0f * offset;
+    added.max += 5.0f * offset;
+    versions[2].push_back(added);
+
+    std::vector<uint8_t> files[kNumPatchLayouts][3];
+    uint64_t moved_patches[kNumPatchLayouts] = { 0 };
+    uint64_t added_patches[kNumPatchLayouts] = { 0 };
+    for (uint32_t i = 0; i < kNumPatchLayouts; ++i) {
+      StageScope scope;
+      for (uint32_t j = 0; j < 3; ++j) {
+        write_patch_scene(files[i][j], versions[j], kPatchLayouts[i]);
+      }
+      moved_patches[i] = file_patch_size(files[i][0], files[i][1]);
+      added_patches[i] = file_patch_size(files[i][0], files[i][2]);
+      add_result(results, make_key("patch", mesh_count, kPatchLayouts[i].name), scope);
+    }
+
+    // the uncompressed files as single zlib streams
+    std::vector<uint8_t> streams[3];
+    const PatchLayout raw_layout = { "raw", 0, false };
+    for (uint32_t j = 0; j < 3; ++j) {
+      std::vector<uint8_t> raw;
+      write_patch_scene(raw, versions[j], raw_layout);
+      streams[j].resize(compressBound((uLong)raw.size()));
+      uLongf len = (uLongf)streams[j].size();
+      compress2(&streams[j][0], &len, &raw[0], (uLong)raw.size(), Z_DEFAULT_COMPRESSION);
+      streams[j].resize(len);
+    }
+
+    // every layout holds the same chunks, and the patch layout's patches are the smallest
+    bool ok = true;
+    for (uint32_t i = 1; i < kNumPatchLayouts; ++i) {
+      for (uint32_t j = 0; j < 3; ++j) {
+        ok = ok && same_chunks(files[0][j], files[i][j]);
+      }
+      ok = ok && added_patches[kNumPatchLayouts - 1] <= added_patches[i - 1];
+    }
+    printf("%-16s %10u meshes  stream %8.2f MB  move patch %8.2f MB  add patch %8.2f MB  %s\n", "patch", mesh_count,
+      streams[0].size() / (1024.0 * 1024.0), file_patch_size(streams[0], streams[1]) / (1024.0 * 1024.0),
+      file_patch_size(streams[0], streams[2]) / (1024.0 * 1024.0), ok ? "layouts match" : "layouts differ");
+    for (uint32_t i = 0; i < kNumPatchLayouts; ++i) {
+      const StageResult& result = results[make_key("patch", mesh_count, kPatchLayouts[i].name)];
+      printf("    %-14s %10.2f ms  file %8.2f MB  move patch %8.2f MB %6.2f%%  add patch %8.2f MB %6.2f%%\n",
+        kPatchLayouts[i].name, result.ms, files[i][0].size() / (1024.0 * 1024.0),
+        moved_patches[i] / (1024.0 * 1024.0), 100.0 * moved_patches[i] / files[i][1].size(),
+        added_patches[i] / (1024.0 * 1024.0), 100.0 * added_patches[i] / files[i][2].size());
+    }
+    return ok;
+  }
+}
+
+bool run_spatial_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumNodeCounts && kNodeCounts[i] <= options.max_nodes; ++i) {
+    ok = run_spatial_case(results, kNodeCounts[i]) && ok;
+  }
+  return ok;
+}
+
+bool run_cells_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumCellMeshCounts; ++i) {
+    ok = run_cells_case(results, kCellMeshCounts[i]) && ok;
+  }
+  return ok;
+}
+
+bool run_batching_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumBatchMeshCounts; ++i) {
+    ok = run_batching_case(results, kBatchMeshCounts[i]) && ok;
+  }
+  return ok;
+}
+
+bool run_determinism_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumDeterminismMeshCounts; ++i) {
+    ok = run_determinism_case(results, kDeterminismMeshCounts[i]) && ok;
+  }
+  return ok;
+}
+
+bool run_patch_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumPatchMeshCounts; ++i) {
+    ok = run_patch_case(results, kPatchMeshCounts[i]) && ok;
+  }
+  return ok;
+}
@@ -0,0 +1,375 @@
+/**
+ * The mesh stages (coordinate conversion, tangent generation, welding, vertex cache
+ * optimization, cache miss counting, bounding volumes and chunk serialization) over the meshes
+ * of every generator from 1K to 10M triangles, with time, throughput, peak heap usage and
+ * ACMR/ATVR for each. They draw their temporaries from an Arena like the exporter does. The
+ * "codec" generator encodes the meshes of every generator, compares their block compressed
+ * size against the raw buffers, and checks the decoded meshes against the source, and that
+ * forged counts are rejected.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include "BenchCommon.hpp"
+#include "../Exporter/Arena.hpp"
+#include "../Exporter/vcacheopt.h"
+#include "../Reader/RdxMeshCodec.hpp"
+
+namespace
+{
+  // Worst angle between a source normal or tangent and the decoded one, in degrees. 16 bit
+  // octahedral encoding is good to about 0.01 degrees
+  const float kMaxCodecNormalError = 0.05f;
+
+  struct CacheResult
+  {
+    CacheResult() : pre_misses(0), post_misses(0), vertices(0), triangles(0), approx_radius(0), exact_radius(0) {}
+    uint32_t pre_misses;
+    uint32_t post_misses;
+    uint32_t vertices;
+    uint32_t triangles;
+    float approx_radius;
+    float exact_radius;
+  };
+
+  // The stages MeshExporter::export_mesh runs for a mesh
+  void process_mesh(Results& results, CacheResult& cache_result, RdxWriter& writer, const MeshGenerator& generator,
+                    const uint32_t target_triangles, const SourceMesh& mesh)
+  {
+    MayaArrays arrays;
+    make_maya_arrays(arrays, mesh);
+    MeshStreams streams;
+    {
+      StageScope scope;
+      convert_maya_arrays(streams, arrays);
+      add_result(results, make_key(generator.name, target_triangles, "convert"), scope);
+    }
+
+    // the exporter's default vertex format
+    VertexBuffer candidates;
+    candidates.format = make_vertex_format(streams, true);
+    for (size_t i = 0; i < mesh.sub_meshes.size(); ++i) {
+      const SourceSubMesh& sub_mesh = mesh.sub_meshes[i];
+      if (sub_mesh.triangles.empty()) {
+        continue;
+      }
+
+      {
+        StageScope scope;
+        gather_candidates(candidates, streams, sub_mesh.corners, sub_mesh.stream_indices);
+        add_result(results, make_key(generator.name, target_triangles, "gather"), scope);
+      }
+
+      {
+        StageScope scope;
+        compute_tangents(candidates, sub_mesh.triangles);
+        add_result(results, make_key(generator.name, target_triangles, "tangents"), scope);
+      }
+
+      VertexBuffer super_verts;
+      IndexBuffer indices;
+      {
+        StageScope scope;
+        IndexBuffer vertex_mapping;
+        weld_vertices(super_verts, vertex_mapping, candidates);
+        remap_indices(indices, sub_mesh.triangles, vertex_mapping, false);
+        add_result(results, make_key(generator.name, target_triangles, "weld"), scope);
+      }
+
+      const int32_t tri_count = (int32_t)indices.size() / 3;
+      {
+        StageScope scope;
+        VertexCache cache;
+        cache_result.pre_misses += cache.GetCacheMissCount((int*)&indices[0], tri_count);
+        add_result(results, make_key(generator.name, target_triangles, "miss_count"), scope);
+      }
+
+      {
+        StageScope scope;
+        VertexCacheOptimizer vcache;
+        vcache.Optimize((int*)&indices[0], tri_count);
+        add_result(results, make_key(generator.name, target_triangles, "vcache"), scope);
+      }
+
+      VertexCache cache;
+      cache_result.post_misses += cache.GetCacheMissCount((int*)&indices[0], tri_count);
+      cache_result.vertices += (uint32_t)super_verts.size();
+      cache_result.triangles += tri_count;
+
+      const float* positions = super_verts.vertex(0);
+      const uint32_t vertex_count = super_verts.size();
+      const uint32_t stride = super_verts.stride();
+      {
+        StageScope scope;
+        Aabb aabb;
+        compute_aabb(aabb, positions, vertex_count, stride);
+        add_result(results, make_key(generator.name, target_triangles, "bounds_aabb"), scope);
+      }
+
+      Sphere approx, exact;
+      {
+        StageScope scope;
+        compute_approx_sphere(approx, positions, vertex_count, stride);
+        add_result(results, make_key(generator.name, target_triangles, "bounds_approx"), scope);
+      }
+
+      {
+        StageScope scope;
+        compute_exact_sphere(exact, positions, vertex_count, stride);
+        add_result(results, make_key(generator.name, target_triangles, "bounds_exact"), scope);
+      }
+      cache_result.approx_radius += approx.radius;
+      cache_result.exact_radius += exact.radius;
+
+      {
+        StageScope scope;
+        Obb obb;
+        compute_obb(obb, positions, vertex_count, stride);
+        add_result(results, make_key(generator.name, target_triangles, "bounds_obb"), scope);
+      }
+
+      {
+        StageScope scope;
+        SCOPED_RDX_CHUNK(writer, RdxChunkId::Mesh);
+        write_vertex_buffers(writer, super_verts, indices);
+        add_result(results, make_key(generator.name, target_triangles, "serialize"), scope);
+      }
+    }
+  }
+
+  void run_case(Results& results, CacheResult& cache_result, const MeshGenerator& generator, const uint32_t target_triangles)
+  {
+    SourceMesh mesh;
+    generator.fn(mesh, target_triangles);
+    const uint32_t triangles = mesh.triangle_count();
+
+    RdxWriter writer;
+    writer.init_writer(kRdxDefaultBlockSize);
+
+    // the arena isn't seen by the heap tracking, so its size is reported separately
+    Arena arena;
+    if (g_use_arena) {
+      ScopedArena scoped_arena(arena);
+      process_mesh(results, cache_result, writer, generator, target_triangles, mesh);
+    } else {
+      process_mesh(results, cache_result, writer, generator, target_triangles, mesh);
+    }
+
+    // compression of the chunk stream is part of serialization
+    StageScope scope;
+    writer.end_of_data();
+    uint8_t* buf = NULL;
+    uint32_t len = 0;
+    writer.get_buffer(buf, len);
+    add_result(results, make_key(generator.name, target_triangles, "serialize"), scope);
+
+    printf("%-16s %10u tris  %10u verts  ACMR %.3f -> %.3f  ATVR %.3f -> %.3f\n",
+      generator.name, triangles, cache_result.vertices,
+      cache_result.pre_misses / (double)cache_result.triangles, cache_result.post_misses / (double)cache_result.triangles,
+      cache_result.pre_misses / (double)cache_result.vertices, cache_result.post_misses / (double)cache_result.vertices);
+    printf("    approx sphere radius %+.2f%% of exact\n",
+      100.0 * (cache_result.approx_radius - cache_result.exact_radius) / std::max<double>(cache_result.exact_radius, 1e-6));
+    if (g_use_arena) {
+      printf("    arena %u allocations, %u blocks, high water %.2f MB\n",
+        arena.allocations(), arena.block_allocations(), arena.high_water_mark() / (1024.0 * 1024.0));
+    }
+
+    const char* stages[] = { "convert", "gather", "tangents", "weld", "miss_count", "vcache", "bounds_aabb", "bounds_approx", "bounds_exact", "bounds_obb", "serialize" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key(generator.name, target_triangles, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f Mtri/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        triangles / (1000.0 * std::max<double>(result.ms, 1e-6)), result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+  }
+
+  struct CodecResult
+  {
+    CodecResult() : raw_bytes(0), encoded_bytes(0), decoded_bytes(0), max_normal_error(0), valid(true) {}
+    uint64_t raw_bytes;
+    uint64_t encoded_bytes;
+    uint64_t decoded_bytes;
+    float max_normal_error;     // degrees
+    bool valid;
+  };
+
+  float angle_between(const float* a, const float* b)
+  {
+    const D3DXVECTOR3 u(a[0], a[1], a[2]);
+    const D3DXVECTOR3 v(b[0], b[1], b[2]);
+    const float len = D3DXVec3Length(&u) * D3DXVec3Length(&v);
+    if (len <= 1e-20f) {
+      return 0;
+    }
+    return acosf(std::max<float>(-1, std::min<float>(1, D3DXVec3Dot(&u, &v) / len))) * 180.0f / D3DX_PI;
+  }
+
+  // The decoded mesh has to match the source up to the quantization: positions within half a
+  // grid step, normals and tangents within kMaxCodecNormalError, the rest exactly, and the same
+  // triangles up to rotation
+  void check_decoded(CodecResult& codec_result, const VertexBuffer& verts, const IndexBuffer& indices,
+                     const std::vector<float>& decoded_verts, const std::vector<uint32_t>& decoded_indices)
+  {
+    const VertexFormat& format = verts.format;
+    const uint32_t vertex_size = format.vertex_size();
+    Aabb aabb;
+    compute_aabb(aabb, verts.vertex(0), verts.size(), verts.stride());
+    float tolerance[3];
+    for (int i = 0; i < 3; ++i) {
+      tolerance[i] = 0.51f * (aabb.max[i] - aabb.min[i]) / 65535.0f +
+        4 * FLT_EPSILON * std::max<float>(fabsf(aabb.min[i]), fabsf(aabb.max[i]));
+    }
+
+    for (uint32_t i = 0; i < verts.size(); ++i) {
+      const float* v = verts.vertex(i);
+      const float* d = &decoded_verts[i * vertex_size];
+      for (int j = 0; j < 3; ++j) {
+        codec_result.valid &= fabsf(v[j] - d[j]) <= tolerance[j];
+      }
+      float error = angle_between(v + 3, d + 3);
+      if (format.tangents) {
+        const uint32_t t = format.tangent_offset();
+        error = std::max<float>(error, angle_between(v + t, d + t));
+        codec_result.valid &= (v[t + 3] < 0) == (d[t + 3] < 0);
+      }
+      codec_result.max_normal_error = std::max<float>(codec_result.max_normal_error, error);
+      const uint32_t uv_offset = format.uv_offset(0);
+      codec_result.valid &= !memcmp(v + uv_offset, d + uv_offset, (vertex_size - uv_offset) * sizeof(float));
+    }
+    codec_result.valid &= codec_result.max_normal_error <= kMaxCodecNormalError;
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      bool same = false;
+      for (int r = 0; r < 3 && !same; ++r) {
+        same = decoded_indices[i] == indices[i + r] && decoded_indices[i + 1] == indices[i + (r + 1) % 3] &&
+          decoded_indices[i + 2] == indices[i + (r + 2) % 3];
+      }
+      codec_result.valid &= same;
+    }
+  }
+
+  // Compares the raw and encoded mesh buffers, both block compressed, and round trips the
+  // encoded ones
+  bool run_codec_case(Results& results, const MeshGenerator& generator, const uint32_t target_triangles)
+  {
+    SourceMesh mesh;
+    generator.fn(mesh, target_triangles);
+    Arena arena;
+    ScopedArena scoped_arena(arena);
+    MayaArrays arrays;
+    make_maya_arrays(arrays, mesh);
+    MeshStreams streams;
+    convert_maya_arrays(streams, arrays);
+
+    RdxWriter raw_writer;
+    raw_writer.init_writer(kRdxDefaultBlockSize);
+    RdxWriter encoded_writer;
+    encoded_writer.init_writer(kRdxDefaultBlockSize);
+    CodecResult codec_result;
+    VertexBuffer candidates;
+    candidates.format = make_vertex_format(streams, true);
+    for (size_t i = 0; i < mesh.sub_meshes.size(); ++i) {
+      const SourceSubMesh& sub_mesh = mesh.sub_meshes[i];
+      if (sub_mesh.triangles.empty()) {
+        continue;
+      }
+      gather_candidates(candidates, streams, sub_mesh.corners, sub_mesh.stream_indices);
+      compute_tangents(candidates, sub_mesh.triangles);
+      VertexBuffer super_verts;
+      IndexBuffer vertex_mapping;
+      IndexBuffer indices;
+      weld_vertices(super_verts, vertex_mapping, candidates);
+      remap_indices(indices, sub_mesh.triangles, vertex_mapping, false);
+      optimize_vertex_cache(indices);
+      reorder_vertices(super_verts, indices);
+
+      {
+        SCOPED_RDX_CHUNK(raw_writer, RdxChunkId::Mesh);
+        write_vertex_buffers(raw_writer, super_verts, indices);
+      }
+
+      EncodedBuffers encoded;
+      {
+        StageScope scope;
+        codec_result.valid &= encode_vertex_buffers(encoded, super_verts, indices);
+        add_result(results, make_key(generator.name, target_triangles, "encode"), scope);
+      }
+      {
+        SCOPED_RDX_CHUNK(encoded_writer, RdxChunkId::Mesh);
+        write_encoded_vertex_buffers(encoded_writer, encoded);
+      }
+
+      std::vector<float> decoded_verts(super_verts.data.size());
+      std::vector<uint32_t> decoded_indices(indices.size());
+      {
+        StageScope scope;
+        codec_result.valid &=
+          decode_vertices(&decoded_verts[0], encoded.vertex_count, super_verts.format.vertex_size(),
+            &encoded.vertices[0], (uint32_t)encoded.vertices.size()) &&
+          decode_indices(&decoded_indices[0], encoded.index_count, encoded.vertex_count,
+            &encoded.indices[0], (uint32_t)encoded.indices.size());
+        add_result(results, make_key(generator.name, target_triangles, "decode"), scope);
+      }
+      codec_result.decoded_bytes += super_verts.data.size() * sizeof(float) + indices.size() * sizeof(uint32_t);
+      if (codec_result.valid) {
+        check_decoded(codec_result, super_verts, indices, decoded_verts, decoded_indices);
+      }
+
+      // counts that don't fit the encoded bytes are rejected before decoding sizes the buffers
+      RdxMeshView view;
+      view.encoding = RdxMeshEncoding::Encoded;
+      view.vertex_count = encoded.vertex_count;
+      view.vertex_size = super_verts.format.vertex_size() * sizeof(float);
+      view.index_count = encoded.index_count;
+      view.encoded_vertices.data = &encoded.vertices[0];
+      view.encoded_vertices.count = (uint32_t)encoded.vertices.size();
+      view.encoded_indices.data = &encoded.indices[0];
+      view.encoded_indices.count = (uint32_t)encoded.indices.size();
+      RdxMeshView forged_vertices(view);
+      forged_vertices.vertex_count = 0x40000000;
+      RdxMeshView forged_indices(view);
+      forged_indices.index_count = 3 * (view.encoded_indices.count + 1);
+      std::vector<float> forged_verts;
+      std::vector<uint32_t> forged_index;
+      codec_result.valid &= !decode_mesh(forged_verts, forged_index, forged_vertices) &&
+        !decode_mesh(forged_verts, forged_index, forged_indices);
+    }
+
+    raw_writer.end_of_data();
+    encoded_writer.end_of_data();
+    uint8_t* buf = NULL;
+    uint32_t len = 0;
+    raw_writer.get_buffer(buf, len);
+    codec_result.raw_bytes = len;
+    encoded_writer.get_buffer(buf, len);
+    codec_result.encoded_bytes = len;
+
+    const StageResult& encode = results[make_key(generator.name, target_triangles, "encode")];
+    const StageResult& decode = results[make_key(generator.name, target_triangles, "decode")];
+    printf("%-16s %10u tris  raw %8.2f MB  encoded %8.2f MB  (%5.1f%%)  normals %.4f deg  %s\n", generator.name,
+      mesh.triangle_count(), codec_result.raw_bytes / (1024.0 * 1024.0), codec_result.encoded_bytes / (1024.0 * 1024.0),
+      100.0 * codec_result.encoded_bytes / std::max<double>((double)codec_result.raw_bytes, 1),
+      codec_result.max_normal_error, codec_result.valid ? "round trip ok" : "round trip failed");
+    printf("    encode %10.2f ms  decode %10.2f ms  %8.2f GB/s\n", encode.ms, decode.ms,
+      codec_result.decoded_bytes / (1024.0 * 1024.0 * 1024.0) * 1000.0 / std::max<double>(decode.ms, 1e-6));
+    return codec_result.valid;
+  }
+}
+
+void run_mesh_case(Results& results, const MeshGenerator& generator, const uint32_t target_triangles)
+{
+  CacheResult cache_result;
+  run_case(results, cache_result, generator, target_triangles);
+}
+
+bool run_codec_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumMeshGenerators; ++i) {
+    for (uint32_t j = 0; j < kNumTriangleCounts && kTriangleCounts[j] <= std::min<uint32_t>(options.max_triangles, 100000); ++j) {
+      ok = run_codec_case(results, kMeshGenerators[i], kTriangleCounts[j]) && ok;
+    }
+  }
+  return ok;
+}
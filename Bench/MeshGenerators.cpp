@@ -0,0 +1,386 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include "MeshGenerators.hpp"
+
+namespace
+{
+  const float kPi = 3.14159265f;
+
+  // Small LCG so the generated meshes are identical between runs and platforms
+  struct Random
+  {
+    Random(const uint32_t seed) : state_(seed) {}
+    uint32_t next() { state_ = state_ * 1664525 + 1013904223; return state_ >> 8; }
+    float next_float() { return (next() & 0xffff) / 65535.0f; }
+    uint32_t state_;
+  };
+
+  // Adds a polygon to the sub mesh, and fan triangulates it like MItMeshPolygon::getTriangles
+  // does for convex polygons
+  void add_polygon(SourceSubMesh& sub_mesh, const uint32_t* pos, const uint32_t* normal, const uint32_t* uv, const uint32_t count)
+  {
+    const uint32_t first = (uint32_t)sub_mesh.corners.size();
+    for (uint32_t i = 0; i < count; ++i) {
+      sub_mesh.corners.push_back(Corner(pos[i], normal[i], uv[i]));
+      sub_mesh.stream_indices.push_back(uv[i]);
+    }
+    for (uint32_t i = 1; i + 1 < count; ++i) {
+      Triangle tri;
+      tri.i[0] = first;
+      tri.i[1] = first + i;
+      tri.i[2] = first + i + 1;
+      sub_mesh.triangles.push_back(tri);
+    }
+  }
+
+  uint32_t grid_side(const uint32_t target_triangles)
+  {
+    return std::max<uint32_t>(1, (uint32_t)sqrtf(target_triangles / 2.0f));
+  }
+
+  // Smooth grid, with positions, normals and uvs shared between all faces. The best case for the welder.
+  void add_grid_vertices(SourceMesh& mesh, const uint32_t side)
+  {
+    for (uint32_t y = 0; y <= side; ++y) {
+      for (uint32_t x = 0; x <= side; ++x) {
+        mesh.positions.push_back(D3DXVECTOR3((float)x, 0, (float)y));
+        mesh.normals.push_back(D3DXVECTOR3(0, 1, 0));
+        mesh.uvs.push_back(D3DXVECTOR2(x / (float)side, y / (float)side));
+      }
+    }
+  }
+
+  void grid_quad(uint32_t* idx, const uint32_t x, const uint32_t y, const uint32_t side)
+  {
+    const uint32_t stride = side + 1;
+    idx[0] = y * stride + x;
+    idx[1] = y * stride + x + 1;
+    idx[2] = (y + 1) * stride + x + 1;
+    idx[3] = (y + 1) * stride + x;
+  }
+
+  void generate_grid(SourceMesh& mesh, const uint32_t target_triangles)
+  {
+    const uint32_t side = grid_side(target_triangles);
+    add_grid_vertices(mesh, side);
+    mesh.sub_meshes.resize(1);
+    for (uint32_t y = 0; y < side; ++y) {
+      for (uint32_t x = 0; x < side; ++x) {
+        uint32_t idx[4];
+        grid_quad(idx, x, y, side);
+        add_polygon(mesh.sub_meshes[0], idx, idx, idx, 4);
+      }
+    }
+  }
+
+  void add_sphere(SourceMesh& mesh, SourceSubMesh& sub_mesh, const uint32_t target_triangles, const float noise, Random& random)
+  {
+    const uint32_t rings = std::max<uint32_t>(2, (uint32_t)sqrtf(target_triangles / 4.0f));
+    const uint32_t segments = 2 * rings;
+    const uint32_t first = (uint32_t)mesh.positions.size();
+    const uint32_t first_uv = (uint32_t)mesh.uvs.size();
+
+    // The seam column is duplicated in uv space, but not in position space
+    for (uint32_t r = 0; r <= rings; ++r) {
+      const float theta = kPi * r / rings;
+      for (uint32_t s = 0; s <= segments; ++s) {
+        const float phi = 2 * kPi * s / segments;
+        if (s < segments) {
+          const float radius = 1 + noise * (random.next_float() - 0.5f);
+          const D3DXVECTOR3 n(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+          mesh.positions.push_back(radius * n);
+          mesh.normals.push_back(n);
+        }
+        mesh.uvs.push_back(D3DXVECTOR2(s / (float)segments, r / (float)rings));
+      }
+    }
+
+    for (uint32_t r = 0; r < rings; ++r) {
+      for (uint32_t s = 0; s < segments; ++s) {
+        const uint32_t s1 = (s + 1) % segments;
+        uint32_t pos[4] = {
+          first + r * segments + s, first + r * segments + s1,
+          first + (r + 1) * segments + s1, first + (r + 1) * segments + s };
+        uint32_t uv[4] = {
+          first_uv + r * (segments + 1) + s, first_uv + r * (segments + 1) + s + 1,
+          first_uv + (r + 1) * (segments + 1) + s + 1, first_uv + (r + 1) * (segments + 1) + s };
+        add_polygon(sub_mesh, pos, pos, uv, 4);
+      }
+    }
+  }
+
+  void generate_sphere(SourceMesh& mesh, const uint32_t target_triangles)
+  {
+    Random random(1);
+    mesh.sub_meshes.resize(1);
+    add_sphere(mesh, mesh.sub_meshes[0], target_triangles, 0, random);
+  }
+
+  // Noisy sphere with the faces in random order, like data coming out of a scanner.
+  void generate_noisy_scan(SourceMesh& mesh, const uint32_t target_triangles)
+  {
+    Random random(2);
+    mesh.sub_meshes.resize(1);
+    SourceSubMesh ordered;
+    add_sphere(mesh, ordered, target_triangles, 0.05f, random);
+
+    // shuffle the quads (2 triangles, 4 corners each)
+    const uint32_t quad_count = (uint32_t)ordered.triangles.size() / 2;
+    std::vector<uint32_t> order(quad_count);
+    for (uint32_t i = 0; i < quad_count; ++i) {
+      order[i] = i;
+    }
+    for (uint32_t i = quad_count; i > 1; --i) {
+      std::swap(order[i - 1], order[random.next() % i]);
+    }
+
+    SourceSubMesh& sub_mesh = mesh.sub_meshes[0];
+    for (uint32_t i = 0; i < quad_count; ++i) {
+      uint32_t pos[4], normal[4], uv[4];
+      for (uint32_t j = 0; j < 4; ++j) {
+        const Corner& corner = ordered.corners[order[i] * 4 + j];
+        pos[j] = corner.position_index;
+        normal[j] = corner.normal_index;
+        uv[j] = corner.uv_index;
+      }
+      add_polygon(sub_mesh, pos, normal, uv, 4);
+    }
+  }
+
+  // Rows of flat shaded cylinders with large n-gon caps, which gives long thin triangles and
+  // a hard edge (unique normal) on every face.
+  void generate_ngon_cad(SourceMesh& mesh, const uint32_t target_triangles)
+  {
+    const uint32_t sides = 48;
+    const uint32_t tris_per_cylinder = 2 * sides + 2 * (sides - 2);
+    const uint32_t cylinder_count = std::max<uint32_t>(1, target_triangles / tris_per_cylinder);
+    mesh.sub_meshes.resize(1);
+    SourceSubMesh& sub_mesh = mesh.sub_meshes[0];
+    mesh.uvs.push_back(D3DXVECTOR2(0, 0));
+
+    for (uint32_t c = 0; c < cylinder_count; ++c) {
+      const D3DXVECTOR3 origin(3.0f * (c % 100), 0, 3.0f * (c / 100));
+      const uint32_t first = (uint32_t)mesh.positions.size();
+      for (uint32_t i = 0; i < sides; ++i) {
+        const float phi = 2 * kPi * i / sides;
+        mesh.positions.push_back(origin + D3DXVECTOR3(cosf(phi), 0, sinf(phi)));
+        mesh.positions.push_back(origin + D3DXVECTOR3(cosf(phi), 2, sinf(phi)));
+      }
+
+      std::vector<uint32_t> pos(sides), normal(sides), uv(sides, 0);
+      for (uint32_t cap = 0; cap < 2; ++cap) {
+        const uint32_t normal_index = (uint32_t)mesh.normals.size();
+        mesh.normals.push_back(D3DXVECTOR3(0, cap ? 1.0f : -1.0f, 0));
+        for (uint32_t i = 0; i < sides; ++i) {
+          pos[i] = first + 2 * (cap ? i : sides - 1 - i) + cap;
+          normal[i] = normal_index;
+        }
+        add_polygon(sub_mesh, &pos[0], &normal[0], &uv[0], sides);
+      }
+
+      for (uint32_t i = 0; i < sides; ++i) {
+        const uint32_t i1 = (i + 1) % sides;
+        const float phi = 2 * kPi * (i + 0.5f) / sides;
+        const uint32_t normal_index = (uint32_t)mesh.normals.size();
+        mesh.normals.push_back(D3DXVECTOR3(cosf(phi), 0, sinf(phi)));
+        uint32_t side_pos[4] = { first + 2 * i, first + 2 * i1, first + 2 * i1 + 1, first + 2 * i + 1 };
+        uint32_t side_normal[4] = { normal_index, normal_index, normal_index, normal_index };
+        uint32_t side_uv[4] = { 0, 0, 0, 0 };
+        add_polygon(sub_mesh, side_pos, side_normal, side_uv, 4);
+      }
+    }
+  }
+
+  // Grid where every face is its own uv island, so no corners can be welded across faces.
+  void generate_uv_seams(SourceMesh& mesh, const uint32_t target_triangles)
+  {
+    const uint32_t side = grid_side(target_triangles);
+    add_grid_vertices(mesh, side);
+    mesh.uvs.clear();
+    mesh.sub_meshes.resize(1);
+    Random random(3);
+    for (uint32_t y = 0; y < side; ++y) {
+      for (uint32_t x = 0; x < side; ++x) {
+        uint32_t idx[4];
+        grid_quad(idx, x, y, side);
+        uint32_t uv[4];
+        const D3DXVECTOR2 island(random.next_float(), random.next_float());
+        for (uint32_t i = 0; i < 4; ++i) {
+          uv[i] = (uint32_t)mesh.uvs.size();
+          mesh.uvs.push_back(D3DXVECTOR2(island.x + 0.01f * (i & 1), island.y + 0.01f * (i >> 1)));
+        }
+        add_polygon(mesh.sub_meshes[0], idx, idx, uv, 4);
+      }
+    }
+  }
+
+  // Grid split into 8 materials in blocks, so each sub mesh borders the others.
+  void generate_multi_material(SourceMesh& mesh, const uint32_t target_triangles)
+  {
+    const uint32_t kMaterialCount = 8;
+    const uint32_t kBlockSize = 16;
+    const uint32_t side = grid_side(target_triangles);
+    add_grid_vertices(mesh, side);
+    mesh.sub_meshes.resize(kMaterialCount);
+    for (uint32_t y = 0; y < side; ++y) {
+      for (uint32_t x = 0; x < side; ++x) {
+        uint32_t idx[4];
+        grid_quad(idx, x, y, side);
+        const uint32_t material = (x / kBlockSize + 3 * (y / kBlockSize)) % kMaterialCount;
+        add_polygon(mesh.sub_meshes[material], idx, idx, idx, 4);
+      }
+    }
+  }
+}
+
+const MeshGenerator kMeshGenerators[] = {
+  { "grid", &generate_grid },
+  { "sphere", &generate_sphere },
+  { "noisy_scan", &generate_noisy_scan },
+  { "ngon_cad", &generate_ngon_cad },
+  { "uv_seams", &generate_uv_seams },
+  { "multi_material", &generate_multi_material },
+};
+
+const uint32_t kNumMeshGenerators = sizeof(kMeshGenerators) / sizeof(kMeshGenerators[0]);
+
+uint32_t SourceMesh::triangle_count() const
+{
+  uint32_t count = 0;
+  for (size_t i = 0; i < sub_meshes.size(); ++i) {
+    count += (uint32_t)sub_meshes[i].triangles.size();
+  }
+  return count;
+}
+
+uint32_t SourceMesh::corner_count() const
+{
+  uint32_t count = 0;
+  for (size_t i = 0; i < sub_meshes.size(); ++i) {
+    count += (uint32_t)sub_meshes[i].corners.size();
+  }
+  return count;
+}
+
+void make_maya_arrays(MayaArrays& arrays, const SourceMesh& mesh)
+{
+  arrays.points.resize(4 * mesh.positions.size());
+  for (size_t i = 0; i < mesh.positions.size(); ++i) {
+    arrays.points[4 * i + 0] = mesh.positions[i].x;
+    arrays.points[4 * i + 1] = mesh.positions[i].y;
+    arrays.points[4 * i + 2] = mesh.positions[i].z;
+    arrays.points[4 * i + 3] = 1;
+  }
+
+  arrays.normals.resize(3 * mesh.normals.size());
+  for (size_t i = 0; i < mesh.normals.size(); ++i) {
+    arrays.normals[3 * i + 0] = mesh.normals[i].x;
+    arrays.normals[3 * i + 1] = mesh.normals[i].y;
+    arrays.normals[3 * i + 2] = mesh.normals[i].z;
+  }
+
+  // the generated uvs are already flipped
+  arrays.us.resize(mesh.uvs.size());
+  arrays.vs.resize(mesh.uvs.size());
+  for (size_t i = 0; i < mesh.uvs.size(); ++i) {
+    arrays.us[i] = mesh.uvs[i].x;
+    arrays.vs[i] = 1.0f - mesh.uvs[i].y;
+  }
+}
+
+void convert_maya_arrays(MeshStreams& streams, const MayaArrays& arrays)
+{
+  convert_points(streams.positions, arrays.points.empty() ? NULL : &arrays.points[0], (uint32_t)arrays.points.size() / 4);
+  convert_vectors(streams.normals, arrays.normals.empty() ? NULL : &arrays.normals[0], (uint32_t)arrays.normals.size() / 3, false);
+  streams.uv_sets.resize(1);
+  convert_uvs(streams.uv_sets[0], arrays.us.empty() ? NULL : &arrays.us[0], arrays.vs.empty() ? NULL : &arrays.vs[0], (uint32_t)arrays.us.size());
+}
+
+void make_scene(SourceScene& scene, const uint32_t node_count)
+{
+  Random rnd(node_count);
+  scene.nodes.clear();
+  scene.nodes.reserve(node_count);
+
+  SourceNode root;
+  root.name = "world";
+  root.parent = ~0u;
+  root.transform = true;
+  scene.nodes.push_back(root);
+
+  // new transforms hang off a random earlier transform, which gives the depth of a random
+  // recursive tree (around 10-30 levels for 100K nodes)
+  std::vector<uint32_t> transforms(1, 0);
+  char name[32];
+  while (scene.nodes.size() < node_count) {
+    SourceNode node;
+    node.parent = transforms[rnd.next() % transforms.size()];
+    node.transform = true;
+    for (int i = 0; i < 3; ++i) {
+      node.translation[i] = 100 * rnd.next_float() - 50;
+      node.scale[i] = 0.5f + rnd.next_float();
+    }
+    const float angle = kPi * rnd.next_float();
+    node.rotation[0] = 0;
+    node.rotation[1] = sinf(angle);
+    node.rotation[2] = 0;
+    node.rotation[3] = cosf(angle);
+
+    const uint32_t idx = (uint32_t)scene.nodes.size();
+    sprintf_s(name, sizeof(name), "transform%u", idx);
+    node.name = name;
+    scene.nodes[node.parent].children.push_back(idx);
+    scene.nodes.push_back(node);
+    transforms.push_back(idx);
+
+    if (scene.nodes.size() < node_count && (rnd.next() & 1)) {
+      SourceNode shape;
+      shape.parent = idx;
+      shape.transform = false;
+      sprintf_s(name, sizeof(name), "transformShape%u", idx);
+      shape.name = name;
+      scene.nodes[idx].children.push_back(idx + 1);
+      scene.nodes.push_back(shape);
+    }
+  }
+}
+
+void make_mesh_bounds(std::vector<Aabb>& bounds, const uint32_t mesh_count)
+{
+  Random rnd(mesh_count);
+  const float kWorldSize = 4000;
+  const uint32_t kTerrainTiles = 16;
+  const uint32_t settlement_count = std::max<uint32_t>(1, mesh_count / 2000);
+
+  std::vector<D3DXVECTOR3> settlements(settlement_count);
+  for (uint32_t i = 0; i < settlement_count; ++i) {
+    settlements[i] = D3DXVECTOR3(kWorldSize * rnd.next_float(), 0, kWorldSize * rnd.next_float());
+  }
+
+  bounds.resize(mesh_count);
+  for (uint32_t i = 0; i < mesh_count; ++i) {
+    Aabb& box = bounds[i];
+    if (i < kTerrainTiles * kTerrainTiles) {
+      const float tile = kWorldSize / kTerrainTiles;
+      box.min = D3DXVECTOR3((i % kTerrainTiles) * tile, -20, (i / kTerrainTiles) * tile);
+      box.max = box.min + D3DXVECTOR3(tile, 60, tile);
+      continue;
+    }
+
+    // most meshes are small props, a few are buildings
+    const D3DXVECTOR3& center = settlements[rnd.next() % settlement_count];
+    const float spread = 200 * rnd.next_float() * rnd.next_float();
+    const float angle = 2 * kPi * rnd.next_float();
+    const float size = 0.5f * powf(60.0f, rnd.next_float() * rnd.next_float());
+    const D3DXVECTOR3 pos(center.x + spread * cosf(angle), size, center.z + spread * sinf(angle));
+    const D3DXVECTOR3 extents(size * (0.5f + rnd.next_float()), size, size * (0.5f + rnd.next_float()));
+    box.min = pos - extents;
+    box.max = pos + extents;
+  }
+
+  // shuffle, keeping the terrain first like it usually is in the outliner
+  for (uint32_t i = mesh_count; i > kTerrainTiles * kTerrainTiles + 1; --i) {
+    std::swap(bounds[i - 1], bounds[kTerrainTiles * kTerrainTiles + rnd.next() % (i - kTerrainTiles * kTerrainTiles)]);
+  }
+}
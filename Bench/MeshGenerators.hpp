@@ -0,0 +1,97 @@
+#ifndef MESH_GENERATORS_HPP
+#define MESH_GENERATORS_HPP
+
+#include <string>
+#include "../Exporter/Bounds.hpp"
+#include "../Exporter/MeshProcessing.hpp"
+#include "../Exporter/VertexConversion.hpp"
+
+/**
+ * Synthetic stand-ins for production meshes. The layout mirrors what MeshExporter collects
+ * from Maya: shared position/normal/uv arrays, and per sub mesh a list of polygon corners
+ * (indices into the shared arrays) with triangles indexing the corners.
+ */
+
+struct Corner
+{
+  Corner(const uint32_t pos, const uint32_t normal, const uint32_t uv) : position_index(pos), normal_index(normal), uv_index(uv) {}
+  uint32_t  position_index;
+  uint32_t  normal_index;
+  uint32_t  uv_index;
+};
+
+struct SourceSubMesh
+{
+  std::vector<Corner> corners;
+  IndexBuffer stream_indices;   // the uv index of each corner, like SubMesh::stream_indices_
+  Triangles triangles;
+};
+
+struct SourceMesh
+{
+  uint32_t triangle_count() const;
+  uint32_t corner_count() const;
+
+  std::vector<D3DXVECTOR3> positions;
+  std::vector<D3DXVECTOR3> normals;
+  std::vector<D3DXVECTOR2> uvs;
+  std::vector<SourceSubMesh> sub_meshes;
+};
+
+typedef void (*MeshGeneratorFn)(SourceMesh& mesh, const uint32_t target_triangles);
+
+struct MeshGenerator
+{
+  const char* name;
+  MeshGeneratorFn fn;
+};
+
+extern const MeshGenerator kMeshGenerators[];
+extern const uint32_t kNumMeshGenerators;
+
+// The mesh in the layout returned by MPointArray::get, MFloatVectorArray::get and MFnMesh::getUVs
+struct MayaArrays
+{
+  std::vector<double> points;
+  std::vector<float> normals;
+  std::vector<float> us;
+  std::vector<float> vs;
+};
+
+void make_maya_arrays(MayaArrays& arrays, const SourceMesh& mesh);
+
+// Converts the arrays the same way MeshExporter::collect_raw_data does
+void convert_maya_arrays(MeshStreams& streams, const MayaArrays& arrays);
+
+/**
+ * Stand-in for a production scene graph: a random tree of transforms where about half of the
+ * transforms also have a shape child. Node 0 is the world root, and children are listed in the
+ * order Maya would return them.
+ */
+
+struct SourceNode
+{
+  std::string name;
+  uint32_t parent;
+  std::vector<uint32_t> children;
+  bool transform;
+  float translation[3];
+  float rotation[4];
+  float scale[3];
+};
+
+struct SourceScene
+{
+  std::vector<SourceNode> nodes;
+};
+
+void make_scene(SourceScene& scene, const uint32_t node_count);
+
+/**
+ * Stand-in for the world space bounds of the meshes in a large level: props and buildings
+ * clustered around settlements on a 4 km square, and a grid of terrain tiles. Like the DAG
+ * order they're exported in, the meshes are in no spatial order.
+ */
+void make_mesh_bounds(std::vector<Aabb>& bounds, const uint32_t mesh_count);
+
+#endif
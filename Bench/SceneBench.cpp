@@ -0,0 +1,683 @@
+/**
+ * The "scene" generator runs the hierarchy export over synthetic scene graphs from 1K to 100K
+ * nodes. The "load" generator writes an exported scene and compares loading it with RdxReader,
+ * mapped and block compressed, against inflating the whole file and parsing it into owned
+ * arrays, and against reading a baked load in place image and fixing it up. The "camera"
+ * generator compresses a sampled crane shot with a zoom into camera curves, and checks the
+ * curves read back from the Camera chunk against every sample. The "materials" generator merges
+ * materials with exact duplicates, -0 for 0 and near duplicates, and checks the mesh and effect
+ * bindings against the materials they were bound to.
+ */
+
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <zlib.h>
+#include "BenchCommon.hpp"
+#include "../Exporter/CameraCurves.hpp"
+#include "../Exporter/Hierarchy.hpp"
+#include "../Exporter/MeshProcessing.hpp"
+#include "../Exporter/SceneDescription.hpp"
+#include "../Exporter/StringTable.hpp"
+#include "../Reader/RdxImage.hpp"
+
+namespace
+{
+  // The scene around the meshes in the load benchmark
+  const uint32_t kLoadNodes = 10000;
+  const uint32_t kLoadTracks = 500;
+  const uint32_t kLoadKeys = 240;
+
+  // Samples of the camera shots, at 30 fps
+  const uint32_t kCameraSampleCounts[] = { 31, 301, 3001 };
+  const uint32_t kNumCameraSampleCounts = sizeof(kCameraSampleCounts) / sizeof(kCameraSampleCounts[0]);
+  const float kCameraTolerance = 1e-4f;
+
+  // Materials in groups of kMaterialCopies, which divides the counts: a material, an exact
+  // duplicate, one with -0 for a 0 and one with a value an ulp away. The first three merge, the
+  // near duplicate doesn't
+  const uint32_t kMaterialCounts[] = { 1000, 10000, 100000 };
+  const uint32_t kNumMaterialCounts = sizeof(kMaterialCounts) / sizeof(kMaterialCounts[0]);
+  const uint32_t kMaterialCopies = 4;
+  const uint32_t kMaterialShaders = 7;
+
+  // The old exporter's layout: a depth first walk that builds every node's full path from scratch
+  // and writes nested [name, child count] records
+  void write_nested_hierarchy(RdxWriter& writer, const SourceScene& scene, const uint32_t idx, const std::string path)
+  {
+    const SourceNode& node = scene.nodes[idx];
+    writer.write_string(path);
+    writer.write_generic<uint32_t>((uint32_t)node.children.size());
+    for (size_t i = 0; i < node.children.size(); ++i) {
+      const SourceNode& child = scene.nodes[node.children[i]];
+      write_nested_hierarchy(writer, scene, node.children[i], idx == 0 ? child.name : path + "|" + child.name);
+    }
+  }
+
+  // Builds the flat hierarchy the same way ReduxExporter::export_hierarchy does
+  void build_flat_hierarchy(Hierarchy& hierarchy, StringTable& strings, const SourceScene& scene)
+  {
+    std::deque<std::pair<uint32_t, uint32_t> > pending;
+    pending.push_back(std::make_pair(0, hierarchy.add_node(Hierarchy::kInvalidNode, strings.intern("root"), NULL, NULL, NULL)));
+    while (!pending.empty()) {
+      const SourceNode& node = scene.nodes[pending.front().first];
+      const uint32_t parent = pending.front().second;
+      pending.pop_front();
+
+      const std::string prefix(parent == 0 ? "" : strings.get(hierarchy.nodes[parent].name) + "|");
+      for (size_t i = 0; i < node.children.size(); ++i) {
+        const SourceNode& child = scene.nodes[node.children[i]];
+        const uint32_t name = strings.intern(prefix + child.name);
+        const uint32_t idx = child.transform ?
+          hierarchy.add_node(parent, name, child.translation, child.rotation, child.scale) :
+          hierarchy.add_node(parent, name, NULL, NULL, NULL);
+        pending.push_back(std::make_pair(node.children[i], idx));
+      }
+    }
+    hierarchy.link_children();
+  }
+
+  void run_scene_case(Results& results, const uint32_t node_count)
+  {
+    SourceScene scene;
+    make_scene(scene, node_count);
+
+    uint32_t nested_bytes = 0;
+    {
+      StageScope scope;
+      RdxWriter writer;
+      writer.init_writer(kRdxDefaultBlockSize);
+      {
+        SCOPED_RDX_CHUNK(writer, RdxChunkId::Hierarchy);
+        write_nested_hierarchy(writer, scene, 0, "root");
+      }
+      writer.end_of_data();
+      uint8_t* buf = NULL;
+      writer.get_buffer(buf, nested_bytes);
+      add_result(results, make_key("scene", node_count, "hierarchy_nested"), scope);
+    }
+
+    uint32_t flat_bytes = 0;
+    Hierarchy hierarchy;
+    {
+      StageScope scope;
+      StringTable strings;
+      build_flat_hierarchy(hierarchy, strings, scene);
+      RdxWriter writer;
+      writer.init_writer(kRdxDefaultBlockSize);
+      {
+        SCOPED_RDX_CHUNK(writer, RdxChunkId::Hierarchy);
+        hierarchy.write(writer);
+      }
+      {
+        SCOPED_RDX_CHUNK(writer, RdxChunkId::StringTable);
+        strings.write(writer);
+      }
+      writer.end_of_data();
+      uint8_t* buf = NULL;
+      writer.get_buffer(buf, flat_bytes);
+      add_result(results, make_key("scene", node_count, "hierarchy_flat"), scope);
+    }
+
+    {
+      StageScope scope;
+      std::vector<float> world;
+      update_world_transforms(world, hierarchy.nodes);
+      add_result(results, make_key("scene", node_count, "world_update"), scope);
+    }
+
+    printf("%-16s %10u nodes  nested %8.2f KB  flat %8.2f KB (including the string table)\n",
+      "scene", node_count, nested_bytes / 1024.0, flat_bytes / 1024.0);
+    const char* stages[] = { "hierarchy_nested", "hierarchy_flat", "world_update" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("scene", node_count, stages[i])];
+      printf("    %-16s %10.2f ms  %8.2f Mnode/s  peak %8.2f MB\n", stages[i], result.ms,
+        node_count / (1000.0 * std::max<double>(result.ms, 1e-6)), result.peak_bytes / (1024.0 * 1024.0));
+    }
+  }
+
+  // Writes a file laid out like the exporter's: hierarchy, animation, one mesh chunk per sub mesh
+  // and the string table last
+  void write_load_scene(RdxWriter& writer, const SourceMesh& mesh, const SourceScene& scene)
+  {
+    StringTable strings;
+    Hierarchy hierarchy;
+    build_flat_hierarchy(hierarchy, strings, scene);
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Hierarchy);
+      hierarchy.write(writer);
+    }
+
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Animation);
+      const uint32_t track_count = std::min<uint32_t>(kLoadTracks, (uint32_t)hierarchy.nodes.size() - 1);
+      writer.write_generic<uint32_t>(30);
+      writer.write_generic<float>(0);
+      writer.write_generic<float>(kLoadKeys / 30.0f);
+      writer.write_generic<uint32_t>(track_count);
+      for (uint32_t i = 0; i < track_count; ++i) {
+        const HierarchyNode& node = hierarchy.nodes[i + 1];
+        writer.write_generic<uint32_t>(node.name);
+        writer.write_generic<uint32_t>(kLoadKeys);
+        for (uint32_t j = 0; j < kLoadKeys; ++j) {
+          RdxAnimationKey key;
+          key.time = j / 30.0f;
+          memcpy(key.translation, node.translation, sizeof(key.translation));
+          key.translation[1] += j * 0.01f;
+          memcpy(key.rotation, node.rotation, sizeof(key.rotation));
+          memcpy(key.scale, node.scale, sizeof(key.scale));
+          writer.write_generic(key);
+        }
+      }
+    }
+
+    MayaArrays arrays;
+    make_maya_arrays(arrays, mesh);
+    MeshStreams streams;
+    convert_maya_arrays(streams, arrays);
+    VertexBuffer candidates;
+    candidates.format = make_vertex_format(streams, true);
+    const uint32_t parent = hierarchy.nodes.size() > 1 ? hierarchy.nodes[1].name : hierarchy.nodes[0].name;
+    for (size_t i = 0; i < mesh.sub_meshes.size(); ++i) {
+      const SourceSubMesh& sub_mesh = mesh.sub_meshes[i];
+      if (sub_mesh.triangles.empty()) {
+        continue;
+      }
+      gather_candidates(candidates, streams, sub_mesh.corners, sub_mesh.stream_indices);
+      compute_tangents(candidates, sub_mesh.triangles);
+      VertexBuffer super_verts;
+      IndexBuffer vertex_mapping;
+      IndexBuffer indices;
+      weld_vertices(super_verts, vertex_mapping, candidates);
+      remap_indices(indices, sub_mesh.triangles, vertex_mapping, false);
+      Bounds bounds;
+      compute_bounds(bounds, super_verts.vertex(0), super_verts.size(), super_verts.stride(), Bounds::kApproxSphere, true);
+
+      char name[64];
+      sprintf_s(name, sizeof(name), "mesh_%u", (uint32_t)i);
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Mesh);
+      writer.write_generic<uint32_t>(strings.intern(name));
+      writer.write_generic<uint32_t>(parent);
+      write_element_desc(writer, strings, candidates.format);
+      write_vertex_buffers(writer, super_verts, indices);
+      write_bounds(writer, bounds);
+    }
+
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::StringTable);
+      strings.write(writer);
+    }
+  }
+
+  // What a loader ends up with when parsing the stream into its own arrays
+  struct ParsedScene
+  {
+    ParsedScene() : vertex_bytes(0), index_count(0), node_count(0), key_count(0), string_count(0) {}
+    std::vector<std::vector<uint8_t> > vertices;
+    std::vector<std::vector<uint32_t> > indices;
+    std::vector<RdxHierarchyNode> nodes;
+    std::vector<std::vector<RdxAnimationKey> > tracks;
+    std::vector<std::string> strings;
+    uint64_t vertex_bytes;
+    uint64_t index_count;
+    uint32_t node_count;
+    uint32_t key_count;
+    uint32_t string_count;
+  };
+
+  // Walks all the chunks. With copy set the arrays are copied out like a stream parser would,
+  // otherwise only the views are created.
+  bool parse_chunks(ParsedScene& parsed, RdxFile& file, const bool copy)
+  {
+    for (uint32_t i = 0; i < file.chunk_count(); ++i) {
+      RdxChunk chunk;
+      if (!file.get_chunk(chunk, i)) {
+        return false;
+      }
+      if (chunk.id == RdxChunkId::Mesh) {
+        RdxMeshView mesh;
+        if (!read_mesh(mesh, chunk)) {
+          return false;
+        }
+        parsed.vertex_bytes += mesh.vertex_count * mesh.vertex_size;
+        parsed.index_count += mesh.index_count;
+        if (copy && mesh.encoding == RdxMeshEncoding::Raw) {
+          parsed.vertices.push_back(std::vector<uint8_t>(mesh.vertices, mesh.vertices + mesh.vertex_count * mesh.vertex_size));
+          parsed.indices.push_back(std::vector<uint32_t>(mesh.indices.data, mesh.indices.data + mesh.indices.count));
+        } else if (copy) {
+          std::vector<float> vertices;
+          parsed.indices.push_back(std::vector<uint32_t>());
+          if (!decode_mesh(vertices, parsed.indices.back(), mesh)) {
+            return false;
+          }
+          const uint8_t* bytes = vertices.empty() ? NULL : (const uint8_t*)&vertices[0];
+          parsed.vertices.push_back(std::vector<uint8_t>(bytes, bytes + vertices.size() * sizeof(float)));
+        }
+      } else if (chunk.id == RdxChunkId::Hierarchy) {
+        RdxHierarchyView hierarchy;
+        if (!read_hierarchy(hierarchy, chunk)) {
+          return false;
+        }
+        parsed.node_count += hierarchy.nodes.count;
+        if (copy) {
+          parsed.nodes.assign(hierarchy.nodes.data, hierarchy.nodes.data + hierarchy.nodes.count);
+        }
+      } else if (chunk.id == RdxChunkId::Animation) {
+        RdxAnimationView animation;
+        if (!read_animation(animation, chunk)) {
+          return false;
+        }
+        for (size_t j = 0; j < animation.tracks.size(); ++j) {
+          const RdxArray<RdxAnimationKey>& keys = animation.tracks[j].keys;
+          parsed.key_count += keys.count;
+          if (copy) {
+            parsed.tracks.push_back(std::vector<RdxAnimationKey>(keys.data, keys.data + keys.count));
+          }
+        }
+      } else if (chunk.id == RdxChunkId::StringTable) {
+        RdxStringTableView strings;
+        if (!read_string_table(strings, chunk)) {
+          return false;
+        }
+        parsed.string_count += strings.entries.count;
+        if (copy) {
+          parsed.strings.resize(strings.entries.count);
+          for (uint32_t j = 0; j < strings.entries.count; ++j) {
+            if (!strings.get(parsed.strings[j], j)) {
+              return false;
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // Reads an image into a buffer aligned for fixup_image, that the caller frees with _aligned_free
+  bool load_image(const char* filename, uint8_t*& buf, uint32_t& len)
+  {
+    FILE* file = NULL;
+    if (fopen_s(&file, filename, "rb") != 0) {
+      return false;
+    }
+    fseek(file, 0, SEEK_END);
+    len = (uint32_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buf = (uint8_t*)_aligned_malloc(std::max<uint32_t>(len, 1), kRdxImageAlignment);
+    const bool res = buf != NULL && fread(buf, 1, len, file) == len;
+    fclose(file);
+    return res;
+  }
+
+  void count_image(ParsedScene& parsed, const RdxImageScene& scene)
+  {
+    for (uint32_t i = 0; i < scene.mesh_count; ++i) {
+      parsed.vertex_bytes += scene.meshes[i].vertex_count * scene.meshes[i].vertex_size;
+      parsed.index_count += scene.meshes[i].index_count;
+    }
+    for (uint32_t i = 0; i < scene.track_count; ++i) {
+      parsed.key_count += scene.tracks[i].key_count;
+    }
+    parsed.node_count = scene.node_count;
+    parsed.string_count = scene.string_count;
+  }
+
+  bool same_counts(const ParsedScene& a, const ParsedScene& b)
+  {
+    return a.vertex_bytes == b.vertex_bytes && a.index_count == b.index_count && a.node_count == b.node_count &&
+      a.key_count == b.key_count && a.string_count == b.string_count;
+  }
+
+  bool run_load_case(Results& results, const uint32_t target_triangles)
+  {
+    SourceMesh mesh;
+    kMeshGenerators[0].fn(mesh, target_triangles);
+    SourceScene scene;
+    make_scene(scene, kLoadNodes);
+
+    // the same scene uncompressed, block compressed, and as a single zlib stream like the old
+    // chunk writer produced
+    RdxWriter writer;
+    writer.init_writer(0);
+    write_load_scene(writer, mesh, scene);
+    writer.end_of_data();
+    uint8_t* raw = NULL;
+    uint32_t raw_len = 0;
+    writer.get_buffer(raw, raw_len);
+
+    std::vector<uint8_t> stream(compressBound(raw_len));
+    uLongf stream_len = (uLongf)stream.size();
+    compress2(&stream[0], &stream_len, raw, raw_len, Z_DEFAULT_COMPRESSION);
+
+    const char* raw_filename = "load_bench_raw.rdx";
+    const char* blocks_filename = "load_bench_blocks.rdx";
+    const char* stream_filename = "load_bench_stream.rdx";
+    const char* image_filename = "load_bench_image.rdi";
+    bool ok = save_file(raw_filename, raw, raw_len) && save_file(stream_filename, &stream[0], (uint32_t)stream_len);
+
+    std::vector<uint8_t> image;
+    {
+      RdxFile file;
+      ok = ok && file.open_memory(raw, raw_len) && bake_image(image, file) &&
+        save_file(image_filename, &image[0], (uint32_t)image.size());
+    }
+
+    writer.init_writer(kRdxDefaultBlockSize);
+    write_load_scene(writer, mesh, scene);
+    writer.end_of_data();
+    uint8_t* blocks = NULL;
+    uint32_t blocks_len = 0;
+    writer.get_buffer(blocks, blocks_len);
+    ok = ok && save_file(blocks_filename, blocks, blocks_len);
+    writer.init_writer(0);
+    if (!ok) {
+      printf("%-16s %10u tris  unable to write the test files\n", "load", target_triangles);
+      return false;
+    }
+
+    ParsedScene streamed;
+    {
+      StageScope scope;
+      std::vector<uint8_t> compressed;
+      std::vector<uint8_t> inflated(raw_len);
+      uLongf inflated_len = raw_len;
+      RdxFile file;
+      ok = load_file(stream_filename, compressed) &&
+        uncompress(&inflated[0], &inflated_len, &compressed[0], (uLong)compressed.size()) == Z_OK &&
+        file.open_memory(&inflated[0], (uint32_t)inflated_len) && parse_chunks(streamed, file, true);
+      add_result(results, make_key("load", target_triangles, "parse_stream"), scope);
+    }
+
+    ParsedScene mapped;
+    {
+      StageScope scope;
+      RdxFile file;
+      ok = ok && file.open(raw_filename) && parse_chunks(mapped, file, false);
+      add_result(results, make_key("load", target_triangles, "map_raw"), scope);
+    }
+
+    ParsedScene block_mapped;
+    {
+      StageScope scope;
+      RdxFile file;
+      ok = ok && file.open(blocks_filename) && parse_chunks(block_mapped, file, false);
+      add_result(results, make_key("load", target_triangles, "map_blocks"), scope);
+    }
+
+    uint32_t inflated_blocks = 0;
+    uint32_t block_count = 0;
+    {
+      StageScope scope;
+      RdxFile file;
+      RdxChunk chunk;
+      RdxMeshView first_mesh;
+      ok = ok && file.open(blocks_filename) &&
+        file.get_chunk(chunk, file.find_chunk(RdxChunkId::Mesh)) && read_mesh(first_mesh, chunk);
+      inflated_blocks = file.inflated_blocks();
+      block_count = file.block_count();
+      add_result(results, make_key("load", target_triangles, "map_one_mesh"), scope);
+    }
+
+    ParsedScene image_loaded;
+    {
+      StageScope scope;
+      uint8_t* buf = NULL;
+      uint32_t len = 0;
+      const RdxImageScene* image_scene = NULL;
+      ok = ok && load_image(image_filename, buf, len) && (image_scene = fixup_image(buf, len)) != NULL;
+      if (ok) {
+        count_image(image_loaded, *image_scene);
+      }
+      _aligned_free(buf);
+      add_result(results, make_key("load", target_triangles, "load_image"), scope);
+    }
+
+    // an image whose mesh counts run past its end is rejected
+    if (ok) {
+      uint8_t* forged = (uint8_t*)_aligned_malloc(image.size(), kRdxImageAlignment);
+      memcpy(forged, &image[0], image.size());
+      const RdxImageScene* forged_scene = (const RdxImageScene*)(forged + ((RdxImageHeader*)forged)->scene_offset);
+      if (forged_scene->mesh_count > 0) {
+        ((RdxImageMesh*)(forged + forged_scene->meshes.value))->vertex_count = 0x40000000;
+        ok = fixup_image(forged, (uint32_t)image.size()) == NULL;
+      }
+      _aligned_free(forged);
+    }
+
+    remove(raw_filename);
+    remove(blocks_filename);
+    remove(stream_filename);
+    remove(image_filename);
+
+    const bool loaded = ok;
+    ok = ok && same_counts(streamed, mapped) && same_counts(streamed, block_mapped) && same_counts(streamed, image_loaded);
+    printf("%-16s %10u tris  raw %8.2f MB  blocks %8.2f MB  stream %8.2f MB  image %8.2f MB  %s\n", "load",
+      mesh.triangle_count(), raw_len / (1024.0 * 1024.0), blocks_len / (1024.0 * 1024.0), stream_len / (1024.0 * 1024.0),
+      image.size() / (1024.0 * 1024.0), !loaded ? "load failed" : ok ? "views match" : "views differ");
+    printf("    one mesh inflated %u of %u blocks\n", inflated_blocks, block_count);
+    const char* stages[] = { "parse_stream", "map_raw", "map_blocks", "map_one_mesh", "load_image" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("load", target_triangles, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f MB/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        raw_len / (1024.0 * 1024.0) * 1000.0 / std::max<double>(result.ms, 1e-6), result.peak_bytes / (1024.0 * 1024.0),
+        result.allocations);
+    }
+    return ok;
+  }
+
+  // A crane shot: the eye circles the origin while rising and looks at it, and the lens zooms
+  // in over the middle third. The aspect ratio and clip planes don't change
+  void make_camera_track(CameraTrack& track, const uint32_t sample_count)
+  {
+    track.resize(sample_count);
+    for (uint32_t i = 0; i < sample_count; ++i) {
+      const float u = (float)i / (sample_count - 1);
+      const float angle = 2 * (float)D3DX_PI * u;
+      const D3DXVECTOR3 eye(50 * cosf(angle), 5 + 20 * u, 50 * sinf(angle));
+      D3DXVECTOR3 view(-eye), right, up;
+      D3DXVec3Normalize(&view, &view);
+      const D3DXVECTOR3 world_up(0, 1, 0);
+      D3DXVec3Cross(&right, &view, &world_up);
+      D3DXVec3Normalize(&right, &right);
+      D3DXVec3Cross(&up, &right, &view);
+      const float zoom = std::min(std::max(3 * u - 1, 0.0f), 1.0f);
+      const float aspect = 16.0f / 9;
+      const float horizontal_fov = 1.0f - 0.6f * zoom * zoom * (3 - 2 * zoom);
+      const float vertical_fov = 2 * atanf(tanf(horizontal_fov / 2) / aspect);
+
+      CameraSample& sample = track[i];
+      sample.time = i / 30.0f;
+      const float values[] = { eye.x, eye.y, eye.z, view.x, view.y, view.z, up.x, up.y, up.z,
+        right.x, right.y, right.z, aspect, horizontal_fov, vertical_fov, 0.1f, 1000.0f };
+      memcpy(sample.values, values, sizeof(sample.values));
+    }
+  }
+
+  bool run_camera_case(Results& results, const uint32_t sample_count)
+  {
+    CameraTrack track;
+    make_camera_track(track, sample_count);
+
+    CameraCurves curves;
+    bool ok = false;
+    {
+      StageScope scope;
+      ok = compress_camera_curves(curves, track, kCameraTolerance);
+      add_result(results, make_key("camera", sample_count, "compress"), scope);
+    }
+
+    RdxWriter writer;
+    writer.init_writer(0);
+    {
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Camera);
+      RdxCamera camera;
+      camera.name = 0;
+      // the fields after the name are the channels
+      memcpy((uint8_t*)&camera + sizeof(camera.name), track[0].values, sizeof(track[0].values));
+      ok = ok && writer.write_generic(camera) && write_camera_curves(writer, curves);
+    }
+
+    // every sample is reproduced within the tolerance of its channel
+    RdxCameraCurvesView view;
+    ok = ok && read_camera_curves(view, writer_chunk(writer, 0)) && view.channels.count == kRdxCameraChannels;
+    float worst = 0;
+    {
+      StageScope scope;
+      for (uint32_t c = 0; ok && c < kRdxCameraChannels; ++c) {
+        float magnitude = 1;
+        for (uint32_t i = 0; i < sample_count; ++i) {
+          magnitude = std::max(magnitude, fabsf(track[i].values[c]));
+        }
+        for (uint32_t i = 0; i < sample_count; ++i) {
+          const float error = fabsf(evaluate_curve(view, c, track[i].time) - track[i].values[c]) / magnitude;
+          worst = std::max(worst, error);
+        }
+      }
+      add_result(results, make_key("camera", sample_count, "evaluate"), scope);
+    }
+    ok = ok && worst <= kCameraTolerance * 1.01f;
+
+    const uint32_t raw_bytes = sample_count * (uint32_t)sizeof(CameraSample);
+    printf("%-16s %10u samples  %6u keys  raw %8.2f KB  curves %8.2f KB  (%5.1f%%)  error %.2e  %s\n", "camera",
+      sample_count, (uint32_t)curves.keys.size(), raw_bytes / 1024.0, camera_curves_size(curves) / 1024.0,
+      100.0 * camera_curves_size(curves) / raw_bytes, worst, ok ? "curves valid" : "curves invalid");
+    const char* stages[] = { "compress", "evaluate" };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("camera", sample_count, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f Ksample/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        sample_count / std::max<double>(result.ms, 1e-6), result.peak_bytes / (1024.0 * 1024.0), result.allocations);
+    }
+    return ok;
+  }
+
+  // Materials of the same shader, textures and values, with 0 and -0 alike
+  bool same_material(const MaterialDesc& lhs, const MaterialDesc& rhs)
+  {
+    if (lhs.shader != rhs.shader || lhs.texture != rhs.texture || lhs.processed_texture != rhs.processed_texture ||
+      lhs.values.size() != rhs.values.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < lhs.values.size(); ++i) {
+      const MaterialValue& a = lhs.values[i];
+      const MaterialValue& b = rhs.values[i];
+      if (a.name != b.name || a.type != b.type ||
+        a.value[0] != b.value[0] || a.value[1] != b.value[1] || a.value[2] != b.value[2] || a.value[3] != b.value[3]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Merges the material groups, each bound to a mesh per material and to an effect, and checks
+  // every binding and the remap still refer to a material equal to the original
+  bool run_materials_case(Results& results, const uint32_t material_count)
+  {
+    StringTable strings;
+    SceneDescription scene(strings);
+    char name[32];
+    for (uint32_t i = 0; i < material_count; ++i) {
+      const uint32_t group = i / kMaterialCopies;
+      MaterialDesc material;
+      sprintf_s(name, sizeof(name), "material_%u", i);
+      material.name = strings.intern(name);
+      sprintf_s(name, sizeof(name), "shader_%u", group % kMaterialShaders);
+      material.shader = strings.intern(name);
+      sprintf_s(name, sizeof(name), "texture_%u.png", group);
+      material.texture = strings.intern(name);
+      float color[4] = { (group % 256) / 255.0f, 0.5f, (group / 256) / 255.0f, 0 };
+      const float specular[4] = { 0.25f, 0, 0, 0 };
+      if (i % kMaterialCopies == 2) {
+        color[3] = -0.0f;
+      } else if (i % kMaterialCopies == 3) {
+        // the next float up, VS2008 has no nextafterf
+        uint32_t bits;
+        memcpy(&bits, &color[1], sizeof(bits));
+        ++bits;
+        memcpy(&color[1], &bits, sizeof(bits));
+      }
+      scene.add_value(material, "color", MaterialValue::kColor, color);
+      scene.add_value(material, "specular", MaterialValue::kFloat, specular);
+      scene.add_material(material);
+
+      sprintf_s(name, sizeof(name), "mesh_%u", i);
+      MaterialBinding binding = { strings.intern(name), i };
+      scene.material_bindings.push_back(binding);
+      if (i % kMaterialCopies == 0) {
+        sprintf_s(name, sizeof(name), "effect_%u", group);
+        scene.effect_bindings.push_back(EffectBinding());
+        scene.effect_bindings.back().effect = strings.intern(name);
+      }
+      scene.effect_bindings.back().materials.push_back(i);
+    }
+    const std::vector<MaterialDesc> originals(scene.materials);
+
+    uint32_t removed = 0;
+    std::vector<uint32_t> remap;
+    {
+      StageScope scope;
+      removed = scene.merge_duplicate_materials(&remap);
+      add_result(results, make_key("materials", material_count, "merge"), scope);
+    }
+
+    // each group leaves its material and the near duplicate, and the effects bind both
+    const uint32_t group_count = material_count / kMaterialCopies;
+    bool ok = scene.materials.size() == 2 * group_count && scene.effect_bindings.size() == group_count;
+    for (uint32_t i = 0; ok && i < material_count; ++i) {
+      const MaterialBinding& binding = scene.material_bindings[i];
+      const uint32_t first = binding.material;
+      const uint32_t copy = i % kMaterialCopies;
+      ok = first < scene.materials.size() && remap[i] == first && same_material(scene.materials[first], originals[i]) &&
+        (copy == 0 || (scene.material_bindings[i - copy].material == first) == (copy != 3));
+    }
+    for (uint32_t i = 0; ok && i < group_count; ++i) {
+      const std::vector<uint32_t>& bound = scene.effect_bindings[i].materials;
+      ok = bound.size() == 2 && bound[0] < bound[1];
+    }
+
+    printf("%-16s %10u materials  %6u merged  %6u left  %s\n", "materials", material_count, removed,
+      (uint32_t)scene.materials.size(), ok ? "bindings valid" : "bindings invalid");
+    const StageResult& result = results[make_key("materials", material_count, "merge")];
+    printf("    %-14s %10.2f ms  %8.2f Mmaterial/s  peak %8.2f MB  %8u allocs\n", "merge", result.ms,
+      material_count / std::max<double>(result.ms, 1e-6) / 1000.0, result.peak_bytes / (1024.0 * 1024.0),
+      result.allocations);
+    return ok;
+  }
+}
+
+bool run_scene_cases(Results& results, const BenchOptions& options)
+{
+  for (uint32_t i = 0; i < kNumNodeCounts && kNodeCounts[i] <= options.max_nodes; ++i) {
+    run_scene_case(results, kNodeCounts[i]);
+  }
+  return true;
+}
+
+bool run_load_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumTriangleCounts && kTriangleCounts[i] <= std::min<uint32_t>(options.max_triangles, 1000000); ++i) {
+    ok = run_load_case(results, kTriangleCounts[i]) && ok;
+  }
+  return ok;
+}
+
+bool run_camera_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumCameraSampleCounts; ++i) {
+    ok = run_camera_case(results, kCameraSampleCounts[i]) && ok;
+  }
+  return ok;
+}
+
+bool run_materials_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumMaterialCounts; ++i) {
+    ok = run_materials_case(results, kMaterialCounts[i]) && ok;
+  }
+  return ok;
+}
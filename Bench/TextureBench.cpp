@@ -0,0 +1,180 @@
+/**
+ * The "textures" generator builds mip chains of synthetic images with the SSE2 box filter, a
+ * scalar reference and the Kaiser filter, block compresses them, processes a batch of textures
+ * in parallel, and reads the .rtx files back to check them. The Kaiser mips are hashed for the
+ * baseline comparison.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include "BenchCommon.hpp"
+#include "../Exporter/DependencyManifest.hpp"
+#include "../Reader/RdxTexture.hpp"
+
+namespace
+{
+  // Texture widths, with the height 3/4 of that, so 1000 gives odd sizes down the mip chain
+  const uint32_t kTextureSizes[] = { 256, 1000, 2048 };
+  const uint32_t kNumTextureSizes = sizeof(kTextureSizes) / sizeof(kTextureSizes[0]);
+  const uint32_t kTextureBatch = 8;
+  // RMS error of the decoded top mip, out of 255
+  const double kMaxTextureRmse = 6;
+
+  // What downsample_box computes, one pixel at a time
+  void downsample_box_reference(TextureImage& dst, const TextureImage& src)
+  {
+    dst.width = std::max<uint32_t>(src.width / 2, 1);
+    dst.height = std::max<uint32_t>(src.height / 2, 1);
+    dst.rgba.resize(dst.width * dst.height * 4);
+    for (uint32_t y = 0; y < dst.height; ++y) {
+      const uint32_t y0 = std::min<uint32_t>(2 * y, src.height - 1);
+      const uint32_t y1 = std::min<uint32_t>(2 * y + 1, src.height - 1);
+      for (uint32_t x = 0; x < dst.width; ++x) {
+        const uint32_t x0 = std::min<uint32_t>(2 * x, src.width - 1);
+        const uint32_t x1 = std::min<uint32_t>(2 * x + 1, src.width - 1);
+        for (uint32_t i = 0; i < 4; ++i) {
+          dst.rgba[(y * dst.width + x) * 4 + i] = (uint8_t)((src.rgba[(y0 * src.width + x0) * 4 + i] +
+            src.rgba[(y0 * src.width + x1) * 4 + i] + src.rgba[(y1 * src.width + x0) * 4 + i] +
+            src.rgba[(y1 * src.width + x1) * 4 + i] + 2) >> 2);
+        }
+      }
+    }
+  }
+
+  double texture_rmse(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+  {
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+      const double d = (double)a[i] - b[i];
+      sum += d * d;
+    }
+    return sqrt(sum / std::max<size_t>(a.size(), 1));
+  }
+
+  // Opens an .rtx image and checks that every mip decodes to the expected size
+  bool check_texture(double& top_rmse, const std::vector<uint8_t>& blob, const TextureImage& source)
+  {
+    RdxTextureView view;
+    if (blob.empty() || !open_texture(view, &blob[0], (uint32_t)blob.size()) ||
+      view.header->width != source.width || view.header->height != source.height) {
+      return false;
+    }
+    uint32_t expected_mips = 1;
+    while ((source.width >> expected_mips) > 0 || (source.height >> expected_mips) > 0) {
+      ++expected_mips;
+    }
+    std::vector<uint8_t> decoded;
+    for (uint32_t i = 0; i < view.header->mip_count; ++i) {
+      decode_texture_mip(decoded, view, i);
+      if (i == 0) {
+        top_rmse = texture_rmse(decoded, source.rgba);
+      }
+    }
+    return view.header->mip_count == expected_mips && view.mips[view.header->mip_count - 1].width == 1 &&
+      view.mips[view.header->mip_count - 1].height == 1;
+  }
+
+  bool run_texture_case(Results& results, const uint32_t width)
+  {
+    const uint32_t height = width * 3 / 4;
+    TextureImage opaque, cutout;
+    make_texture(opaque, width, height, false, 1);
+    make_texture(cutout, width, height, true, 2);
+
+    // the SSE2 box filter has to match the scalar one exactly
+    std::vector<TextureImage> mips;
+    {
+      StageScope scope;
+      build_mip_chain(mips, opaque, TextureFilter::kBox);
+      add_result(results, make_key("textures", width, "box_sse2"), scope);
+    }
+    bool ok = true;
+    {
+      StageScope scope;
+      TextureImage level = opaque;
+      for (size_t i = 1; i < mips.size(); ++i) {
+        TextureImage next;
+        downsample_box_reference(next, level);
+        ok &= next.rgba == mips[i].rgba;
+        level.rgba.swap(next.rgba);
+        level.width = next.width;
+        level.height = next.height;
+      }
+      add_result(results, make_key("textures", width, "box_scalar"), scope);
+    }
+    {
+      StageScope scope;
+      build_mip_chain(mips, opaque, TextureFilter::kKaiser);
+      add_result(results, make_key("textures", width, "kaiser"), scope);
+    }
+    uint64_t kaiser_hash = 0;
+    for (size_t i = 0; i < mips.size(); ++i) {
+      kaiser_hash = hash_bytes(&mips[i].rgba[0], mips[i].rgba.size(), kaiser_hash);
+    }
+    results[make_key("textures", width, "kaiser")].hash = kaiser_hash;
+
+    std::vector<uint8_t> bc1, bc3, raw;
+    {
+      StageScope scope;
+      write_texture(bc1, opaque, TextureFilter::kBox, true);
+      write_texture(bc3, cutout, TextureFilter::kBox, true);
+      add_result(results, make_key("textures", width, "bc_encode"), scope);
+    }
+    write_texture(raw, opaque, TextureFilter::kKaiser, false);
+    double bc1_rmse = 0, bc3_rmse = 0, raw_rmse = 0;
+    ok &= check_texture(bc1_rmse, bc1, opaque) && check_texture(bc3_rmse, bc3, cutout) &&
+      check_texture(raw_rmse, raw, opaque);
+    ok &= ((const RdxTextureHeader*)&bc1[0])->format == RdxTextureFormat::Bc1 &&
+      ((const RdxTextureHeader*)&bc3[0])->format == RdxTextureFormat::Bc3 && raw_rmse == 0 &&
+      bc1_rmse <= kMaxTextureRmse && bc3_rmse <= kMaxTextureRmse;
+
+    // a batch of textures through the parallel stage, the way the exporter runs it
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    std::vector<TextureJob> jobs(kTextureBatch);
+    std::vector<TextureImage> sources(kTextureBatch);
+    for (uint32_t i = 0; i < kTextureBatch; ++i) {
+      make_texture(sources[i], width, height, (i & 1) != 0, 10 + i);
+      jobs[i].image = sources[i];
+      char filename[64];
+      sprintf_s(filename, sizeof(filename), "texture_bench_%u.rtx", i);
+      jobs[i].filename = filename;
+    }
+    {
+      StageScope scope;
+      process_textures(jobs, TextureFilter::kBox, true, info.dwNumberOfProcessors);
+      add_result(results, make_key("textures", width, "process"), scope);
+    }
+    for (uint32_t i = 0; i < kTextureBatch; ++i) {
+      std::vector<uint8_t> blob;
+      double rmse = 0;
+      ok &= jobs[i].ok && load_file(jobs[i].filename.c_str(), blob) && check_texture(rmse, blob, sources[i]) &&
+        rmse <= kMaxTextureRmse;
+      remove(jobs[i].filename.c_str());
+    }
+
+    printf("%-16s %5ux%-5u  %2u mips  bc1 %8.2f KB  rmse %5.2f  bc3 %8.2f KB  rmse %5.2f  raw %8.2f KB  %s\n",
+      "textures", width, height, (uint32_t)mips.size(), bc1.size() / 1024.0, bc1_rmse, bc3.size() / 1024.0, bc3_rmse,
+      raw.size() / 1024.0, ok ? "textures valid" : "textures invalid");
+    const double mpixels = width * height / 1000000.0;
+    const char* stages[] = { "box_sse2", "box_scalar", "kaiser", "bc_encode", "process" };
+    const double stage_mpixels[] = { mpixels, mpixels, mpixels, 2 * mpixels, kTextureBatch * mpixels };
+    for (uint32_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i) {
+      const StageResult& result = results[make_key("textures", width, stages[i])];
+      printf("    %-14s %10.2f ms  %8.2f Mpixel/s  peak %8.2f MB  %8u allocs\n", stages[i], result.ms,
+        stage_mpixels[i] * 1000.0 / std::max<double>(result.ms, 1e-6), result.peak_bytes / (1024.0 * 1024.0),
+        result.allocations);
+    }
+    return ok;
+  }
+}
+
+bool run_texture_cases(Results& results, const BenchOptions& options)
+{
+  bool ok = true;
+  for (uint32_t i = 0; i < kNumTextureSizes; ++i) {
+    ok = run_texture_case(results, kTextureSizes[i]) && ok;
+  }
+  return ok;
+}
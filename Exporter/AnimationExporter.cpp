@@ -1,6 +1,7 @@
 #include "stdafx.h"
 #include "AnimationExporter.hpp"
 #include "ExporterUtils.hpp"
+#include "Profiler.hpp"
 #include <celsus/DX10Utils.hpp>
 
 namespace
@@ -27,10 +28,39 @@ namespace
     }
   }
 
+  float* put_vector(float* out, const MVector& v)
+  {
+    out[0] = (float)v.x;
+    out[1] = (float)v.y;
+    out[2] = (float)v.z;
+    return out + 3;
+  }
+
+  // The camera in world space, with the values in the order of the RdxCamera fields
+  void sample_camera(CameraTrack& track, const MTime& time, const MDagPath& path)
+  {
+    MFnCamera camera(path);
+    const MSpace::Space space = MSpace::kWorld;
+    CameraSample sample;
+    sample.time = (float)time.as(MTime::kSeconds);
+    float* values = sample.values;
+    values = put_vector(values, MVector(camera.eyePoint(space)));
+    values = put_vector(values, camera.viewDirection(space));
+    values = put_vector(values, camera.upDirection(space));
+    values = put_vector(values, camera.rightDirection(space));
+    *values++ = (float)camera.aspectRatio();
+    *values++ = (float)camera.horizontalFieldOfView();
+    *values++ = (float)camera.verticalFieldOfView();
+    *values++ = (float)camera.nearClippingPlane();
+    *values++ = (float)camera.farClippingPlane();
+    track.push_back(sample);
+  }
 }
 
-AnimationExporter::AnimationExporter(ChunkIo& writer)
+AnimationExporter::AnimationExporter(RdxWriter& writer, StringTable& strings, const SceneSnapshot& snapshot)
   : writer_(writer)
+  , strings_(strings)
+  , snapshot_(snapshot)
 {
 }
 
@@ -81,48 +111,69 @@ void AnimationExporter::extractKeyFrameTimes(std::set<MTime>& jointTimes, const
 }
 */
 
+void AnimationExporter::add_sample_times(const uint32_t node_idx, const double start_time, const double end_time)
+{
+  const double animation_length = end_time - start_time;
+  if (animation_length <= 0) {
+    time_to_path_idx_map_.insert(std::make_pair(MTime(start_time, MTime::kSeconds), node_idx));
+    return;
+  }
+  const double inc = animation_length / (double)kConstantFps;
+
+  for (double cur_time = start_time; cur_time <= end_time; cur_time += inc) {
+    time_to_path_idx_map_.insert(std::make_pair(MTime(cur_time, MTime::kSeconds), node_idx));
+  }
+}
+
 void AnimationExporter::create_time_to_idx_mapping()
 {
 
-  // create a mapping of "time -> path_idx" for each time in the
-  // animated sequence
+  // create a mapping of "time -> node_idx" for each time in the
+  // animated sequence. We export animations for transforms and cameras
 
-  for (uint32_t i = 0; i < transform_paths_.size(); ++i) {
+  const std::vector<uint32_t>& transforms = snapshot_.transforms();
+  for (size_t i = 0; i < transforms.size(); ++i) {
 
-    const MDagPath& cur_path = transform_paths_[i];
+    const uint32_t node_idx = transforms[i];
+    const MDagPath& cur_path = snapshot_.node(node_idx).path;
     double start_time, end_time;
 
     if (get_start_end_time(start_time, end_time, cur_path)) {
-
-      const double animation_length = end_time - start_time;
-      const double inc = animation_length / (double)kConstantFps;
-
-      for (double cur_time = start_time; cur_time <= end_time; cur_time += inc) {
-        time_to_path_idx_map_.insert(std::make_pair(MTime(cur_time, MTime::kSeconds), i));
-      }
+      add_sample_times(node_idx, start_time, end_time);
     } else {
-      time_to_path_idx_map_.insert(std::make_pair(MTime(0.0), i));
+      time_to_path_idx_map_.insert(std::make_pair(MTime(0.0), node_idx));
     }
   }
-}
 
-MStatus AnimationExporter::collect_transform_paths()
-{
-  // We only export animations for transforms
-  for( MItDag it(MItDag::kDepthFirst); !it.isDone(); it.next() ) {
-    MDagPath dag_path;
-    CONTINUE_ON_ERROR_MSTATUS(it.getPath(dag_path));
-    if (dag_path.apiType() == MFn::kTransform) {
-      transform_paths_.push_back(dag_path);
-    } 
+  // A camera moves with its transform and the transform's parents, so it's sampled over the
+  // keys of all of them. Static cameras aren't sampled
+  const std::vector<uint32_t>& cameras = snapshot_.cameras();
+  for (size_t i = 0; i < cameras.size(); ++i) {
+
+    const uint32_t node_idx = cameras[i];
+    MDagPath cur_path(snapshot_.node(node_idx).path);
+    bool animated = false;
+    double start_time = 0, end_time = 0;
+    for (; cur_path.length() > 0; cur_path.pop()) {
+      double path_start, path_end;
+      if (get_start_end_time(path_start, path_end, cur_path)) {
+        start_time = animated ? std::min<double>(start_time, path_start) : path_start;
+        end_time = animated ? std::max<double>(end_time, path_end) : path_end;
+        animated = true;
+      }
+    }
+    if (animated && end_time > start_time) {
+      add_sample_times(node_idx, start_time, end_time);
+    }
   }
-  return MS::kSuccess;
 }
 
 MStatus AnimationExporter::collect_transforms()
 {
   // Loop over all the saved (time, path_idx) pairs, and at each time get
-  // the transform for the path
+  // the transform or camera for the path, so the timeline is only stepped once
+  PROFILE_SCOPE("animation/sample");
+  PROFILE_COUNTER("animation/samples", (int64_t)time_to_path_idx_map_.size());
 
   const MTime initialTime = MAnimControl::currentTime();
 
@@ -130,9 +181,12 @@ MStatus AnimationExporter::collect_transforms()
     if (MAnimControl::currentTime() != it->first) {
       MAnimControl::setCurrentTime(it->first);
     }
-    const std::string path_name(strip_pipes(transform_paths_[it->second].fullPathName().asChar()));
-    Track& currentTrack = tracks_[path_name];
-    const MDagPath& current_path = transform_paths_[it->second];
+    const MDagPath& current_path = snapshot_.node(it->second).path;
+    if (snapshot_.node(it->second).object.hasFn(MFn::kCamera)) {
+      sample_camera(camera_tracks_[it->second], it->first, current_path);
+      continue;
+    }
+    Track& currentTrack = tracks_[snapshot_.path_name(it->second)];
     KeyFrame newKeyFrame;
     newKeyFrame.time = it->first;
 
@@ -142,15 +196,17 @@ MStatus AnimationExporter::collect_transforms()
   }
   // back to initial time
   MAnimControl::setCurrentTime(initialTime);
+  PROFILE_COUNTER("animation/cameras", (int64_t)camera_tracks_.size());
 
   return MS::kSuccess;
 }
 
 MStatus AnimationExporter::do_export()
 {
-  RETURN_ON_ERROR_MSTATUS(collect_transform_paths());
-
-  create_time_to_idx_mapping();
+  {
+    PROFILE_SCOPE("animation/time_mapping");
+    create_time_to_idx_mapping();
+  }
 
   if (time_to_path_idx_map_.size() == 0) {
     return MS::kSuccess;
@@ -169,7 +225,8 @@ MStatus AnimationExporter::do_export()
 MStatus AnimationExporter::write_animation()
 {
   // All times are converted to seconds when exported
-  SCOPED_CHUNK(writer_, ChunkHeader::Animation);
+  PROFILE_SCOPE("animation/write");
+  SCOPED_RDX_CHUNK(writer_, RdxChunkId::Animation);
   RETURN_ON_ERROR_BOOL(writer_.write_generic<uint32_t>(fps_));
   const double fps = fps_;
   RETURN_ON_ERROR_BOOL(writer_.write_generic<float>((float)(start_.value() / fps)));
@@ -180,10 +237,12 @@ MStatus AnimationExporter::write_animation()
 
     // write track name
     const std::string track_name = it_track->first;
-    RETURN_ON_ERROR_BOOL(writer_.write_string(track_name.c_str()));
+    PROFILE_SCOPE_ITEM("animation/track", track_name);
+    RETURN_ON_ERROR_BOOL(writer_.write_generic<uint32_t>(strings_.intern(track_name)));
 
     // write keys for track
     const uint32_t track_count = (uint32_t)it_track->second.size();
+    PROFILE_COUNTER("animation/keys", track_count);
     const bool export_static = track_count == 1;
     if (export_static) {
       std::cout << "Exporting transform " << track_name << " as static" << std::endl;
@@ -229,3 +288,13 @@ bool AnimationExporter::is_animated(const std::string& transform_name) const
   }
   return it->second.size() > 1;
 }
+
+bool AnimationExporter::get_camera_track(CameraTrack& track, const uint32_t camera_node) const
+{
+  CameraTrackMap::const_iterator it = camera_tracks_.find(camera_node);
+  if (it == camera_tracks_.end()) {
+    return false;
+  }
+  track = it->second;
+  return true;
+}
@@ -1,6 +1,8 @@
 #ifndef ANIMATION_EXPORTER_HPP
 #define ANIMATION_EXPORTER_HPP
 
+#include "SceneSnapshot.hpp"
+#include "CameraCurves.hpp"
 
 struct KeyFrame
 {
@@ -13,31 +15,36 @@ typedef std::vector<KeyFrame> Track;
 class AnimationExporter
 {
 public:
-  AnimationExporter(ChunkIo& writer);
+  AnimationExporter(RdxWriter& writer, StringTable& strings, const SceneSnapshot& snapshot);
 
   MStatus do_export();
   bool  get_track_for_transform(Track& track, const std::string& transform_name) const;
   bool  is_animated(const std::string& transform_name) const;
+  // The world space samples of an animated camera, taken in the same pass as the transforms
+  bool  get_camera_track(CameraTrack& track, const uint32_t camera_node) const;
 private:
 
   typedef std::map<std::string, Track> StringTrackMap;
 
   typedef std::multimap<MTime, uint32_t> TimeToPathIdxMap;
+  typedef std::map<uint32_t, CameraTrack> CameraTrackMap;
 
-  MStatus collect_transform_paths();
+  void add_sample_times(const uint32_t node_idx, const double start_time, const double end_time);
   void create_time_to_idx_mapping();
   MStatus write_animation();
   MStatus collect_transforms();
 
-  std::vector<MDagPath> transform_paths_;
   TimeToPathIdxMap time_to_path_idx_map_;
 
   uint32_t fps_;
   MTime start_;
   MTime end_;
   StringTrackMap tracks_;
+  CameraTrackMap camera_tracks_;
 
-  ChunkIo& writer_;
+  RdxWriter& writer_;
+  StringTable& strings_;
+  const SceneSnapshot& snapshot_;
 };
 
 #endif
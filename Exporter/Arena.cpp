@@ -0,0 +1,105 @@
+#include <malloc.h>
+#include <algorithm>
+#include "Arena.hpp"
+
+namespace
+{
+  Arena* g_current_arena = NULL;
+
+  const size_t kAlignment = 16;
+}
+
+Arena::Arena(const size_t block_size)
+  : block_size_(block_size)
+  , cur_block_(0)
+  , cur_offset_(0)
+  , used_(0)
+  , high_water_mark_(0)
+  , allocations_(0)
+  , block_allocations_(0)
+{
+}
+
+Arena::~Arena()
+{
+  free_blocks();
+}
+
+void Arena::free_blocks()
+{
+  for (size_t i = 0; i < blocks_.size(); ++i) {
+    _aligned_free(blocks_[i].data);
+  }
+  blocks_.clear();
+}
+
+void* Arena::allocate(const size_t size)
+{
+  ++allocations_;
+  const size_t aligned_size = std::max<size_t>((size + kAlignment - 1) & ~(kAlignment - 1), kAlignment);
+
+  // move on to the next block (reusing one from an earlier mesh, if it's large enough) when
+  // the current block is full
+  while (blocks_.empty() || cur_offset_ + aligned_size > blocks_[cur_block_].size) {
+    if (!blocks_.empty() && cur_block_ + 1 < blocks_.size()) {
+      used_ += cur_offset_;
+      ++cur_block_;
+      cur_offset_ = 0;
+      continue;
+    }
+
+    Block block;
+    block.size = std::max<size_t>(block_size_, aligned_size);
+    block.data = (uint8_t*)_aligned_malloc(block.size, kAlignment);
+    if (block.data == NULL) {
+      throw std::bad_alloc();
+    }
+    ++block_allocations_;
+    if (!blocks_.empty()) {
+      used_ += cur_offset_;
+      ++cur_block_;
+    }
+    cur_offset_ = 0;
+    blocks_.push_back(block);
+  }
+
+  void* ptr = blocks_[cur_block_].data + cur_offset_;
+  cur_offset_ += aligned_size;
+  high_water_mark_ = std::max<size_t>(high_water_mark_, used_ + cur_offset_);
+  return ptr;
+}
+
+void Arena::reset()
+{
+  // merge the blocks into one, so the next mesh of the same size fits in a single block
+  if (blocks_.size() > 1) {
+    free_blocks();
+    block_size_ = std::max<size_t>(block_size_, high_water_mark_);
+  }
+  cur_block_ = 0;
+  cur_offset_ = 0;
+  used_ = 0;
+}
+
+Arena* Arena::current()
+{
+  return g_current_arena;
+}
+
+void Arena::set_current(Arena* arena)
+{
+  g_current_arena = arena;
+}
+
+ScopedArena::ScopedArena(Arena& arena)
+  : arena_(arena)
+  , prev_(Arena::current())
+{
+  Arena::set_current(&arena_);
+}
+
+ScopedArena::~ScopedArena()
+{
+  Arena::set_current(prev_);
+  arena_.reset();
+}
@@ -0,0 +1,137 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+/**
+ * Linear allocator for the per mesh temporaries. Allocations bump a pointer in the current
+ * block, frees are no-ops, and everything is released at once when the arena is reset after
+ * the mesh. On reset the blocks are merged into a single block the size of the high water
+ * mark, so once the largest mesh has been seen no more system allocations are made.
+ *
+ * An arena is made current with ScopedArena, and the containers using ArenaAllocator pick up
+ * the current arena when they are constructed. Containers created without a current arena
+ * use the heap, so the same types work outside of the mesh export. Nothing allocated from
+ * the arena may outlive the ScopedArena.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <new>
+#include <vector>
+
+class Arena
+{
+public:
+  explicit Arena(const size_t block_size = 1 << 20);
+  ~Arena();
+
+  // Returns 16 byte aligned memory
+  void* allocate(const size_t size);
+  void reset();
+
+  // Statistics since the arena was created
+  uint32_t allocations() const { return allocations_; }
+  uint32_t block_allocations() const { return block_allocations_; }
+  size_t high_water_mark() const { return high_water_mark_; }
+
+  static Arena* current();
+  static void set_current(Arena* arena);
+
+private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  struct Block
+  {
+    uint8_t* data;
+    size_t size;
+  };
+
+  void free_blocks();
+
+  size_t block_size_;
+  std::vector<Block> blocks_;
+  size_t cur_block_;
+  size_t cur_offset_;
+  size_t used_;           // bytes in the blocks before the current one
+  size_t high_water_mark_;
+  uint32_t allocations_;
+  uint32_t block_allocations_;
+};
+
+// Makes the arena current, and resets it and restores the previous arena when going out of scope
+struct ScopedArena
+{
+  ScopedArena(Arena& arena);
+  ~ScopedArena();
+  Arena& arena_;
+  Arena* prev_;
+};
+
+template <class T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <class U>
+  struct rebind
+  {
+    typedef ArenaAllocator<U> other;
+  };
+
+  ArenaAllocator() : arena_(Arena::current()) {}
+  ArenaAllocator(const ArenaAllocator& rhs) : arena_(rhs.arena_) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& rhs) : arena_(rhs.arena()) {}
+
+  pointer address(reference x) const { return &x; }
+  const_pointer address(const_reference x) const { return &x; }
+  size_type max_size() const { return (size_type)-1 / sizeof(T); }
+
+  pointer allocate(const size_type n, const void* = 0)
+  {
+    return (pointer)(arena_ ? arena_->allocate(n * sizeof(T)) : ::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(pointer p, const size_type)
+  {
+    if (!arena_) {
+      ::operator delete(p);
+    }
+  }
+
+  void construct(pointer p, const T& value) { new(p) T(value); }
+  void destroy(pointer p) { p->~T(); }
+
+  Arena* arena() const { return arena_; }
+
+private:
+  Arena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) { return lhs.arena() == rhs.arena(); }
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) { return lhs.arena() != rhs.arena(); }
+
+template <class T>
+struct ArenaVector
+{
+  typedef std::vector<T, ArenaAllocator<T> > Type;
+};
+
+template <class K, class V, class Less = std::less<K> >
+struct ArenaMap
+{
+  typedef std::map<K, V, Less, ArenaAllocator<std::pair<const K, V> > > Type;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include "BlockManifest.hpp"
+#include "DependencyManifest.hpp"
+#include "../Reader/RdxFormat.hpp"
+
+namespace
+{
+  const uint32_t kBlockManifestVersion = 1;
+
+  void add_block(BlockManifest& manifest, const uint8_t* file, const uint32_t offset, const uint32_t size)
+  {
+    FileBlock block;
+    block.hash = hash_bytes(file + offset, size, 0);
+    block.offset = offset;
+    block.size = size;
+    manifest.blocks.push_back(block);
+  }
+
+  void add_pieces(BlockManifest& manifest, const uint8_t* file, const uint32_t begin, const uint32_t end)
+  {
+    for (uint32_t offset = begin; offset < end; offset += kRdxPatchBlockSize) {
+      add_block(manifest, file, offset, std::min<uint32_t>(kRdxPatchBlockSize, end - offset));
+    }
+  }
+
+  // The block table of a block compressed .rdx, or NULL for anything else
+  const RdxBlockEntry* block_table(const uint8_t* file, const uint32_t len)
+  {
+    if (len < sizeof(RdxFileHeader)) {
+      return NULL;
+    }
+    RdxFileHeader header;
+    memcpy(&header, file, sizeof(header));
+    const uint64_t tables_end = sizeof(RdxFileHeader) + (uint64_t)header.chunk_count * sizeof(RdxChunkEntry) +
+      (uint64_t)header.block_count * sizeof(RdxBlockEntry);
+    if (header.magic != kRdxMagic || !(header.flags & RdxFileHeader::kBlockCompressed) ||
+      tables_end > header.data_offset || header.data_offset > len) {
+      return NULL;
+    }
+    const RdxBlockEntry* blocks = (const RdxBlockEntry*)(file + sizeof(RdxFileHeader) + header.chunk_count * sizeof(RdxChunkEntry));
+    for (uint32_t i = 0; i < header.block_count; ++i) {
+      if ((uint64_t)blocks[i].offset + blocks[i].compressed_size > len) {
+        return NULL;
+      }
+    }
+    return blocks;
+  }
+}
+
+void hash_blocks(BlockManifest& manifest, const uint8_t* file, const uint32_t len)
+{
+  manifest.blocks.clear();
+  const RdxBlockEntry* blocks = block_table(file, len);
+  if (blocks) {
+    RdxFileHeader header;
+    memcpy(&header, file, sizeof(header));
+    add_pieces(manifest, file, 0, header.data_offset);
+    for (uint32_t i = 0; i < header.block_count; ++i) {
+      add_block(manifest, file, blocks[i].offset, blocks[i].compressed_size);
+    }
+    return;
+  }
+  add_pieces(manifest, file, 0, len);
+}
+
+uint64_t patch_size(const BlockManifest& old_manifest, const BlockManifest& new_manifest)
+{
+  std::set<uint64_t> old_hashes;
+  for (size_t i = 0; i < old_manifest.blocks.size(); ++i) {
+    old_hashes.insert(old_manifest.blocks[i].hash);
+  }
+  uint64_t size = 0;
+  for (size_t i = 0; i < new_manifest.blocks.size(); ++i) {
+    if (!old_hashes.count(new_manifest.blocks[i].hash)) {
+      size += new_manifest.blocks[i].size;
+    }
+  }
+  return size;
+}
+
+bool write_block_manifest(const char* filename, const BlockManifest& manifest)
+{
+  FILE* file = fopen(filename, "wt");
+  if (file == NULL) {
+    return false;
+  }
+  fprintf(file, "redux_blocks %u\n", kBlockManifestVersion);
+  for (size_t i = 0; i < manifest.blocks.size(); ++i) {
+    const FileBlock& block = manifest.blocks[i];
+    fprintf(file, "%08x%08x %u %u\n", (uint32_t)(block.hash >> 32), (uint32_t)block.hash, block.offset, block.size);
+  }
+  fclose(file);
+  return true;
+}
+
+bool read_block_manifest(BlockManifest& manifest, const char* filename)
+{
+  std::ifstream file(filename);
+  std::string line;
+  uint32_t version = 0;
+  if (!std::getline(file, line) || sscanf(line.c_str(), "redux_blocks %u", &version) != 1 ||
+    version != kBlockManifestVersion) {
+    return false;
+  }
+
+  manifest.blocks.clear();
+  while (std::getline(file, line)) {
+    uint32_t hi = 0, lo = 0;
+    FileBlock block;
+    if (sscanf(line.c_str(), "%8x%8x %u %u", &hi, &lo, &block.offset, &block.size) != 4) {
+      return false;
+    }
+    block.hash = (uint64_t)hi << 32 | lo;
+    manifest.blocks.push_back(block);
+  }
+  return true;
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCK_MANIFEST_HPP
+#define BLOCK_MANIFEST_HPP
+
+/**
+ * Block hashes of an exported file, for building binary patches between two exports. The
+ * exporter writes one next to a patch layout output, as <output without extension>.blocks.
+ * A patch only has to carry the blocks of the new file whose hash the old file doesn't have,
+ * and the others are copied from the old file by hash, wherever they moved to. Doesn't depend
+ * on Maya or stdafx.h.
+ *
+ * The file is text: a "redux_blocks <version>" line, then a "<hash> <offset> <size>" line per
+ * block, with the hash as 16 hex digits.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct FileBlock
+{
+  uint64_t hash;
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct BlockManifest
+{
+  std::vector<FileBlock> blocks;
+};
+
+// Splits a file image into blocks. A block compressed .rdx gives its headers and tables in
+// kRdxPatchBlockSize pieces followed by each compressed block, anything else gives
+// kRdxPatchBlockSize pieces
+void hash_blocks(BlockManifest& manifest, const uint8_t* file, const uint32_t len);
+
+// The bytes a patch from the old file to the new one carries
+uint64_t patch_size(const BlockManifest& old_manifest, const BlockManifest& new_manifest);
+
+bool write_block_manifest(const char* filename, const BlockManifest& manifest);
+bool read_block_manifest(BlockManifest& manifest, const char* filename);
+
+#endif
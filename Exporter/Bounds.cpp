@@ -0,0 +1,346 @@
+#include <float.h>
+#include <math.h>
+#include <vector>
+#include <xmmintrin.h>
+#include "Arena.hpp"
+#include "Bounds.hpp"
+#include "Miniball.h"
+
+namespace
+{
+  const uint32_t kBoundsVersion = 1;
+
+  // Directions used to find the extreme points (the EPOS-26 set, 13 directions)
+  const float kExtremeDirections[13][3] = {
+    { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },
+    { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 },
+    { 1, 1, 0 }, { 1, -1, 0 }, { 1, 0, 1 }, { 1, 0, -1 }, { 0, 1, 1 }, { 0, 1, -1 },
+  };
+
+  // The exact sphere is found by adding the worst outlier to the Miniball point set until all
+  // points are inside. This normally converges after a handful of iterations.
+  const uint32_t kMaxExactIterations = 64;
+
+  inline const D3DXVECTOR3& get_position(const float* positions, const uint32_t idx, const uint32_t stride)
+  {
+    return *(const D3DXVECTOR3*)((const uint8_t*)positions + idx * stride);
+  }
+
+  inline float dist_sq(const D3DXVECTOR3& a, const D3DXVECTOR3& b)
+  {
+    const D3DXVECTOR3 d(a - b);
+    return d.x * d.x + d.y * d.y + d.z * d.z;
+  }
+
+  inline float dot(const D3DXVECTOR3& a, const float* b)
+  {
+    return a.x * b[0] + a.y * b[1] + a.z * b[2];
+  }
+
+  // Collects the min and max points along each of the first direction_count extreme directions
+  void find_extreme_points(ArenaVector<uint32_t>::Type& extremes, const float* positions, const uint32_t count,
+    const uint32_t stride, const uint32_t direction_count)
+  {
+    extremes.assign(2 * direction_count, 0);
+    ArenaVector<float>::Type min_proj(direction_count, FLT_MAX);
+    ArenaVector<float>::Type max_proj(direction_count, -FLT_MAX);
+    for (uint32_t i = 0; i < count; ++i) {
+      const D3DXVECTOR3& p = get_position(positions, i, stride);
+      for (uint32_t j = 0; j < direction_count; ++j) {
+        const float proj = dot(p, kExtremeDirections[j]);
+        if (proj < min_proj[j]) {
+          min_proj[j] = proj;
+          extremes[2 * j + 0] = i;
+        }
+        if (proj > max_proj[j]) {
+          max_proj[j] = proj;
+          extremes[2 * j + 1] = i;
+        }
+      }
+    }
+  }
+
+  // Grows the sphere to include all the points (Ritter's second pass)
+  void grow_sphere(Sphere& sphere, const float* positions, const uint32_t count, const uint32_t stride)
+  {
+    float radius_sq = sphere.radius * sphere.radius;
+    for (uint32_t i = 0; i < count; ++i) {
+      const D3DXVECTOR3& p = get_position(positions, i, stride);
+      const float d_sq = dist_sq(p, sphere.center);
+      if (d_sq > radius_sq) {
+        const float d = sqrtf(d_sq);
+        const float new_radius = 0.5f * (sphere.radius + d);
+        sphere.center += (p - sphere.center) * ((new_radius - sphere.radius) / d);
+        sphere.radius = new_radius;
+        radius_sq = new_radius * new_radius;
+      }
+    }
+  }
+
+  // Jacobi eigen decomposition of a symmetric 3x3 matrix. The eigenvectors are returned as rows.
+  void eigen_decomposition(double a[3][3], double v[3][3])
+  {
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        v[i][j] = i == j ? 1 : 0;
+      }
+    }
+
+    for (int sweep = 0; sweep < 32; ++sweep) {
+      const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+      if (off < 1e-20) {
+        break;
+      }
+      for (int p = 0; p < 2; ++p) {
+        for (int q = p + 1; q < 3; ++q) {
+          if (fabs(a[p][q]) < 1e-20) {
+            continue;
+          }
+          const double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+          const double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+          const double c = 1 / sqrt(t * t + 1);
+          const double s = t * c;
+          for (int k = 0; k < 3; ++k) {
+            const double akp = a[k][p];
+            const double akq = a[k][q];
+            a[k][p] = c * akp - s * akq;
+            a[k][q] = s * akp + c * akq;
+          }
+          for (int k = 0; k < 3; ++k) {
+            const double apk = a[p][k];
+            const double aqk = a[q][k];
+            a[p][k] = c * apk - s * aqk;
+            a[q][k] = s * apk + c * aqk;
+          }
+          for (int k = 0; k < 3; ++k) {
+            const double vpk = v[p][k];
+            const double vqk = v[q][k];
+            v[p][k] = c * vpk - s * vqk;
+            v[q][k] = s * vpk + c * vqk;
+          }
+        }
+      }
+    }
+  }
+}
+
+void compute_aabb(Aabb& aabb, const float* positions, const uint32_t count, const uint32_t stride)
+{
+  if (count == 0) {
+    aabb.min = aabb.max = D3DXVECTOR3(0, 0, 0);
+    return;
+  }
+
+  // Each load reads 4 floats, so the last position is loaded separately to stay inside the buffer.
+  // The 4th lane is ignored.
+  __m128 min0 = _mm_set1_ps(FLT_MAX);
+  __m128 max0 = _mm_set1_ps(-FLT_MAX);
+  __m128 min1 = min0;
+  __m128 max1 = max0;
+  const uint8_t* ptr = (const uint8_t*)positions;
+  uint32_t i = 0;
+  for (; i + 2 < count; i += 2) {
+    const __m128 a = _mm_loadu_ps((const float*)(ptr + i * stride));
+    const __m128 b = _mm_loadu_ps((const float*)(ptr + (i + 1) * stride));
+    min0 = _mm_min_ps(min0, a);
+    max0 = _mm_max_ps(max0, a);
+    min1 = _mm_min_ps(min1, b);
+    max1 = _mm_max_ps(max1, b);
+  }
+  for (; i < count; ++i) {
+    const D3DXVECTOR3& p = get_position(positions, i, stride);
+    const __m128 a = _mm_set_ps(0, p.z, p.y, p.x);
+    min0 = _mm_min_ps(min0, a);
+    max0 = _mm_max_ps(max0, a);
+  }
+
+  float res_min[4], res_max[4];
+  _mm_storeu_ps(res_min, _mm_min_ps(min0, min1));
+  _mm_storeu_ps(res_max, _mm_max_ps(max0, max1));
+  aabb.min = D3DXVECTOR3(res_min[0], res_min[1], res_min[2]);
+  aabb.max = D3DXVECTOR3(res_max[0], res_max[1], res_max[2]);
+}
+
+void compute_approx_sphere(Sphere& sphere, const float* positions, const uint32_t count, const uint32_t stride)
+{
+  if (count == 0) {
+    sphere.center = D3DXVECTOR3(0, 0, 0);
+    sphere.radius = 0;
+    return;
+  }
+
+  // Start with the sphere spanned by the most distant pair of extreme points (EPOS-14),
+  // and grow it to include the rest
+  ArenaVector<uint32_t>::Type extremes;
+  find_extreme_points(extremes, positions, count, stride, 7);
+
+  uint32_t best = 0;
+  float best_dist_sq = -1;
+  for (uint32_t i = 0; i < extremes.size(); i += 2) {
+    const float d_sq = dist_sq(get_position(positions, extremes[i], stride), get_position(positions, extremes[i + 1], stride));
+    if (d_sq > best_dist_sq) {
+      best_dist_sq = d_sq;
+      best = i;
+    }
+  }
+
+  const D3DXVECTOR3& a = get_position(positions, extremes[best + 0], stride);
+  const D3DXVECTOR3& b = get_position(positions, extremes[best + 1], stride);
+  sphere.center = 0.5f * (a + b);
+  sphere.radius = 0.5f * sqrtf(best_dist_sq);
+  grow_sphere(sphere, positions, count, stride);
+}
+
+void compute_exact_sphere(Sphere& sphere, const float* positions, const uint32_t count, const uint32_t stride)
+{
+  if (count == 0) {
+    sphere.center = D3DXVECTOR3(0, 0, 0);
+    sphere.radius = 0;
+    return;
+  }
+
+  ArenaVector<uint32_t>::Type subset;
+  find_extreme_points(subset, positions, count, stride, 13);
+
+  for (uint32_t iteration = 0; iteration < kMaxExactIterations; ++iteration) {
+    miniball::Miniball<3> mb;
+    for (size_t i = 0; i < subset.size(); ++i) {
+      const D3DXVECTOR3& p = get_position(positions, subset[i], stride);
+      mb.check_in(miniball::Point<3>(p.x, p.y, p.z));
+    }
+    mb.build();
+
+    const miniball::Point<3> center = mb.center();
+    sphere.center = D3DXVECTOR3((float)center[0], (float)center[1], (float)center[2]);
+    sphere.radius = (float)sqrt(mb.squared_radius());
+
+    // find the point furthest outside the ball
+    const float limit_sq = sphere.radius * sphere.radius * (1 + 1e-6f);
+    float worst_sq = limit_sq;
+    uint32_t worst = count;
+    for (uint32_t i = 0; i < count; ++i) {
+      const float d_sq = dist_sq(get_position(positions, i, stride), sphere.center);
+      if (d_sq > worst_sq) {
+        worst_sq = d_sq;
+        worst = i;
+      }
+    }
+
+    if (worst == count) {
+      return;
+    }
+    subset.push_back(worst);
+  }
+
+  // didn't converge, so make sure everything is inside
+  grow_sphere(sphere, positions, count, stride);
+}
+
+void compute_obb(Obb& obb, const float* positions, const uint32_t count, const uint32_t stride)
+{
+  if (count == 0) {
+    obb.center = obb.extents = D3DXVECTOR3(0, 0, 0);
+    obb.axes[0] = D3DXVECTOR3(1, 0, 0);
+    obb.axes[1] = D3DXVECTOR3(0, 1, 0);
+    obb.axes[2] = D3DXVECTOR3(0, 0, 1);
+    return;
+  }
+
+  // The axes are the eigenvectors of the covariance matrix of the points
+  double mean[3] = { 0, 0, 0 };
+  for (uint32_t i = 0; i < count; ++i) {
+    const D3DXVECTOR3& p = get_position(positions, i, stride);
+    mean[0] += p.x;
+    mean[1] += p.y;
+    mean[2] += p.z;
+  }
+  for (int i = 0; i < 3; ++i) {
+    mean[i] /= count;
+  }
+
+  double cov[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+  for (uint32_t i = 0; i < count; ++i) {
+    const D3DXVECTOR3& p = get_position(positions, i, stride);
+    const double d[3] = { p.x - mean[0], p.y - mean[1], p.z - mean[2] };
+    for (int j = 0; j < 3; ++j) {
+      for (int k = j; k < 3; ++k) {
+        cov[j][k] += d[j] * d[k];
+      }
+    }
+  }
+  cov[1][0] = cov[0][1];
+  cov[2][0] = cov[0][2];
+  cov[2][1] = cov[1][2];
+
+  double axes[3][3];
+  eigen_decomposition(cov, axes);
+
+  float axis[3][3];
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      axis[i][j] = (float)axes[i][j];
+    }
+  }
+
+  float min_proj[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float max_proj[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (uint32_t i = 0; i < count; ++i) {
+    const D3DXVECTOR3& p = get_position(positions, i, stride);
+    for (int j = 0; j < 3; ++j) {
+      const float proj = dot(p, axis[j]);
+      min_proj[j] = std::min<float>(min_proj[j], proj);
+      max_proj[j] = std::max<float>(max_proj[j], proj);
+    }
+  }
+
+  obb.center = D3DXVECTOR3(0, 0, 0);
+  for (int i = 0; i < 3; ++i) {
+    obb.axes[i] = D3DXVECTOR3(axis[i][0], axis[i][1], axis[i][2]);
+    obb.center += obb.axes[i] * (0.5f * (min_proj[i] + max_proj[i]));
+    obb.extents[i] = 0.5f * (max_proj[i] - min_proj[i]);
+  }
+}
+
+void compute_bounds(Bounds& bounds, const float* positions, const uint32_t count, const uint32_t stride,
+                    const Bounds::Mode mode, const bool obb)
+{
+  bounds.mode = mode;
+  bounds.flags = 0;
+  compute_aabb(bounds.aabb, positions, count, stride);
+
+  switch (mode) {
+    case Bounds::kAabbOnly:
+      bounds.sphere.center = 0.5f * (bounds.aabb.min + bounds.aabb.max);
+      bounds.sphere.radius = 0.5f * sqrtf(dist_sq(bounds.aabb.max, bounds.aabb.min));
+      break;
+
+    case Bounds::kApproxSphere:
+      compute_approx_sphere(bounds.sphere, positions, count, stride);
+      break;
+
+    case Bounds::kExactSphere:
+      compute_exact_sphere(bounds.sphere, positions, count, stride);
+      break;
+  }
+
+  if (obb) {
+    compute_obb(bounds.obb, positions, count, stride);
+    bounds.flags |= Bounds::kObbFlag;
+  }
+}
+
+bool write_bounds(RdxWriter& writer, const Bounds& bounds)
+{
+  if (!(writer.write_generic<uint32_t>(kBoundsVersion) &&
+    writer.write_generic<uint32_t>(bounds.mode) &&
+    writer.write_generic<uint32_t>(bounds.flags) &&
+    writer.write_generic<Aabb>(bounds.aabb) &&
+    writer.write_generic<Sphere>(bounds.sphere))) {
+      return false;
+  }
+
+  if (bounds.flags & Bounds::kObbFlag) {
+    return writer.write_generic<Obb>(bounds.obb);
+  }
+  return true;
+}
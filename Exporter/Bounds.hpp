@@ -0,0 +1,66 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <stdint.h>
+#include <D3DX10.h>
+#include "RdxWriter.hpp"
+
+/**
+ * Bounding volumes for the exported meshes. Positions are passed as a pointer and a stride,
+ * so the functions work directly on interleaved vertex data.
+ */
+
+struct Aabb
+{
+  D3DXVECTOR3 min;
+  D3DXVECTOR3 max;
+};
+
+struct Sphere
+{
+  D3DXVECTOR3 center;
+  float radius;
+};
+
+struct Obb
+{
+  D3DXVECTOR3 center;
+  D3DXVECTOR3 axes[3];
+  D3DXVECTOR3 extents;
+};
+
+struct Bounds
+{
+  enum Mode
+  {
+    kAabbOnly,      // sphere is the one enclosing the aabb
+    kApproxSphere,  // extreme points + Ritter, within a few percent of the exact sphere
+    kExactSphere    // Miniball on a growing subset of extreme points
+  };
+
+  enum Flags
+  {
+    kObbFlag = 1 << 0
+  };
+
+  Bounds() : mode(kAabbOnly), flags(0) {}
+
+  Aabb aabb;
+  Sphere sphere;
+  Obb obb;
+  Mode mode;
+  uint32_t flags;
+};
+
+void compute_aabb(Aabb& aabb, const float* positions, const uint32_t count, const uint32_t stride);
+void compute_approx_sphere(Sphere& sphere, const float* positions, const uint32_t count, const uint32_t stride);
+void compute_exact_sphere(Sphere& sphere, const float* positions, const uint32_t count, const uint32_t stride);
+void compute_obb(Obb& obb, const float* positions, const uint32_t count, const uint32_t stride);
+
+void compute_bounds(Bounds& bounds, const float* positions, const uint32_t count, const uint32_t stride,
+  const Bounds::Mode mode, const bool obb);
+
+// Writes the versioned bounds block: [version, mode, flags, aabb, sphere, (obb)]
+bool write_bounds(RdxWriter& writer, const Bounds& bounds);
+
+#endif
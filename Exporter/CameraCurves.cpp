@@ -0,0 +1,118 @@
+#include <math.h>
+#include <algorithm>
+#include "CameraCurves.hpp"
+
+namespace
+{
+  const uint32_t kCameraCurvesVersion = 1;
+  const uint32_t kMaxSamples = 0x10000;
+
+  uint16_t quantize(const RdxCurveChannel& channel, const float value)
+  {
+    if (channel.scale <= 0) {
+      return 0;
+    }
+    const float q = floorf((value - channel.min) / channel.scale + 0.5f);
+    return (uint16_t)std::min(std::max(q, 0.0f), 65535.0f);
+  }
+
+  // The quantized value of a key, as the reader sees it
+  float dequantize(const RdxCurveChannel& channel, const uint16_t value)
+  {
+    return channel.min + value * channel.scale;
+  }
+
+  // Whether the line between the quantized samples first and last stays within the tolerance
+  // of the samples in between
+  bool fits_line(const CameraTrack& samples, const RdxCurveChannel& channel, const uint32_t c,
+                 const size_t first, const size_t last, const float tolerance)
+  {
+    const float v0 = dequantize(channel, quantize(channel, samples[first].values[c]));
+    const float v1 = dequantize(channel, quantize(channel, samples[last].values[c]));
+    for (size_t i = first + 1; i < last; ++i) {
+      const float t = (float)(i - first) / (last - first);
+      if (fabsf(v0 + t * (v1 - v0) - samples[i].values[c]) > tolerance) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void add_key(CameraCurves& curves, const RdxCurveChannel& channel, const CameraTrack& samples,
+               const size_t idx, const uint32_t c)
+  {
+    RdxCurveKey key;
+    key.sample = (uint16_t)idx;
+    key.value = quantize(channel, samples[idx].values[c]);
+    curves.keys.push_back(key);
+  }
+}
+
+bool compress_camera_curves(CameraCurves& curves, const CameraTrack& samples, const float tolerance)
+{
+  curves = CameraCurves();
+  if (samples.empty() || samples.size() > kMaxSamples) {
+    return false;
+  }
+  curves.sample_count = (uint32_t)samples.size();
+  curves.start = samples.front().time;
+  curves.step = samples.size() > 1 ? (samples.back().time - samples.front().time) / (samples.size() - 1) : 0;
+
+  for (uint32_t c = 0; c < kRdxCameraChannels; ++c) {
+    float magnitude = 1;
+    float lo = samples[0].values[c];
+    float hi = lo;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      const float v = samples[i].values[c];
+      magnitude = std::max(magnitude, fabsf(v));
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+    }
+    const float channel_tolerance = tolerance * magnitude;
+
+    RdxCurveChannel channel;
+    channel.first_key = (uint32_t)curves.keys.size();
+    channel.min = lo;
+    channel.scale = (hi - lo) / 65535;
+
+    if (hi - lo <= channel_tolerance) {
+      // a constant channel keeps the midpoint of its range
+      channel.min = lo + (hi - lo) / 2;
+      channel.scale = 0;
+      add_key(curves, channel, samples, 0, c);
+    } else {
+      // extend each segment until the next sample no longer fits the line from its start
+      add_key(curves, channel, samples, 0, c);
+      size_t start = 0;
+      for (size_t end = start + 2; end < samples.size(); ++end) {
+        if (!fits_line(samples, channel, c, start, end, channel_tolerance)) {
+          start = end - 1;
+          add_key(curves, channel, samples, start, c);
+        }
+      }
+      add_key(curves, channel, samples, samples.size() - 1, c);
+    }
+    channel.key_count = (uint32_t)curves.keys.size() - channel.first_key;
+    curves.channels.push_back(channel);
+  }
+  return true;
+}
+
+bool write_camera_curves(RdxWriter& writer, const CameraCurves& curves)
+{
+  return
+    writer.write_generic<uint32_t>(kCameraCurvesVersion) &&
+    writer.write_generic<uint32_t>(curves.sample_count) &&
+    writer.write_generic<float>(curves.start) &&
+    writer.write_generic<float>(curves.step) &&
+    writer.write_generic<uint32_t>((uint32_t)curves.channels.size()) &&
+    (curves.channels.empty() || writer.write_raw_data((const uint8_t*)&curves.channels[0], (uint32_t)(curves.channels.size() * sizeof(RdxCurveChannel)))) &&
+    writer.write_generic<uint32_t>((uint32_t)curves.keys.size()) &&
+    (curves.keys.empty() || writer.write_raw_data((const uint8_t*)&curves.keys[0], (uint32_t)(curves.keys.size() * sizeof(RdxCurveKey))));
+}
+
+uint32_t camera_curves_size(const CameraCurves& curves)
+{
+  return (uint32_t)(4 * sizeof(uint32_t) + 2 * sizeof(float) + curves.channels.size() * sizeof(RdxCurveChannel) +
+    curves.keys.size() * sizeof(RdxCurveKey));
+}
@@ -0,0 +1,42 @@
+#ifndef CAMERA_CURVES_HPP
+#define CAMERA_CURVES_HPP
+
+/**
+ * Compression of sampled camera animation into the curves of the Camera chunk, see
+ * RdxCurveChannel in Reader/RdxFormat.hpp. The values of each channel are quantized to 16
+ * bits over the channel's range, and the channel keeps the samples that linear interpolation
+ * between the kept ones can't reproduce within a tolerance relative to the channel's
+ * magnitude. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "RdxWriter.hpp"
+
+// The camera at one time step, with the values in the order of the RdxCamera fields
+struct CameraSample
+{
+  float time;       // seconds
+  float values[kRdxCameraChannels];
+};
+
+typedef std::vector<CameraSample> CameraTrack;
+
+struct CameraCurves
+{
+  CameraCurves() : sample_count(0), start(0), step(0) {}
+  uint32_t sample_count;
+  float start;
+  float step;
+  std::vector<RdxCurveChannel> channels;
+  std::vector<RdxCurveKey> keys;
+};
+
+// The samples need to be evenly spaced in time. Fails for more than 64K samples
+bool compress_camera_curves(CameraCurves& curves, const CameraTrack& samples, const float tolerance);
+
+// [version, sample count, start, step, channel count, channels, key count, keys]
+bool write_camera_curves(RdxWriter& writer, const CameraCurves& curves);
+uint32_t camera_curves_size(const CameraCurves& curves);
+
+#endif
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include "DependencyManifest.hpp"
+#include "ParallelFor.hpp"
+
+namespace
+{
+  const uint32_t kManifestVersion = 1;
+  const uint32_t kHashBlockSize = 1 << 20;
+
+  const uint64_t kPrime1 = (uint64_t)0x9e3779b1 << 32 | 0x85ebca87;
+  const uint64_t kPrime2 = (uint64_t)0xc2b2ae3d << 32 | 0x27d4eb4f;
+  const uint64_t kPrime3 = (uint64_t)0x165667b1 << 32 | 0x9e3779f9;
+  const uint64_t kPrime4 = (uint64_t)0x85ebca77 << 32 | 0xc2b2ae63;
+  const uint64_t kPrime5 = (uint64_t)0x27d4eb2f << 32 | 0x165667c5;
+
+  const char* kKindNames[] = { "scene", "texture", "exporter", "settings" };
+
+  inline uint64_t rotl(const uint64_t x, const int r)
+  {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  inline uint64_t read64(const uint8_t* p)
+  {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  inline uint32_t read32(const uint8_t* p)
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  inline uint64_t hash_round(uint64_t acc, const uint64_t input)
+  {
+    acc += input * kPrime2;
+    return rotl(acc, 31) * kPrime1;
+  }
+
+  inline uint64_t merge_round(uint64_t acc, const uint64_t val)
+  {
+    acc ^= hash_round(0, val);
+    return acc * kPrime1 + kPrime4;
+  }
+
+  struct HashFilesContext
+  {
+    const std::vector<std::string>* filenames;
+    std::vector<uint64_t>* hashes;
+  };
+
+  void hash_file_item(void* context, const uint32_t idx)
+  {
+    HashFilesContext& ctx = *(HashFilesContext*)context;
+    (*ctx.hashes)[idx] = hash_file((*ctx.filenames)[idx].c_str());
+  }
+
+  bool parse_hash(uint64_t& hash, const std::string& str)
+  {
+    if (str.size() != 16) {
+      return false;
+    }
+    hash = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+      const char ch = str[i];
+      const uint64_t digit = ch >= '0' && ch <= '9' ? ch - '0' : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : 16;
+      if (digit > 15) {
+        return false;
+      }
+      hash = hash << 4 | digit;
+    }
+    return true;
+  }
+}
+
+void DependencyManifest::add(const Dependency::Kind kind, const std::string& path, const uint64_t hash)
+{
+  Dependency dep;
+  dep.kind = kind;
+  dep.hash = hash;
+  dep.path = path;
+  inputs.push_back(dep);
+}
+
+const Dependency* DependencyManifest::find(const Dependency::Kind kind) const
+{
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (inputs[i].kind == kind) {
+      return &inputs[i];
+    }
+  }
+  return NULL;
+}
+
+uint64_t hash_bytes(const void* data, const size_t len, const uint64_t seed)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  const uint8_t* end = p + len;
+  uint64_t h;
+  if (len >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = hash_round(v1, read64(p + 0));
+      v2 = hash_round(v2, read64(p + 8));
+      v3 = hash_round(v3, read64(p + 16));
+      v4 = hash_round(v4, read64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge_round(h, v1);
+    h = merge_round(h, v2);
+    h = merge_round(h, v3);
+    h = merge_round(h, v4);
+  } else {
+    h = seed + kPrime5;
+  }
+
+  h += len;
+  for (; p + 8 <= end; p += 8) {
+    h ^= hash_round(0, read64(p));
+    h = rotl(h, 27) * kPrime1 + kPrime4;
+  }
+  if (p + 4 <= end) {
+    h ^= read32(p) * kPrime1;
+    h = rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= *p * kPrime5;
+    h = rotl(h, 11) * kPrime1;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t hash_file(const char* filename)
+{
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL) {
+    return kMissingFileHash;
+  }
+
+  std::vector<uint8_t> block(kHashBlockSize);
+  std::vector<uint64_t> block_hashes;
+  uint64_t size = 0;
+  size_t len;
+  while ((len = fread(&block[0], 1, block.size(), file)) > 0) {
+    block_hashes.push_back(hash_bytes(&block[0], len, 0));
+    size += len;
+  }
+  const bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) {
+    return kMissingFileHash;
+  }
+
+  const uint64_t hash = hash_bytes(block_hashes.empty() ? NULL : &block_hashes[0], block_hashes.size() * sizeof(uint64_t), size);
+  return hash != kMissingFileHash ? hash : 1;
+}
+
+void hash_files(std::vector<uint64_t>& hashes, const std::vector<std::string>& filenames, const uint32_t thread_count)
+{
+  hashes.resize(filenames.size());
+  HashFilesContext ctx;
+  ctx.filenames = &filenames;
+  ctx.hashes = &hashes;
+  parallel_for((uint32_t)filenames.size(), hash_file_item, &ctx, thread_count);
+}
+
+bool write_manifest(const char* filename, const DependencyManifest& manifest)
+{
+  FILE* file = fopen(filename, "wt");
+  if (file == NULL) {
+    return false;
+  }
+  fprintf(file, "redux_deps %u\n", kManifestVersion);
+  for (size_t i = 0; i < manifest.inputs.size(); ++i) {
+    const Dependency& dep = manifest.inputs[i];
+    fprintf(file, "%s %08x%08x %s\n", dependency_kind_name(dep.kind),
+      (uint32_t)(dep.hash >> 32), (uint32_t)dep.hash, dep.path.c_str());
+  }
+  fclose(file);
+  return true;
+}
+
+bool read_manifest(DependencyManifest& manifest, const char* filename)
+{
+  std::ifstream file(filename);
+  std::string line;
+  uint32_t version = 0;
+  if (!std::getline(file, line) || sscanf(line.c_str(), "redux_deps %u", &version) != 1 || version != kManifestVersion) {
+    return false;
+  }
+
+  manifest.inputs.clear();
+  while (std::getline(file, line)) {
+    // the path is the rest of the line, and can have spaces
+    const size_t kind_end = line.find(' ');
+    const size_t hash_end = kind_end == std::string::npos ? std::string::npos : line.find(' ', kind_end + 1);
+    if (hash_end == std::string::npos) {
+      return false;
+    }
+    const std::string kind(line, 0, kind_end);
+    Dependency dep;
+    dep.path = line.substr(hash_end + 1);
+    if (!parse_hash(dep.hash, line.substr(kind_end + 1, hash_end - kind_end - 1))) {
+      return false;
+    }
+    const size_t kind_count = sizeof(kKindNames) / sizeof(kKindNames[0]);
+    size_t kind_idx = 0;
+    while (kind_idx < kind_count && kind != kKindNames[kind_idx]) {
+      ++kind_idx;
+    }
+    if (kind_idx == kind_count) {
+      return false;
+    }
+    dep.kind = (Dependency::Kind)kind_idx;
+    manifest.inputs.push_back(dep);
+  }
+  return true;
+}
+
+std::string manifest_filename(const std::string& output)
+{
+  const size_t slash = output.find_last_of("\\/");
+  const size_t dot = output.find_last_of('.');
+  const bool has_extension = dot != std::string::npos && (slash == std::string::npos || dot > slash + 1);
+  return (has_extension ? output.substr(0, dot) : output) + ".deps";
+}
+
+const char* dependency_kind_name(const Dependency::Kind kind)
+{
+  return kKindNames[kind];
+}
@@ -0,0 +1,63 @@
+#ifndef DEPENDENCY_MANIFEST_HPP
+#define DEPENDENCY_MANIFEST_HPP
+
+/**
+ * The manifest of what an exported file was built from. The exporter writes one next to each
+ * output, as <output without extension>.deps, with content hashes of the scene, the textures
+ * its materials use, the exporter dll and the exporter settings. ReduxBatch compares them to
+ * the current inputs to skip the scenes that are up to date. Doesn't depend on Maya or stdafx.h.
+ *
+ * The file is text: a "redux_deps <version>" line, then a "<kind> <hash> <path>" line per
+ * input, with the hash as 16 hex digits. The path of the settings line is the option string.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct Dependency
+{
+  enum Kind
+  {
+    kScene,
+    kTexture,
+    kExporter,
+    kSettings,
+  };
+
+  Kind kind;
+  uint64_t hash;
+  std::string path;
+};
+
+struct DependencyManifest
+{
+  void add(const Dependency::Kind kind, const std::string& path, const uint64_t hash);
+  // The first dependency of the kind, or NULL
+  const Dependency* find(const Dependency::Kind kind) const;
+
+  std::vector<Dependency> inputs;
+};
+
+// The hash of a file that can't be read
+const uint64_t kMissingFileHash = 0;
+
+// xxHash64
+uint64_t hash_bytes(const void* data, const size_t len, const uint64_t seed);
+
+// Content hash of the file. The file is hashed in blocks, which are then hashed together
+// with the file size
+uint64_t hash_file(const char* filename);
+
+// Hashes the files on thread_count threads
+void hash_files(std::vector<uint64_t>& hashes, const std::vector<std::string>& filenames, const uint32_t thread_count);
+
+bool write_manifest(const char* filename, const DependencyManifest& manifest);
+bool read_manifest(DependencyManifest& manifest, const char* filename);
+
+// Replaces the extension of the output with .deps
+std::string manifest_filename(const std::string& output);
+
+const char* dependency_kind_name(const Dependency::Kind kind);
+
+#endif
@@ -1,19 +1,6 @@
 #include "stdafx.h"
 #include "ExporterUtils.hpp"
-
-std::string sanitize_name(const std::string& input) 
-{
-  std::string output(input);
-  const char invalid_tokens[] = ":/ ";
-  const char valid_token = '_';
-  for (size_t i = 0; i < input.length(); ++i) {
-    if (strchr(invalid_tokens, input[i])) {
-      output[i] = valid_token;
-    }
-  }
-  return output;
-}
-
+#include "StringTable.hpp"
 
 std::string make_material_name(const MObject& src_node) {
   std::string candidate("Unknown");
@@ -45,7 +45,6 @@
   }\
 }
 
-std::string sanitize_name(const std::string& input);
 std::string make_material_name(const MObject& src_node);
 
 template<typename T>
@@ -0,0 +1,97 @@
+#include "Hierarchy.hpp"
+
+namespace
+{
+  const uint32_t kHierarchyVersion = 1;
+
+  // local = scale * rotation * translation
+  void make_local_transform(float* m, const HierarchyNode& node)
+  {
+    const float x = node.rotation[0], y = node.rotation[1], z = node.rotation[2], w = node.rotation[3];
+    const float* s = node.scale;
+    m[0] = s[0] * (1 - 2 * (y * y + z * z));  m[1] = s[0] * 2 * (x * y + z * w);        m[2] = s[0] * 2 * (x * z - y * w);
+    m[3] = s[1] * 2 * (x * y - z * w);        m[4] = s[1] * (1 - 2 * (x * x + z * z));  m[5] = s[1] * 2 * (y * z + x * w);
+    m[6] = s[2] * 2 * (x * z + y * w);        m[7] = s[2] * 2 * (y * z - x * w);        m[8] = s[2] * (1 - 2 * (x * x + y * y));
+    m[9] = node.translation[0];               m[10] = node.translation[1];              m[11] = node.translation[2];
+  }
+
+  // res = a * b, where the 4x3 matrices have an implicit [0 0 0 1] column
+  void multiply(float* res, const float* a, const float* b)
+  {
+    for (int i = 0; i < 4; ++i) {
+      const float* row = a + 3 * i;
+      for (int j = 0; j < 3; ++j) {
+        res[3 * i + j] = row[0] * b[j] + row[1] * b[3 + j] + row[2] * b[6 + j] + (i == 3 ? b[9 + j] : 0);
+      }
+    }
+  }
+}
+
+uint32_t Hierarchy::add_node(const uint32_t parent, const uint32_t name, const float* translation, const float* rotation, const float* scale)
+{
+  HierarchyNode node;
+  node.parent = parent;
+  node.name = name;
+  node.first_child = kInvalidNode;
+  node.child_count = 0;
+  for (int i = 0; i < 3; ++i) {
+    node.translation[i] = translation ? translation[i] : 0;
+    node.scale[i] = scale ? scale[i] : 1;
+  }
+  for (int i = 0; i < 4; ++i) {
+    node.rotation[i] = rotation ? rotation[i] : (i == 3 ? 1.0f : 0.0f);
+  }
+  nodes.push_back(node);
+  return (uint32_t)nodes.size() - 1;
+}
+
+bool Hierarchy::link_children()
+{
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const uint32_t parent = nodes[i].parent;
+    if (parent == kInvalidNode) {
+      continue;
+    }
+    if (parent >= i) {
+      return false;
+    }
+    HierarchyNode& p = nodes[parent];
+    if (p.child_count == 0) {
+      p.first_child = (uint32_t)i;
+    } else if (p.first_child + p.child_count != i) {
+      // the children aren't contiguous
+      return false;
+    }
+    ++p.child_count;
+  }
+  return true;
+}
+
+bool Hierarchy::write(RdxWriter& writer) const
+{
+  return
+    writer.write_generic<uint32_t>(kHierarchyVersion) &&
+    writer.write_generic<uint32_t>((uint32_t)nodes.size()) &&
+    (nodes.empty() || writer.write_raw_data((const uint8_t*)&nodes[0], (uint32_t)(nodes.size() * sizeof(HierarchyNode))));
+}
+
+uint32_t Hierarchy::serialized_size() const
+{
+  return (uint32_t)(2 * sizeof(uint32_t) + nodes.size() * sizeof(HierarchyNode));
+}
+
+void update_world_transforms(std::vector<float>& world, const std::vector<HierarchyNode>& nodes)
+{
+  world.resize(12 * nodes.size());
+  float local[12];
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const HierarchyNode& node = nodes[i];
+    float* m = &world[12 * i];
+    if (node.parent == Hierarchy::kInvalidNode) {
+      make_local_transform(m, node);
+    } else {
+      make_local_transform(local, node);
+      multiply(m, local, &world[12 * node.parent]);
+    }
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef HIERARCHY_HPP
+#define HIERARCHY_HPP
+
+/**
+ * Flat scene hierarchy. Nodes are stored breadth first, so every parent comes before its
+ * children and the children of a node are contiguous. The node array is written as is, so a
+ * loader can read it with a single copy and update the world transforms in one linear pass.
+ * Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "RdxWriter.hpp"
+
+// The node layout is part of the file format
+typedef RdxHierarchyNode HierarchyNode;
+
+class Hierarchy
+{
+public:
+  static const uint32_t kInvalidNode = 0xffffffff;
+
+  // Nodes must be added in breadth first order. A null transform gives the identity.
+  uint32_t add_node(const uint32_t parent, const uint32_t name, const float* translation, const float* rotation, const float* scale);
+
+  // Fills in first_child and child_count. Returns false if the nodes aren't breadth first.
+  bool link_children();
+
+  // [version, count, nodes[count]]
+  bool write(RdxWriter& writer) const;
+  uint32_t serialized_size() const;
+
+  std::vector<HierarchyNode> nodes;
+};
+
+// Computes the world transform of every node the way a loader would. Each transform is a 4x3
+// matrix (12 floats, row vector convention like D3DX), with the translation in the last row.
+void update_world_transforms(std::vector<float>& world, const std::vector<HierarchyNode>& nodes);
+
+#endif
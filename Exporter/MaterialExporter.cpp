@@ -20,27 +20,14 @@ void write_float4_py(FILE* file, const MColor& value, const std::string& setting
   fprintf(file, "\t\t\t(\"%s\", dx.Vector4(%f, %f, %f, 1)),\n", setting_name.c_str(), value[0], value[1], value[2]);
 }
 
-void write_color_json(FILE* file, const MColor& value, const std::string& setting_name, const bool comma = false) 
-{
-  fprintf(file, "\t\t\t{ \"name\" : \"%s\", \"type\" : \"color\", \"value\" : [%f, %f, %f, %f] }%s\n", 
-    setting_name.c_str(), value[0], value[1], value[2], value[3], comma ? "," : "" );
-}
-
-void write_float1_json(FILE* file, const float value, const std::string& setting_name, const bool comma = false) 
+float color_to_grayscale(const MColor& value) 
 {
-  fprintf(file, "\t\t\t{ \"name\" : \"%s\", \"type\" : \"float\", \"value\" : %f }%s\n", 
-    setting_name.c_str(), value, comma ? "," : "");
+  return value[0] * 0.3f + value[1] * 0.59f + value[2] * 0.11f;
 }
 
-void write_float4_json(FILE* file, const MColor& value, const std::string& setting_name, const bool comma = false) 
+const float* color_values(const MColor& value)
 {
-  fprintf(file, "\t\t\t{ \"name\" : \"%s\", \"type\" : \"vec4\", \"value\" : [%f, %f, %f, 1] }%s\n", 
-    setting_name.c_str(), value[0], value[1], value[2], comma ? "," : "");
-}
-
-float color_to_grayscale(const MColor& value) 
-{
-  return value[0] * 0.3f + value[1] * 0.59f + value[2] * 0.11f;
+  return &value.r;
 }
 
 template<class Shader>
@@ -75,60 +62,30 @@ std::string find_texture(const Shader& shader)
 }
 
 template<class Shader> 
-void write_common_material_props(FILE* material_file, const Shader& shader, const bool write_comma) 
+void collect_common_material_props(SceneDescription& scene, const Shader& shader, const MObject& shader_node) 
 {
   const std::string material_name(sanitize_name(shader.name().asChar()));
-  const std::string kTransparencyName("transparency");
-  const std::string kAmbientName("ambient_color");
-  const std::string kDiffuseName("diffuse_color");
-  const std::string kEmissiveName("emissive_color");
   const std::string texture_filename(find_texture(shader));
-  const float trans = color_to_grayscale(shader.transparency());
-  const char* psz_name = material_name.c_str();
-
-  fprintf(material_file, "\t\t{ \"name\" : \"%s\",\n", material_name.c_str());
-  fprintf(material_file, "\t\t\"values\" : [\n");
-  write_float1_json(material_file, trans, kTransparencyName, true);
-  write_color_json(material_file, shader.ambientColor(), kAmbientName, true);
-  write_color_json(material_file, shader.color(), kDiffuseName, true);
-  write_color_json(material_file, shader.incandescence(), kEmissiveName, false);
-  fprintf(material_file, "\t\t] }%s\n", (write_comma ? "," : ""));
-}
-
+  const float trans[4] = { color_to_grayscale(shader.transparency()), 0, 0, 0 };
 
-bool material_has_texture(MObject material) 
-{
-  if (!material.hasFn(MFn::kLambert)) {
-    return false;
+  MaterialDesc material;
+  material.name = scene.strings.intern(material_name);
+  material.shader = scene.strings.intern(make_shader_name(shader_node, !texture_filename.empty()));
+  if (!texture_filename.empty()) {
+    material.texture = scene.strings.intern(texture_filename);
   }
-  MFnLambertShader lambert(material);
-  MPlug color_plug(lambert.findPlug("color"));
-
-  // get plugs connected to colour attribute
-  MPlugArray plugs;
-  color_plug.connectedTo(plugs,true,false);
 
-  // see if any file textures are present
-  for( uint32_t i = 0; i != plugs.length(); ++i) {
-    // if file texture found
-    if(plugs[i].node().apiType() == MFn::kFileTexture) {
-      // bind a function set to it ....
-      MFnDependencyNode fnDep(plugs[i].node());
-
-      // get the attribute for the full texture path
-      MStatus status;
-      MPlug ftn = fnDep.findPlug("ftn", &status);
-      CONTINUE_ON_ERROR_MSTATUS(status);
-      return true;
-    }
-  } 
-  return false;
+  scene.add_value(material, "transparency", MaterialValue::kFloat, trans);
+  scene.add_value(material, "ambient_color", MaterialValue::kColor, color_values(shader.ambientColor()));
+  scene.add_value(material, "diffuse_color", MaterialValue::kColor, color_values(shader.color()));
+  scene.add_value(material, "emissive_color", MaterialValue::kColor, color_values(shader.incandescence()));
+  scene.add_material(material);
 }
 
 
-std::string make_shader_name(const MObject& src_node) 
+std::string make_shader_name(const MObject& src_node, const bool has_texture) 
 {
-  const std::string texture_suffix(material_has_texture(src_node) ? "Texture" : "");
+  const std::string texture_suffix(has_texture ? "Texture" : "");
   std::string shader_base("Diffuse");
   if (src_node.hasFn(MFn::kLambert)) {
     shader_base = "Diffuse";
@@ -150,28 +107,28 @@ MObject get_surface_shader(MObject shader_set)
   return srcplugarray[0].node();
 }
 
-MStatus write_material(FILE* file, MObject shader_node, const bool write_comma) 
+MStatus collect_material(SceneDescription& scene, MObject shader_node) 
 {
   // We're interested in the actual api type, not the function sets, so we use a switch/case
   switch(shader_node.apiType()) {
     case MFn::kLambert:
       {
         MFnLambertShader shader(shader_node);
-        write_common_material_props(file, shader, write_comma);
+        collect_common_material_props(scene, shader, shader_node);
         return MS::kSuccess;
       }
 
     case MFn::kBlinn:
       {
         MFnBlinnShader shader(shader_node);
-        write_common_material_props(file, shader, write_comma);
+        collect_common_material_props(scene, shader, shader_node);
         return MS::kSuccess;
       }
 
     case MFn::kPhong:
       {
         MFnPhongShader shader(shader_node);
-        write_common_material_props(file, shader, write_comma);
+        collect_common_material_props(scene, shader, shader_node);
         return MS::kSuccess;
       }
   }
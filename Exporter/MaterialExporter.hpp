@@ -1,8 +1,13 @@
 #ifndef MATERIAL_EXPORTER_HPP
 #define MATERIAL_EXPORTER_HPP
 
+#include "SceneDescription.hpp"
+
 MObject get_surface_shader(MObject shader_set);
-std::string make_shader_name(const MObject& src_node);
-MStatus write_material(FILE* file, MObject shader_node, const bool write_comma);
+// The texture decides the shader, and is passed in as finding it walks the plugs
+std::string make_shader_name(const MObject& src_node, const bool has_texture);
+
+// Adds the material's values to the scene description
+MStatus collect_material(SceneDescription& scene, MObject shader_node);
 
 #endif
@@ -0,0 +1,165 @@
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include "MeshBatching.hpp"
+#include "SpatialIndex.hpp"
+#include "../Reader/RdxReader.hpp"
+
+namespace
+{
+  const uint32_t kMeshBatchesVersion = 1;
+
+  // material, then the vertex format
+  typedef std::pair<uint32_t, uint32_t> GroupKey;
+
+  GroupKey group_key(const BatchSource& source)
+  {
+    const VertexFormat& format = source.format;
+    return GroupKey(source.material, format.uv_sets | format.color_sets << 8 | (format.tangents ? 1 : 0) << 16);
+  }
+
+  bool read_source(RdxMeshView& mesh, const RdxWriter& writer, const uint32_t idx)
+  {
+    RdxChunk chunk;
+    chunk.id = writer.chunk_entry(idx).id;
+    chunk.data = writer.chunk_data(idx);
+    chunk.size = writer.chunk_entry(idx).size;
+    return chunk.id == RdxChunkId::Mesh && read_mesh(mesh, chunk);
+  }
+
+  void add_batch(std::vector<MeshBatch>& batches, MeshBatch& batch)
+  {
+    if (batch.sources.size() > 1) {
+      batches.push_back(batch);
+    }
+    batch.sources.clear();
+    batch.vertex_count = 0;
+  }
+}
+
+bool plan_mesh_batches(std::vector<MeshBatch>& batches, const std::vector<BatchSource>& sources,
+                       const RdxWriter& writer, const uint32_t max_vertices)
+{
+  std::vector<uint32_t> vertex_counts(sources.size());
+  std::map<GroupKey, std::vector<uint32_t> > groups;
+  for (size_t i = 0; i < sources.size(); ++i) {
+    RdxMeshView mesh;
+    if (!read_source(mesh, writer, sources[i].chunk)) {
+      return false;
+    }
+    vertex_counts[i] = mesh.vertex_count;
+    groups[group_key(sources[i])].push_back((uint32_t)i);
+  }
+
+  for (std::map<GroupKey, std::vector<uint32_t> >::const_iterator it = groups.begin(); it != groups.end(); ++it) {
+    const std::vector<uint32_t>& group = it->second;
+    if (group.size() < 2) {
+      continue;
+    }
+    std::vector<Aabb> boxes(group.size());
+    for (size_t i = 0; i < group.size(); ++i) {
+      boxes[i] = sources[group[i]].aabb;
+    }
+    SpatialIndex index;
+    index.build(boxes);
+
+    MeshBatch batch;
+    for (size_t i = 0; i < index.items.size(); ++i) {
+      const uint32_t source = group[index.items[i]];
+      if (batch.vertex_count + vertex_counts[source] > max_vertices) {
+        add_batch(batches, batch);
+      }
+      batch.sources.push_back(source);
+      batch.vertex_count += vertex_counts[source];
+    }
+    add_batch(batches, batch);
+  }
+  return true;
+}
+
+bool write_batch_mesh(RdxWriter& writer, StringTable& strings, Bounds& bounds, std::vector<RdxMeshBatchRange>& ranges,
+                      const MeshBatch& batch, const std::vector<BatchSource>& sources, const uint32_t name,
+                      const Bounds::Mode bounds_mode, const bool obb, const bool vcache, const bool encode)
+{
+  // the sources are copied out first, as writing the batch can move the writer's data
+  VertexBuffer verts;
+  verts.format = sources[batch.sources[0]].format;
+  IndexBuffer indices;
+  const size_t first_range = ranges.size();
+  std::vector<float> mesh_vertices;
+  std::vector<uint32_t> mesh_indices;
+  for (size_t i = 0; i < batch.sources.size(); ++i) {
+    const BatchSource& source = sources[batch.sources[i]];
+    RdxMeshView mesh;
+    if (!read_source(mesh, writer, source.chunk) || mesh.vertex_size != verts.stride() ||
+      !decode_mesh(mesh_vertices, mesh_indices, mesh)) {
+      return false;
+    }
+
+    RdxMeshBatchRange range;
+    range.name = mesh.name;
+    range.parent = mesh.parent;
+    range.first_index = (uint32_t)indices.size();
+    range.index_count = mesh.index_count;
+    range.first_vertex = verts.size();
+    memcpy(&range.aabb, mesh.aabb, sizeof(range.aabb));
+    ranges.push_back(range);
+
+    IndexBuffer range_indices(mesh_indices.begin(), mesh_indices.end());
+    if (vcache) {
+      optimize_vertex_cache(range_indices);
+    }
+    for (size_t j = 0; j < range_indices.size(); ++j) {
+      indices.push_back(range.first_vertex + range_indices[j]);
+    }
+    verts.data.insert(verts.data.end(), mesh_vertices.begin(), mesh_vertices.end());
+  }
+
+  // The ranges use disjoint vertices, so in first use order the vertices of each range are
+  // contiguous
+  reorder_vertices(verts, indices);
+  for (size_t i = first_range; i < ranges.size(); ++i) {
+    RdxMeshBatchRange& range = ranges[i];
+    uint32_t min_vertex = kRdxInvalidIndex;
+    uint32_t max_vertex = 0;
+    for (uint32_t j = range.first_index; j < range.first_index + range.index_count; ++j) {
+      min_vertex = std::min<uint32_t>(min_vertex, indices[j]);
+      max_vertex = std::max<uint32_t>(max_vertex, indices[j]);
+    }
+    range.first_vertex = range.index_count ? min_vertex : 0;
+    range.vertex_count = range.index_count ? max_vertex - min_vertex + 1 : 0;
+  }
+  compute_bounds(bounds, verts.vertex(0), verts.size(), verts.stride(), bounds_mode, obb);
+
+  SCOPED_RDX_CHUNK(writer, RdxChunkId::Mesh);
+  if (!(writer.write_generic<uint32_t>(name) &&
+    writer.write_generic<uint32_t>(strings.intern("")) &&
+    write_element_desc(writer, strings, verts.format))) {
+    return false;
+  }
+  if (encode) {
+    EncodedBuffers encoded;
+    if (!(encode_vertex_buffers(encoded, verts, indices) && write_encoded_vertex_buffers(writer, encoded))) {
+      return false;
+    }
+  } else if (!write_vertex_buffers(writer, verts, indices)) {
+    return false;
+  }
+  return write_bounds(writer, bounds);
+}
+
+bool write_mesh_batches(RdxWriter& writer, const std::vector<RdxMeshBatch>& batches,
+                        const std::vector<RdxMeshBatchRange>& ranges)
+{
+  return
+    writer.write_generic<uint32_t>(kMeshBatchesVersion) &&
+    writer.write_generic<uint32_t>((uint32_t)batches.size()) &&
+    (batches.empty() || writer.write_raw_data((const uint8_t*)&batches[0], (uint32_t)(batches.size() * sizeof(RdxMeshBatch)))) &&
+    writer.write_generic<uint32_t>((uint32_t)ranges.size()) &&
+    (ranges.empty() || writer.write_raw_data((const uint8_t*)&ranges[0], (uint32_t)(ranges.size() * sizeof(RdxMeshBatchRange))));
+}
+
+uint32_t mesh_batches_size(const std::vector<RdxMeshBatch>& batches, const std::vector<RdxMeshBatchRange>& ranges)
+{
+  return (uint32_t)(3 * sizeof(uint32_t) + batches.size() * sizeof(RdxMeshBatch) + ranges.size() * sizeof(RdxMeshBatchRange));
+}
@@ -0,0 +1,58 @@
+#ifndef MESH_BATCHING_HPP
+#define MESH_BATCHING_HPP
+
+/**
+ * Draw call batching: the static meshes, which are exported in world space, are merged into
+ * batch meshes when they share a material and a vertex format, so the runtime draws each
+ * batch with one call instead of one per mesh. The meshes of a batch are neighbours, and the
+ * MeshBatches chunk keeps the ranges and bounds of the merged meshes so they can still be
+ * culled one by one, see RdxMeshBatch in Reader/RdxFormat.hpp. Works on the Mesh chunks
+ * already in the writer. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "Bounds.hpp"
+#include "MeshProcessing.hpp"
+#include "RdxWriter.hpp"
+#include "StringTable.hpp"
+
+// Batches are kept to what 16 bit indices can address
+const uint32_t kMaxBatchVertices = 65536;
+
+// A static mesh, written as a Mesh chunk
+struct BatchSource
+{
+  uint32_t chunk;
+  uint32_t material;        // string index of the material name
+  VertexFormat format;
+  Aabb aabb;
+};
+
+struct MeshBatch
+{
+  MeshBatch() : vertex_count(0) {}
+  uint32_t vertex_count;
+  std::vector<uint32_t> sources;    // indices into the sources, in spatial order
+};
+
+// Splits the sources with the same material and vertex format into batches of at most
+// max_vertices vertices. Each group is taken in the leaf order of a SpatialIndex over its
+// meshes, so a batch covers a compact part of the scene. Meshes that would end up alone in
+// a batch aren't batched.
+bool plan_mesh_batches(std::vector<MeshBatch>& batches, const std::vector<BatchSource>& sources,
+  const RdxWriter& writer, const uint32_t max_vertices);
+
+// Appends a Mesh chunk named name with the meshes of the batch merged, encoded if encode is
+// set, and appends the range of each merged mesh. When vcache is set the vertex cache is optimized
+// per range, so the ranges stay contiguous, and the vertices are in first use order.
+bool write_batch_mesh(RdxWriter& writer, StringTable& strings, Bounds& bounds, std::vector<RdxMeshBatchRange>& ranges,
+  const MeshBatch& batch, const std::vector<BatchSource>& sources, const uint32_t name,
+  const Bounds::Mode bounds_mode, const bool obb, const bool vcache, const bool encode);
+
+// [version, batch count, batches[batch count], range count, ranges[range count]]
+bool write_mesh_batches(RdxWriter& writer, const std::vector<RdxMeshBatch>& batches,
+  const std::vector<RdxMeshBatchRange>& ranges);
+uint32_t mesh_batches_size(const std::vector<RdxMeshBatch>& batches, const std::vector<RdxMeshBatchRange>& ranges);
+
+#endif
@@ -3,313 +3,349 @@
 #include "ExporterUtils.hpp"
 #include "MaterialExporter.hpp"
 #include "AnimationExporter.hpp"
-#include "Miniball.h"
-#include "vcacheopt.h"
-
-std::set<std::string> MeshExporter::mesh_names_;
+#include "Profiler.hpp"
+#include "StringTable.hpp"
 
 namespace fs = boost::filesystem;
 
-// less specialized for SuperVertex
-template<> struct std::less<SuperVertex> : public std::binary_function<SuperVertex, SuperVertex, bool> {
-  bool operator()(const SuperVertex& lhs, const SuperVertex& rhs) const {
-    for (int i = 0; i < 3; ++i ) {
-      if (lhs.pos_[i] < rhs.pos_[i] ) { return true; }
-      if (rhs.pos_[i] < lhs.pos_[i] ) { return false; }
-    }
-    for (int i = 0; i < 3; ++i ) {
-      if (lhs.normal_[i] < rhs.normal_[i] ) { return true; }
-      if (rhs.normal_[i] < lhs.normal_[i] ) { return false; }
-    }
-    for (int i = 0; i < 2; ++i ) {
-      if (lhs.uv_[i] < rhs.uv_[i] ) { return true; }
-      if (rhs.uv_[i] < lhs.uv_[i] ) { return false; }
-    }
-    return false;
-  }
-};
-
-
-namespace 
-{
-  const uint32_t kPosDataSize = 3 * sizeof(float);
-  const uint32_t kNormalDataSize = 3 * sizeof(float);
-  const uint32_t kTexCoordDataSize = 2 * sizeof(float);
-}
-
-MeshExporter::MeshExporter(MeshesByMaterialName& meshes_by_material_name, ExportedMaterials& exported_materials, 
-                           Materials& materials, ChunkIo& writer, const AnimationExporter& animation_exporter)
-                           : meshes_by_material_name_(meshes_by_material_name)
+MeshExporter::MeshExporter(MeshesByMaterialName& meshes_by_material_name, MeshNames& mesh_names,
+                           ExportedMaterials& exported_materials, Materials& materials, RdxWriter& writer, StringTable& strings, const SceneSnapshot& snapshot,
+                           const AnimationExporter& animation_exporter,
+                           const ExporterSettings& settings)
+                           : writer_(writer)
+                           , strings_(strings)
+                           , snapshot_(snapshot)
+                           , settings_(settings)
+                           , meshes_by_material_name_(meshes_by_material_name)
+                           , mesh_names_(mesh_names)
                            , exported_materials_(exported_materials)
                            , materials_(materials)
-                           , writer_(writer)
                            , animation_exporter_(animation_exporter)
 {
 }
 
 
-MStatus MeshExporter::collect_raw_data(MeshRawData& raw_data, const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path, const std::string& transform_path)
+MStatus MeshExporter::collect_raw_data(MeshRawData& raw_data, const MFnMesh& maya_mesh, const uint32_t mesh_node, 
+                                       const std::string& transform_path, const bool opposite)
 {
   const bool is_animated = animation_exporter_.is_animated(transform_path);
   const MSpace::Space space = is_animated ? MSpace::kObject : MSpace::kWorld;
 
-  RETURN_ON_ERROR_MSTATUS(maya_mesh.getPoints(raw_data.positions, space));
-  RETURN_ON_ERROR_MSTATUS(maya_mesh.getNormals(raw_data.normals, space));
-  RETURN_ON_ERROR_MSTATUS(get_uvs(raw_data.uvs, maya_mesh));
-  RETURN_ON_ERROR_MSTATUS(get_skinning_data(raw_data.skinning_data, maya_mesh, mesh_dag_path));
+  // Skinned meshes are exported in the world space bind pose, which is the skin cluster's
+  // input shape transformed by its geomMatrix, instead of the deformed mesh
+  MObject bind_shape;
+  MMatrix bind_matrix;
+  RETURN_ON_ERROR_MSTATUS(get_skinning_data(raw_data.skinning_data, bind_shape, bind_matrix, maya_mesh, mesh_node));
+  const bool skinned = !raw_data.skinning_data.influences.empty();
+
+  MPointArray positions;
+  MFloatVectorArray normals;
+  if (skinned) {
+    MStatus status;
+    MFnMesh bind_mesh(bind_shape, &status);
+    RETURN_ON_ERROR_MSTATUS(status);
+    RETURN_ON_ERROR_MSTATUS(bind_mesh.getPoints(positions, MSpace::kObject));
+    RETURN_ON_ERROR_MSTATUS(bind_mesh.getNormals(normals, MSpace::kObject));
+    const MMatrix normal_matrix(bind_matrix.inverse().transpose());
+    for (uint32_t i = 0; i < positions.length(); ++i) {
+      positions[i] *= bind_matrix;
+    }
+    for (uint32_t i = 0; i < normals.length(); ++i) {
+      normals[i] = (MVector(normals[i]) * normal_matrix).normal();
+    }
+  } else {
+    RETURN_ON_ERROR_MSTATUS(maya_mesh.getPoints(positions, space));
+    RETURN_ON_ERROR_MSTATUS(maya_mesh.getNormals(normals, space));
+  }
+
+  {
+    // convert to our coordinate system in bulk, instead of per corner when creating the vertices
+    PROFILE_SCOPE("mesh/convert");
+    const uint32_t position_count = positions.length();
+    ArenaVector<double>::Type raw_positions(4 * std::max<uint32_t>(position_count, 1));
+    RETURN_ON_ERROR_MSTATUS(positions.get((double(*)[4])&raw_positions[0]));
+    convert_points(raw_data.streams.positions, &raw_positions[0], position_count);
+
+    const uint32_t normal_count = normals.length();
+    ArenaVector<float>::Type raw_normals(3 * std::max<uint32_t>(normal_count, 1));
+    RETURN_ON_ERROR_MSTATUS(normals.get((float(*)[3])&raw_normals[0]));
+    convert_vectors(raw_data.streams.normals, &raw_normals[0], normal_count, opposite);
+
+    RETURN_ON_ERROR_MSTATUS(get_uvs(raw_data.streams.uv_sets, maya_mesh));
+    if (settings_.export_vertex_colors) {
+      RETURN_ON_ERROR_MSTATUS(get_colors(raw_data.streams.color_sets, maya_mesh));
+    }
+  }
+  {
+    // the deltas are in object space, and static and skinned meshes are exported in world space
+    PROFILE_SCOPE("mesh/morph_targets");
+    const MMatrix matrix(skinned ? bind_matrix :
+      space == MSpace::kWorld ? snapshot_.node(mesh_node).path.inclusiveMatrix() : MMatrix::identity);
+    RETURN_ON_ERROR_MSTATUS(get_morph_targets(raw_data.morph_targets, maya_mesh, mesh_node, matrix));
+  }
 
   return MS::kSuccess;
 }
 
 
-std::string MeshExporter::create_unique_mesh_name(const std::string& candidate)
+const std::string& MeshExporter::find_material_name(const MObject& shader)
 {
-  std::string mesh_name_candidate(candidate);
-  if (mesh_names_.find(mesh_name_candidate) != mesh_names_.end()) {
-    do {
-      mesh_name_candidate += "a";
-    } while (mesh_names_.find(mesh_name_candidate) != mesh_names_.end());
+  // Most shaders are shared by many meshes, so the shader nodes are looked up by their hash,
+  // and the name made and the material added once per node
+  const uint32_t hash = MObjectHandle(shader).hashCode();
+  std::pair<ShaderNames::const_iterator, ShaderNames::const_iterator> range = shader_names_.equal_range(hash);
+  for (ShaderNames::const_iterator it = range.first; it != range.second; ++it) {
+    if (it->second.first == shader) {
+      return it->second.second;
+    }
   }
-  mesh_names_.insert(mesh_name_candidate);
-  return mesh_name_candidate;
-}
 
-MStatus MeshExporter::write_element_desc(const bool has_uvs) 
-{
-  // Write the input element desc
-  const int element_desc_count = 2 + (has_uvs ? 1 : 0);
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(element_desc_count));
-
-  RETURN_ON_ERROR_BOOL(writer_.write_string("POSITION"));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(DXGI_FORMAT_R32G32B32_FLOAT));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-
-  RETURN_ON_ERROR_BOOL(writer_.write_string("NORMAL"));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(DXGI_FORMAT_R32G32B32_FLOAT));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(kPosDataSize));
-
-  if (has_uvs) {
-    RETURN_ON_ERROR_BOOL(writer_.write_string("TEXCOORD"));
-    RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-    RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(DXGI_FORMAT_R32G32_FLOAT));
-    RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(0));
-    RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(kPosDataSize + kNormalDataSize));
+  const std::string material_name(make_material_name(shader));
+  if (exported_materials_.find(material_name) == exported_materials_.end()) {
+    materials_.push_back(shader);
+    exported_materials_.insert(material_name);
   }
+  return shader_names_.insert(std::make_pair(hash, std::make_pair(shader, material_name)))->second.second;
+}
 
+MStatus MeshExporter::write_element_desc(const VertexFormat& format) 
+{
+  RETURN_ON_ERROR_BOOL(::write_element_desc(writer_, strings_, format));
   return MS::kSuccess;
 }
 
-MStatus MeshExporter::write_vertex_data( SuperVerts& super_verts,
-                                        const MeshRawData& raw_data, 
-                                        const Vertices& vertices, 
-                                        const Triangles& triangles, 
-                                        const bool opposite) 
+MStatus MeshExporter::weld_sub_mesh(VertexBuffer& super_verts,
+                                    IndexBuffer& indices,
+                                    IndexBuffer& vertex_points,
+                                    const MeshRawData& raw_data, 
+                                    const IndexBuffer& point_weights,
+                                    const SubMesh& sub_mesh,
+                                    const bool opposite) 
 {
-  // Reformat the data
-  // TODO: this should be done when we collect the data in the first place..
-  const float normal_mul = opposite ? -1.0f : 1.0f;
-  super_verts.reserve(vertices.size());
+  const Vertices& vertices = sub_mesh.vertices_;
+  const Triangles& triangles = sub_mesh.triangles_;
+
+  // the raw data is already converted, and the normals are flipped for opposite meshes
+  VertexBuffer candidates;
+  candidates.format = make_vertex_format(raw_data.streams, settings_.export_tangents);
+  candidates.format.skinned = !point_weights.empty();
+  gather_candidates(candidates, raw_data.streams, vertices, sub_mesh.stream_indices_);
+  if (candidates.format.skinned) {
+    gather_skin_weights(candidates, vertices, point_weights);
+  }
 
-  // map indices from the vertices array to the super_verts array, which only contains unique verts
-  std::map<uint32_t, uint32_t > vertex_mapping;
+  if (candidates.format.tangents) {
+    PROFILE_SCOPE("mesh/tangents");
+    compute_tangents(candidates, triangles);
+  }
 
-  // keep a mapping of super vertex -> index in super_verts array
-  std::map<SuperVertex, uint32_t, std::less<SuperVertex> > super_vertex_map;
+  PROFILE_SCOPE("mesh/weld");
+  // map indices from the vertices array to the super_verts array, which only contains unique verts
+  IndexBuffer vertex_mapping;
+  IndexBuffer weld_keys;
+  if (!raw_data.morph_targets.empty()) {
+    gather_morph_weld_keys(weld_keys, vertices);
+  }
+  weld_vertices(super_verts, vertex_mapping, candidates, weld_keys.empty() ? NULL : &weld_keys);
 
   const uint32_t vertex_count_pre = (uint32_t)vertices.size();
-  for (uint32_t i = 0; i < vertices.size(); ++i) {
-
-    D3DXVECTOR3 normal(0,0,0);
-    D3DXVECTOR3 pos(0,0,0);
-    D3DXVECTOR2 uv(0,0);
+  const uint32_t vertex_count_post = (uint32_t)super_verts.size();
+  PROFILE_COUNTER("mesh/vertices_in", vertex_count_pre);
+  PROFILE_COUNTER("mesh/vertices_out", vertex_count_post);
+  PROFILE_COUNTER("mesh/triangles", triangles.size());
 
-    // only use valid indices
-    if (vertices[i].position_index < raw_data.positions.length()) {
-      pos = to_vector3(raw_data.positions[vertices[i].position_index]);
-    }
+  remap_indices(indices, triangles, vertex_mapping, opposite);
 
-    if (vertices[i].normal_index < raw_data.normals.length()) {
-      normal = normal_mul * to_vector3(raw_data.normals[vertices[i].normal_index]);
-    }
+  // the point each welded vertex was made from, for the morph targets
+  vertex_points.assign(super_verts.size(), kRdxInvalidIndex);
+  for (size_t i = 0; i < vertex_mapping.size(); ++i) {
+    vertex_points[vertex_mapping[i]] = vertices[i].position_index;
+  }
+  return MS::kSuccess;
+}
 
-    if (raw_data.uvs.size() > 0 ) {
-      if (vertices[i].uv_index < raw_data.uvs[0].size()) {
-        uv = raw_data.uvs[0][vertices[i].uv_index];
-      }
-    }
+MStatus MeshExporter::write_vertex_data(VertexBuffer& super_verts, IndexBuffer& indices, IndexBuffer& vertex_points) 
+{
+  RETURN_ON_ERROR_MSTATUS(write_element_desc(super_verts.format));
 
-    SuperVertex candidate(pos, normal, uv);
-    if (super_vertex_map.find(candidate) == super_vertex_map.end()) {
-      super_verts.push_back(candidate);
-      const uint32_t new_idx = (uint32_t)(super_verts.size() - 1);
-      super_vertex_map.insert(std::make_pair(candidate, new_idx));
-      vertex_mapping[i] = new_idx;
-    } else {
-      vertex_mapping[i] = super_vertex_map[candidate];
+  // run the vertex cache optimizer
+  if (settings_.use_vertex_cache) {
+    PROFILE_SCOPE("mesh/vcache");
+    const VertexCacheStats stats = optimize_vertex_cache(indices);
+    if (!stats.success) {
+      cout << "Error running vertex cache optimzer" << endl;
     }
+    cout << "vertex miss count: " << stats.pre_miss_count << " -> " << stats.post_miss_count << endl;
+    PROFILE_COUNTER("mesh/vcache_misses_pre", stats.pre_miss_count);
+    PROFILE_COUNTER("mesh/vcache_misses_post", stats.post_miss_count);
   }
 
-  const uint32_t vertex_count_post = (uint32_t)super_verts.size();
-  cout << "vertex count: " << vertex_count_pre << " -> " << vertex_count_post << endl;
-
-
-  std::vector<uint32_t> indices;
-  indices.reserve(triangles.size() * 3);
-  for (uint32_t i = 0; i < triangles.size(); ++i) {
-    uint32_t a, b, c;
-    if (opposite) {
-      a = triangles[i].i[0];
-      b = triangles[i].i[1];
-      c = triangles[i].i[2];
-    } else {
-      a = triangles[i].i[2];
-      b = triangles[i].i[1];
-      c = triangles[i].i[0];
+  if (settings_.encode_meshes) {
+    PROFILE_SCOPE("mesh/encode");
+    IndexBuffer new_index;
+    reorder_vertices(super_verts, indices, &new_index);
+    IndexBuffer reordered_points(vertex_points.size());
+    for (size_t i = 0; i < new_index.size(); ++i) {
+      reordered_points[new_index[i]] = vertex_points[i];
     }
-
-    indices.push_back(vertex_mapping[a]);
-    indices.push_back(vertex_mapping[b]);
-    indices.push_back(vertex_mapping[c]);
-  }
-
-  const int vertex_count = (int32_t)super_verts.size();
-  const int index_count = (int32_t)indices.size();
-
-  const int vertex_size = sizeof(SuperVertex);
-  const int index_size = sizeof(uint32_t);
-
-  // run the vertex cache optimizer
-  int32_t* index_buffer = (int32_t*)&indices[0];
-  const int32_t triangle_count = index_count / 3;
-  VertexCacheOptimizer vcache;
-  VertexCache cache;
-  const int pre_miss_count = cache.GetCacheMissCount(index_buffer, triangle_count);
-  VertexCacheOptimizer::Result res = vcache.Optimize(index_buffer, triangle_count);
-  if (res != VertexCacheOptimizer::Success) {
-    cout << "Error running vertex cache optimzer" << endl;
+    vertex_points.assign(reordered_points.begin(), reordered_points.end());
+    EncodedBuffers encoded;
+    RETURN_ON_ERROR_BOOL(encode_vertex_buffers(encoded, super_verts, indices));
+    RETURN_ON_ERROR_BOOL(write_encoded_vertex_buffers(writer_, encoded));
+    return MS::kSuccess;
   }
-  const int post_miss_count = cache.GetCacheMissCount(index_buffer, triangle_count);
-  cout << "vertex miss count: " << pre_miss_count << " -> " << post_miss_count << endl;
-
-
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(vertex_count));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(vertex_size));
-  RETURN_ON_ERROR_BOOL(writer_.write_raw_data((uint8_t*)&super_verts[0], sizeof(SuperVertex) * vertex_count));
 
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(index_count));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(index_size));
-  RETURN_ON_ERROR_BOOL(writer_.write_raw_data((uint8_t*)&indices[0], sizeof(uint32_t) * index_count));
+  RETURN_ON_ERROR_BOOL(write_vertex_buffers(writer_, super_verts, indices));
   return MS::kSuccess;
 }
 
-MStatus MeshExporter::export_mesh(const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path) 
+MStatus MeshExporter::export_mesh(const uint32_t mesh_node) 
 {
-  // We get "random" failures on the dag_node ctor, with the error code "(kSuccess): API Error Log Opened",
-  // but this seems to be ok.
-  MStatus status;
-  MFnDagNode dag_node(mesh_dag_path, &status);
-  //RETURN_ON_ERROR_MSTATUS_FN(status, dag_node(mesh_dag_path, &status));
-
-  MObject mesh_parent = dag_node.parent(0, &status);
-  //RETURN_ON_ERROR_MSTATUS_FN(status, dag_node.parent(0, &status));
+  // The parent is the node we were reached through in the snapshot, so instanced meshes get
+  // the transform of the instance instead of the first path Maya returns
+  const SnapshotNode& node = snapshot_.node(mesh_node);
+  const MDagPath& mesh_dag_path = node.path;
+  MFnMesh maya_mesh;
+  RETURN_ON_ERROR_MSTATUS(maya_mesh.setObject(mesh_dag_path));
+
+  const std::string parent_path_name(snapshot_.path_name(node.parent));
+  const std::string path_name(snapshot_.path_name(mesh_node));
+  bool opposite = false;
+  maya_mesh.findPlug("opposite",true).getValue(opposite);
 
-  MDagPath parent_path = MDagPath::getAPathTo(mesh_parent, &status);
-  //RETURN_ON_ERROR_MSTATUS_FN(status, MDagPath::getAPathTo(mesh_parent, &status));
-
-  const std::string parent_path_name(strip_pipes(parent_path.fullPathName().asChar()));
-  const std::string path_name(strip_pipes(mesh_dag_path.fullPathName().asChar()));
   MeshRawData raw_data;
-  RETURN_ON_ERROR_MSTATUS(collect_raw_data(raw_data, maya_mesh, mesh_dag_path, parent_path_name));
-
   SubMeshes sub_meshes;
-  RETURN_ON_ERROR_MSTATUS(create_sub_meshes(sub_meshes, maya_mesh, mesh_dag_path));
+  {
+    PROFILE_SCOPE_ITEM("mesh/extract", path_name);
+    RETURN_ON_ERROR_MSTATUS(collect_raw_data(raw_data, maya_mesh, mesh_node, parent_path_name, opposite));
+    RETURN_ON_ERROR_MSTATUS(create_sub_meshes(sub_meshes, maya_mesh, mesh_dag_path));
+  }
 
   bool found_triangles = false;
   for (SubMeshes::iterator it = sub_meshes.begin(); it != sub_meshes.end(); ++it) {
-    SubMeshPtr& sub_mesh = *it;
-    if (sub_mesh->triangles_.size() != 0) {
+    if (!it->triangles_.empty()) {
       found_triangles = true;
       break;
     }
   }
 
   if (!found_triangles) {
-    std::cout << "Skipping mesh: " << mesh_dag_path.fullPathName() << " no triangles found." << std::endl;
+    std::cout << "Skipping mesh: " << path_name << " no triangles found." << std::endl;
     return MS::kSuccess;
   }
 
+  // static meshes are exported in world space, so they can be merged into batches
+  const bool is_static = settings_.batch_meshes && !animation_exporter_.is_animated(parent_path_name) &&
+    raw_data.skinning_data.influences.empty() && raw_data.morph_targets.empty();
+
   /*
   SCOPED_CHUNK(ChunkHeader::Geometry);
   const int32_t node_id = 0;
   RETURN_ON_ERROR_BOOL(writer_.write_generic<int>(node_id));
   */
 
+  // The influences are quantized once per mesh, and each skinned sub mesh is split into parts
+  // whose joints fit the palette, each written as a Mesh chunk with its skin
+  const bool skinned = !raw_data.skinning_data.influences.empty();
+  std::vector<SkinWeights> skin_weights;
+  IndexBuffer point_weights;
+  if (skinned) {
+    quantize_skin_weights(skin_weights, point_weights, raw_data.skinning_data.influences);
+  }
+
   int32_t mesh_name_iter = 0;
   for (SubMeshes::iterator it = sub_meshes.begin(); it != sub_meshes.end(); ++it) {
-    SubMeshPtr& sub_mesh = *it;
-    if (sub_mesh->triangles_.size() == 0) {
+    const SubMesh& sub_mesh = *it;
+    if (sub_mesh.triangles_.empty()) {
       continue;
     }
-    SCOPED_CHUNK(writer_, ChunkHeader::Mesh);
-    MObject shader = sub_mesh->shader_;
-
-    const std::string mesh_name(create_unique_mesh_name(sanitize_name(toString("%s_%d", path_name.c_str(), mesh_name_iter++))));
-
-    const std::string material_name(make_material_name(shader));
-    const std::string shader_name(make_shader_name(shader));
-
-    meshes_by_material_name_[material_name].push_back(mesh_name);
-    if (exported_materials_.find(material_name) == exported_materials_.end()) {
-      materials_.push_back(shader);
-      //write_material(material_file_, shader);
-      exported_materials_.insert(material_name);
+    VertexBuffer super_verts;
+    IndexBuffer indices;
+    IndexBuffer vertex_points;
+    RETURN_ON_ERROR_MSTATUS(weld_sub_mesh(super_verts, indices, vertex_points, raw_data, point_weights, sub_mesh, opposite));
+
+    std::vector<SkinPart> parts;
+    if (skinned) {
+      PROFILE_SCOPE("mesh/palettes");
+      split_skin_palettes(parts, super_verts, indices, skin_weights, settings_.palette_joints);
+      PROFILE_COUNTER("mesh/skin_parts", parts.size());
     }
 
-    RETURN_ON_ERROR_BOOL(writer_.write_string(mesh_name));
-    RETURN_ON_ERROR_BOOL(writer_.write_string(parent_path_name));
-
-    //const bool has_texture = material_has_texture(shader);
-    // We always save a desc containing texture coords
-    const bool has_texture = true;
-    RETURN_ON_ERROR_MSTATUS(write_element_desc(has_texture));
-
-    bool opposite = false;
-    maya_mesh.findPlug("opposite",true).getValue(opposite);
-    std::vector<SuperVertex> super_verts;
-    RETURN_ON_ERROR_MSTATUS(write_vertex_data(super_verts, raw_data, sub_mesh->vertices_, sub_mesh->triangles_, opposite));
-    RETURN_ON_ERROR_MSTATUS(write_geometry_info(super_verts));
-    mesh_name_iter++;
+    const size_t part_count = skinned ? parts.size() : 1;
+    for (size_t part = 0; part < part_count; ++part) {
+      VertexBuffer part_verts;
+      IndexBuffer part_indices;
+      IndexBuffer part_points;
+      if (skinned) {
+        IndexBuffer part_sources;
+        make_skin_part(part_verts, part_indices, part_sources, super_verts, parts[part], skin_weights);
+        part_points.resize(part_sources.size());
+        for (size_t i = 0; i < part_sources.size(); ++i) {
+          part_points[i] = vertex_points[part_sources[i]];
+        }
+      }
+      VertexBuffer& mesh_verts = skinned ? part_verts : super_verts;
+      IndexBuffer& mesh_indices = skinned ? part_indices : indices;
+      IndexBuffer& mesh_points = skinned ? part_points : vertex_points;
+
+      SCOPED_RDX_CHUNK(writer_, RdxChunkId::Mesh);
+      MObject shader = sub_mesh.shader_;
+
+      const std::string mesh_name(make_unique_name(mesh_names_, sanitize_name(toString("%s_%d", path_name.c_str(), mesh_name_iter++))));
+
+      const std::string& material_name(find_material_name(shader));
+      meshes_by_material_name_[material_name].push_back(mesh_name);
+
+      PROFILE_SCOPE_ITEM("mesh/submesh", mesh_name);
+      RETURN_ON_ERROR_BOOL(writer_.write_generic<uint32_t>(strings_.intern(mesh_name)));
+      RETURN_ON_ERROR_BOOL(writer_.write_generic<uint32_t>(strings_.intern(parent_path_name)));
+
+      // The element desc is written by write_vertex_data. We always save a desc containing
+      // texture coords, even if the mesh doesn't have any uv sets.
+      RETURN_ON_ERROR_MSTATUS(write_vertex_data(mesh_verts, mesh_indices, mesh_points));
+      RETURN_ON_ERROR_MSTATUS(write_geometry_info(mesh_verts));
+      if (!raw_data.morph_targets.empty()) {
+        add_morph_mesh(morph_targets_, strings_.intern(mesh_name), mesh_verts.size());
+        for (size_t i = 0; i < raw_data.morph_targets.size(); ++i) {
+          const RawMorphTarget& target = raw_data.morph_targets[i];
+          add_morph_target(morph_targets_, strings_.intern(target.name), target.deltas, mesh_points);
+        }
+      }
+      if (skinned) {
+        add_skin(skins_, strings_.intern(mesh_name), parts[part], raw_data.skinning_data.joints);
+      }
+      if (is_static) {
+        BatchSource source;
+        source.chunk = mesh_bounds_.back().chunk;
+        source.material = strings_.intern(material_name);
+        source.format = mesh_verts.format;
+        source.aabb = mesh_bounds_.back().aabb;
+        batch_sources_.push_back(source);
+      }
+      mesh_name_iter++;
+    }
   }
   return MS::kSuccess;
 }
 
-MStatus MeshExporter::write_geometry_info(const SuperVerts& super_verts)
+MStatus MeshExporter::write_geometry_info(const VertexBuffer& super_verts)
 {
+  PROFILE_SCOPE("mesh/bounds");
 
-  miniball::Miniball<3> mb;
-  for (size_t i = 0; i < super_verts.size(); ++i) {
-    mb.check_in(miniball::Point<3>(super_verts[i].pos_[0], super_verts[i].pos_[1], super_verts[i].pos_[2]));
+  Bounds bounds;
+  if (super_verts.size() > 0) {
+    compute_bounds(bounds, super_verts.vertex(0), super_verts.size(), super_verts.stride(),
+      (Bounds::Mode)settings_.bounds_mode, settings_.compute_bounding_box);
   }
 
-  mb.build();
-
-  const miniball::Point<3> center = mb.center();
-  const double radius = sqrt(mb.squared_radius());
-
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<float>((float)center[0]));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<float>((float)center[1]));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<float>((float)center[2]));
-  RETURN_ON_ERROR_BOOL(writer_.write_generic<float>((float)radius));
+  RETURN_ON_ERROR_BOOL(write_bounds(writer_, bounds));
+  mesh_bounds_.push_back(MeshBounds(writer_.chunk_count() - 1, bounds.aabb));
 
   return MS::kSuccess;
 }
 
 MStatus MeshExporter::convert_mesh_local_to_polygon_local(
-  std::vector<Triangle>& polygon_local_triangles, MIntArray triangle_indices, MIntArray poly_indices) 
+  Triangles& polygon_local_triangles, const MIntArray& triangle_indices, const MIntArray& poly_indices) 
 {
   uint32_t i = 0;
   while (i < triangle_indices.length()) {
@@ -334,7 +370,8 @@ MStatus MeshExporter::convert_mesh_local_to_polygon_local(
   return MS::kSuccess;
 }
 
-MStatus MeshExporter::add_triangles(SubMeshPtr& sub_mesh, MItMeshPolygon& poly_iter, const MFnMesh& maya_mesh) 
+MStatus MeshExporter::add_triangles(SubMesh& sub_mesh, Triangles& poly_local_triangles, MItMeshPolygon& poly_iter, 
+                                    const MStringArray& uv_set_names, const MStringArray& color_set_names) 
 {
   // Calc the vertex indices
   MPointArray triangle_points;
@@ -343,29 +380,32 @@ MStatus MeshExporter::add_triangles(SubMeshPtr& sub_mesh, MItMeshPolygon& poly_i
   poly_iter.getTriangles(triangle_points, mesh_local_triangle_indices);
   poly_iter.getVertices(mesh_local_polygon_indices);
 
-  std::vector<Triangle> poly_local_triangles;
+  poly_local_triangles.clear();
   convert_mesh_local_to_polygon_local(poly_local_triangles, mesh_local_triangle_indices, mesh_local_polygon_indices);
 
   // make the indices relative to current vertex list
-  const uint32_t vertex_offset = (uint32_t)sub_mesh->vertices_.size();
+  const uint32_t vertex_offset = (uint32_t)sub_mesh.vertices_.size();
   for (uint32_t i = 0; i < poly_local_triangles.size(); ++i) {
     poly_local_triangles[i].i[0] += vertex_offset;
     poly_local_triangles[i].i[1] += vertex_offset;
     poly_local_triangles[i].i[2] += vertex_offset;
 
-    sub_mesh->triangles_.push_back(poly_local_triangles[i]);
+    sub_mesh.triangles_.push_back(poly_local_triangles[i]);
   }
 
-  MStringArray uv_set_names;
-  const bool uvs_available = MS::kSuccess == maya_mesh.getUVSetNames(uv_set_names);
-
-  // Create the vertices
+  // Create the vertices, and their indices into each uv and color set
   for (uint32_t i = 0; i < poly_iter.polygonVertexCount(); ++i) {
-    int32_t uv_index = -1;
-    if (uvs_available) {
-      poly_iter.getUVIndex(i, uv_index, &uv_set_names[0]);
+    sub_mesh.vertices_.push_back(Vertex(poly_iter.vertexIndex(i), poly_iter.normalIndex(i)));
+    for (uint32_t j = 0; j < uv_set_names.length(); ++j) {
+      int32_t uv_index = -1;
+      poly_iter.getUVIndex(i, uv_index, &uv_set_names[j]);
+      sub_mesh.stream_indices_.push_back(uv_index);
+    }
+    for (uint32_t j = 0; j < color_set_names.length(); ++j) {
+      int32_t color_index = -1;
+      poly_iter.getColorIndex(i, color_index, &color_set_names[j]);
+      sub_mesh.stream_indices_.push_back(color_index);
     }
-    sub_mesh->vertices_.push_back(Vertex(poly_iter.vertexIndex(i), poly_iter.normalIndex(i), uv_index));
   }
   return MS::kSuccess;
 }
@@ -379,50 +419,97 @@ MStatus MeshExporter::create_sub_meshes(SubMeshes& sub_meshes, const MFnMesh& ma
     return MS::kSuccess;
   }
 
+  sub_meshes.resize(shaders.length());
+  for (uint32_t i = 0; i < shaders.length(); ++i) {
+    sub_meshes[i].shader_ = get_surface_shader(shaders[i]);
+  }
+
+  // the set names have to match the streams returned by get_uvs and get_colors
+  MStringArray uv_set_names;
+  MStringArray color_set_names;
+  RETURN_ON_ERROR_MSTATUS(maya_mesh.getUVSetNames(uv_set_names));
+  if (settings_.export_vertex_colors) {
+    RETURN_ON_ERROR_MSTATUS(maya_mesh.getColorSetNames(color_set_names));
+  }
+
+  // size the sub meshes up front, so they grow in the arena only once
+  const uint32_t stream_index_count = uv_set_names.length() + color_set_names.length();
+  IndexBuffer face_counts(shaders.length(), 0);
+  IndexBuffer corner_counts(shaders.length(), 0);
+  for (uint32_t i = 0; i < shader_indices.length(); ++i) {
+    if (shader_indices[i] >= 0 && shader_indices[i] < (int)shaders.length()) {
+      face_counts[shader_indices[i]]++;
+      corner_counts[shader_indices[i]] += maya_mesh.polygonVertexCount(i);
+    }
+  }
   for (uint32_t i = 0; i < shaders.length(); ++i) {
-    SubMesh* sub_mesh = new SubMesh();
-    sub_mesh->shader_ = get_surface_shader(shaders[i]);
-    sub_meshes.push_back(SubMeshPtr(sub_mesh));
+    sub_meshes[i].vertices_.reserve(corner_counts[i]);
+    sub_meshes[i].stream_indices_.reserve(corner_counts[i] * stream_index_count);
+    sub_meshes[i].triangles_.reserve(corner_counts[i] - std::min(2 * face_counts[i], corner_counts[i]));
   }
 
   MStatus status;
   MItMeshPolygon face_iter(maya_mesh.object(),&status);
   RETURN_ON_ERROR_MSTATUS(status);
+  Triangles poly_local_triangles;
   for (; !face_iter.isDone(); face_iter.next()) {
     const uint32_t face_index = face_iter.index();
-    RETURN_ON_ERROR_MSTATUS(add_triangles(sub_meshes[shader_indices[face_index]], face_iter, maya_mesh));
+    RETURN_ON_ERROR_MSTATUS(add_triangles(sub_meshes[shader_indices[face_index]], poly_local_triangles, face_iter,
+      uv_set_names, color_set_names));
   }
 
   return MS::kSuccess;
 }
 
-MStatus MeshExporter::get_uvs(std::vector<UVs>& uvs, const MFnMesh& maya_mesh) 
+MStatus MeshExporter::get_uvs(ArenaVector<SoaStream>::Type& uv_sets, const MFnMesh& maya_mesh) 
 {
   MStringArray uv_set_names;
   RETURN_ON_ERROR_MSTATUS(maya_mesh.getUVSetNames(uv_set_names));
 
+  uv_sets.resize(uv_set_names.length());
   for (uint32_t i = 0; i < uv_set_names.length(); ++i) {
     MFloatArray us;
     MFloatArray vs;
     RETURN_ON_ERROR_MSTATUS(maya_mesh.getUVs(us, vs, &uv_set_names[i]));
 
-    UVs cur_uvs;
-    cur_uvs.reserve(us.length());
-    for (uint32_t j = 0; j < us.length(); ++j) {
-      cur_uvs.push_back(D3DXVECTOR2(us[j], 1.0f - vs[j]));
-    }
-    uvs.push_back(cur_uvs);
+    const uint32_t uv_count = std::min<uint32_t>(us.length(), vs.length());
+    ArenaVector<float>::Type raw_us(std::max<uint32_t>(uv_count, 1));
+    ArenaVector<float>::Type raw_vs(std::max<uint32_t>(uv_count, 1));
+    RETURN_ON_ERROR_MSTATUS(us.get(&raw_us[0]));
+    RETURN_ON_ERROR_MSTATUS(vs.get(&raw_vs[0]));
+    convert_uvs(uv_sets[i], &raw_us[0], &raw_vs[0], uv_count);
   }
   return MS::kSuccess;
 }
 
-MStatus MeshExporter::get_skinning_data(SkinningData& skinning_data, const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path) 
+MStatus MeshExporter::get_colors(ArenaVector<SoaStream>::Type& color_sets, const MFnMesh& maya_mesh) 
 {
-  for (MItDependencyNodes skin_cluster_it(MFn::kSkinClusterFilter); !skin_cluster_it.isDone(); skin_cluster_it.next())
+  MStringArray color_set_names;
+  RETURN_ON_ERROR_MSTATUS(maya_mesh.getColorSetNames(color_set_names));
+
+  color_sets.resize(color_set_names.length());
+  for (uint32_t i = 0; i < color_set_names.length(); ++i) {
+    MColorArray colors;
+    RETURN_ON_ERROR_MSTATUS(maya_mesh.getColors(colors, &color_set_names[i]));
+
+    const uint32_t color_count = colors.length();
+    ArenaVector<float>::Type raw_colors(4 * std::max<uint32_t>(color_count, 1));
+    RETURN_ON_ERROR_MSTATUS(colors.get((float(*)[4])&raw_colors[0]));
+    convert_colors(color_sets[i], &raw_colors[0], color_count);
+  }
+  return MS::kSuccess;
+}
+
+MStatus MeshExporter::get_skinning_data(SkinningData& skinning_data, MObject& bind_shape, MMatrix& bind_matrix,
+                                        const MFnMesh& maya_mesh, const uint32_t mesh_node) 
+{
+  const MDagPath& mesh_dag_path = snapshot_.node(mesh_node).path;
+  std::vector<MObject> skin_clusters;
+  snapshot_.get_skin_clusters(skin_clusters, mesh_node);
+  for (size_t skin_cluster_idx = 0; skin_cluster_idx < skin_clusters.size(); ++skin_cluster_idx)
   {
     MStatus status = MS::kSuccess;
-    MObject depNodeObject = skin_cluster_it.item();
-    MFnSkinCluster maya_skin_cluster(depNodeObject, &status);
+    MFnSkinCluster maya_skin_cluster(skin_clusters[skin_cluster_idx], &status);
     CONTINUE_ON_ERROR_MSG(status, "Error creating skin cluster");
 
     // Check if our mesh is the output for this skin cluster
@@ -431,17 +518,38 @@ MStatus MeshExporter::get_skinning_data(SkinningData& skinning_data, const MFnMe
       continue;
     }
 
-    // Get the influence objects (joints)
+    // Get the influence objects (joints), and the inverse of their world matrix at bind time
     MDagPathArray influence_objects;
     maya_skin_cluster.influenceObjects(influence_objects, &status);
     CONTINUE_ON_ERROR_MSG(status, "Error getting influence objects");
+    const uint32_t first_joint = (uint32_t)skinning_data.joints.size();
+    const MPlug bind_pre_matrices = maya_skin_cluster.findPlug("bindPreMatrix", true);
     for (uint32_t i = 0; i < influence_objects.length(); ++i) {
-      skinning_data.joint_names.push_back(influence_objects[i].partialPathName().asChar());
+      // the full path without the leading '|', as in the hierarchy
+      const std::string path_name(influence_objects[i].fullPathName().asChar());
+      RdxSkinJoint joint;
+      joint.name = strings_.intern(path_name.substr(path_name.empty() ? 0 : 1));
+
+      MMatrix inverse_bind(influence_objects[i].inclusiveMatrixInverse());
+      MObject matrix_data;
+      const uint32_t logical_index = maya_skin_cluster.indexForInfluenceObject(influence_objects[i], &status);
+      if (status && bind_pre_matrices.elementByLogicalIndex(logical_index).getValue(matrix_data) == MS::kSuccess) {
+        inverse_bind = MFnMatrixData(matrix_data).matrix();
+      }
+      convert_matrix(joint.inverse_bind, inverse_bind.matrix);
+      skinning_data.joints.push_back(joint);
     }
 
     // Get the influences
     MObject maya_input_object = maya_skin_cluster.inputShapeAtIndex(shape_index, &status);
+    CONTINUE_ON_ERROR_MSG(status, "Error getting skin cluster input shape");
     skinning_data.influences.resize(maya_mesh.numVertices());
+    bind_shape = maya_input_object;
+    MObject geom_matrix_data;
+    bind_matrix = mesh_dag_path.inclusiveMatrix();
+    if (maya_skin_cluster.findPlug("geomMatrix", true).getValue(geom_matrix_data) == MS::kSuccess) {
+      bind_matrix = MFnMatrixData(geom_matrix_data).matrix();
+    }
 
     // iterate over all points (= components in Maya) and get the influences (= [boneIndex, weight])
     uint32_t pointCounter = 0;
@@ -451,13 +559,88 @@ MStatus MeshExporter::get_skinning_data(SkinningData& skinning_data, const MFnMe
       uint32_t numInfluences;
       maya_skin_cluster.getWeights(mesh_dag_path, geometryIt.component(), mayaWeightArray, numInfluences);
 
-      // Store them for this point
+      // Store them for this point, with the joints numbered across the skin clusters
       for (uint32_t j = 0; j < mayaWeightArray.length(); ++j) {
         if (mayaWeightArray[j] == 0) {
           continue;
         }
-        skinning_data.influences[pointCounter].push_back(Influence(j, mayaWeightArray[j]));
+        skinning_data.influences[pointCounter].push_back(Influence(first_joint + j, mayaWeightArray[j]));
+      }
+    }
+  }
+  return MS::kSuccess;
+}
+
+MStatus MeshExporter::get_morph_targets(ArenaVector<RawMorphTarget>::Type& morph_targets, const MFnMesh& maya_mesh,
+                                        const uint32_t mesh_node, const MMatrix& matrix)
+{
+  const MDagPath& mesh_dag_path = snapshot_.node(mesh_node).path;
+  std::vector<MObject> blend_shapes;
+  snapshot_.get_blend_shapes(blend_shapes, mesh_node);
+
+  const uint32_t point_count = maya_mesh.numVertices();
+  for (size_t blend_shape_idx = 0; blend_shape_idx < blend_shapes.size(); ++blend_shape_idx) {
+    MStatus status = MS::kSuccess;
+    MFnGeometryFilter maya_blend_shape(blend_shapes[blend_shape_idx], &status);
+    CONTINUE_ON_ERROR_MSG(status, "Error creating blend shape");
+
+    const uint32_t geometry_index = maya_blend_shape.indexForOutputShape(mesh_dag_path.node(), &status);
+    if (!status) {
+      continue;
+    }
+
+    // The deltas are read from the deformer's inputTarget array, which keeps them even when
+    // the target meshes have been deleted. Only the full weight item (6000) is exported, not
+    // the in-between targets.
+    const MObject group_attribute = maya_blend_shape.attribute("inputTargetGroup");
+    const MObject item_attribute = maya_blend_shape.attribute("inputTargetItem");
+    const MObject points_attribute = maya_blend_shape.attribute("inputPointsTarget");
+    const MObject components_attribute = maya_blend_shape.attribute("inputComponentsTarget");
+    const MPlug groups = maya_blend_shape.findPlug("inputTarget", true).elementByLogicalIndex(geometry_index).child(group_attribute);
+    const MPlug weights = maya_blend_shape.findPlug("weight", true);
+    for (uint32_t i = 0; i < weights.numElements(); ++i) {
+      const MPlug weight = weights.elementByPhysicalIndex(i);
+      const MPlug item = groups.elementByLogicalIndex(weight.logicalIndex()).child(item_attribute).elementByLogicalIndex(6000);
+      MObject points_data;
+      MObject components_data;
+      if (item.child(points_attribute).getValue(points_data) != MS::kSuccess ||
+        item.child(components_attribute).getValue(components_data) != MS::kSuccess) {
+        continue;
+      }
+      MFnPointArrayData points(points_data, &status);
+      CONTINUE_ON_ERROR_MSG(status, "Error reading blend shape deltas");
+      MFnComponentListData components(components_data, &status);
+      CONTINUE_ON_ERROR_MSG(status, "Error reading blend shape components");
+
+      // the deltas are listed in the order of the component elements
+      MIntArray point_indices;
+      for (uint32_t j = 0; j < components.length(); ++j) {
+        MIntArray elements;
+        MFnSingleIndexedComponent(components[j]).getElements(elements);
+        for (uint32_t k = 0; k < elements.length(); ++k) {
+          point_indices.append(elements[k]);
+        }
+      }
+
+      const MPointArray deltas(points.array());
+      ArenaVector<double>::Type raw_deltas(4 * std::max<uint32_t>(point_count, 1), 0.0);
+      for (uint32_t j = 0; j < std::min<uint32_t>(point_indices.length(), deltas.length()); ++j) {
+        if (point_indices[j] < 0 || (uint32_t)point_indices[j] >= point_count) {
+          continue;
+        }
+        const MVector delta(MVector(deltas[j]) * matrix);
+        double* raw_delta = &raw_deltas[4 * point_indices[j]];
+        raw_delta[0] = delta.x;
+        raw_delta[1] = delta.y;
+        raw_delta[2] = delta.z;
       }
+
+      morph_targets.push_back(RawMorphTarget());
+      RawMorphTarget& target = morph_targets.back();
+      const MString alias(maya_blend_shape.plugsAlias(weight));
+      target.name = alias.length() > 0 ? alias.asChar() :
+        toString("%s_%u", maya_blend_shape.name().asChar(), weight.logicalIndex());
+      convert_points(target.deltas, &raw_deltas[0], point_count);
     }
   }
   return MS::kSuccess;
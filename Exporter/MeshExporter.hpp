@@ -1,74 +1,47 @@
 #ifndef MESH_EXPORTER_HPP
 #define MESH_EXPORTER_HPP
 
+#include "MeshProcessing.hpp"
+#include "VertexConversion.hpp"
+#include "Bounds.hpp"
+#include "MeshBatching.hpp"
+#include "MeshLayout.hpp"
+#include "MorphTargets.hpp"
+#include "Skinning.hpp"
+#include "SceneSnapshot.hpp"
+#include "../Stub/exporter_settings.hpp"
 
-struct SuperVertex
-{
-  SuperVertex(const D3DXVECTOR3& pos, const D3DXVECTOR3& normal, const D3DXVECTOR2& uv) 
-    : pos_(pos), normal_(normal), uv_(uv) 
-  {
-  }
-
-  SuperVertex(const D3DXVECTOR3& pos, const D3DXVECTOR3& normal) 
-    : pos_(pos), normal_(normal), uv_(0,0) 
-  {
-  }
-
-  SuperVertex() 
-    : pos_(0,0,0), normal_(0,0,0), uv_(0,0) 
-  {
-  }
-
-  D3DXVECTOR3 pos_;
-  D3DXVECTOR3 normal_;
-  D3DXVECTOR2 uv_;
-};
-
-
-typedef std::vector<SuperVertex> SuperVerts;
-
-typedef std::vector<D3DXVECTOR2> UVs;
-struct Influence 
+struct SkinningData 
 {
-  Influence(const uint32_t bone_index, const float weight) : bone_index(bone_index), weight(weight) {}
-  uint32_t  bone_index;
-  float     weight;
+  std::vector<RdxSkinJoint> joints;   // the influence objects, with their inverse bind matrices
+  ArenaVector<Influences>::Type influences;
 };
 
-typedef std::vector<Influence> Influences;
-
-struct SkinningData 
+// A blend shape target, as a delta per point of the mesh
+struct RawMorphTarget
 {
-  std::vector<std::string> joint_names;
-  std::vector<Influences> influences;
+  std::string name;
+  SoaStream deltas;
 };
 
 struct MeshRawData 
 {
-  MPointArray positions;
-  MFloatVectorArray normals;
-  std::vector<UVs> uvs;
+  MeshStreams streams;
   SkinningData skinning_data;
+  ArenaVector<RawMorphTarget>::Type morph_targets;
 };
 
-// A vertex contains indices into the raw data 
+// A vertex contains indices into the raw data. The uv and color set indices are kept
+// in SubMesh::stream_indices_
 struct Vertex 
 {
-  Vertex() : position_index(-1), normal_index(-1), uv_index(-1) {}
-  Vertex(const uint32_t pos, const uint32_t normal, const uint32_t uv = -1) : position_index(pos), normal_index(normal), uv_index(uv) {}
+  Vertex() : position_index(-1), normal_index(-1) {}
+  Vertex(const uint32_t pos, const uint32_t normal) : position_index(pos), normal_index(normal) {}
   uint32_t  position_index;
   uint32_t  normal_index;
-  uint32_t  uv_index;
 };
 
-
-struct Triangle 
-{
-  uint32_t i[3];
-};
-
-typedef std::vector<Vertex> Vertices;
-typedef std::vector<Triangle> Triangles;
+typedef ArenaVector<Vertex>::Type Vertices;
 
 struct SubMesh 
 {
@@ -76,11 +49,12 @@ struct SubMesh
   MObject shader_;
 
   Vertices  vertices_;
+  IndexBuffer stream_indices_;  // MeshStreams::stream_index_count() per vertex
   Triangles triangles_;
 };
 
-typedef boost::shared_ptr<SubMesh> SubMeshPtr;
-typedef std::vector<SubMeshPtr> SubMeshes;
+typedef ArenaVector<SubMesh>::Type SubMeshes;
+
 typedef std::vector<MObject> Materials;
 
 typedef boost::shared_ptr<MItMeshPolygon> MItMeshPolygonPtr;
@@ -95,35 +69,61 @@ public:
   typedef std::string MaterialName;
   typedef std::set<MaterialName> ExportedMaterials;
   typedef std::map<MaterialName, Meshes> MeshesByMaterialName;
+  typedef std::set<MeshName> MeshNames;
 
-  MeshExporter(MeshesByMaterialName& meshes_by_material_name, ExportedMaterials& exported_materials, Materials& materials_, 
-    ChunkIo& writer, const AnimationExporter& animation_exporter);
-  MStatus export_mesh(const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path);
+  MeshExporter(MeshesByMaterialName& meshes_by_material_name, MeshNames& mesh_names, ExportedMaterials& exported_materials,
+    Materials& materials_, RdxWriter& writer, StringTable& strings, const SceneSnapshot& snapshot,
+    const AnimationExporter& animation_exporter, const ExporterSettings& settings);
+  MStatus export_mesh(const uint32_t mesh_node);
+  const std::vector<MeshBounds>& mesh_bounds() const { return mesh_bounds_; }
+  const std::vector<BatchSource>& batch_sources() const { return batch_sources_; }
+  const MorphTargets& morph_targets() const { return morph_targets_; }
+  const Skins& skins() const { return skins_; }
 
 private:
-  MStatus collect_raw_data(MeshRawData& raw_data, const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path, const std::string& parent_path_name);
-  std::string create_unique_mesh_name(const std::string& candidate);
-  MStatus write_element_desc(const bool has_uvs);
-  MStatus write_vertex_data( SuperVerts& super_verts,
+  MStatus collect_raw_data(MeshRawData& raw_data, const MFnMesh& maya_mesh, const uint32_t mesh_node, 
+    const std::string& parent_path_name, const bool opposite);
+  const std::string& find_material_name(const MObject& shader);
+  MStatus write_element_desc(const VertexFormat& format);
+  MStatus weld_sub_mesh(VertexBuffer& super_verts,
+    IndexBuffer& indices,
+    IndexBuffer& vertex_points,
     const MeshRawData& raw_data, 
-    const Vertices& vertices,
-    const Triangles& triangles, 
+    const IndexBuffer& point_weights,
+    const SubMesh& sub_mesh,
     const bool opposite);
-
-  MStatus write_geometry_info(const SuperVerts& super_verts);
-  MStatus get_skinning_data(SkinningData& skinning_data, const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path);
-  MStatus get_uvs(std::vector<UVs>& uvs, const MFnMesh& maya_mesh);
+  MStatus write_vertex_data(VertexBuffer& super_verts, IndexBuffer& indices, IndexBuffer& vertex_points);
+
+  MStatus write_geometry_info(const VertexBuffer& super_verts);
+  MStatus get_skinning_data(SkinningData& skinning_data, MObject& bind_shape, MMatrix& bind_matrix,
+    const MFnMesh& maya_mesh, const uint32_t mesh_node);
+  MStatus get_morph_targets(ArenaVector<RawMorphTarget>::Type& morph_targets, const MFnMesh& maya_mesh,
+    const uint32_t mesh_node, const MMatrix& matrix);
+  MStatus get_uvs(ArenaVector<SoaStream>::Type& uv_sets, const MFnMesh& maya_mesh);
+  MStatus get_colors(ArenaVector<SoaStream>::Type& color_sets, const MFnMesh& maya_mesh);
   MStatus create_sub_meshes(SubMeshes& sub_meshes, const MFnMesh& maya_mesh, const MDagPath& mesh_dag_path);
-  MStatus add_triangles(SubMeshPtr& sub_mesh, MItMeshPolygon& poly_iter, const MFnMesh& maya_mesh);
-  MStatus convert_mesh_local_to_polygon_local(Triangles& polygon_local_triangles, MIntArray triangle_indices, MIntArray poly_indices);
+  MStatus add_triangles(SubMesh& sub_mesh, Triangles& poly_local_triangles, MItMeshPolygon& poly_iter, 
+    const MStringArray& uv_set_names, const MStringArray& color_set_names);
+  MStatus convert_mesh_local_to_polygon_local(Triangles& polygon_local_triangles, const MIntArray& triangle_indices,
+    const MIntArray& poly_indices);
 
-  static std::set<std::string> mesh_names_;
-  ChunkIo& writer_;
+  RdxWriter& writer_;
+  StringTable& strings_;
+  const SceneSnapshot& snapshot_;
+  const ExporterSettings& settings_;
 
   MeshesByMaterialName& meshes_by_material_name_;
+  MeshNames& mesh_names_;
   ExportedMaterials& exported_materials_;
   Materials& materials_;
+  // Material names of the shader nodes, by the hash of their MObject
+  typedef std::multimap<uint32_t, std::pair<MObject, MaterialName> > ShaderNames;
+  ShaderNames shader_names_;
   const AnimationExporter& animation_exporter_;
+  std::vector<MeshBounds> mesh_bounds_;
+  std::vector<BatchSource> batch_sources_;
+  MorphTargets morph_targets_;
+  Skins skins_;
 };
 
 #endif
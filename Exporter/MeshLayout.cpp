@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include "MeshLayout.hpp"
+#include "SpatialIndex.hpp"
+#include "StreamingCells.hpp"
+
+namespace
+{
+  bool layout_batches(MeshLayout& layout, RdxWriter& writer, StringTable& strings, std::set<std::string>& mesh_names,
+                      std::vector<MeshBounds>& mesh_bounds, const std::vector<BatchSource>& sources,
+                      const uint32_t first_mesh_chunk, const ExporterSettings& settings)
+  {
+    std::vector<MeshBatch> plan;
+    if (!plan_mesh_batches(plan, sources, writer, kMaxBatchVertices)) {
+      return false;
+    }
+    if (plan.empty()) {
+      return true;
+    }
+
+    // The batch meshes are appended after the other meshes
+    const uint32_t mesh_count = writer.chunk_count() - first_mesh_chunk;
+    std::vector<bool> batched(mesh_count, false);
+    std::vector<MeshBounds> batch_bounds;
+    for (size_t i = 0; i < plan.size(); ++i) {
+      const uint32_t material = sources[plan[i].sources[0]].material;
+      char suffix[16];
+      sprintf_s(suffix, sizeof(suffix), "_%d", (int)i);
+      const std::string batch_name(make_unique_name(mesh_names, sanitize_name("batch_" + strings.get(material) + suffix)));
+      RdxMeshBatch batch;
+      batch.mesh = strings.intern(batch_name);
+      batch.first_range = (uint32_t)layout.ranges.size();
+      batch.range_count = (uint32_t)plan[i].sources.size();
+      batch.reserved = 0;
+      layout.batches.push_back(batch);
+      layout.batch_materials.push_back(material);
+
+      Bounds bounds;
+      if (!write_batch_mesh(writer, strings, bounds, layout.ranges, plan[i], sources, batch.mesh,
+                            (Bounds::Mode)settings.bounds_mode, settings.compute_bounding_box,
+                            settings.use_vertex_cache, settings.encode_meshes)) {
+        return false;
+      }
+      batch_bounds.push_back(MeshBounds(writer.chunk_count() - 1, bounds.aabb));
+      for (size_t j = 0; j < plan[i].sources.size(); ++j) {
+        batched[sources[plan[i].sources[j]].chunk - first_mesh_chunk] = true;
+      }
+    }
+
+    // keep the unbatched meshes and the batches, and drop the merged meshes
+    const uint32_t total_count = writer.chunk_count() - first_mesh_chunk;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> new_chunk(total_count);
+    for (uint32_t i = 0; i < total_count; ++i) {
+      if (i >= mesh_count || !batched[i]) {
+        new_chunk[i] = first_mesh_chunk + (uint32_t)order.size();
+        order.push_back(i);
+      }
+    }
+    const uint32_t kept_count = (uint32_t)order.size();
+    for (uint32_t i = 0; i < mesh_count; ++i) {
+      if (batched[i]) {
+        order.push_back(i);
+      }
+    }
+    if (!writer.reorder_chunks(first_mesh_chunk, order) || !writer.remove_chunks(first_mesh_chunk + kept_count)) {
+      return false;
+    }
+
+    std::vector<MeshBounds> new_bounds;
+    for (size_t i = 0; i < mesh_bounds.size(); ++i) {
+      const uint32_t idx = mesh_bounds[i].chunk - first_mesh_chunk;
+      if (!batched[idx]) {
+        new_bounds.push_back(MeshBounds(new_chunk[idx], mesh_bounds[i].aabb));
+      }
+    }
+    for (size_t i = 0; i < batch_bounds.size(); ++i) {
+      new_bounds.push_back(MeshBounds(new_chunk[batch_bounds[i].chunk - first_mesh_chunk], batch_bounds[i].aabb));
+    }
+    mesh_bounds.swap(new_bounds);
+    return true;
+  }
+
+  bool layout_spatial_index(MeshLayout& layout, RdxWriter& writer, const std::vector<MeshBounds>& mesh_bounds,
+                            const uint32_t first_mesh_chunk, const ExporterSettings& settings)
+  {
+    // The mesh chunks are the last ones written, and a mesh id is its position among them
+    const uint32_t mesh_count = writer.chunk_count() - first_mesh_chunk;
+    std::vector<Aabb> boxes(mesh_bounds.size());
+    std::vector<uint32_t> mesh_ids(mesh_bounds.size());
+    for (size_t i = 0; i < mesh_bounds.size(); ++i) {
+      boxes[i] = mesh_bounds[i].aabb;
+      mesh_ids[i] = mesh_bounds[i].chunk - first_mesh_chunk;
+    }
+
+    SpatialIndex index;
+    index.build(boxes);
+    index.remap_items(mesh_ids);
+
+    // write the meshes in leaf order, so the meshes of a subtree are contiguous in the file. Not
+    // done when some of the meshes failed to export, as they have no bounds
+    if (settings.spatial_order && mesh_bounds.size() == mesh_count) {
+      const std::vector<uint32_t> order(index.items);
+      if (!writer.reorder_chunks(first_mesh_chunk, order)) {
+        return false;
+      }
+      for (uint32_t i = 0; i < mesh_count; ++i) {
+        mesh_ids[order[i]] = i;
+      }
+      index.remap_items(mesh_ids);
+      layout.reordered = true;
+    }
+
+    layout.index_nodes = (uint32_t)index.nodes.size();
+    layout.sah_cost = index.sah_cost();
+    SCOPED_RDX_CHUNK(writer, RdxChunkId::SpatialIndex);
+    return index.write(writer);
+  }
+
+  bool layout_cells(MeshLayout& layout, RdxWriter& writer, StringTable& strings, const std::vector<MeshBounds>& mesh_bounds,
+                    const uint32_t first_mesh_chunk, const std::string& pack_name, const ExporterSettings& settings)
+  {
+    std::vector<Aabb> boxes(mesh_bounds.size());
+    std::vector<uint32_t> mesh_chunks(mesh_bounds.size());
+    for (size_t i = 0; i < mesh_bounds.size(); ++i) {
+      boxes[i] = mesh_bounds[i].aabb;
+      mesh_chunks[i] = mesh_bounds[i].chunk;
+    }
+
+    CellPartition partition;
+    partition.build(boxes, settings.stream_cell_size);
+    if (!write_cell_pack(layout.pack, layout.manifest, partition, boxes, writer, mesh_chunks,
+                         settings.compress ? kRdxDefaultBlockSize : 0)) {
+      return false;
+    }
+
+    // Only the shared meshes stay in this file. Meshes without bounds failed to export, and are
+    // left here as well.
+    const uint32_t mesh_count = writer.chunk_count() - first_mesh_chunk;
+    std::vector<bool> in_cell(mesh_count, false);
+    for (size_t i = 0; i < partition.cells.size(); ++i) {
+      const std::vector<uint32_t>& meshes = partition.cells[i].meshes;
+      for (size_t j = 0; j < meshes.size(); ++j) {
+        in_cell[mesh_chunks[meshes[j]] - first_mesh_chunk] = true;
+      }
+    }
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> new_chunk(mesh_count);
+    for (uint32_t i = 0; i < mesh_count; ++i) {
+      if (!in_cell[i]) {
+        new_chunk[i] = first_mesh_chunk + (uint32_t)order.size();
+        order.push_back(i);
+      }
+    }
+    const uint32_t kept_count = (uint32_t)order.size();
+    for (uint32_t i = 0; i < mesh_count; ++i) {
+      if (in_cell[i]) {
+        order.push_back(i);
+      }
+    }
+    if (!writer.reorder_chunks(first_mesh_chunk, order) || !writer.remove_chunks(first_mesh_chunk + kept_count)) {
+      return false;
+    }
+
+    std::vector<MeshBounds> shared_bounds;
+    for (size_t i = 0; i < partition.shared.size(); ++i) {
+      const MeshBounds& bounds = mesh_bounds[partition.shared[i]];
+      shared_bounds.push_back(MeshBounds(new_chunk[bounds.chunk - first_mesh_chunk], bounds.aabb));
+    }
+    if (!layout_spatial_index(layout, writer, shared_bounds, first_mesh_chunk, settings)) {
+      return false;
+    }
+    layout.shared_meshes = (uint32_t)partition.shared.size();
+
+    SCOPED_RDX_CHUNK(writer, RdxChunkId::CellManifest);
+    return write_cell_manifest(writer, settings.stream_cell_size, strings.intern(pack_name), layout.manifest);
+  }
+}
+
+bool layout_meshes(MeshLayout& layout, RdxWriter& writer, StringTable& strings, std::set<std::string>& mesh_names,
+                   const std::vector<MeshBounds>& mesh_bounds, const std::vector<BatchSource>& sources,
+                   const uint32_t first_mesh_chunk, const std::string& pack_name, const ExporterSettings& settings)
+{
+  std::vector<MeshBounds> bounds(mesh_bounds);
+  if (settings.batch_meshes &&
+      !layout_batches(layout, writer, strings, mesh_names, bounds, sources, first_mesh_chunk, settings)) {
+    return false;
+  }
+
+  if (settings.stream_cell_size > 0) {
+    if (!layout_cells(layout, writer, strings, bounds, first_mesh_chunk, pack_name, settings)) {
+      return false;
+    }
+  } else if (!layout_spatial_index(layout, writer, bounds, first_mesh_chunk, settings)) {
+    return false;
+  }
+
+  // Written after the spatial index, which expects the mesh chunks to be the last ones
+  if (!layout.batches.empty()) {
+    SCOPED_RDX_CHUNK(writer, RdxChunkId::MeshBatches);
+    return write_mesh_batches(writer, layout.batches, layout.ranges);
+  }
+  return true;
+}
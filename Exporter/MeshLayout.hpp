@@ -0,0 +1,51 @@
+#ifndef MESH_LAYOUT_HPP
+#define MESH_LAYOUT_HPP
+
+/**
+ * The layout of the Mesh chunks, once they are all written: the static meshes are merged into
+ * batches, the meshes of the streaming cells are moved into the cell pack, and the remaining
+ * meshes are put in the leaf order of a spatial index over them. ReduxExporter and GeometryBench
+ * both run it, so the bench hashes what the exporter writes. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+#include "Bounds.hpp"
+#include "MeshBatching.hpp"
+#include "RdxWriter.hpp"
+#include "StringTable.hpp"
+#include "../Stub/exporter_settings.hpp"
+
+// The bounds of a written Mesh chunk, for the spatial index
+struct MeshBounds
+{
+  MeshBounds(const uint32_t chunk, const Aabb& aabb) : chunk(chunk), aabb(aabb) {}
+  uint32_t chunk;
+  Aabb aabb;
+};
+
+struct MeshLayout
+{
+  MeshLayout() : shared_meshes(0), index_nodes(0), sah_cost(0), reordered(false) {}
+  std::vector<RdxMeshBatch> batches;
+  std::vector<RdxMeshBatchRange> ranges;
+  std::vector<uint32_t> batch_materials;    // string index of the material of each batch
+  std::vector<uint8_t> pack;                // the cell files, written next to the .rdx
+  std::vector<RdxCell> manifest;
+  uint32_t shared_meshes;                   // meshes wider than a cell, kept in the main file
+  uint32_t index_nodes;
+  float sah_cost;
+  bool reordered;                           // the meshes are in the leaf order of the index
+};
+
+// Lays out the Mesh chunks from first_mesh_chunk on, which are the last chunks in the writer, and
+// appends the SpatialIndex, CellManifest and MeshBatches chunks. sources are the static meshes,
+// with the material of each already merged, and the batch names are made unique in mesh_names.
+// Batching, cells and the leaf order follow batch_meshes, stream_cell_size and spatial_order.
+bool layout_meshes(MeshLayout& layout, RdxWriter& writer, StringTable& strings, std::set<std::string>& mesh_names,
+  const std::vector<MeshBounds>& mesh_bounds, const std::vector<BatchSource>& sources, const uint32_t first_mesh_chunk,
+  const std::string& pack_name, const ExporterSettings& settings);
+
+#endif
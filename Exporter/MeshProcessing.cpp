@@ -0,0 +1,391 @@
+#include <math.h>
+#include <string.h>
+#include <map>
+#include <algorithm>
+#include "MeshProcessing.hpp"
+#include "vcacheopt.h"
+
+namespace
+{
+  // Orders candidate indices by their weld keys, if any, then by comparing all the attributes
+  // of the vertices. The skin words are compared as integers, as their bits can be nans or
+  // denormals as floats
+  struct VertexLess
+  {
+    VertexLess(const VertexBuffer& vertices, const IndexBuffer* weld_keys)
+      : vertices_(vertices), weld_keys_(weld_keys), float_size_(vertices.format.skin_offset()),
+        size_(vertices.format.vertex_size()) {}
+    bool operator()(const uint32_t lhs, const uint32_t rhs) const
+    {
+      if (weld_keys_ && (*weld_keys_)[lhs] != (*weld_keys_)[rhs]) {
+        return (*weld_keys_)[lhs] < (*weld_keys_)[rhs];
+      }
+      const float* a = vertices_.vertex(lhs);
+      const float* b = vertices_.vertex(rhs);
+      for (uint32_t i = 0; i < float_size_; ++i) {
+        if (a[i] < b[i]) { return true; }
+        if (b[i] < a[i]) { return false; }
+      }
+      const uint32_t* wa = (const uint32_t*)a;
+      const uint32_t* wb = (const uint32_t*)b;
+      for (uint32_t i = float_size_; i < size_; ++i) {
+        if (wa[i] != wb[i]) { return wa[i] < wb[i]; }
+      }
+      return false;
+    }
+    const VertexBuffer& vertices_;
+    const IndexBuffer* weld_keys_;
+    const uint32_t float_size_;
+    const uint32_t size_;
+  };
+
+  // The corners whose tangents are averaged together share position, normal, uv and handedness
+  struct TangentKey
+  {
+    float attributes[8];
+    bool flipped;
+  };
+
+  struct TangentKeyLess
+  {
+    bool operator()(const TangentKey& lhs, const TangentKey& rhs) const
+    {
+      for (int i = 0; i < 8; ++i) {
+        if (lhs.attributes[i] < rhs.attributes[i]) { return true; }
+        if (rhs.attributes[i] < lhs.attributes[i]) { return false; }
+      }
+      return lhs.flipped < rhs.flipped;
+    }
+  };
+
+  struct TangentGroup
+  {
+    TangentGroup() : tangent(0,0,0), bitangent(0,0,0) {}
+    D3DXVECTOR3 tangent;
+    D3DXVECTOR3 bitangent;
+  };
+
+  // Removes the component along the normal, and normalizes the result
+  D3DXVECTOR3 project_to_plane(const D3DXVECTOR3& v, const D3DXVECTOR3& normal)
+  {
+    D3DXVECTOR3 res(v - D3DXVec3Dot(&normal, &v) * normal);
+    const float len = D3DXVec3Length(&res);
+    return len > 1e-20f ? res / len : D3DXVECTOR3(0,0,0);
+  }
+
+  float corner_angle(const D3DXVECTOR3& corner, const D3DXVECTOR3& a, const D3DXVECTOR3& b)
+  {
+    D3DXVECTOR3 e0(a - corner);
+    D3DXVECTOR3 e1(b - corner);
+    const float len = D3DXVec3Length(&e0) * D3DXVec3Length(&e1);
+    if (len <= 1e-20f) {
+      return 0;
+    }
+    return acosf(std::max<float>(-1, std::min<float>(1, D3DXVec3Dot(&e0, &e1) / len)));
+  }
+
+  void add_element(std::vector<RdxElementDesc>& elements, StringTable& strings, const char* semantic,
+                   const uint32_t semantic_index, const DXGI_FORMAT format, const uint32_t float_offset)
+  {
+    RdxElementDesc element;
+    element.semantic = strings.intern(semantic);
+    element.semantic_index = semantic_index;
+    element.format = format;
+    element.input_slot = 0;
+    element.byte_offset = float_offset * sizeof(float);
+    elements.push_back(element);
+  }
+
+  // [byte count, data, padding to 4]
+  bool write_padded(RdxWriter& writer, const std::vector<uint8_t>& data)
+  {
+    const uint8_t padding[3] = { 0, 0, 0 };
+    const uint32_t size = (uint32_t)data.size();
+    return
+      writer.write_generic<uint32_t>(size) &&
+      (data.empty() || writer.write_raw_data(&data[0], size)) &&
+      (size % 4 == 0 || writer.write_raw_data(padding, 4 - size % 4));
+  }
+}
+
+void weld_vertices(VertexBuffer& super_verts, IndexBuffer& vertex_mapping, const VertexBuffer& candidates,
+                   const IndexBuffer* weld_keys)
+{
+  const uint32_t candidate_count = candidates.size();
+  const uint32_t vertex_size = candidates.format.vertex_size();
+  super_verts.format = candidates.format;
+  super_verts.data.clear();
+  super_verts.data.reserve(candidates.data.size());
+  vertex_mapping.resize(candidate_count);
+
+  // keep a mapping of first candidate with a given value -> index in super_verts array
+  typedef ArenaMap<uint32_t, uint32_t, VertexLess>::Type SuperVertexMap;
+  SuperVertexMap super_vertex_map((VertexLess(candidates, weld_keys)));
+
+  for (uint32_t i = 0; i < candidate_count; ++i) {
+    SuperVertexMap::iterator it = super_vertex_map.find(i);
+    if (it == super_vertex_map.end()) {
+      const uint32_t new_idx = super_verts.size();
+      const float* candidate = candidates.vertex(i);
+      super_verts.data.insert(super_verts.data.end(), candidate, candidate + vertex_size);
+      super_vertex_map.insert(std::make_pair(i, new_idx));
+      vertex_mapping[i] = new_idx;
+    } else {
+      vertex_mapping[i] = it->second;
+    }
+  }
+}
+
+void compute_tangents(VertexBuffer& candidates, const Triangles& triangles)
+{
+  const VertexFormat& format = candidates.format;
+  if (!format.tangents) {
+    return;
+  }
+
+  const uint32_t uv_ofs = format.uv_offset(0);
+  const uint32_t tangent_ofs = format.tangent_offset();
+  const uint32_t kNoGroup = ~0u;
+
+  typedef ArenaMap<TangentKey, uint32_t, TangentKeyLess>::Type GroupMap;
+  ArenaVector<TangentGroup>::Type groups;
+  IndexBuffer corner_groups(candidates.size(), kNoGroup);
+  GroupMap group_map;
+
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const uint32_t* tri = triangles[i].i;
+    const D3DXVECTOR3 p[3] = {
+      D3DXVECTOR3(candidates.vertex(tri[0])),
+      D3DXVECTOR3(candidates.vertex(tri[1])),
+      D3DXVECTOR3(candidates.vertex(tri[2])) };
+    const float* uv[3] = {
+      candidates.vertex(tri[0]) + uv_ofs,
+      candidates.vertex(tri[1]) + uv_ofs,
+      candidates.vertex(tri[2]) + uv_ofs };
+
+    const D3DXVECTOR3 e1(p[1] - p[0]);
+    const D3DXVECTOR3 e2(p[2] - p[0]);
+    const float du1 = uv[1][0] - uv[0][0];
+    const float dv1 = uv[1][1] - uv[0][1];
+    const float du2 = uv[2][0] - uv[0][0];
+    const float dv2 = uv[2][1] - uv[0][1];
+    const float det = du1 * dv2 - du2 * dv1;
+
+    // triangles without uv area don't contribute, but still get a tangent frame below
+    D3DXVECTOR3 tangent(0,0,0);
+    D3DXVECTOR3 bitangent(0,0,0);
+    if (fabsf(det) > 1e-20f) {
+      tangent = (e1 * dv2 - e2 * dv1) / det;
+      bitangent = (e2 * du1 - e1 * du2) / det;
+    }
+
+    for (int j = 0; j < 3; ++j) {
+      const float* vtx = candidates.vertex(tri[j]);
+      TangentKey key;
+      memcpy(key.attributes, vtx, 6 * sizeof(float));
+      key.attributes[6] = uv[j][0];
+      key.attributes[7] = uv[j][1];
+      key.flipped = det < 0;
+
+      GroupMap::iterator it = group_map.find(key);
+      const uint32_t group_idx = it != group_map.end() ? it->second : (uint32_t)groups.size();
+      if (it == group_map.end()) {
+        group_map.insert(std::make_pair(key, group_idx));
+        groups.push_back(TangentGroup());
+      }
+      if (corner_groups[tri[j]] == kNoGroup) {
+        corner_groups[tri[j]] = group_idx;
+      }
+
+      const D3DXVECTOR3 normal(vtx + 3);
+      const float angle = corner_angle(p[j], p[(j + 1) % 3], p[(j + 2) % 3]);
+      groups[group_idx].tangent += angle * project_to_plane(tangent, normal);
+      groups[group_idx].bitangent += angle * project_to_plane(bitangent, normal);
+    }
+  }
+
+  for (uint32_t i = 0; i < candidates.size(); ++i) {
+    float* vtx = candidates.vertex(i);
+    const D3DXVECTOR3 normal(vtx + 3);
+    const TangentGroup group = corner_groups[i] != kNoGroup ? groups[corner_groups[i]] : TangentGroup();
+
+    D3DXVECTOR3 tangent(project_to_plane(group.tangent, normal));
+    if (D3DXVec3LengthSq(&tangent) == 0) {
+      // no uv derivatives, so pick any vector in the tangent plane
+      tangent = project_to_plane(fabsf(normal.x) < 0.9f ? D3DXVECTOR3(1,0,0) : D3DXVECTOR3(0,1,0), normal);
+    }
+
+    D3DXVECTOR3 cross;
+    D3DXVec3Cross(&cross, &normal, &tangent);
+    vtx[tangent_ofs + 0] = tangent.x;
+    vtx[tangent_ofs + 1] = tangent.y;
+    vtx[tangent_ofs + 2] = tangent.z;
+    vtx[tangent_ofs + 3] = D3DXVec3Dot(&cross, &group.bitangent) < 0 ? -1.0f : 1.0f;
+  }
+}
+
+void remap_indices(IndexBuffer& indices, const Triangles& triangles,
+                   const IndexBuffer& vertex_mapping, const bool opposite)
+{
+  indices.reserve(triangles.size() * 3);
+  for (uint32_t i = 0; i < triangles.size(); ++i) {
+    uint32_t a, b, c;
+    if (opposite) {
+      a = triangles[i].i[0];
+      b = triangles[i].i[1];
+      c = triangles[i].i[2];
+    } else {
+      a = triangles[i].i[2];
+      b = triangles[i].i[1];
+      c = triangles[i].i[0];
+    }
+
+    indices.push_back(vertex_mapping[a]);
+    indices.push_back(vertex_mapping[b]);
+    indices.push_back(vertex_mapping[c]);
+  }
+}
+
+VertexCacheStats optimize_vertex_cache(IndexBuffer& indices)
+{
+  VertexCacheStats stats;
+  if (indices.empty()) {
+    return stats;
+  }
+
+  int32_t* index_buffer = (int32_t*)&indices[0];
+  const int32_t triangle_count = (int32_t)indices.size() / 3;
+  VertexCacheOptimizer vcache;
+  VertexCache cache;
+  stats.pre_miss_count = cache.GetCacheMissCount(index_buffer, triangle_count);
+  stats.success = vcache.Optimize(index_buffer, triangle_count) == VertexCacheOptimizer::Success;
+  stats.post_miss_count = cache.GetCacheMissCount(index_buffer, triangle_count);
+  return stats;
+}
+
+bool write_element_desc(RdxWriter& writer, StringTable& strings, const VertexFormat& format)
+{
+  std::vector<RdxElementDesc> elements;
+  add_element(elements, strings, "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0);
+  add_element(elements, strings, "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 3);
+  if (format.tangents) {
+    add_element(elements, strings, "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, format.tangent_offset());
+  }
+  for (uint32_t i = 0; i < format.uv_sets; ++i) {
+    add_element(elements, strings, "TEXCOORD", i, DXGI_FORMAT_R32G32_FLOAT, format.uv_offset(i));
+  }
+  for (uint32_t i = 0; i < format.color_sets; ++i) {
+    add_element(elements, strings, "COLOR", i, DXGI_FORMAT_R32G32B32A32_FLOAT, format.color_offset(i));
+  }
+  if (format.skinned) {
+    add_element(elements, strings, "BLENDINDICES", 0, DXGI_FORMAT_R8G8B8A8_UINT, format.skin_offset());
+    add_element(elements, strings, "BLENDWEIGHT", 0, DXGI_FORMAT_R8G8B8A8_UNORM, format.skin_offset() + 1);
+  }
+
+  return
+    writer.write_generic<uint32_t>((uint32_t)elements.size()) &&
+    writer.write_raw_data((const uint8_t*)&elements[0], (uint32_t)(elements.size() * sizeof(RdxElementDesc)));
+}
+
+uint32_t element_desc_size(const VertexFormat& format)
+{
+  const uint32_t element_count = 2 + (format.tangents ? 1 : 0) + format.uv_sets + format.color_sets +
+    (format.skinned ? 2 : 0);
+  return sizeof(uint32_t) + element_count * sizeof(RdxElementDesc);
+}
+
+bool write_vertex_buffers(RdxWriter& writer, const VertexBuffer& super_verts, const IndexBuffer& indices)
+{
+  const int vertex_count = (int32_t)super_verts.size();
+  const int index_count = (int32_t)indices.size();
+
+  const int vertex_size = (int32_t)super_verts.stride();
+  const int index_size = sizeof(uint32_t);
+
+  return
+    writer.write_generic<uint32_t>(RdxMeshEncoding::Raw) &&
+    writer.write_generic<int>(vertex_count) &&
+    writer.write_generic<int>(vertex_size) &&
+    writer.write_raw_data((uint8_t*)&super_verts.data[0], vertex_size * vertex_count) &&
+    writer.write_generic<int>(index_count) &&
+    writer.write_generic<int>(index_size) &&
+    writer.write_raw_data((uint8_t*)&indices[0], index_size * index_count);
+}
+
+void reorder_vertices(VertexBuffer& super_verts, IndexBuffer& indices, IndexBuffer* new_index_out)
+{
+  const uint32_t vertex_count = super_verts.size();
+  const uint32_t vertex_size = super_verts.format.vertex_size();
+  IndexBuffer new_index(vertex_count, kRdxInvalidIndex);
+  uint32_t next = 0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    uint32_t& idx = new_index[indices[i]];
+    if (idx == kRdxInvalidIndex) {
+      idx = next++;
+    }
+    indices[i] = idx;
+  }
+
+  VertexBuffer reordered;
+  reordered.format = super_verts.format;
+  reordered.resize(vertex_count);
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    if (new_index[i] == kRdxInvalidIndex) {
+      new_index[i] = next++;
+    }
+    memcpy(reordered.vertex(new_index[i]), super_verts.vertex(i), vertex_size * sizeof(float));
+  }
+  super_verts.data.swap(reordered.data);
+  if (new_index_out) {
+    new_index_out->assign(new_index.begin(), new_index.end());
+  }
+}
+
+std::vector<RdxVertexStream> vertex_streams(const VertexFormat& format)
+{
+  std::vector<RdxVertexStream> streams;
+  const RdxVertexStream position = { RdxVertexStream::kQuantizedPosition, 0, 3 };
+  const RdxVertexStream normal = { RdxVertexStream::kOctahedralNormal, 3, 3 };
+  streams.push_back(position);
+  streams.push_back(normal);
+  if (format.tangents) {
+    const RdxVertexStream tangent = { RdxVertexStream::kOctahedralTangent, format.tangent_offset(), 4 };
+    streams.push_back(tangent);
+  }
+
+  // the uvs and colors are kept at full precision, and the skin words as they are
+  const uint32_t uv_offset = format.uv_offset(0);
+  if (format.vertex_size() > uv_offset) {
+    const RdxVertexStream rest = { RdxVertexStream::kFloat, uv_offset, format.vertex_size() - uv_offset };
+    streams.push_back(rest);
+  }
+  return streams;
+}
+
+uint32_t EncodedBuffers::serialized_size() const
+{
+  return (uint32_t)(7 * sizeof(uint32_t) + ((vertices.size() + 3) & ~3) + ((indices.size() + 3) & ~3));
+}
+
+bool encode_vertex_buffers(EncodedBuffers& encoded, const VertexBuffer& super_verts, const IndexBuffer& indices)
+{
+  encoded.vertex_count = super_verts.size();
+  encoded.vertex_size = super_verts.stride();
+  encoded.index_count = (uint32_t)indices.size();
+  return
+    encode_vertices(encoded.vertices, super_verts.data.empty() ? NULL : &super_verts.data[0], encoded.vertex_count,
+      super_verts.format.vertex_size(), vertex_streams(super_verts.format)) &&
+    encode_indices(encoded.indices, indices.empty() ? NULL : &indices[0], encoded.index_count);
+}
+
+bool write_encoded_vertex_buffers(RdxWriter& writer, const EncodedBuffers& encoded)
+{
+  return
+    writer.write_generic<uint32_t>(RdxMeshEncoding::Encoded) &&
+    writer.write_generic<uint32_t>(encoded.vertex_count) &&
+    writer.write_generic<uint32_t>(encoded.vertex_size) &&
+    write_padded(writer, encoded.vertices) &&
+    writer.write_generic<uint32_t>(encoded.index_count) &&
+    writer.write_generic<uint32_t>(sizeof(uint32_t)) &&
+    write_padded(writer, encoded.indices);
+}
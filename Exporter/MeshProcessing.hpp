@@ -0,0 +1,119 @@
+#ifndef MESH_PROCESSING_HPP
+#define MESH_PROCESSING_HPP
+
+/**
+ * The Maya independent stages of the mesh pipeline (tangent generation, welding, vertex cache
+ * optimization, buffer serialization and encoding). These are shared between the exporter and
+ * the geometry benchmark, so they mustn't depend on stdafx.h or the Maya headers. The buffers
+ * and the stages' temporaries are allocated from the current Arena, if there is one.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include <D3DX10.h>
+#include "RdxWriter.hpp"
+#include "Arena.hpp"
+#include "StringTable.hpp"
+#include "../Reader/RdxMeshCodec.hpp"
+
+// The attributes of the exported vertices. Each vertex is stored as floats, in the order
+// position, normal, tangent (x, y, z, handedness), uv sets, color sets (rgba), followed by two
+// skin words for skinned meshes. The skin words aren't floats but raw 32 bit values, see
+// Skinning.hpp, so they are only ever copied.
+struct VertexFormat
+{
+  VertexFormat() : uv_sets(1), color_sets(0), tangents(false), skinned(false) {}
+
+  uint32_t tangent_offset() const { return 6; }
+  uint32_t uv_offset(const uint32_t set) const { return 6 + (tangents ? 4 : 0) + 2 * set; }
+  uint32_t color_offset(const uint32_t set) const { return uv_offset(uv_sets) + 4 * set; }
+  uint32_t skin_offset() const { return color_offset(color_sets); }
+  uint32_t vertex_size() const { return skin_offset() + (skinned ? 2 : 0); }
+
+  uint32_t uv_sets;
+  uint32_t color_sets;
+  bool tangents;
+  bool skinned;
+};
+
+struct VertexBuffer
+{
+  uint32_t size() const { return format.vertex_size() ? (uint32_t)data.size() / format.vertex_size() : 0; }
+  void resize(const uint32_t count) { data.resize(count * format.vertex_size()); }
+  float* vertex(const uint32_t idx) { return &data[idx * format.vertex_size()]; }
+  const float* vertex(const uint32_t idx) const { return &data[idx * format.vertex_size()]; }
+  uint32_t stride() const { return format.vertex_size() * sizeof(float); }
+
+  VertexFormat format;
+  ArenaVector<float>::Type data;
+};
+
+struct Triangle
+{
+  uint32_t i[3];
+};
+
+typedef ArenaVector<Triangle>::Type Triangles;
+typedef ArenaVector<uint32_t>::Type IndexBuffer;
+
+struct VertexCacheStats
+{
+  VertexCacheStats() : pre_miss_count(0), post_miss_count(0), success(false) {}
+  int   pre_miss_count;
+  int   post_miss_count;
+  bool  success;
+};
+
+// Merges identical vertices, comparing all the attributes, and the skin words as integers. On return vertex_mapping[i] is the index in
+// super_verts of candidates[i]. Candidates with different weld keys, if given, are never merged
+void weld_vertices(VertexBuffer& super_verts, IndexBuffer& vertex_mapping, const VertexBuffer& candidates,
+                   const IndexBuffer* weld_keys = NULL);
+
+// Computes the tangent frames of the (unwelded) candidate vertices from the first uv set. Per corner tangents
+// are projected onto the tangent plane, angle weighted, and averaged only over corners that share position,
+// normal, uv and handedness. This isn't the reference MikkTSpace code, so the frames can differ slightly
+// from the ones a MikkTSpace baker uses
+void compute_tangents(VertexBuffer& candidates, const Triangles& triangles);
+
+// Creates the index buffer for the welded vertices. The winding is flipped unless opposite is set
+void remap_indices(IndexBuffer& indices, const Triangles& triangles,
+  const IndexBuffer& vertex_mapping, const bool opposite);
+
+// Reorders the triangles in place, and returns the cache miss counts before and after
+VertexCacheStats optimize_vertex_cache(IndexBuffer& indices);
+
+// Writes the D3D10 input element desc of the format as [count, RdxElementDesc[count]], with the
+// semantic names interned in the string table
+bool write_element_desc(RdxWriter& writer, StringTable& strings, const VertexFormat& format);
+uint32_t element_desc_size(const VertexFormat& format);
+
+// Renumbers the vertices in the order the indices first use them, which is the order the index
+// codec expects new vertices in, and keeps neighbouring vertices close for the vertex deltas.
+// Unused vertices are moved to the end. If new_index is given it receives the new index of
+// each old vertex
+void reorder_vertices(VertexBuffer& super_verts, IndexBuffer& indices, IndexBuffer* new_index = NULL);
+
+// How the encoded vertices store each attribute of the format
+std::vector<RdxVertexStream> vertex_streams(const VertexFormat& format);
+
+// The vertex and index buffers in the encoding of Reader/RdxMeshCodec.hpp
+struct EncodedBuffers
+{
+  EncodedBuffers() : vertex_count(0), vertex_size(0), index_count(0) {}
+  uint32_t serialized_size() const;
+
+  uint32_t vertex_count;
+  uint32_t vertex_size;
+  uint32_t index_count;
+  std::vector<uint8_t> vertices;
+  std::vector<uint8_t> indices;
+};
+
+bool encode_vertex_buffers(EncodedBuffers& encoded, const VertexBuffer& super_verts, const IndexBuffer& indices);
+
+// Writes the encoding, then the vertex buffer followed by the index buffer as [count, element size, data]
+bool write_vertex_buffers(RdxWriter& writer, const VertexBuffer& super_verts, const IndexBuffer& indices);
+// As above, but with each buffer's data as [byte count, encoded data, padding to 4]
+bool write_encoded_vertex_buffers(RdxWriter& writer, const EncodedBuffers& encoded);
+
+#endif
@@ -31,6 +31,7 @@
 #include <cmath>
 #include <iostream>
 #include <list>
+#include "Arena.hpp"
 
 namespace miniball
 {
@@ -64,12 +65,13 @@ namespace miniball
   class Miniball {
   public:
     // types
-    typedef typename std::list<Point<d> >::iterator         It;
-    typedef typename std::list<Point<d> >::const_iterator   Cit;
+    typedef std::list<Point<d>, ArenaAllocator<Point<d> > > PointList;
+    typedef typename PointList::iterator         It;
+    typedef typename PointList::const_iterator   Cit;
 
   private:
     // data members
-    std::list<Point<d> > L;            // internal point set
+    PointList            L;            // internal point set
     Miniball_b<d>        B;            // the current ball
     It                   support_end;  // past-the-end iterator of support set
 
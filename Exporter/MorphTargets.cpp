@@ -0,0 +1,90 @@
+#include <math.h>
+#include <algorithm>
+#include "MorphTargets.hpp"
+
+namespace
+{
+  const uint32_t kMorphTargetsVersion = 1;
+
+  int16_t quantize(const float value, const float scale)
+  {
+    if (fabsf(value) < kMinMorphDelta) {
+      return 0;
+    }
+    const float q = floorf(value / scale * 32767 + 0.5f);
+    return (int16_t)std::min(std::max(q, -32767.0f), 32767.0f);
+  }
+}
+
+void add_morph_mesh(MorphTargets& morphs, const uint32_t mesh, const uint32_t vertex_count)
+{
+  RdxMorphMesh morph_mesh;
+  morph_mesh.mesh = mesh;
+  morph_mesh.vertex_count = vertex_count;
+  morph_mesh.first_target = (uint32_t)morphs.targets.size();
+  morph_mesh.target_count = 0;
+  morphs.meshes.push_back(morph_mesh);
+}
+
+void add_morph_target(MorphTargets& morphs, const uint32_t name, const SoaStream& point_deltas,
+                      const IndexBuffer& vertex_points)
+{
+  RdxMorphMesh& mesh = morphs.meshes.back();
+  mesh.target_count++;
+  morphs.dense_deltas += mesh.vertex_count;
+
+  RdxMorphTarget target;
+  target.name = name;
+  target.first_delta = (uint32_t)morphs.deltas.size();
+  target.delta_count = 0;
+  target.scale = 0;
+
+  const float* components[] = { point_deltas.component(0), point_deltas.component(1), point_deltas.component(2) };
+  for (size_t i = 0; i < vertex_points.size(); ++i) {
+    if (vertex_points[i] >= point_deltas.size()) {
+      continue;
+    }
+    for (uint32_t j = 0; j < 3; ++j) {
+      target.scale = std::max(target.scale, fabsf(components[j][vertex_points[i]]));
+    }
+  }
+
+  if (target.scale >= kMinMorphDelta) {
+    for (size_t i = 0; i < vertex_points.size(); ++i) {
+      if (vertex_points[i] >= point_deltas.size()) {
+        continue;
+      }
+      RdxMorphDelta delta;
+      for (uint32_t j = 0; j < 3; ++j) {
+        delta.position[j] = quantize(components[j][vertex_points[i]], target.scale);
+      }
+      delta.position[3] = 0;
+      if (delta.position[0] != 0 || delta.position[1] != 0 || delta.position[2] != 0) {
+        morphs.vertex_indices.push_back((uint32_t)i);
+        morphs.deltas.push_back(delta);
+      }
+    }
+  }
+  target.delta_count = (uint32_t)morphs.deltas.size() - target.first_delta;
+  morphs.targets.push_back(target);
+}
+
+bool write_morph_targets(RdxWriter& writer, const MorphTargets& morphs)
+{
+  return
+    writer.write_generic<uint32_t>(kMorphTargetsVersion) &&
+    writer.write_generic<uint32_t>((uint32_t)morphs.meshes.size()) &&
+    (morphs.meshes.empty() || writer.write_raw_data((const uint8_t*)&morphs.meshes[0], (uint32_t)(morphs.meshes.size() * sizeof(RdxMorphMesh)))) &&
+    writer.write_generic<uint32_t>((uint32_t)morphs.targets.size()) &&
+    (morphs.targets.empty() || writer.write_raw_data((const uint8_t*)&morphs.targets[0], (uint32_t)(morphs.targets.size() * sizeof(RdxMorphTarget)))) &&
+    writer.write_generic<uint32_t>((uint32_t)morphs.deltas.size()) &&
+    (morphs.deltas.empty() || (
+      writer.write_raw_data((const uint8_t*)&morphs.vertex_indices[0], (uint32_t)(morphs.vertex_indices.size() * sizeof(uint32_t))) &&
+      writer.write_raw_data((const uint8_t*)&morphs.deltas[0], (uint32_t)(morphs.deltas.size() * sizeof(RdxMorphDelta)))));
+}
+
+uint32_t morph_targets_size(const MorphTargets& morphs)
+{
+  return (uint32_t)(4 * sizeof(uint32_t) + morphs.meshes.size() * sizeof(RdxMorphMesh) +
+    morphs.targets.size() * sizeof(RdxMorphTarget) + morphs.deltas.size() * (sizeof(uint32_t) + sizeof(RdxMorphDelta)));
+}
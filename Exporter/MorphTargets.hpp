@@ -0,0 +1,55 @@
+#ifndef MORPH_TARGETS_HPP
+#define MORPH_TARGETS_HPP
+
+/**
+ * Sparse encoding of blend shape targets for the MorphTargets chunk, see RdxMorphMesh in
+ * Reader/RdxFormat.hpp. The targets come from Maya as deltas of the mesh's points, and are
+ * mapped onto the exported vertices through the point each vertex was made from, so vertices
+ * split by welding get the delta of their point. Deltas are quantized to 16 bit snorms scaled
+ * by the target's largest component, and the ones that quantize to zero are dropped. Doesn't
+ * depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "MeshProcessing.hpp"
+#include "RdxWriter.hpp"
+#include "VertexConversion.hpp"
+
+// Smaller delta components are noise from the target's modelling, and are dropped
+const float kMinMorphDelta = 1e-5f;
+
+struct MorphTargets
+{
+  MorphTargets() : dense_deltas(0) {}
+  std::vector<RdxMorphMesh> meshes;
+  std::vector<RdxMorphTarget> targets;
+  std::vector<uint32_t> vertex_indices;
+  std::vector<RdxMorphDelta> deltas;
+  uint64_t dense_deltas;      // vertices times targets, for the sparsity stats
+};
+
+// Sets the weld key of each candidate vertex to its point. Coincident points can move apart in
+// the targets, so the vertices of a mesh with targets only weld with those of the same point.
+// Corners is a vector of anything with a position_index member, as for gather_candidates
+template <class Corners>
+void gather_morph_weld_keys(IndexBuffer& weld_keys, const Corners& corners)
+{
+  weld_keys.resize(corners.size());
+  for (size_t i = 0; i < corners.size(); ++i) {
+    weld_keys[i] = corners[i].position_index;
+  }
+}
+
+// Starts the targets of a mesh, the name is its string index
+void add_morph_mesh(MorphTargets& morphs, const uint32_t mesh, const uint32_t vertex_count);
+
+// Adds a target to the last mesh. point_deltas holds a delta per Maya point, in the converted
+// coordinate system, and vertex_points the point of each of the mesh's vertices
+void add_morph_target(MorphTargets& morphs, const uint32_t name, const SoaStream& point_deltas,
+  const IndexBuffer& vertex_points);
+
+bool write_morph_targets(RdxWriter& writer, const MorphTargets& morphs);
+uint32_t morph_targets_size(const MorphTargets& morphs);
+
+#endif
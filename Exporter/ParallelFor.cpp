@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <vector>
+#include "ParallelFor.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace
+{
+  struct WorkQueue
+  {
+    uint32_t count;
+    ParallelForFn fn;
+    void* context;
+#ifdef _WIN32
+    volatile LONG next;
+#else
+    volatile long next;
+#endif
+  };
+
+  void run_queue(WorkQueue& queue)
+  {
+    for (;;) {
+#ifdef _WIN32
+      const long idx = InterlockedIncrement(&queue.next) - 1;
+#else
+      const long idx = __sync_add_and_fetch(&queue.next, 1) - 1;
+#endif
+      if (idx >= (long)queue.count) {
+        return;
+      }
+      queue.fn(queue.context, (uint32_t)idx);
+    }
+  }
+
+#ifdef _WIN32
+  DWORD WINAPI queue_thread(void* param)
+  {
+    run_queue(*(WorkQueue*)param);
+    return 0;
+  }
+#else
+  void* queue_thread(void* param)
+  {
+    run_queue(*(WorkQueue*)param);
+    return NULL;
+  }
+#endif
+}
+
+void parallel_for(const uint32_t count, ParallelForFn fn, void* context, const uint32_t thread_count)
+{
+  WorkQueue queue;
+  queue.count = count;
+  queue.fn = fn;
+  queue.context = context;
+  queue.next = 0;
+
+  const uint32_t extra_threads = std::max<uint32_t>(std::min<uint32_t>(thread_count, count), 1) - 1;
+#ifdef _WIN32
+  std::vector<HANDLE> threads;
+  for (uint32_t i = 0; i < extra_threads; ++i) {
+    HANDLE thread = CreateThread(NULL, 0, queue_thread, &queue, 0, NULL);
+    if (thread != NULL) {
+      threads.push_back(thread);
+    }
+  }
+  run_queue(queue);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+  }
+#else
+  std::vector<pthread_t> threads;
+  for (uint32_t i = 0; i < extra_threads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, queue_thread, &queue) == 0) {
+      threads.push_back(thread);
+    }
+  }
+  run_queue(queue);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    pthread_join(threads[i], NULL);
+  }
+#endif
+}
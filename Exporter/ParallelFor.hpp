@@ -0,0 +1,16 @@
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+/**
+ * Runs fn(context, i) for i in [0, count) on up to thread_count threads, the calling thread
+ * being one of them. Items are handed out one at a time, so slow items don't hold up a
+ * thread's share of the others. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+
+typedef void (*ParallelForFn)(void* context, const uint32_t idx);
+
+void parallel_for(const uint32_t count, ParallelForFn fn, void* context, const uint32_t thread_count);
+
+#endif
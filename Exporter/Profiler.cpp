@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "Profiler.hpp"
+
+namespace
+{
+  Profiler* g_current_profiler = NULL;
+  volatile LONG g_allocation_count = 0;
+
+  int64_t get_ticks()
+  {
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+  }
+
+  std::string escape_json(const std::string& str)
+  {
+    std::string res;
+    res.reserve(str.length());
+    for (size_t i = 0; i < str.length(); ++i) {
+      const char ch = str[i];
+      if (ch == '"' || ch == '\\') {
+        res += '\\';
+      }
+      res += ch;
+    }
+    return res;
+  }
+}
+
+// Count every allocation made by the exporter. This only sees the dll's own heap traffic,
+// allocations done inside Maya aren't included.
+void* operator new(size_t size)
+{
+  InterlockedIncrement(&g_allocation_count);
+  void* ptr = malloc(size ? size : 1);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* ptr)
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr)
+{
+  free(ptr);
+}
+
+Profiler::Profiler()
+  : frequency_(0)
+  , start_(get_ticks())
+  , start_allocations_(allocation_count())
+  , own_allocations_(0)
+{
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  frequency_ = frequency.QuadPart;
+}
+
+Profiler* Profiler::current()
+{
+  return g_current_profiler;
+}
+
+void Profiler::set_current(Profiler* profiler)
+{
+  g_current_profiler = profiler;
+}
+
+int32_t Profiler::allocation_count()
+{
+  return g_allocation_count;
+}
+
+double Profiler::to_ms(const int64_t ticks) const
+{
+  return 1000.0 * ticks / (double)frequency_;
+}
+
+void Profiler::begin_scope(const char* stage, const std::string& item)
+{
+  // the scope's count starts after the event is stored, which allocates
+  const int32_t allocations = allocation_count();
+  Event event;
+  event.stage = stage;
+  event.item = item;
+  open_events_.push_back((uint32_t)events_.size());
+  events_.push_back(event);
+  own_allocations_ += allocation_count() - allocations;
+
+  Event& stored = events_.back();
+  stored.allocations = exporter_allocations();
+  stored.start = get_ticks();
+  stored.end = stored.start;
+}
+
+void Profiler::end_scope()
+{
+  if (open_events_.empty()) {
+    return;
+  }
+  Event& event = events_[open_events_.back()];
+  open_events_.pop_back();
+  event.end = get_ticks();
+  const int32_t allocations = allocation_count();
+  event.allocations = allocations - own_allocations_ - event.allocations;
+
+  StageStats& stats = stages_[event.stage];
+  const int64_t duration = event.end - event.start;
+  stats.calls++;
+  stats.total += duration;
+  stats.max = std::max<int64_t>(stats.max, duration);
+  stats.allocations += event.allocations;
+  own_allocations_ += allocation_count() - allocations;
+}
+
+void Profiler::add_counter(const char* name, const int64_t value)
+{
+  const int32_t allocations = allocation_count();
+  counters_[name] += value;
+  own_allocations_ += allocation_count() - allocations;
+}
+
+void Profiler::add_chunk_bytes(const char* chunk, const uint32_t bytes)
+{
+  const int32_t allocations = allocation_count();
+  chunk_bytes_[chunk] += bytes;
+  own_allocations_ += allocation_count() - allocations;
+}
+
+bool Profiler::write_report(const char* filename) const
+{
+  FILE* file = NULL;
+  if (fopen_s(&file, filename, "wt") != 0) {
+    return false;
+  }
+  SCOPED_DELETER(&fclose, file);
+
+  fprintf(file, "{\n");
+  fprintf(file, "\t\"total_ms\" : %.3f,\n", to_ms(get_ticks() - start_));
+  fprintf(file, "\t\"allocations\" : %d,\n", exporter_allocations() - start_allocations_);
+  fprintf(file, "\t\"profiler_allocations\" : %d,\n", own_allocations_);
+
+  fprintf(file, "\t\"stages\" : [\n");
+  uint32_t counter = (uint32_t)stages_.size();
+  for (StageStatsMap::const_iterator it = stages_.begin(); it != stages_.end(); ++it) {
+    const StageStats& stats = it->second;
+    fprintf(file, "\t\t{ \"name\" : \"%s\", \"calls\" : %u, \"total_ms\" : %.3f, \"max_ms\" : %.3f, \"allocations\" : %d }%s\n",
+      escape_json(it->first).c_str(), stats.calls, to_ms(stats.total), to_ms(stats.max), stats.allocations,
+      (--counter != 0 ? "," : ""));
+  }
+  fprintf(file, "\t],\n");
+
+  // Per item timings, so a single slow mesh or track stands out
+  uint32_t item_count = 0;
+  for (size_t i = 0; i < events_.size(); ++i) {
+    item_count += events_[i].item.empty() ? 0 : 1;
+  }
+  fprintf(file, "\t\"items\" : [\n");
+  for (size_t i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    if (event.item.empty()) {
+      continue;
+    }
+    fprintf(file, "\t\t{ \"stage\" : \"%s\", \"item\" : \"%s\", \"ms\" : %.3f, \"allocations\" : %d }%s\n",
+      escape_json(event.stage).c_str(), escape_json(event.item).c_str(), to_ms(event.end - event.start), event.allocations,
+      (--item_count != 0 ? "," : ""));
+  }
+  fprintf(file, "\t],\n");
+
+  fprintf(file, "\t\"counters\" : {\n");
+  counter = (uint32_t)counters_.size();
+  for (Counters::const_iterator it = counters_.begin(); it != counters_.end(); ++it) {
+    fprintf(file, "\t\t\"%s\" : %I64d%s\n", escape_json(it->first).c_str(), it->second, (--counter != 0 ? "," : ""));
+  }
+  fprintf(file, "\t},\n");
+
+  fprintf(file, "\t\"chunk_bytes\" : {\n");
+  counter = (uint32_t)chunk_bytes_.size();
+  for (Counters::const_iterator it = chunk_bytes_.begin(); it != chunk_bytes_.end(); ++it) {
+    fprintf(file, "\t\t\"%s\" : %I64d%s\n", escape_json(it->first).c_str(), it->second, (--counter != 0 ? "," : ""));
+  }
+  fprintf(file, "\t}\n");
+  fprintf(file, "}\n");
+
+  return true;
+}
+
+bool Profiler::write_trace(const char* filename) const
+{
+  FILE* file = NULL;
+  if (fopen_s(&file, filename, "wt") != 0) {
+    return false;
+  }
+  SCOPED_DELETER(&fclose, file);
+
+  // Complete ("X") events, with timestamps in microseconds relative to the start of the export
+  fprintf(file, "{ \"traceEvents\" : [\n");
+  for (size_t i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    fprintf(file, "\t{ \"name\" : \"%s\", \"cat\" : \"export\", \"ph\" : \"X\", \"pid\" : 1, \"tid\" : 1, "
+      "\"ts\" : %.1f, \"dur\" : %.1f, \"args\" : { \"item\" : \"%s\", \"allocations\" : %d } }%s\n",
+      escape_json(event.stage).c_str(), 1000 * to_ms(event.start - start_), 1000 * to_ms(event.end - event.start),
+      escape_json(event.item).c_str(), event.allocations, (i != events_.size() - 1 ? "," : ""));
+  }
+  fprintf(file, "] }\n");
+
+  return true;
+}
+
+ScopedProfile::ScopedProfile(const char* stage, const std::string& item)
+  : profiler_(Profiler::current())
+{
+  if (profiler_) {
+    profiler_->begin_scope(stage, item);
+  }
+}
+
+ScopedProfile::~ScopedProfile()
+{
+  if (profiler_) {
+    profiler_->end_scope();
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "ScopedDeleter.hpp"
+
+/**
+ * Scoped timers and counters for the export stages. A Profiler is made current for the
+ * duration of an export, and the PROFILE_ macros are no-ops when no profiler is current.
+ * Stage times are aggregated by stage name, and every scope is also kept as an event so
+ * it can be dumped as a Chrome trace (chrome://tracing).
+ */
+class Profiler
+{
+public:
+  Profiler();
+
+  void begin_scope(const char* stage, const std::string& item);
+  void end_scope();
+  void add_counter(const char* name, const int64_t value);
+  void add_chunk_bytes(const char* chunk, const uint32_t bytes);
+
+  bool write_report(const char* filename) const;
+  bool write_trace(const char* filename) const;
+
+  static Profiler* current();
+  static void set_current(Profiler* profiler);
+
+  // Number of operator new calls made by the exporter dll so far
+  static int32_t allocation_count();
+
+private:
+
+  struct Event
+  {
+    std::string stage;
+    std::string item;
+    int64_t start;
+    int64_t end;
+    int32_t allocations;
+  };
+
+  struct StageStats
+  {
+    StageStats() : calls(0), total(0), max(0), allocations(0) {}
+    uint32_t  calls;
+    int64_t   total;
+    int64_t   max;
+    int32_t   allocations;
+  };
+
+  typedef std::map<std::string, StageStats> StageStatsMap;
+  typedef std::map<std::string, int64_t> Counters;
+
+  double to_ms(const int64_t ticks) const;
+  // The allocations so far, but the profiler's own
+  int32_t exporter_allocations() const { return allocation_count() - own_allocations_; }
+
+  std::vector<Event> events_;
+  std::vector<uint32_t> open_events_;
+  StageStatsMap stages_;
+  Counters counters_;
+  Counters chunk_bytes_;
+
+  int64_t frequency_;
+  int64_t start_;
+  int32_t start_allocations_;
+  // Made by the profiler's bookkeeping, which the scopes and the report leave out
+  int32_t own_allocations_;
+};
+
+struct ScopedProfile
+{
+  ScopedProfile(const char* stage, const std::string& item = std::string());
+  ~ScopedProfile();
+  Profiler* profiler_;
+};
+
+#define PROFILE_SCOPE(stage) ScopedProfile GEN_NAME(profile_scope, __LINE__)(stage)
+#define PROFILE_SCOPE_ITEM(stage, item) ScopedProfile GEN_NAME(profile_scope, __LINE__)(stage, item)
+#define PROFILE_COUNTER(name, value) { if (Profiler* p = Profiler::current()) { p->add_counter(name, value); } }
+#define PROFILE_CHUNK_BYTES(chunk, bytes) { if (Profiler* p = Profiler::current()) { p->add_chunk_bytes(chunk, bytes); } }
+
+
+#endif
@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+#include "RdxWriter.hpp"
+
+namespace
+{
+  // In the patch layout a chunk starts a new group when its crc32 picks it, with a chance of
+  // this many times its share of a block. The groups then fill about half a block, and their
+  // boundaries after an edit are the same as before it
+  const uint32_t kPatchGroupsPerBlock = 2;
+
+  uint32_t align(const uint32_t value)
+  {
+    return (value + kRdxAlignment - 1) & ~(kRdxAlignment - 1);
+  }
+}
+
+RdxWriter::RdxWriter()
+  : block_size_(kRdxDefaultBlockSize)
+  , patch_layout_(false)
+  , in_chunk_(false)
+{
+}
+
+void RdxWriter::init_writer(const uint32_t block_size, const bool patch_layout)
+{
+  block_size_ = block_size;
+  patch_layout_ = patch_layout;
+  in_chunk_ = false;
+  chunks_.clear();
+  data_.clear();
+  file_.clear();
+}
+
+void RdxWriter::begin_chunk(const RdxChunkId::Enum id)
+{
+  assert(!in_chunk_);
+  in_chunk_ = true;
+  data_.resize(align((uint32_t)data_.size()), 0);
+
+  RdxChunkEntry chunk;
+  chunk.id = id;
+  chunk.offset = (uint32_t)data_.size();
+  chunk.size = 0;
+  chunk.reserved = 0;
+  chunks_.push_back(chunk);
+}
+
+void RdxWriter::end_chunk()
+{
+  assert(in_chunk_);
+  in_chunk_ = false;
+  RdxChunkEntry& chunk = chunks_.back();
+  chunk.size = (uint32_t)data_.size() - chunk.offset;
+}
+
+bool RdxWriter::write_raw_data(const uint8_t* data, const uint32_t len)
+{
+  if (!in_chunk_) {
+    return false;
+  }
+  data_.insert(data_.end(), data, data + len);
+  return true;
+}
+
+bool RdxWriter::write_string(const std::string& str)
+{
+  return
+    write_generic<int32_t>((int32_t)str.size()) &&
+    write_raw_data((const uint8_t*)str.c_str(), (uint32_t)str.size());
+}
+
+bool RdxWriter::reorder_chunks(const uint32_t first, const std::vector<uint32_t>& order)
+{
+  if (in_chunk_ || first + order.size() != chunks_.size()) {
+    return false;
+  }
+  std::vector<bool> used(order.size(), false);
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (order[i] >= order.size() || used[order[i]]) {
+      return false;
+    }
+    used[order[i]] = true;
+  }
+  if (order.empty()) {
+    return true;
+  }
+
+  // the chunks are the tail of the data, so it can be rebuilt from their start
+  const uint32_t start = chunks_[first].offset;
+  const std::vector<RdxChunkEntry> old_chunks(chunks_.begin() + first, chunks_.end());
+  std::vector<uint8_t> old_data(data_.begin() + start, data_.end());
+  data_.resize(start);
+  for (size_t i = 0; i < order.size(); ++i) {
+    RdxChunkEntry chunk = old_chunks[order[i]];
+    data_.resize(align((uint32_t)data_.size()), 0);
+    const uint32_t old_offset = chunk.offset - start;
+    chunk.offset = (uint32_t)data_.size();
+    data_.insert(data_.end(), old_data.begin() + old_offset, old_data.begin() + old_offset + chunk.size);
+    chunks_[first + i] = chunk;
+  }
+  return true;
+}
+
+bool RdxWriter::remove_chunks(const uint32_t first)
+{
+  if (in_chunk_ || first > chunks_.size()) {
+    return false;
+  }
+  if (first < chunks_.size()) {
+    data_.resize(chunks_[first].offset);
+    chunks_.resize(first);
+  }
+  return true;
+}
+
+bool RdxWriter::end_of_data()
+{
+  if (in_chunk_) {
+    return false;
+  }
+  if (patch_layout_ && block_size_) {
+    align_chunk_groups();
+  }
+
+  RdxFileHeader header;
+  header.magic = kRdxMagic;
+  header.version = kRdxVersion;
+  header.flags = block_size_ ? RdxFileHeader::kBlockCompressed : 0;
+  header.chunk_count = (uint32_t)chunks_.size();
+  header.block_size = block_size_;
+  header.block_count = block_size_ ? ((uint32_t)data_.size() + block_size_ - 1) / block_size_ : 0;
+  header.data_offset = align(sizeof(RdxFileHeader) + header.chunk_count * sizeof(RdxChunkEntry) +
+    header.block_count * sizeof(RdxBlockEntry));
+  header.data_size = (uint32_t)data_.size();
+
+  file_.clear();
+  file_.resize(header.data_offset, 0);
+  if (!chunks_.empty()) {
+    memcpy(&file_[sizeof(RdxFileHeader)], &chunks_[0], chunks_.size() * sizeof(RdxChunkEntry));
+  }
+
+  if (block_size_) {
+    if (!compress_blocks(header)) {
+      return false;
+    }
+  } else {
+    file_.insert(file_.end(), data_.begin(), data_.end());
+  }
+  memcpy(&file_[0], &header, sizeof(header));
+  return true;
+}
+
+bool RdxWriter::compress_blocks(RdxFileHeader& header)
+{
+  std::vector<RdxBlockEntry> blocks(header.block_count);
+  std::vector<uint8_t> compressed(compressBound(block_size_));
+  for (uint32_t i = 0; i < header.block_count; ++i) {
+    const uint32_t offset = i * block_size_;
+    const uint32_t size = std::min<uint32_t>(block_size_, (uint32_t)data_.size() - offset);
+    uLongf compressed_size = (uLongf)compressed.size();
+    if (compress2(&compressed[0], &compressed_size, &data_[offset], size, Z_DEFAULT_COMPRESSION) != Z_OK) {
+      return false;
+    }
+
+    // blocks that don't shrink are stored as is
+    blocks[i].offset = (uint32_t)file_.size();
+    if (compressed_size < size) {
+      blocks[i].compressed_size = (uint32_t)compressed_size;
+      file_.insert(file_.end(), compressed.begin(), compressed.begin() + compressed_size);
+    } else {
+      blocks[i].compressed_size = size;
+      file_.insert(file_.end(), data_.begin() + offset, data_.begin() + offset + size);
+    }
+  }
+
+  if (!blocks.empty()) {
+    memcpy(&file_[sizeof(RdxFileHeader) + header.chunk_count * sizeof(RdxChunkEntry)], &blocks[0],
+      blocks.size() * sizeof(RdxBlockEntry));
+  }
+  return true;
+}
+
+void RdxWriter::align_chunk_groups()
+{
+  std::vector<uint8_t> old_data;
+  old_data.swap(data_);
+  uint32_t group_start = 0;
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    RdxChunkEntry& chunk = chunks_[i];
+    const uint8_t* src = chunk.size ? &old_data[chunk.offset] : NULL;
+    const bool picked = crc32(0, src, chunk.size) % block_size_ < (uint64_t)chunk.size * kPatchGroupsPerBlock;
+    uint32_t start = align((uint32_t)data_.size());
+    if (picked || start - group_start + chunk.size > block_size_) {
+      group_start = ((uint32_t)data_.size() + block_size_ - 1) / block_size_ * block_size_;
+      start = group_start;
+    }
+    data_.resize(start, 0);
+    chunk.offset = start;
+    data_.insert(data_.end(), src, src + chunk.size);
+  }
+}
+
+void RdxWriter::get_buffer(uint8_t*& buf, uint32_t& len)
+{
+  buf = file_.empty() ? NULL : &file_[0];
+  len = (uint32_t)file_.size();
+}
@@ -0,0 +1,74 @@
+#ifndef RDX_WRITER_HPP
+#define RDX_WRITER_HPP
+
+/**
+ * Writes the .rdx container described in Reader/RdxFormat.hpp. The chunks are collected in
+ * memory, 16 byte aligned, and end_of_data lays out the chunk table followed by either the
+ * raw data or its compressed blocks, after moving the chunk groups of the patch layout onto
+ * block boundaries. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "ScopedDeleter.hpp"
+#include "../Reader/RdxFormat.hpp"
+
+class RdxWriter
+{
+public:
+  RdxWriter();
+
+  // A block size of 0 writes an uncompressed file, that a reader can map and use in place.
+  // patch_layout groups the chunks of a block compressed file on block boundaries, see
+  // Reader/RdxFormat.hpp
+  void init_writer(const uint32_t block_size, const bool patch_layout = false);
+
+  // Chunks can't be nested
+  void begin_chunk(const RdxChunkId::Enum id);
+  void end_chunk();
+
+  template <class T>
+  bool write_generic(const T& value)
+  {
+    return write_raw_data((const uint8_t*)&value, sizeof(T));
+  }
+  bool write_raw_data(const uint8_t* data, const uint32_t len);
+  bool write_string(const std::string& str);
+
+  // Builds the file image, which get_buffer returns
+  bool end_of_data();
+  void get_buffer(uint8_t*& buf, uint32_t& len);
+
+  uint32_t chunk_count() const { return (uint32_t)chunks_.size(); }
+
+  const RdxChunkEntry& chunk_entry(const uint32_t idx) const { return chunks_[idx]; }
+  const uint8_t* chunk_data(const uint32_t idx) const { return data_.empty() ? NULL : &data_[chunks_[idx].offset]; }
+
+  // Moves the chunks from first to the last one so that chunk first + order[i] comes i-th
+  bool reorder_chunks(const uint32_t first, const std::vector<uint32_t>& order);
+  // Drops the chunks from first to the last one
+  bool remove_chunks(const uint32_t first);
+
+private:
+  bool compress_blocks(RdxFileHeader& header);
+  void align_chunk_groups();
+
+  uint32_t block_size_;
+  bool patch_layout_;
+  bool in_chunk_;
+  std::vector<RdxChunkEntry> chunks_;
+  std::vector<uint8_t> data_;
+  std::vector<uint8_t> file_;
+};
+
+struct ScopedRdxChunk
+{
+  ScopedRdxChunk(RdxWriter& writer, const RdxChunkId::Enum id) : writer_(writer) { writer_.begin_chunk(id); }
+  ~ScopedRdxChunk() { writer_.end_chunk(); }
+  RdxWriter& writer_;
+};
+
+#define SCOPED_RDX_CHUNK(writer, id) ScopedRdxChunk GEN_NAME(rdx_chunk, __LINE__)(writer, id)
+
+#endif
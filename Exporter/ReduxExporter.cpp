@@ -6,8 +6,18 @@
 #include "ScopedDeleter.hpp"
 #include "ExporterUtils.hpp"
 #include "MeshExporter.hpp"
+#include "Arena.hpp"
 #include "AnimationExporter.hpp"
 #include "MaterialExporter.hpp"
+#include "Hierarchy.hpp"
+#include "StringTable.hpp"
+#include "MeshLayout.hpp"
+#include "SceneSnapshot.hpp"
+#include "BlockManifest.hpp"
+#include "DependencyManifest.hpp"
+#include "TextureExporter.hpp"
+#include "../Reader/RdxReader.hpp"
+#include "../Reader/RdxImage.hpp"
 
 using namespace std;
 namespace fs = boost::filesystem;
@@ -15,15 +25,43 @@ namespace fs = boost::filesystem;
 
 namespace {
   const char* kDefaultFileExtension = "rdx";
+  const uint32_t kHashThreads = 4;
+  // Relative to each camera channel's magnitude, or to 1 for small values
+  const float kCameraCurveTolerance = 1e-4f;
+
+  // The path of the exporter dll, as opposed to the executable that loaded it
+  string exporter_module_path()
+  {
+    HMODULE module = NULL;
+    char path[MAX_PATH];
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+      (LPCSTR)&export_main, &module) || !GetModuleFileNameA(module, path, MAX_PATH)) {
+      return string();
+    }
+    return path;
+  }
+
+  // The names of the chunks in the stats report
+  const char* chunk_name(const uint32_t id)
+  {
+    const char* kChunkNames[] = { "Unknown", "Mesh", "Camera", "Animation", "Hierarchy", "StringTable", "Materials",
+      "SpatialIndex", "CellManifest", "MeshBatches", "MorphTargets", "Skins" };
+    return id < sizeof(kChunkNames) / sizeof(kChunkNames[0]) ? kChunkNames[id] : kChunkNames[0];
+  }
 }
 
-ReduxExporter::ReduxExporter(const char* filename) 
+ReduxExporter::ReduxExporter(const char* filename, const ExporterSettings& settings) 
   : filename_(filename)
+  , settings_(settings)
   , writer_()
-  , animation_exporter_(writer_)
-  , json_file_(NULL)
+  , scene_desc_(strings_)
+  , snapshot_(strings_)
+  , animation_exporter_(writer_, strings_, snapshot_)
 {
-  writer_.init_writer(ChunkIo::MainHeader::CompressedZLib);
+  // the image is baked from the uncompressed chunks. Patches copy unchanged blocks, so the
+  // patch layout uses smaller ones
+  const uint32_t block_size = settings.patch_layout ? kRdxPatchBlockSize : kRdxDefaultBlockSize;
+  writer_.init_writer(settings.compress && !settings.load_in_place ? block_size : 0, settings.patch_layout);
 }
 
 MStatus ReduxExporter::export_all() 
@@ -34,11 +72,15 @@ MStatus ReduxExporter::export_all()
   fs::path out_path(filename_);
   out_path.replace_extension();
 
+  // a stale manifest could mark a half written output as up to date
+  const string deps_filename(manifest_filename(filename_));
+  remove(deps_filename.c_str());
+
+  Profiler::set_current(&profiler_);
+  SCOPED_DELETER(&Profiler::set_current, (Profiler*)NULL);
 
-  const string json_filename(out_path.string() + ".json");
-  RETURN_ON_ERROR_BOOL(fopen_s(&json_file_, json_filename.c_str(), "wt") == 0);
-  SCOPED_DELETER(&fclose, json_file_);
-  fprintf(json_file_, "{\n");
+  // Walk the scene once, all the stages use the snapshot
+  RETURN_ON_ERROR_MSTATUS(snapshot_.build());
 
   RETURN_ON_ERROR_MSTATUS(export_hierarchy());
 
@@ -50,15 +92,57 @@ MStatus ReduxExporter::export_all()
 
   RETURN_ON_ERROR_MSTATUS(export_materials());
 
-  writer_.end_of_data();
+  // Written last, as all the other chunks add names to it
+  RETURN_ON_ERROR_MSTATUS(export_strings());
 
-  const string out_filename(out_path.string() + ".rdx");
+  // The writer sets the size of each chunk as it closes, and the merged meshes are already dropped
+  for (uint32_t i = 0; i < writer_.chunk_count(); ++i) {
+    const RdxChunkEntry& chunk = writer_.chunk_entry(i);
+    PROFILE_CHUNK_BYTES(chunk_name(chunk.id), chunk.size);
+  }
+
+  const string out_filename(out_path.string() + (settings_.load_in_place ? ".rdi" : ".rdx"));
   uint8_t* buf = NULL;
   uint32_t len = 0;
-  writer_.get_buffer(buf, len);
-  RETURN_ON_ERROR_BOOL(write_file(buf, len, out_filename.c_str()));
+  {
+    PROFILE_SCOPE("compression");
+    RETURN_ON_ERROR_BOOL(writer_.end_of_data());
+    writer_.get_buffer(buf, len);
+  }
+
+  vector<uint8_t> image;
+  if (settings_.load_in_place) {
+    PROFILE_SCOPE("bake_image");
+    RdxFile file;
+    RETURN_ON_ERROR_BOOL(file.open_memory(buf, len) && bake_image(image, file));
+    buf = &image[0];
+    len = (uint32_t)image.size();
+  }
+  PROFILE_COUNTER("file_bytes", len);
+  {
+    PROFILE_SCOPE("write_file");
+    RETURN_ON_ERROR_BOOL(write_file(buf, len, out_filename.c_str()));
+  }
+
+  if (settings_.patch_layout) {
+    PROFILE_SCOPE("block_manifest");
+    BlockManifest blocks;
+    hash_blocks(blocks, buf, len);
+    PROFILE_COUNTER("patch/blocks", blocks.blocks.size());
+    RETURN_ON_ERROR_BOOL(write_block_manifest((out_path.string() + ".blocks").c_str(), blocks));
+  }
+
+  if (settings_.write_material_json) {
+    RETURN_ON_ERROR_BOOL(scene_desc_.write_json((out_path.string() + ".json").c_str()));
+  }
+
+  RETURN_ON_ERROR_BOOL(profiler_.write_report((out_path.string() + ".stats.json").c_str()));
+  if (settings_.write_trace) {
+    RETURN_ON_ERROR_BOOL(profiler_.write_trace((out_path.string() + ".trace.json").c_str()));
+  }
 
-  fprintf(json_file_, "\n}");
+  // Written once everything else succeeded
+  RETURN_ON_ERROR_MSTATUS(export_dependencies(deps_filename));
 
   _strtime_s(time_buf, sizeof(time_buf));
   cout << "***************************************** EXPORTING SUCESSFULLY DONE (" << time_buf << ")" << endl;
@@ -66,46 +150,118 @@ MStatus ReduxExporter::export_all()
   return MS::kSuccess;
 }
 
-MStatus ReduxExporter::export_materials()
+MStatus ReduxExporter::collect_materials()
 {
-  // Export materials
-  fprintf(json_file_, "\t\"materials\" : [\n" );
+  PROFILE_SCOPE("materials/collect");
   for (uint32_t i = 0; i < materials_.size(); ++i) {
-    write_material(json_file_, materials_[i], i != materials_.size() - 1);
+    // unsupported shader types are skipped, and their meshes left unbound
+    if (collect_material(scene_desc_, materials_[i]) != MS::kSuccess) {
+      cout << "Unsupported material: " << make_material_name(materials_[i]) << endl;
+    }
   }
-  fprintf(json_file_, "\t], \n\n" );
 
-  // Export material connections
-  fprintf(json_file_, "\t\"material_connections\" : [\n" );
-  uint32_t counter = 0;
+  // Scenes merged from many sources have lots of identical materials under different names
+  vector<MaterialName> names(scene_desc_.materials.size());
+  for (size_t i = 0; i < names.size(); ++i) {
+    names[i] = scene_desc_.strings.get(scene_desc_.materials[i].name);
+  }
+  PROFILE_COUNTER("materials/collected", scene_desc_.materials.size());
+  vector<uint32_t> remap;
+  const uint32_t merged_materials = scene_desc_.merge_duplicate_materials(&remap);
+  PROFILE_COUNTER("materials/merged", merged_materials);
+  for (size_t i = 0; i < names.size(); ++i) {
+    material_indices_[names[i]] = remap[i];
+  }
+  return MS::kSuccess;
+}
+
+uint32_t ReduxExporter::find_material(const MaterialName& name) const
+{
+  MaterialIndices::const_iterator it = material_indices_.find(name);
+  return it == material_indices_.end() ? StringTable::kInvalidIndex : it->second;
+}
+
+MStatus ReduxExporter::export_materials()
+{
+  PROFILE_SCOPE("materials");
+
+  // Bind the meshes to their materials. All the materials use the default effect
+  EffectBinding effect_binding;
+  effect_binding.effect = scene_desc_.strings.intern("blinn_effect");
   for (MeshesByMaterialName::iterator it = meshes_by_material_name_.begin(); it != meshes_by_material_name_.end(); ++it) {
+    const uint32_t material_idx = find_material(it->first);
+    if (material_idx == StringTable::kInvalidIndex) {
+      continue;
+    }
     for (Meshes::iterator mesh_it = it->second.begin(); mesh_it != it->second.end(); ++mesh_it) {
-      counter++;
+      MaterialBinding binding;
+      binding.mesh = scene_desc_.strings.intern(*mesh_it);
+      binding.material = material_idx;
+      scene_desc_.material_bindings.push_back(binding);
     }
+    effect_binding.materials.push_back(material_idx);
+  }
+  // the names of merged materials share an index
+  sort(effect_binding.materials.begin(), effect_binding.materials.end());
+  effect_binding.materials.erase(unique(effect_binding.materials.begin(), effect_binding.materials.end()),
+    effect_binding.materials.end());
+  scene_desc_.effect_bindings.push_back(effect_binding);
+
+  if (settings_.texture_mode != 0) {
+    RETURN_ON_ERROR_MSTATUS(export_textures(scene_desc_, fs::path(filename_).parent_path().string(), settings_));
   }
 
-  for (MeshesByMaterialName::iterator it = meshes_by_material_name_.begin(); it != meshes_by_material_name_.end(); ++it) {
-    for (Meshes::iterator mesh_it = it->second.begin(); mesh_it != it->second.end(); ++mesh_it) {
-      fprintf(json_file_, "\t{\"mesh\" : \"%s\", \"material\" : \"%s\"}%s\n", 
-        mesh_it->c_str(), it->first.c_str(), ((--counter != 0) ? "," : ""));
+  SCOPED_RDX_CHUNK(writer_, RdxChunkId::Materials);
+  RETURN_ON_ERROR_BOOL(scene_desc_.write(writer_));
+
+  return MS::kSuccess;
+}
+
+MStatus ReduxExporter::export_dependencies(const string& deps_filename)
+{
+  PROFILE_SCOPE("dependencies");
+
+  set<string> textures;
+  for (size_t i = 0; i < scene_desc_.materials.size(); ++i) {
+    if (scene_desc_.materials[i].texture != StringTable::kInvalidIndex) {
+      textures.insert(scene_desc_.strings.get(scene_desc_.materials[i].texture));
     }
   }
 
-  fprintf(json_file_, "\t], \n\n");
+  vector<string> files;
+  files.push_back(MFileIO::currentFile().asChar());
+  files.push_back(exporter_module_path());
+  files.insert(files.end(), textures.begin(), textures.end());
+  vector<uint64_t> hashes;
+  hash_files(hashes, files, kHashThreads);
+
+  DependencyManifest manifest;
+  manifest.add(Dependency::kScene, files[0], hashes[0]);
+  manifest.add(Dependency::kExporter, files[1], hashes[1]);
+  for (size_t i = 2; i < files.size(); ++i) {
+    manifest.add(Dependency::kTexture, files[i], hashes[i]);
+  }
+  const string options(format_exporter_options(settings_));
+  manifest.add(Dependency::kSettings, options, hash_bytes(options.data(), options.size(), 0));
 
-  // Export shader connections
-  const char* psz_default_shader = "blinn_effect";
-  fprintf(json_file_, "\"effect_connections\" : [ { \"effect\" : \"%s\" , \"materials\" : [\n\t", psz_default_shader);
-  counter = (int32_t)meshes_by_material_name_.size();
-  for (MeshesByMaterialName::iterator it = meshes_by_material_name_.begin(); it != meshes_by_material_name_.end(); ++it) {
-    fprintf(json_file_, "\"%s\"%s \n\t", (*it).first.c_str(), (--counter != 0 ? "," : "") );
+  RETURN_ON_ERROR_BOOL(write_manifest(deps_filename.c_str(), manifest));
+  return MS::kSuccess;
+}
+
+MStatus ReduxExporter::export_strings()
+{
+  PROFILE_SCOPE("strings");
+  PROFILE_COUNTER("strings/count", strings_.size());
+  if (strings_.hash_collisions() > 0) {
+    cout << "Warning: " << strings_.hash_collisions() << " name hash collisions" << endl;
   }
-  fprintf(json_file_, "] } ]\n");
 
+  SCOPED_RDX_CHUNK(writer_, RdxChunkId::StringTable);
+  RETURN_ON_ERROR_BOOL(strings_.write(writer_));
   return MS::kSuccess;
 }
 
-MStatus ReduxExporter::export_camera(const MFnCamera& maya_camera)
+MStatus ReduxExporter::export_camera(const MFnCamera& maya_camera, const uint32_t camera_node)
 {
   const std::string camera_name(maya_camera.name().asChar());
   const MSpace::Space space = MSpace::kObject;
@@ -119,8 +275,8 @@ MStatus ReduxExporter::export_camera(const MFnCamera& maya_camera)
   const float near_plane = (float)maya_camera.nearClippingPlane();
   const float far_plane = (float)maya_camera.farClippingPlane();
 
-  SCOPED_CHUNK(writer_, ChunkHeader::Camera);
-  RETURN_ON_ERROR_BOOL(writer_.write_string(camera_name));
+  SCOPED_RDX_CHUNK(writer_, RdxChunkId::Camera);
+  RETURN_ON_ERROR_BOOL(writer_.write_generic<uint32_t>(strings_.intern(camera_name)));
   RETURN_ON_ERROR_BOOL(writer_.write_generic(to_vector3(eye_pos)));
   RETURN_ON_ERROR_BOOL(writer_.write_generic(to_vector3(view_dir)));
   RETURN_ON_ERROR_BOOL(writer_.write_generic(to_vector3(up_dir)));
@@ -132,6 +288,15 @@ MStatus ReduxExporter::export_camera(const MFnCamera& maya_camera)
   RETURN_ON_ERROR_BOOL(writer_.write_generic(near_plane));
   RETURN_ON_ERROR_BOOL(writer_.write_generic(far_plane));
 
+  CameraTrack track;
+  if (animation_exporter_.get_camera_track(track, camera_node) && track.size() > 1) {
+    CameraCurves curves;
+    RETURN_ON_ERROR_BOOL(compress_camera_curves(curves, track, kCameraCurveTolerance));
+    PROFILE_COUNTER("cameras/samples", (int64_t)track.size());
+    PROFILE_COUNTER("cameras/keys", (int64_t)curves.keys.size());
+    RETURN_ON_ERROR_BOOL(write_camera_curves(writer_, curves));
+  }
+
   return MS::kSuccess;
 }
 
@@ -141,69 +306,164 @@ MStatus ReduxExporter::export_animation()
   return animation_exporter_.do_export();
 }
 
-MStatus ReduxExporter::export_hierarchy_inner(const MDagPath& dag_path, const string indent)
+MStatus ReduxExporter::export_hierarchy()
 {
-  cout << indent << dag_path.fullPathName() << " (" << dag_path.node().apiTypeStr() << ")" << endl;
-  const uint32_t child_count = dag_path.childCount();
+  PROFILE_SCOPE("hierarchy");
+
+  // The snapshot is already breadth first, so the node indices carry over as is
+  Hierarchy hierarchy;
+  for (uint32_t i = 0; i < snapshot_.size(); ++i) {
+    const SnapshotNode& node = snapshot_.node(i);
+    const uint32_t parent = node.parent == SceneSnapshot::kInvalidNode ? Hierarchy::kInvalidNode : node.parent;
+    if (node.object.hasFn(MFn::kTransform) && i != 0) {
+      D3DXVECTOR3 pos, scale;
+      D3DXQUATERNION rot;
+      decompose_matrix(pos, rot, scale, MFnTransform(node.path).transformation().asMatrix());
+      hierarchy.add_node(parent, node.name, &pos.x, &rot.x, &scale.x);
+    } else {
+      hierarchy.add_node(parent, node.name, NULL, NULL, NULL);
+    }
+  }
 
-  writer_.write_string(strip_pipes(dag_path.fullPathName().asChar()));
-  writer_.write_generic<uint32_t>(child_count);
-  for (uint32_t i = 0; i < child_count; ++i) {
-    MObject child = dag_path.child(i);
-    MDagPath child_path;
-    MDagPath::getAPathTo(child, child_path);
-    export_hierarchy_inner(child_path, indent + "  ");
+  if (!hierarchy.link_children()) {
+    cout << "Hierarchy isn't breadth first ordered" << endl;
+    return MS::kFailure;
   }
+  PROFILE_COUNTER("hierarchy/nodes", hierarchy.nodes.size());
+
+  SCOPED_RDX_CHUNK(writer_, RdxChunkId::Hierarchy);
+  RETURN_ON_ERROR_BOOL(hierarchy.write(writer_));
   return MS::kSuccess;
 }
 
-MStatus ReduxExporter::export_hierarchy()
+
+MStatus ReduxExporter::export_meshes()
 {
-  SCOPED_CHUNK(writer_, ChunkHeader::Hierarchy);
-
-  MItDag it_root;
-  MDagPath root_path;
-  it_root.getPath(root_path);
-  const uint32_t child_count = root_path.childCount();
-  writer_.write_string("root");
-  writer_.write_generic<uint32_t>(child_count);
-  for (uint32_t i = 0; i < child_count; ++i) {
-    MObject child = root_path.child(i);
-    MDagPath child_path;
-    MDagPath::getAPathTo(child, child_path);
-    RETURN_ON_ERROR_MSTATUS(export_hierarchy_inner(child_path, ""));
+  MeshExporter mesh_exporter(meshes_by_material_name_, mesh_names_, exported_materials_, materials_, writer_, strings_, snapshot_, animation_exporter_, settings_);
+
+  // The per mesh temporaries come from the arena, which is reset after each mesh
+  Arena arena;
+  const uint32_t first_mesh_chunk = writer_.chunk_count();
+  const std::vector<uint32_t>& meshes = snapshot_.meshes();
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    PROFILE_SCOPE_ITEM("mesh", snapshot_.path_name(meshes[i]));
+    ScopedArena scoped_arena(arena);
+    CONTINUE_ON_ERROR_MSTATUS(mesh_exporter.export_mesh(meshes[i]));
+  }
+
+  PROFILE_COUNTER("mesh/arena_allocations", arena.allocations());
+  PROFILE_COUNTER("mesh/arena_blocks", arena.block_allocations());
+  PROFILE_COUNTER("mesh/arena_high_water_kb", (int64_t)(arena.high_water_mark() / 1024));
+
+  // The materials are merged before the batches are planned, so the meshes of merged materials
+  // can share batches
+  RETURN_ON_ERROR_MSTATUS(collect_materials());
+
+  RETURN_ON_ERROR_MSTATUS(export_layout(first_mesh_chunk, mesh_exporter.mesh_bounds(), mesh_exporter.batch_sources()));
+
+  const MorphTargets& morphs = mesh_exporter.morph_targets();
+  if (!morphs.meshes.empty()) {
+    PROFILE_COUNTER("morph/meshes", morphs.meshes.size());
+    PROFILE_COUNTER("morph/targets", morphs.targets.size());
+    PROFILE_COUNTER("morph/dense_deltas", (int64_t)morphs.dense_deltas);
+    PROFILE_COUNTER("morph/deltas", morphs.deltas.size());
+    cout << "morph targets: " << morphs.targets.size() << " targets, " << morphs.deltas.size() << " of " <<
+      morphs.dense_deltas << " vertex deltas stored, " << morph_targets_size(morphs) << " bytes" << endl;
+
+    SCOPED_RDX_CHUNK(writer_, RdxChunkId::MorphTargets);
+    RETURN_ON_ERROR_BOOL(write_morph_targets(writer_, morphs));
+  }
+
+  const Skins& skins = mesh_exporter.skins();
+  if (!skins.skins.empty()) {
+    PROFILE_COUNTER("skin/meshes", skins.skins.size());
+    PROFILE_COUNTER("skin/palette_joints", skins.joints.size());
+    cout << "skins: " << skins.skins.size() << " skinned meshes, " << skins.joints.size() << " palette joints" << endl;
+
+    SCOPED_RDX_CHUNK(writer_, RdxChunkId::Skins);
+    RETURN_ON_ERROR_BOOL(write_skins(writer_, skins));
   }
   return MS::kSuccess;
 }
 
-
-MStatus ReduxExporter::export_meshes()
+MStatus ReduxExporter::export_layout(const uint32_t first_mesh_chunk, const vector<MeshBounds>& mesh_bounds,
+                                     const vector<BatchSource>& sources)
 {
-  MeshExporter mesh_exporter(meshes_by_material_name_, exported_materials_, materials_, writer_, animation_exporter_);
+  PROFILE_SCOPE("mesh_layout");
+
+  // The meshes are grouped by their merged material, the ones without a material by their name
+  vector<BatchSource> merged_sources(sources);
+  for (size_t i = 0; i < merged_sources.size(); ++i) {
+    const uint32_t material_idx = find_material(strings_.get(merged_sources[i].material));
+    if (material_idx != StringTable::kInvalidIndex) {
+      merged_sources[i].material = scene_desc_.materials[material_idx].name;
+    }
+  }
 
-  MStatus status;
-  for( MItDag it(MItDag::kDepthFirst, MFn::kMesh); !it.isDone(); it.next() ) {
+  // the pack is found next to this file
+  fs::path out_path(filename_);
+  out_path.replace_extension();
+  const string pack_filename(out_path.string() + ".cells");
+  const string::size_type separator = pack_filename.find_last_of("/\\");
+  const string pack_name(separator == string::npos ? pack_filename : pack_filename.substr(separator + 1));
 
-    MDagPath dag_path;
-    CONTINUE_ON_ERROR_MSTATUS(it.getPath(dag_path));
+  MeshLayout layout;
+  RETURN_ON_ERROR_BOOL(layout_meshes(layout, writer_, strings_, mesh_names_, mesh_bounds, merged_sources,
+    first_mesh_chunk, pack_name, settings_));
 
-    MFnMesh maya_mesh(dag_path, &status);
-    CONTINUE_ON_ERROR_MSG(status, "Error creating MFnMesh from path");
+  if (!layout.batches.empty()) {
+    for (size_t i = 0; i < layout.batches.size(); ++i) {
+      meshes_by_material_name_[strings_.get(layout.batch_materials[i])].push_back(strings_.get(layout.batches[i].mesh));
+    }
 
-    CONTINUE_ON_ERROR_MSTATUS(mesh_exporter.export_mesh(maya_mesh, dag_path));
+    // the merged meshes are bound through their batch
+    set<string> merged_names;
+    for (size_t i = 0; i < layout.ranges.size(); ++i) {
+      merged_names.insert(strings_.get(layout.ranges[i].name));
+    }
+    for (MeshesByMaterialName::iterator it = meshes_by_material_name_.begin(); it != meshes_by_material_name_.end(); ++it) {
+      Meshes kept;
+      for (size_t i = 0; i < it->second.size(); ++i) {
+        if (!merged_names.count(it->second[i])) {
+          kept.push_back(it->second[i]);
+        }
+      }
+      it->second.swap(kept);
+    }
+
+    PROFILE_COUNTER("batches/count", layout.batches.size());
+    PROFILE_COUNTER("batches/merged_meshes", layout.ranges.size());
+    cout << "batches: " << layout.ranges.size() << " meshes merged into " << layout.batches.size() << " batches" << endl;
+  }
+
+  if (settings_.stream_cell_size > 0) {
+    {
+      PROFILE_SCOPE("write_file");
+      RETURN_ON_ERROR_BOOL(write_file(layout.pack.empty() ? NULL : &layout.pack[0], (uint32_t)layout.pack.size(),
+        pack_filename.c_str()));
+    }
+    PROFILE_COUNTER("cells/count", layout.manifest.size());
+    PROFILE_COUNTER("cells/shared_meshes", layout.shared_meshes);
+    PROFILE_COUNTER("cells/pack_bytes", layout.pack.size());
+    cout << "cells: " << layout.manifest.size() << " cells, " << layout.shared_meshes << " shared meshes, "
+      << layout.pack.size() / 1024 << " KB pack" << endl;
+  }
+
+  if (settings_.spatial_order && !layout.reordered) {
+    cout << "Not reordering the meshes, as some of them failed to export" << endl;
   }
+  PROFILE_COUNTER("spatial_index/nodes", layout.index_nodes);
+  cout << "spatial index: " << layout.index_nodes << " nodes, sah cost " << layout.sah_cost << endl;
   return MS::kSuccess;
 }
 
 MStatus ReduxExporter::export_cameras()
 {
-  for( MItDag it(MItDag::kDepthFirst, MFn::kCamera); !it.isDone(); it.next() ) {
-
-    MDagPath dag_path;
-    CONTINUE_ON_ERROR_MSTATUS(it.getPath(dag_path));
-
-    MFnCamera maya_camera(dag_path);
-    CONTINUE_ON_ERROR_MSTATUS(export_camera(maya_camera));
+  PROFILE_SCOPE("cameras");
+  const std::vector<uint32_t>& cameras = snapshot_.cameras();
+  for (size_t i = 0; i < cameras.size(); ++i) {
+    MFnCamera maya_camera(snapshot_.node(cameras[i]).path);
+    CONTINUE_ON_ERROR_MSTATUS(export_camera(maya_camera, cameras[i]));
   }
   return MS::kSuccess;
 }
@@ -212,9 +472,9 @@ MStatus ReduxExporter::export_cameras()
 
 extern "C"
 {
-  bool export_main(const char* filename)
+  bool export_main(const char* filename, const ExporterSettings& settings)
   {
-    ReduxExporter exporter(filename);
+    ReduxExporter exporter(filename, settings);
     return exporter.export_all() == MS::kSuccess;
   }
 }
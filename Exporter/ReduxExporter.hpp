@@ -1,19 +1,26 @@
 #ifndef REDUX_EXPORTER_HPP
 #define REDUX_EXPORTER_HPP
 
-#include <celsus/chunkio.hpp>
+#include "RdxWriter.hpp"
 #include "AnimationExporter.hpp"
+#include "Profiler.hpp"
+#include "SceneDescription.hpp"
+#include "SceneSnapshot.hpp"
+#include "../Stub/exporter_settings.hpp"
 
 extern "C"
 {
-  __declspec(dllexport) bool export_main(const char* filename);
+  __declspec(dllexport) bool export_main(const char* filename, const ExporterSettings& settings);
 }
-typedef bool(*ExportMainFn)(const char*);
+typedef bool(*ExportMainFn)(const char*, const ExporterSettings&);
+
+struct MeshBounds;
+struct BatchSource;
 
 class ReduxExporter
 {
 public:
-  ReduxExporter(const char* filename);
+  ReduxExporter(const char* filename, const ExporterSettings& settings);
   MStatus export_all();
 private:
 
@@ -21,21 +28,38 @@ private:
   typedef std::string MeshName;
   typedef std::set<MaterialName> ExportedMaterials;
   typedef std::vector<MeshName> Meshes;
+  typedef std::set<MeshName> MeshNames;
 
   MStatus export_hierarchy();
-  MStatus export_hierarchy_inner(const MDagPath& dag_path, const std::string indent);
   MStatus export_animation();
   MStatus export_meshes();
+  // Batches, streams and orders the mesh chunks with layout_meshes, and binds the batches
+  MStatus export_layout(const uint32_t first_mesh_chunk, const std::vector<MeshBounds>& mesh_bounds,
+    const std::vector<BatchSource>& sources);
+  MStatus collect_materials();
+  // Index in scene_desc_ of the material with the given name, after merging duplicates, or
+  // StringTable::kInvalidIndex
+  uint32_t find_material(const MaterialName& name) const;
   MStatus export_materials();
+  MStatus export_strings();
+  MStatus export_dependencies(const std::string& deps_filename);
   MStatus export_cameras();
-  MStatus export_camera(const MFnCamera& maya_camera);
+  MStatus export_camera(const MFnCamera& maya_camera, const uint32_t camera_node);
 
   typedef std::map<MaterialName, Meshes> MeshesByMaterialName;
   MeshesByMaterialName meshes_by_material_name_;
+  // The names of the exported meshes, which are made unique within the export
+  MeshNames mesh_names_;
+  typedef std::map<MaterialName, uint32_t> MaterialIndices;
+  MaterialIndices material_indices_;
 
   const char* filename_;
-  ChunkIo writer_;
-  FILE* json_file_;
+  ExporterSettings settings_;
+  Profiler profiler_;
+  RdxWriter writer_;
+  StringTable strings_;
+  SceneDescription scene_desc_;
+  SceneSnapshot snapshot_;
 
   ExportedMaterials exported_materials_;
   std::vector<MObject> materials_;
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include "SceneDescription.hpp"
+#include "ScopedDeleter.hpp"
+
+namespace
+{
+  const uint32_t kMaterialsVersion = 3;
+
+  const char* kValueTypeNames[] = { "float", "color", "vec4" };
+
+  // The json dump uses forward slashes, so texture paths don't need escaping
+  std::string to_json_path(const std::string& str)
+  {
+    std::string res(str);
+    for (size_t i = 0; i < res.size(); ++i) {
+      if (res[i] == '\\') {
+        res[i] = '/';
+      }
+    }
+    return res;
+  }
+
+  // Everything but the name, with -0 and 0 alike, so equal keys are interchangeable materials
+  void material_key(std::vector<uint32_t>& key, const MaterialDesc& material)
+  {
+    key.clear();
+    key.push_back(material.shader);
+    key.push_back(material.texture);
+    key.push_back(material.processed_texture);
+    key.push_back((uint32_t)material.values.size());
+    for (size_t i = 0; i < material.values.size(); ++i) {
+      const MaterialValue& v = material.values[i];
+      key.push_back(v.name);
+      key.push_back(v.type);
+      for (int j = 0; j < 4; ++j) {
+        const float value = v.value[j] == 0 ? 0.0f : v.value[j];
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        key.push_back(bits);
+      }
+    }
+  }
+}
+
+SceneDescription::SceneDescription(StringTable& strings)
+  : strings(strings)
+{
+}
+
+uint32_t SceneDescription::add_material(const MaterialDesc& material)
+{
+  materials.push_back(material);
+  return (uint32_t)materials.size() - 1;
+}
+
+void SceneDescription::add_value(MaterialDesc& material, const std::string& name, const MaterialValue::Type type, const float* value)
+{
+  MaterialValue v;
+  v.name = strings.intern(name);
+  v.type = type;
+  for (int i = 0; i < 4; ++i) {
+    v.value[i] = value[i];
+  }
+  material.values.push_back(v);
+}
+
+uint32_t SceneDescription::find_material(const std::string& name) const
+{
+  for (size_t i = 0; i < materials.size(); ++i) {
+    if (strings.get(materials[i].name) == name) {
+      return (uint32_t)i;
+    }
+  }
+  return StringTable::kInvalidIndex;
+}
+
+uint32_t SceneDescription::merge_duplicate_materials(std::vector<uint32_t>* remap)
+{
+  // candidates by the hash of their key, so each material is compared with the few that hash
+  // the same, instead of all the others
+  typedef std::multimap<uint32_t, uint32_t> MaterialsByHash;
+  MaterialsByHash materials_by_hash;
+  std::vector<std::vector<uint32_t> > keys;
+  std::vector<MaterialDesc> merged;
+  std::vector<uint32_t> new_index(materials.size());
+  std::vector<uint32_t> key;
+  for (size_t i = 0; i < materials.size(); ++i) {
+    material_key(key, materials[i]);
+    const uint32_t hash = StringTable::hash((const char*)&key[0], key.size() * sizeof(uint32_t));
+    new_index[i] = StringTable::kInvalidIndex;
+    std::pair<MaterialsByHash::iterator, MaterialsByHash::iterator> range = materials_by_hash.equal_range(hash);
+    for (MaterialsByHash::iterator it = range.first; it != range.second; ++it) {
+      if (keys[it->second] == key) {
+        new_index[i] = it->second;
+        break;
+      }
+    }
+    if (new_index[i] == StringTable::kInvalidIndex) {
+      new_index[i] = (uint32_t)merged.size();
+      materials_by_hash.insert(std::make_pair(hash, new_index[i]));
+      keys.push_back(key);
+      merged.push_back(materials[i]);
+    }
+  }
+
+  const uint32_t removed = (uint32_t)(materials.size() - merged.size());
+  materials.swap(merged);
+  for (size_t i = 0; i < material_bindings.size(); ++i) {
+    material_bindings[i].material = new_index[material_bindings[i].material];
+  }
+  for (size_t i = 0; i < effect_bindings.size(); ++i) {
+    std::vector<uint32_t>& bound = effect_bindings[i].materials;
+    for (size_t j = 0; j < bound.size(); ++j) {
+      bound[j] = new_index[bound[j]];
+    }
+    std::sort(bound.begin(), bound.end());
+    bound.erase(std::unique(bound.begin(), bound.end()), bound.end());
+  }
+  if (remap) {
+    remap->swap(new_index);
+  }
+  return removed;
+}
+
+bool SceneDescription::write(RdxWriter& writer) const
+{
+  if (!(writer.write_generic<uint32_t>(kMaterialsVersion) &&
+    writer.write_generic<uint32_t>((uint32_t)materials.size()))) {
+    return false;
+  }
+  for (size_t i = 0; i < materials.size(); ++i) {
+    const MaterialDesc& material = materials[i];
+    if (!(writer.write_generic<uint32_t>(material.name) &&
+      writer.write_generic<uint32_t>(material.shader) &&
+      writer.write_generic<uint32_t>(material.texture) &&
+      writer.write_generic<uint32_t>(material.processed_texture) &&
+      writer.write_generic<uint32_t>((uint32_t)material.values.size()))) {
+        return false;
+    }
+    if (!material.values.empty() &&
+      !writer.write_raw_data((const uint8_t*)&material.values[0], (uint32_t)(material.values.size() * sizeof(MaterialValue)))) {
+        return false;
+    }
+  }
+
+  if (!writer.write_generic<uint32_t>((uint32_t)material_bindings.size())) {
+    return false;
+  }
+  if (!material_bindings.empty() &&
+    !writer.write_raw_data((const uint8_t*)&material_bindings[0], (uint32_t)(material_bindings.size() * sizeof(MaterialBinding)))) {
+      return false;
+  }
+
+  if (!writer.write_generic<uint32_t>((uint32_t)effect_bindings.size())) {
+    return false;
+  }
+  for (size_t i = 0; i < effect_bindings.size(); ++i) {
+    const EffectBinding& binding = effect_bindings[i];
+    if (!(writer.write_generic<uint32_t>(binding.effect) &&
+      writer.write_generic<uint32_t>((uint32_t)binding.materials.size()))) {
+        return false;
+    }
+    if (!binding.materials.empty() &&
+      !writer.write_raw_data((const uint8_t*)&binding.materials[0], (uint32_t)(binding.materials.size() * sizeof(uint32_t)))) {
+        return false;
+    }
+  }
+
+  return true;
+}
+
+uint32_t SceneDescription::serialized_size() const
+{
+  uint32_t res = 2 * sizeof(uint32_t);
+  for (size_t i = 0; i < materials.size(); ++i) {
+    res += 5 * sizeof(uint32_t) + (uint32_t)(materials[i].values.size() * sizeof(MaterialValue));
+  }
+  res += sizeof(uint32_t) + (uint32_t)(material_bindings.size() * sizeof(MaterialBinding));
+  res += sizeof(uint32_t);
+  for (size_t i = 0; i < effect_bindings.size(); ++i) {
+    res += 2 * sizeof(uint32_t) + (uint32_t)(effect_bindings[i].materials.size() * sizeof(uint32_t));
+  }
+  return res;
+}
+
+bool SceneDescription::write_json(const char* filename) const
+{
+  FILE* file = NULL;
+  if (fopen_s(&file, filename, "wt") != 0) {
+    return false;
+  }
+  SCOPED_DELETER(&fclose, file);
+
+  fprintf(file, "{\n");
+
+  // %.9g round trips floats exactly
+  fprintf(file, "\t\"materials\" : [\n");
+  for (size_t i = 0; i < materials.size(); ++i) {
+    const MaterialDesc& material = materials[i];
+    fprintf(file, "\t\t{ \"name\" : \"%s\",\n", strings.get(material.name).c_str());
+    if (material.texture != StringTable::kInvalidIndex) {
+      fprintf(file, "\t\t\"texture\" : \"%s\",\n", to_json_path(strings.get(material.texture)).c_str());
+    }
+    if (material.processed_texture != StringTable::kInvalidIndex) {
+      fprintf(file, "\t\t\"processed_texture\" : \"%s\",\n", to_json_path(strings.get(material.processed_texture)).c_str());
+    }
+    fprintf(file, "\t\t\"values\" : [\n");
+    for (size_t j = 0; j < material.values.size(); ++j) {
+      const MaterialValue& v = material.values[j];
+      fprintf(file, "\t\t\t{ \"name\" : \"%s\", \"type\" : \"%s\", \"value\" : ", strings.get(v.name).c_str(), kValueTypeNames[v.type]);
+      if (v.type == MaterialValue::kFloat) {
+        fprintf(file, "%.9g", v.value[0]);
+      } else {
+        fprintf(file, "[%.9g, %.9g, %.9g, %.9g]", v.value[0], v.value[1], v.value[2], v.value[3]);
+      }
+      fprintf(file, " }%s\n", j != material.values.size() - 1 ? "," : "");
+    }
+    fprintf(file, "\t\t] }%s\n", i != materials.size() - 1 ? "," : "");
+  }
+  fprintf(file, "\t], \n\n");
+
+  fprintf(file, "\t\"material_connections\" : [\n");
+  for (size_t i = 0; i < material_bindings.size(); ++i) {
+    const MaterialBinding& binding = material_bindings[i];
+    fprintf(file, "\t{\"mesh\" : \"%s\", \"material\" : \"%s\"}%s\n", strings.get(binding.mesh).c_str(),
+      strings.get(materials[binding.material].name).c_str(), i != material_bindings.size() - 1 ? "," : "");
+  }
+  fprintf(file, "\t], \n\n");
+
+  fprintf(file, "\t\"effect_connections\" : [\n");
+  for (size_t i = 0; i < effect_bindings.size(); ++i) {
+    const EffectBinding& binding = effect_bindings[i];
+    fprintf(file, "\t{ \"effect\" : \"%s\" , \"materials\" : [", strings.get(binding.effect).c_str());
+    for (size_t j = 0; j < binding.materials.size(); ++j) {
+      fprintf(file, "\"%s\"%s", strings.get(materials[binding.materials[j]].name).c_str(), j != binding.materials.size() - 1 ? ", " : "");
+    }
+    fprintf(file, "] }%s\n", i != effect_bindings.size() - 1 ? "," : "");
+  }
+  fprintf(file, "\t]\n}\n");
+
+  return true;
+}
@@ -0,0 +1,82 @@
+#ifndef SCENE_DESCRIPTION_HPP
+#define SCENE_DESCRIPTION_HPP
+
+/**
+ * In-memory model of the materials, mesh -> material bindings and effect bindings. It's
+ * written as a binary Materials chunk where everything refers to names by index in the scene's
+ * string table, and optionally dumped as JSON for debugging. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "RdxWriter.hpp"
+#include "StringTable.hpp"
+
+struct MaterialValue
+{
+  enum Type
+  {
+    kFloat,
+    kColor,
+    kVec4
+  };
+
+  uint32_t name;
+  uint32_t type;
+  float value[4];
+};
+
+struct MaterialDesc
+{
+  MaterialDesc()
+    : name(StringTable::kInvalidIndex), shader(StringTable::kInvalidIndex), texture(StringTable::kInvalidIndex)
+    , processed_texture(StringTable::kInvalidIndex) {}
+  uint32_t name;
+  uint32_t shader;
+  uint32_t texture;
+  uint32_t processed_texture; // .rtx of the texture, relative to the output, see TextureExporter.hpp
+  std::vector<MaterialValue> values;
+};
+
+struct MaterialBinding
+{
+  uint32_t mesh;      // string index of the mesh name
+  uint32_t material;  // index into materials
+};
+
+struct EffectBinding
+{
+  uint32_t effect;                  // string index of the effect name
+  std::vector<uint32_t> materials;  // indices into materials
+};
+
+class SceneDescription
+{
+public:
+  SceneDescription(StringTable& strings);
+
+  uint32_t add_material(const MaterialDesc& material);
+  void add_value(MaterialDesc& material, const std::string& name, const MaterialValue::Type type, const float* value);
+
+  // Returns the index of a material added with the given name, or StringTable::kInvalidIndex
+  uint32_t find_material(const std::string& name) const;
+
+  // Merges the materials with the same shader, textures and values, whatever their names, into
+  // the first of them, and points the bindings at the merged materials. Returns the number of
+  // materials removed. remap, if given, receives the new index of each material
+  uint32_t merge_duplicate_materials(std::vector<uint32_t>* remap = NULL);
+
+  bool write(RdxWriter& writer) const;
+  uint32_t serialized_size() const;
+
+  // Debug dump, in the layout of the old side-car json file
+  bool write_json(const char* filename) const;
+
+  StringTable& strings;
+  std::vector<MaterialDesc> materials;
+  std::vector<MaterialBinding> material_bindings;
+  std::vector<EffectBinding> effect_bindings;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "stdafx.h"
+#include "SceneSnapshot.hpp"
+#include "ExporterUtils.hpp"
+#include "Profiler.hpp"
+
+SceneSnapshot::SceneSnapshot(StringTable& strings)
+  : strings_(strings)
+{
+}
+
+MStatus SceneSnapshot::build()
+{
+  PROFILE_SCOPE("snapshot");
+  nodes_.clear();
+  transforms_.clear();
+  meshes_.clear();
+  cameras_.clear();
+  skin_clusters_.clear();
+  blend_shapes_.clear();
+
+  MItDag it_root;
+  SnapshotNode root;
+  RETURN_ON_ERROR_MSTATUS(it_root.getPath(root.path));
+  root.object = root.path.node();
+  root.type = root.object.apiType();
+  root.parent = kInvalidNode;
+  root.name = strings_.intern("root");
+  nodes_.push_back(root);
+
+  // The nodes vector doubles as the breadth first queue. Full path names are built from the
+  // parent's name instead of asking Maya for each node's fullPathName.
+  for (uint32_t parent = 0; parent < nodes_.size(); ++parent) {
+    const MDagPath parent_path(nodes_[parent].path);
+    const std::string prefix(parent == 0 ? "" : strings_.get(nodes_[parent].name) + "|");
+    const uint32_t child_count = parent_path.childCount();
+    for (uint32_t i = 0; i < child_count; ++i) {
+      SnapshotNode node;
+      node.object = parent_path.child(i);
+      // the original shapes of deformed meshes stay in the DAG as hidden intermediate objects
+      const MFnDagNode dag_node(node.object);
+      if (dag_node.isIntermediateObject()) {
+        continue;
+      }
+      node.path = parent_path;
+      CONTINUE_ON_ERROR_MSTATUS(node.path.push(node.object));
+      node.type = node.object.apiType();
+      node.parent = parent;
+      node.name = strings_.intern(prefix + dag_node.name().asChar());
+
+      const uint32_t idx = (uint32_t)nodes_.size();
+      if (node.type == MFn::kTransform) {
+        transforms_.push_back(idx);
+      } else if (node.object.hasFn(MFn::kMesh)) {
+        meshes_.push_back(idx);
+      } else if (node.object.hasFn(MFn::kCamera)) {
+        cameras_.push_back(idx);
+      }
+      nodes_.push_back(node);
+    }
+  }
+
+  PROFILE_COUNTER("snapshot/nodes", nodes_.size());
+  PROFILE_COUNTER("snapshot/meshes", meshes_.size());
+  return collect_deformers();
+}
+
+MStatus SceneSnapshot::collect_deformers()
+{
+  // Find the mesh nodes by the hash of their MObject, as an instanced shape has a node per path
+  NodesByHash meshes_by_hash;
+  for (size_t i = 0; i < meshes_.size(); ++i) {
+    meshes_by_hash.insert(std::make_pair(MObjectHandle(nodes_[meshes_[i]].object).hashCode(), meshes_[i]));
+  }
+
+  add_deformers(skin_clusters_, meshes_by_hash, MFn::kSkinClusterFilter);
+  add_deformers(blend_shapes_, meshes_by_hash, MFn::kBlendShape);
+  return MS::kSuccess;
+}
+
+void SceneSnapshot::add_deformers(Deformers& deformers, const NodesByHash& meshes_by_hash, const MFn::Type type)
+{
+  for (MItDependencyNodes it(type); !it.isDone(); it.next()) {
+    MStatus status;
+    MObject deformer = it.item();
+    MFnGeometryFilter maya_deformer(deformer, &status);
+    CONTINUE_ON_ERROR_MSG(status, "Error creating deformer");
+
+    MObjectArray outputs;
+    CONTINUE_ON_ERROR_MSTATUS(maya_deformer.getOutputGeometry(outputs));
+    for (uint32_t i = 0; i < outputs.length(); ++i) {
+      std::pair<NodesByHash::const_iterator, NodesByHash::const_iterator> range =
+        meshes_by_hash.equal_range(MObjectHandle(outputs[i]).hashCode());
+      for (NodesByHash::const_iterator it_mesh = range.first; it_mesh != range.second; ++it_mesh) {
+        if (nodes_[it_mesh->second].object == outputs[i]) {
+          deformers.insert(std::make_pair(it_mesh->second, deformer));
+        }
+      }
+    }
+  }
+}
+
+void SceneSnapshot::get_deformers(std::vector<MObject>& out, const Deformers& deformers, const uint32_t mesh) const
+{
+  out.clear();
+  std::pair<Deformers::const_iterator, Deformers::const_iterator> range = deformers.equal_range(mesh);
+  for (Deformers::const_iterator it = range.first; it != range.second; ++it) {
+    out.push_back(it->second);
+  }
+}
+
+void SceneSnapshot::get_skin_clusters(std::vector<MObject>& skin_clusters, const uint32_t mesh) const
+{
+  get_deformers(skin_clusters, skin_clusters_, mesh);
+}
+
+void SceneSnapshot::get_blend_shapes(std::vector<MObject>& blend_shapes, const uint32_t mesh) const
+{
+  get_deformers(blend_shapes, blend_shapes_, mesh);
+}
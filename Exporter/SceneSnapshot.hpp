@@ -0,0 +1,63 @@
+#ifndef SCENE_SNAPSHOT_HPP
+#define SCENE_SNAPSHOT_HPP
+
+#include "StringTable.hpp"
+
+/**
+ * A single breadth first walk of the DAG, shared by all the exporter stages. Nodes get stable
+ * indices in walk order (the same as in the Hierarchy chunk), their full path names are
+ * interned once, and the transforms, meshes and cameras are listed by node index. The skin
+ * clusters and blend shapes are mapped to the meshes they deform in the same pass, so the mesh
+ * export doesn't have to search them. Intermediate objects, such as the original shapes of
+ * deformed meshes, are left out.
+ */
+
+struct SnapshotNode
+{
+  MDagPath path;
+  MObject object;
+  MFn::Type type;
+  uint32_t parent;    // index of the parent node, or SceneSnapshot::kInvalidNode for the root
+  uint32_t name;      // string index of the full path name, without the leading '|'
+};
+
+class SceneSnapshot
+{
+public:
+  static const uint32_t kInvalidNode = 0xffffffff;
+
+  SceneSnapshot(StringTable& strings);
+
+  MStatus build();
+
+  uint32_t size() const { return (uint32_t)nodes_.size(); }
+  const SnapshotNode& node(const uint32_t idx) const { return nodes_[idx]; }
+  const std::string& path_name(const uint32_t idx) const { return strings_.get(nodes_[idx].name); }
+
+  // Plain transforms (not joints), meshes and cameras, as node indices in walk order
+  const std::vector<uint32_t>& transforms() const { return transforms_; }
+  const std::vector<uint32_t>& meshes() const { return meshes_; }
+  const std::vector<uint32_t>& cameras() const { return cameras_; }
+
+  // The skin clusters and blend shapes with the mesh node as an output shape
+  void get_skin_clusters(std::vector<MObject>& skin_clusters, const uint32_t mesh) const;
+  void get_blend_shapes(std::vector<MObject>& blend_shapes, const uint32_t mesh) const;
+
+private:
+  typedef std::multimap<uint32_t, MObject> Deformers;
+  typedef std::multimap<uint32_t, uint32_t> NodesByHash;
+
+  MStatus collect_deformers();
+  void add_deformers(Deformers& deformers, const NodesByHash& meshes_by_hash, const MFn::Type type);
+  void get_deformers(std::vector<MObject>& out, const Deformers& deformers, const uint32_t mesh) const;
+
+  StringTable& strings_;
+  std::vector<SnapshotNode> nodes_;
+  std::vector<uint32_t> transforms_;
+  std::vector<uint32_t> meshes_;
+  std::vector<uint32_t> cameras_;
+  Deformers skin_clusters_;
+  Deformers blend_shapes_;
+};
+
+#endif
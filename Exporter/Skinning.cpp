@@ -0,0 +1,244 @@
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include "Skinning.hpp"
+
+namespace
+{
+  const uint32_t kSkinsVersion = 1;
+
+  // Largest weight first, and the lowest joint first among equal weights, so the selection
+  // doesn't depend on the order Maya lists the influences in
+  bool heavier(const Influence& lhs, const Influence& rhs)
+  {
+    if (lhs.weight != rhs.weight) {
+      return lhs.weight > rhs.weight;
+    }
+    return lhs.bone_index < rhs.bone_index;
+  }
+
+  SkinWeights quantize(const Influences& influences)
+  {
+    SkinWeights res;
+    memset(&res, 0, sizeof(res));
+
+    Influences sorted;
+    for (size_t i = 0; i < influences.size(); ++i) {
+      if (influences[i].weight > 0) {
+        sorted.push_back(influences[i]);
+      }
+    }
+    const size_t count = std::min<size_t>(sorted.size(), kRdxMaxInfluences);
+    std::partial_sort(sorted.begin(), sorted.begin() + count, sorted.end(), heavier);
+
+    float total = 0;
+    for (size_t i = 0; i < count; ++i) {
+      total += sorted[i].weight;
+    }
+    if (total <= 0) {
+      return res;
+    }
+
+    // round each weight, and give the rounding error to the largest so they sum to 255
+    int sum = 0;
+    int quantized[kRdxMaxInfluences] = { 0 };
+    for (size_t i = 0; i < count; ++i) {
+      quantized[i] = (int)floorf(sorted[i].weight / total * 255 + 0.5f);
+      sum += quantized[i];
+    }
+    quantized[0] += 255 - sum;
+    for (size_t i = 0; i < count; ++i) {
+      if (quantized[i] > 0) {
+        res.joints[i] = sorted[i].bone_index;
+        res.weights[i] = (uint8_t)quantized[i];
+      }
+    }
+    return res;
+  }
+
+  uint32_t weight_index(const VertexBuffer& verts, const uint32_t vertex)
+  {
+    uint32_t idx;
+    memcpy(&idx, verts.vertex(vertex) + verts.format.skin_offset(), sizeof(idx));
+    return idx;
+  }
+
+  // Appends the joints of the triangle that aren't marked with the part yet, and marks them
+  void collect_joints(std::vector<uint32_t>& joints, std::vector<uint32_t>& marks, const uint32_t part,
+                      const VertexBuffer& super_verts, const uint32_t* tri, const std::vector<SkinWeights>& weights)
+  {
+    joints.clear();
+    for (int i = 0; i < 3; ++i) {
+      const SkinWeights& w = weights[weight_index(super_verts, tri[i])];
+      for (uint32_t j = 0; j < kRdxMaxInfluences; ++j) {
+        if (w.weights[j] && marks[w.joints[j]] != part) {
+          marks[w.joints[j]] = part;
+          joints.push_back(w.joints[j]);
+        }
+      }
+    }
+  }
+
+  void add_part(std::vector<SkinPart>& parts, SkinPart& part)
+  {
+    if (!part.indices.empty()) {
+      std::sort(part.palette.begin(), part.palette.end());
+      parts.push_back(part);
+    }
+    part.indices.clear();
+    part.palette.clear();
+  }
+}
+
+bool SkinWeights::operator<(const SkinWeights& rhs) const
+{
+  for (uint32_t i = 0; i < kRdxMaxInfluences; ++i) {
+    if (joints[i] != rhs.joints[i]) {
+      return joints[i] < rhs.joints[i];
+    }
+    if (weights[i] != rhs.weights[i]) {
+      return weights[i] < rhs.weights[i];
+    }
+  }
+  return false;
+}
+
+void quantize_skin_weights(std::vector<SkinWeights>& weights, IndexBuffer& point_weights,
+                           const ArenaVector<Influences>::Type& influences)
+{
+  weights.clear();
+  point_weights.resize(influences.size());
+  std::map<SkinWeights, uint32_t> indices;
+  for (size_t i = 0; i < influences.size(); ++i) {
+    const SkinWeights w(quantize(influences[i]));
+    std::map<SkinWeights, uint32_t>::iterator it = indices.find(w);
+    if (it == indices.end()) {
+      it = indices.insert(std::make_pair(w, (uint32_t)weights.size())).first;
+      weights.push_back(w);
+    }
+    point_weights[i] = it->second;
+  }
+}
+
+void split_skin_palettes(std::vector<SkinPart>& parts, const VertexBuffer& super_verts, const IndexBuffer& indices,
+                         const std::vector<SkinWeights>& weights, const uint32_t max_joints)
+{
+  parts.clear();
+  const uint32_t palette_size = std::min(std::max(max_joints, kMinPaletteJoints), kMaxPaletteJoints);
+  uint32_t joint_count = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    for (uint32_t j = 0; j < kRdxMaxInfluences; ++j) {
+      joint_count = std::max(joint_count, weights[i].joints[j] + 1);
+    }
+  }
+
+  // Each part takes the remaining triangles in order, skipping the ones whose joints don't fit
+  // it anymore, so it also picks up the later triangles within its joints. The skipped ones
+  // are left for the next parts
+  IndexBuffer remaining(indices.size() / 3);
+  for (uint32_t i = 0; i < remaining.size(); ++i) {
+    remaining[i] = i;
+  }
+  IndexBuffer skipped;
+
+  // marks[joint] is the number of the last part using the joint
+  std::vector<uint32_t> marks(joint_count, kRdxInvalidIndex);
+  std::vector<uint32_t> joints;
+  SkinPart part;
+  for (uint32_t part_number = 0; !remaining.empty(); ++part_number) {
+    skipped.clear();
+    for (size_t i = 0; i < remaining.size(); ++i) {
+      const uint32_t* tri = &indices[3 * remaining[i]];
+      collect_joints(joints, marks, part_number, super_verts, tri, weights);
+      if (part.palette.size() + joints.size() > palette_size) {
+        // unmark the joints the triangle would have added
+        for (size_t j = 0; j < joints.size(); ++j) {
+          marks[joints[j]] = kRdxInvalidIndex;
+        }
+        skipped.push_back(remaining[i]);
+        continue;
+      }
+      part.palette.insert(part.palette.end(), joints.begin(), joints.end());
+      part.indices.insert(part.indices.end(), tri, tri + 3);
+    }
+    add_part(parts, part);
+    remaining.swap(skipped);
+  }
+}
+
+void make_skin_part(VertexBuffer& part_verts, IndexBuffer& part_indices, IndexBuffer& part_sources,
+                    const VertexBuffer& super_verts, const SkinPart& part, const std::vector<SkinWeights>& weights)
+{
+  const uint32_t vertex_size = super_verts.format.vertex_size();
+  const uint32_t skin_offset = super_verts.format.skin_offset();
+  part_verts.format = super_verts.format;
+  part_verts.data.clear();
+  part_indices.clear();
+  part_sources.clear();
+
+  const uint32_t joint_count = part.palette.empty() ? 0 : part.palette.back() + 1;
+  std::vector<uint8_t> slots(joint_count, 0);
+  for (size_t i = 0; i < part.palette.size(); ++i) {
+    slots[part.palette[i]] = (uint8_t)i;
+  }
+
+  IndexBuffer new_index(super_verts.size(), kRdxInvalidIndex);
+  part_indices.reserve(part.indices.size());
+  for (size_t i = 0; i < part.indices.size(); ++i) {
+    const uint32_t src = part.indices[i];
+    if (new_index[src] == kRdxInvalidIndex) {
+      new_index[src] = (uint32_t)part_sources.size();
+      part_sources.push_back(src);
+
+      const float* vertex = super_verts.vertex(src);
+      part_verts.data.insert(part_verts.data.end(), vertex, vertex + vertex_size);
+      const SkinWeights& w = weights[weight_index(super_verts, src)];
+      uint8_t packed[2][kRdxMaxInfluences];
+      for (uint32_t j = 0; j < kRdxMaxInfluences; ++j) {
+        packed[0][j] = w.weights[j] ? slots[w.joints[j]] : 0;
+        packed[1][j] = w.weights[j];
+      }
+      memcpy(part_verts.vertex(new_index[src]) + skin_offset, packed, sizeof(packed));
+    }
+    part_indices.push_back(new_index[src]);
+  }
+}
+
+void convert_matrix(float out[4][4], const double in[4][4])
+{
+  // z is negated on the way in and on the way out, which flips the elements of the z row and
+  // column, but not the one they share
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      out[i][j] = (i == 2) != (j == 2) ? -(float)in[i][j] : (float)in[i][j];
+    }
+  }
+}
+
+void add_skin(Skins& skins, const uint32_t mesh, const SkinPart& part, const std::vector<RdxSkinJoint>& joints)
+{
+  RdxSkin skin;
+  skin.mesh = mesh;
+  skin.first_joint = (uint32_t)skins.joints.size();
+  skin.joint_count = (uint32_t)part.palette.size();
+  skin.reserved = 0;
+  skins.skins.push_back(skin);
+  for (size_t i = 0; i < part.palette.size(); ++i) {
+    skins.joints.push_back(joints[part.palette[i]]);
+  }
+}
+
+bool write_skins(RdxWriter& writer, const Skins& skins)
+{
+  return
+    writer.write_generic<uint32_t>(kSkinsVersion) &&
+    writer.write_generic<uint32_t>((uint32_t)skins.skins.size()) &&
+    (skins.skins.empty() || writer.write_raw_data((const uint8_t*)&skins.skins[0], (uint32_t)(skins.skins.size() * sizeof(RdxSkin)))) &&
+    writer.write_generic<uint32_t>((uint32_t)skins.joints.size()) &&
+    (skins.joints.empty() || writer.write_raw_data((const uint8_t*)&skins.joints[0], (uint32_t)(skins.joints.size() * sizeof(RdxSkinJoint))));
+}
+
+uint32_t skins_size(const Skins& skins)
+{
+  return (uint32_t)(3 * sizeof(uint32_t) + skins.skins.size() * sizeof(RdxSkin) + skins.joints.size() * sizeof(RdxSkinJoint));
+}
@@ -0,0 +1,96 @@
+#ifndef SKINNING_HPP
+#define SKINNING_HPP
+
+/**
+ * The skinned vertex format and bone palette splitting, see RdxSkin in Reader/RdxFormat.hpp.
+ * The influences of each Maya point are reduced to the kRdxMaxInfluences largest and quantized
+ * to unorm8 weights. While welding, the first skin word of a vertex holds the index of its
+ * point's quantized weights, so vertices only merge when their influences match. The welded
+ * triangles are then split into parts whose joints fit a palette, and each part's vertices get
+ * their skin words packed: palette indices in the first, weights in the second, a byte per
+ * influence. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "MeshProcessing.hpp"
+#include "RdxWriter.hpp"
+
+// The joints of a triangle always fit a palette
+const uint32_t kMinPaletteJoints = 3 * kRdxMaxInfluences;
+const uint32_t kMaxPaletteJoints = 256;
+
+struct Influence
+{
+  Influence(const uint32_t bone_index, const float weight) : bone_index(bone_index), weight(weight) {}
+  uint32_t  bone_index;
+  float     weight;
+};
+
+typedef ArenaVector<Influence>::Type Influences;
+
+// The largest influences of a point, largest first, with the weights summing to 255. Unused
+// slots have joint and weight 0
+struct SkinWeights
+{
+  bool operator<(const SkinWeights& rhs) const;
+  uint32_t joints[kRdxMaxInfluences];
+  uint8_t weights[kRdxMaxInfluences];
+};
+
+// A part of a skinned mesh, drawn with one palette
+struct SkinPart
+{
+  IndexBuffer indices;              // into the welded vertices
+  std::vector<uint32_t> palette;    // the joints used by the part, sorted
+};
+
+struct Skins
+{
+  std::vector<RdxSkin> skins;
+  std::vector<RdxSkinJoint> joints;
+};
+
+// Quantizes the influences of each point. point_weights receives the index of each point's
+// weights, and points with equal weights share one, so their vertices can be welded
+void quantize_skin_weights(std::vector<SkinWeights>& weights, IndexBuffer& point_weights,
+  const ArenaVector<Influences>::Type& influences);
+
+// Sets the first skin word of the candidate vertices to the weights of their point. Corners is
+// a vector of anything with a position_index member, as for gather_candidates
+template <class Corners>
+void gather_skin_weights(VertexBuffer& candidates, const Corners& corners, const IndexBuffer& point_weights)
+{
+  const uint32_t skin_offset = candidates.format.skin_offset();
+  for (size_t i = 0; i < corners.size(); ++i) {
+    const uint32_t point = corners[i].position_index;
+    const uint32_t words[2] = { point < point_weights.size() ? point_weights[point] : 0, 0 };
+    memcpy(candidates.vertex((uint32_t)i) + skin_offset, words, sizeof(words));
+  }
+}
+
+// Splits the triangles of indices, which refer to welded vertices holding weight indices, into
+// parts using at most max_joints joints. Each part takes the remaining triangles whose joints
+// still fit it, in order
+void split_skin_palettes(std::vector<SkinPart>& parts, const VertexBuffer& super_verts, const IndexBuffer& indices,
+  const std::vector<SkinWeights>& weights, const uint32_t max_joints);
+
+// Creates the vertex and index buffers of a part, with the vertices it uses in first use order
+// and their skin words packed for its palette. part_sources receives the welded vertex each of
+// the part's vertices was made from
+void make_skin_part(VertexBuffer& part_verts, IndexBuffer& part_indices, IndexBuffer& part_sources,
+  const VertexBuffer& super_verts, const SkinPart& part, const std::vector<SkinWeights>& weights);
+
+// Converts a Maya matrix, row major for row vectors, to the exporter's coordinate system
+void convert_matrix(float out[4][4], const double in[4][4]);
+
+// Adds the skin of a part, the name is the string index of its mesh and joints holds the mesh's
+// joints, indexed by the palette
+void add_skin(Skins& skins, const uint32_t mesh, const SkinPart& part, const std::vector<RdxSkinJoint>& joints);
+
+// [version, skin count, skins, joint count, joints]
+bool write_skins(RdxWriter& writer, const Skins& skins);
+uint32_t skins_size(const Skins& skins);
+
+#endif
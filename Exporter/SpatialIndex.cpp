@@ -0,0 +1,245 @@
+#include <float.h>
+#include <algorithm>
+#include "SpatialIndex.hpp"
+
+namespace
+{
+  const uint32_t kSpatialIndexVersion = 1;
+  const uint32_t kNumBins = 16;
+
+  struct BuildItem
+  {
+    Aabb box;
+    D3DXVECTOR3 centroid;
+    uint32_t id;
+  };
+
+  void clear_box(Aabb& box)
+  {
+    box.min = D3DXVECTOR3(FLT_MAX, FLT_MAX, FLT_MAX);
+    box.max = D3DXVECTOR3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  }
+
+  void grow_box(Aabb& box, const Aabb& other)
+  {
+    D3DXVec3Minimize(&box.min, &box.min, &other.min);
+    D3DXVec3Maximize(&box.max, &box.max, &other.max);
+  }
+
+  void grow_box(Aabb& box, const D3DXVECTOR3& point)
+  {
+    D3DXVec3Minimize(&box.min, &box.min, &point);
+    D3DXVec3Maximize(&box.max, &box.max, &point);
+  }
+
+  float half_area(const Aabb& box)
+  {
+    const D3DXVECTOR3 d(box.max - box.min);
+    return d.x < 0 ? 0 : d.x * d.y + d.y * d.z + d.z * d.x;
+  }
+
+  float half_area(const BvhNode& node)
+  {
+    const float dx = node.max[0] - node.min[0];
+    const float dy = node.max[1] - node.min[1];
+    const float dz = node.max[2] - node.min[2];
+    return dx * dy + dy * dz + dz * dx;
+  }
+
+  // Ties are broken by id, so the order doesn't depend on the standard library's sort
+  struct CentroidLess
+  {
+    CentroidLess(const int axis) : axis(axis) {}
+    bool operator()(const BuildItem& lhs, const BuildItem& rhs) const
+    {
+      if (lhs.centroid[axis] != rhs.centroid[axis]) {
+        return lhs.centroid[axis] < rhs.centroid[axis];
+      }
+      return lhs.id < rhs.id;
+    }
+    int axis;
+  };
+
+  struct InBin
+  {
+    InBin(const int axis, const float min, const float scale, const uint32_t last_bin)
+      : axis(axis), min(min), scale(scale), last_bin(last_bin) {}
+    bool operator()(const BuildItem& item) const
+    {
+      const uint32_t bin = std::min<uint32_t>((uint32_t)((item.centroid[axis] - min) * scale), kNumBins - 1);
+      return bin <= last_bin;
+    }
+    int axis;
+    float min;
+    float scale;
+    uint32_t last_bin;
+  };
+
+  class Builder
+  {
+  public:
+    Builder(std::vector<BvhNode>& nodes, std::vector<BuildItem>& items, const uint32_t max_leaf_size)
+      : nodes_(nodes), items_(items), max_leaf_size_(std::max<uint32_t>(max_leaf_size, 1)) {}
+
+    uint32_t build(const uint32_t begin, const uint32_t end)
+    {
+      Aabb box, centroids;
+      clear_box(box);
+      clear_box(centroids);
+      for (uint32_t i = begin; i < end; ++i) {
+        grow_box(box, items_[i].box);
+        grow_box(centroids, items_[i].centroid);
+      }
+
+      const uint32_t node_idx = (uint32_t)nodes_.size();
+      BvhNode node;
+      for (int i = 0; i < 3; ++i) {
+        node.min[i] = box.min[i];
+        node.max[i] = box.max[i];
+      }
+      node.offset = begin;
+      node.count = end - begin;
+      nodes_.push_back(node);
+      if (end - begin <= max_leaf_size_) {
+        return node_idx;
+      }
+
+      const uint32_t mid = split(begin, end, centroids);
+      build(begin, mid);
+      const uint32_t right = build(mid, end);
+      nodes_[node_idx].offset = right;
+      nodes_[node_idx].count = 0;
+      return node_idx;
+    }
+
+  private:
+    // Partitions the items along the longest centroid axis at the cheapest bin boundary
+    uint32_t split(const uint32_t begin, const uint32_t end, const Aabb& centroids)
+    {
+      const D3DXVECTOR3 extent(centroids.max - centroids.min);
+      const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+      const uint32_t median = begin + (end - begin) / 2;
+      if (extent[axis] <= 0) {
+        // all the centroids coincide, so any split is as good as another, but the items are
+        // put in id order to make it the same one every time
+        std::sort(items_.begin() + begin, items_.begin() + end, CentroidLess(axis));
+        return median;
+      }
+
+      Aabb bin_boxes[kNumBins];
+      uint32_t bin_counts[kNumBins] = { 0 };
+      for (uint32_t i = 0; i < kNumBins; ++i) {
+        clear_box(bin_boxes[i]);
+      }
+      const float min = centroids.min[axis];
+      const float scale = kNumBins / extent[axis];
+      for (uint32_t i = begin; i < end; ++i) {
+        const uint32_t bin = std::min<uint32_t>((uint32_t)((items_[i].centroid[axis] - min) * scale), kNumBins - 1);
+        grow_box(bin_boxes[bin], items_[i].box);
+        ++bin_counts[bin];
+      }
+
+      // sweep from the right to get the cost of everything right of each boundary
+      float right_cost[kNumBins];
+      Aabb acc;
+      clear_box(acc);
+      uint32_t count = 0;
+      for (uint32_t i = kNumBins - 1; i > 0; --i) {
+        grow_box(acc, bin_boxes[i]);
+        count += bin_counts[i];
+        right_cost[i] = half_area(acc) * count;
+      }
+
+      clear_box(acc);
+      count = 0;
+      float best_cost = FLT_MAX;
+      uint32_t best_bin = 0;
+      for (uint32_t i = 0; i < kNumBins - 1; ++i) {
+        grow_box(acc, bin_boxes[i]);
+        count += bin_counts[i];
+        const float cost = half_area(acc) * count + right_cost[i + 1];
+        if (count > 0 && count < end - begin && cost < best_cost) {
+          best_cost = cost;
+          best_bin = i;
+        }
+      }
+
+      // stable, so the leaves list their items in an order that only depends on the bounds
+      const uint32_t mid = (uint32_t)(std::stable_partition(items_.begin() + begin, items_.begin() + end,
+        InBin(axis, min, scale, best_bin)) - items_.begin());
+      if (mid == begin || mid == end) {
+        std::sort(items_.begin() + begin, items_.begin() + end, CentroidLess(axis));
+        return median;
+      }
+      return mid;
+    }
+
+    std::vector<BvhNode>& nodes_;
+    std::vector<BuildItem>& items_;
+    const uint32_t max_leaf_size_;
+  };
+}
+
+void SpatialIndex::build(const std::vector<Aabb>& bounds, const uint32_t max_leaf_size)
+{
+  nodes.clear();
+  items.clear();
+  if (bounds.empty()) {
+    return;
+  }
+
+  std::vector<BuildItem> build_items(bounds.size());
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    build_items[i].box = bounds[i];
+    build_items[i].centroid = 0.5f * (bounds[i].min + bounds[i].max);
+    build_items[i].id = (uint32_t)i;
+  }
+
+  // a binary tree with at least one item per leaf
+  nodes.reserve(2 * bounds.size() - 1);
+  Builder builder(nodes, build_items, max_leaf_size);
+  builder.build(0, (uint32_t)build_items.size());
+
+  items.resize(build_items.size());
+  for (size_t i = 0; i < build_items.size(); ++i) {
+    items[i] = build_items[i].id;
+  }
+}
+
+void SpatialIndex::remap_items(const std::vector<uint32_t>& new_ids)
+{
+  for (size_t i = 0; i < items.size(); ++i) {
+    items[i] = new_ids[items[i]];
+  }
+}
+
+float SpatialIndex::sah_cost() const
+{
+  if (nodes.empty()) {
+    return 0;
+  }
+  const float root_area = half_area(nodes[0]);
+  if (root_area <= 0) {
+    return 1;
+  }
+  float cost = 0;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    cost += half_area(nodes[i]) / root_area * (nodes[i].count > 0 ? nodes[i].count : 1);
+  }
+  return cost;
+}
+
+bool SpatialIndex::write(RdxWriter& writer) const
+{
+  return
+    writer.write_generic<uint32_t>(kSpatialIndexVersion) &&
+    writer.write_generic<uint32_t>((uint32_t)nodes.size()) &&
+    writer.write_generic<uint32_t>((uint32_t)items.size()) &&
+    (nodes.empty() || writer.write_raw_data((const uint8_t*)&nodes[0], (uint32_t)(nodes.size() * sizeof(BvhNode)))) &&
+    (items.empty() || writer.write_raw_data((const uint8_t*)&items[0], (uint32_t)(items.size() * sizeof(uint32_t))));
+}
+
+uint32_t SpatialIndex::serialized_size() const
+{
+  return (uint32_t)(3 * sizeof(uint32_t) + nodes.size() * sizeof(BvhNode) + items.size() * sizeof(uint32_t));
+}
@@ -0,0 +1,41 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+/**
+ * BVH over the exported mesh bounds, written as the SpatialIndex chunk so a loader doesn't
+ * have to build one. The tree is built top down with binned SAH splits, and the nodes are
+ * stored depth first. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "Bounds.hpp"
+#include "RdxWriter.hpp"
+
+// The node layout is part of the file format
+typedef RdxBvhNode BvhNode;
+
+class SpatialIndex
+{
+public:
+  static const uint32_t kDefaultLeafSize = 4;
+
+  // Item i of the index is bounds[i]
+  void build(const std::vector<Aabb>& bounds, const uint32_t max_leaf_size = kDefaultLeafSize);
+
+  // Replaces the item ids, for when the items are written in leaf order
+  void remap_items(const std::vector<uint32_t>& new_ids);
+
+  // The expected number of node and item tests for a ray through the root bounds, the usual
+  // measure of a BVH's quality
+  float sah_cost() const;
+
+  // [version, node count, item count, nodes[node count], items[item count]]
+  bool write(RdxWriter& writer) const;
+  uint32_t serialized_size() const;
+
+  std::vector<BvhNode> nodes;
+  std::vector<uint32_t> items;    // item ids in leaf order
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <math.h>
+#include <float.h>
+#include <map>
+#include "StreamingCells.hpp"
+#include "SpatialIndex.hpp"
+
+namespace
+{
+  const uint32_t kCellManifestVersion = 1;
+
+  typedef std::pair<int32_t, int32_t> CellKey;    // z, x so the map is in manifest order
+
+  int32_t cell_coord(const float value, const float cell_size)
+  {
+    return (int32_t)floorf(value / cell_size);
+  }
+
+  bool write_cell(RdxWriter& writer, RdxAabb& cell_bounds, const StreamingCell& cell, const std::vector<Aabb>& bounds,
+                  const RdxWriter& src, const std::vector<uint32_t>& mesh_chunks)
+  {
+    std::vector<Aabb> cell_boxes(cell.meshes.size());
+    Aabb total;
+    total.min = D3DXVECTOR3(FLT_MAX, FLT_MAX, FLT_MAX);
+    total.max = D3DXVECTOR3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (size_t i = 0; i < cell.meshes.size(); ++i) {
+      cell_boxes[i] = bounds[cell.meshes[i]];
+      D3DXVec3Minimize(&total.min, &total.min, &cell_boxes[i].min);
+      D3DXVec3Maximize(&total.max, &total.max, &cell_boxes[i].max);
+    }
+    for (int i = 0; i < 3; ++i) {
+      cell_bounds.min[i] = total.min[i];
+      cell_bounds.max[i] = total.max[i];
+    }
+
+    // the meshes are written in leaf order, so the index refers to them in file order
+    SpatialIndex index;
+    index.build(cell_boxes);
+    std::vector<uint32_t> new_ids(index.items.size());
+    for (size_t i = 0; i < index.items.size(); ++i) {
+      const uint32_t chunk = mesh_chunks[cell.meshes[index.items[i]]];
+      new_ids[index.items[i]] = (uint32_t)i;
+      SCOPED_RDX_CHUNK(writer, RdxChunkId::Mesh);
+      if (!writer.write_raw_data(src.chunk_data(chunk), src.chunk_entry(chunk).size)) {
+        return false;
+      }
+    }
+    index.remap_items(new_ids);
+
+    SCOPED_RDX_CHUNK(writer, RdxChunkId::SpatialIndex);
+    return index.write(writer);
+  }
+}
+
+void CellPartition::build(const std::vector<Aabb>& bounds, const float size)
+{
+  cell_size = size;
+  cells.clear();
+  shared.clear();
+
+  std::map<CellKey, uint32_t> cell_map;
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    const Aabb& box = bounds[i];
+    if (box.max.x - box.min.x > cell_size || box.max.z - box.min.z > cell_size) {
+      shared.push_back((uint32_t)i);
+      continue;
+    }
+    const CellKey key(cell_coord(0.5f * (box.min.z + box.max.z), cell_size), cell_coord(0.5f * (box.min.x + box.max.x), cell_size));
+    std::map<CellKey, uint32_t>::iterator it = cell_map.find(key);
+    if (it == cell_map.end()) {
+      it = cell_map.insert(std::make_pair(key, (uint32_t)cell_map.size())).first;
+      cells.push_back(StreamingCell());
+      cells.back().x = key.second;
+      cells.back().z = key.first;
+    }
+    cells[it->second].meshes.push_back((uint32_t)i);
+  }
+
+  // put the cells in manifest order
+  std::vector<StreamingCell> sorted(cells.size());
+  uint32_t idx = 0;
+  for (std::map<CellKey, uint32_t>::const_iterator it = cell_map.begin(); it != cell_map.end(); ++it, ++idx) {
+    sorted[idx].x = cells[it->second].x;
+    sorted[idx].z = cells[it->second].z;
+    sorted[idx].meshes.swap(cells[it->second].meshes);
+  }
+  cells.swap(sorted);
+}
+
+bool write_cell_pack(std::vector<uint8_t>& pack, std::vector<RdxCell>& manifest, const CellPartition& partition,
+                     const std::vector<Aabb>& bounds, const RdxWriter& src, const std::vector<uint32_t>& mesh_chunks,
+                     const uint32_t block_size)
+{
+  manifest.resize(partition.cells.size());
+  RdxWriter writer;
+  for (size_t i = 0; i < partition.cells.size(); ++i) {
+    const StreamingCell& cell = partition.cells[i];
+    RdxCell& entry = manifest[i];
+    writer.init_writer(block_size);
+    if (!write_cell(writer, entry.bounds, cell, bounds, src, mesh_chunks) || !writer.end_of_data()) {
+      return false;
+    }
+
+    uint8_t* buf = NULL;
+    uint32_t len = 0;
+    writer.get_buffer(buf, len);
+    pack.resize((pack.size() + kRdxCellAlignment - 1) & ~(size_t)(kRdxCellAlignment - 1), 0);
+    entry.x = cell.x;
+    entry.z = cell.z;
+    entry.mesh_count = (uint32_t)cell.meshes.size();
+    entry.size = len;
+    entry.offset = pack.size();
+    pack.insert(pack.end(), buf, buf + len);
+  }
+  return true;
+}
+
+bool write_cell_manifest(RdxWriter& writer, const float cell_size, const uint32_t pack_name,
+                         const std::vector<RdxCell>& manifest)
+{
+  return
+    writer.write_generic<uint32_t>(kCellManifestVersion) &&
+    writer.write_generic<float>(cell_size) &&
+    writer.write_generic<uint32_t>(pack_name) &&
+    writer.write_generic<uint32_t>((uint32_t)manifest.size()) &&
+    (manifest.empty() || writer.write_raw_data((const uint8_t*)&manifest[0], (uint32_t)(manifest.size() * sizeof(RdxCell))));
+}
+
+uint32_t cell_manifest_size(const std::vector<RdxCell>& manifest)
+{
+  return (uint32_t)(4 * sizeof(uint32_t) + manifest.size() * sizeof(RdxCell));
+}
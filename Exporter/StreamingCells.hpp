@@ -0,0 +1,47 @@
+#ifndef STREAMING_CELLS_HPP
+#define STREAMING_CELLS_HPP
+
+/**
+ * Streaming export: the meshes are split into square cells on the xz plane, and each cell is
+ * written as its own .rdx file into a pack that the runtime streams from. The layout is
+ * described with RdxCell in Reader/RdxFormat.hpp. Doesn't depend on Maya or stdafx.h.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "Bounds.hpp"
+#include "RdxWriter.hpp"
+
+struct StreamingCell
+{
+  int32_t x;
+  int32_t z;
+  std::vector<uint32_t> meshes;
+};
+
+class CellPartition
+{
+public:
+  CellPartition() : cell_size(0) {}
+
+  // Meshes wider than a cell go to the shared list, the others to the cell of their center
+  void build(const std::vector<Aabb>& bounds, const float size);
+
+  float cell_size;
+  std::vector<StreamingCell> cells;   // ordered by z, then x
+  std::vector<uint32_t> shared;
+};
+
+// Copies the Mesh chunks of each cell from src into an .rdx file, in the leaf order of a
+// SpatialIndex chunk over them, and appends the files to the pack. mesh_chunks[i] is the
+// chunk of mesh i in src.
+bool write_cell_pack(std::vector<uint8_t>& pack, std::vector<RdxCell>& manifest, const CellPartition& partition,
+  const std::vector<Aabb>& bounds, const RdxWriter& src, const std::vector<uint32_t>& mesh_chunks,
+  const uint32_t block_size);
+
+// [version, cell size, pack name, cell count, cells[cell count]]
+bool write_cell_manifest(RdxWriter& writer, const float cell_size, const uint32_t pack_name,
+  const std::vector<RdxCell>& manifest);
+uint32_t cell_manifest_size(const std::vector<RdxCell>& manifest);
+
+#endif
@@ -0,0 +1,97 @@
+#include <string.h>
+#include "StringTable.hpp"
+
+namespace
+{
+  const uint32_t kStringTableVersion = 1;
+}
+
+StringTable::StringTable()
+  : hash_collisions_(0)
+{
+}
+
+uint32_t StringTable::hash(const char* str, const size_t len)
+{
+  uint32_t res = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    res ^= (uint8_t)str[i];
+    res *= 16777619u;
+  }
+  return res;
+}
+
+uint32_t StringTable::intern(const std::string& str)
+{
+  StringIndices::iterator it = indices_.find(str);
+  if (it != indices_.end()) {
+    return it->second;
+  }
+
+  // intern the parent path first, so it gets shared by all its children
+  Entry entry;
+  entry.prefix = kInvalidIndex;
+  size_t suffix_start = 0;
+  const size_t separator = str.rfind('|');
+  if (separator != std::string::npos && separator > 0) {
+    entry.prefix = intern(str.substr(0, separator));
+    suffix_start = separator;
+  }
+
+  entry.suffix_offset = (uint32_t)chars_.size();
+  entry.length = (uint32_t)str.size();
+  entry.hash = hash(str.c_str(), str.size());
+  chars_.insert(chars_.end(), str.begin() + suffix_start, str.end());
+  chars_.push_back(0);
+
+  const uint32_t idx = (uint32_t)strings_.size();
+  HashIndices::iterator hash_it = hashes_.find(entry.hash);
+  if (hash_it != hashes_.end()) {
+    ++hash_collisions_;
+  } else {
+    hashes_.insert(std::make_pair(entry.hash, idx));
+  }
+
+  strings_.push_back(str);
+  entries_.push_back(entry);
+  indices_.insert(std::make_pair(str, idx));
+  return idx;
+}
+
+bool StringTable::write(RdxWriter& writer) const
+{
+  return
+    writer.write_generic<uint32_t>(kStringTableVersion) &&
+    writer.write_generic<uint32_t>(size()) &&
+    (entries_.empty() || writer.write_raw_data((const uint8_t*)&entries_[0], (uint32_t)(entries_.size() * sizeof(Entry)))) &&
+    writer.write_generic<uint32_t>((uint32_t)chars_.size()) &&
+    (chars_.empty() || writer.write_raw_data((const uint8_t*)&chars_[0], (uint32_t)chars_.size()));
+}
+
+uint32_t StringTable::serialized_size() const
+{
+  return (uint32_t)(3 * sizeof(uint32_t) + entries_.size() * sizeof(Entry) + chars_.size());
+}
+
+std::string make_unique_name(std::set<std::string>& names, const std::string& candidate)
+{
+  std::string name(candidate);
+  while (names.find(name) != names.end()) {
+    name += "a";
+  }
+  names.insert(name);
+  return name;
+}
+
+std::string sanitize_name(const std::string& input)
+{
+  std::string output(input);
+  const char invalid_tokens[] = ":/ ";
+  const char valid_token = '_';
+  for (size_t i = 0; i < input.length(); ++i) {
+    if (strchr(invalid_tokens, input[i])) {
+      output[i] = valid_token;
+    }
+  }
+  return output;
+}
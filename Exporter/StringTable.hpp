@@ -0,0 +1,60 @@
+#ifndef STRING_TABLE_HPP
+#define STRING_TABLE_HPP
+
+/**
+ * Scene wide table of the names written to the chunk stream. Every name is interned once and
+ * the other chunks refer to it by index. Names are stored as a prefix (another entry) plus a
+ * suffix, split at the last '|', so the DAG paths of deep hierarchies share their parent
+ * paths. A 32 bit FNV-1a hash of each full name is precomputed, so a loader can look names
+ * up without string compares.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "RdxWriter.hpp"
+
+class StringTable
+{
+public:
+  static const uint32_t kInvalidIndex = 0xffffffff;
+
+  StringTable();
+
+  uint32_t intern(const std::string& str);
+  const std::string& get(const uint32_t idx) const { return strings_[idx]; }
+  uint32_t size() const { return (uint32_t)strings_.size(); }
+
+  // Number of names that have the same hash as an earlier, different name
+  uint32_t hash_collisions() const { return hash_collisions_; }
+
+  // [version, count, entries[count], char count, chars], see Entry
+  bool write(RdxWriter& writer) const;
+  uint32_t serialized_size() const;
+
+  static uint32_t hash(const char* str, const size_t len);
+
+private:
+  // The suffix is stored in the char data, and is zero terminated
+  typedef RdxStringEntry Entry;
+
+  typedef std::map<std::string, uint32_t> StringIndices;
+  typedef std::map<uint32_t, uint32_t> HashIndices;
+  StringIndices indices_;
+  HashIndices hashes_;
+  std::vector<std::string> strings_;
+  std::vector<Entry> entries_;
+  std::vector<char> chars_;
+  uint32_t hash_collisions_;
+};
+
+// Appends "a" to the candidate until it isn't in names, and adds the result to them. The names
+// belong to one export, so the same scene gets the same names every time
+std::string make_unique_name(std::set<std::string>& names, const std::string& candidate);
+
+// Replaces the characters that aren't allowed in exported names with '_'
+std::string sanitize_name(const std::string& input);
+
+#endif
@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "TextureExporter.hpp"
+#include "TextureProcessing.hpp"
+#include "DependencyManifest.hpp"
+#include "Profiler.hpp"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace
+{
+  const char* kTextureDir = "textures";
+  const uint32_t kHashThreads = 4;
+  // Images decoded before they are handed to the worker threads, which bounds the memory
+  // held by the decoded images
+  const uint32_t kDecodeBatch = 8;
+
+  struct TextureKey
+  {
+    uint64_t content_hash;
+    uint32_t texture_mode;
+    uint32_t kaiser_mips;
+  };
+
+  string texture_name(const uint64_t key)
+  {
+    char buf[32];
+    sprintf_s(buf, sizeof(buf), "%08x%08x.rtx", (uint32_t)(key >> 32), (uint32_t)key);
+    return buf;
+  }
+
+  // Maya decodes the image, so this has to run on the main thread
+  bool decode_image(TextureImage& image, const string& filename)
+  {
+    MImage maya_image;
+    if (maya_image.readFromFile(filename.c_str()) != MS::kSuccess || maya_image.pixelType() != MImage::kByte ||
+      maya_image.depth() != 4) {
+      return false;
+    }
+    unsigned int width = 0, height = 0;
+    maya_image.getSize(width, height);
+    const uint8_t* pixels = maya_image.pixels();
+    if (!pixels || width == 0 || height == 0) {
+      return false;
+    }
+    // Maya stores the rows bottom up
+    image.width = width;
+    image.height = height;
+    image.rgba.resize(width * height * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+      memcpy(&image.rgba[y * width * 4], &pixels[(height - 1 - y) * width * 4], width * 4);
+    }
+    return true;
+  }
+}
+
+MStatus export_textures(SceneDescription& scene, const string& output_dir, const ExporterSettings& settings)
+{
+  PROFILE_SCOPE("textures");
+
+  // the unique source images, and the materials using them
+  map<string, vector<uint32_t> > materials_by_texture;
+  for (size_t i = 0; i < scene.materials.size(); ++i) {
+    if (scene.materials[i].texture != StringTable::kInvalidIndex) {
+      materials_by_texture[scene.strings.get(scene.materials[i].texture)].push_back((uint32_t)i);
+    }
+  }
+  if (materials_by_texture.empty()) {
+    return MS::kSuccess;
+  }
+
+  vector<string> sources;
+  for (map<string, vector<uint32_t> >::iterator it = materials_by_texture.begin(); it != materials_by_texture.end(); ++it) {
+    sources.push_back(it->first);
+  }
+  vector<uint64_t> content_hashes;
+  {
+    PROFILE_SCOPE("textures/hash");
+    hash_files(content_hashes, sources, kHashThreads);
+  }
+
+  const fs::path cache_dir(fs::path(output_dir) / kTextureDir);
+  if (!CreateDirectoryA(cache_dir.string().c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+    cout << "Unable to create the texture cache " << cache_dir.string() << endl;
+    return MS::kFailure;
+  }
+
+  // images with the same contents under different paths are processed once
+  map<uint64_t, string> source_by_key;
+  map<string, uint64_t> key_by_source;
+  for (size_t i = 0; i < sources.size(); ++i) {
+    if (content_hashes[i] == kMissingFileHash) {
+      cout << "Warning: can't read texture " << sources[i] << endl;
+      continue;
+    }
+    TextureKey key;
+    key.content_hash = content_hashes[i];
+    key.texture_mode = settings.texture_mode;
+    key.kaiser_mips = settings.kaiser_mips;
+    const uint64_t hash = hash_bytes(&key, sizeof(key), 0);
+    key_by_source[sources[i]] = hash;
+    source_by_key.insert(make_pair(hash, sources[i]));
+  }
+
+  vector<uint64_t> pending;
+  uint32_t cache_hits = 0;
+  for (map<uint64_t, string>::iterator it = source_by_key.begin(); it != source_by_key.end(); ++it) {
+    if (GetFileAttributesA((cache_dir / texture_name(it->first)).string().c_str()) != INVALID_FILE_ATTRIBUTES) {
+      ++cache_hits;
+    } else {
+      pending.push_back(it->first);
+    }
+  }
+
+  // Maya isn't thread safe, so the images are decoded on this thread, and the mips and the
+  // compression done by the workers
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const TextureFilter::Enum filter = settings.kaiser_mips ? TextureFilter::kKaiser : TextureFilter::kBox;
+  set<uint64_t> failed;
+  for (size_t start = 0; start < pending.size(); start += kDecodeBatch) {
+    const size_t end = min<size_t>(start + kDecodeBatch, pending.size());
+    vector<TextureJob> jobs;
+    vector<uint64_t> job_keys;
+    {
+      PROFILE_SCOPE("textures/decode");
+      for (size_t i = start; i < end; ++i) {
+        jobs.push_back(TextureJob());
+        const string& source = source_by_key[pending[i]];
+        if (!decode_image(jobs.back().image, source)) {
+          cout << "Warning: can't decode texture " << source << endl;
+          jobs.pop_back();
+          failed.insert(pending[i]);
+          continue;
+        }
+        jobs.back().filename = (cache_dir / texture_name(pending[i])).string();
+        job_keys.push_back(pending[i]);
+      }
+    }
+    {
+      PROFILE_SCOPE("textures/process");
+      process_textures(jobs, filter, settings.texture_mode == 1, info.dwNumberOfProcessors);
+    }
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      if (!jobs[i].ok) {
+        cout << "Warning: can't write texture " << jobs[i].filename << endl;
+        failed.insert(job_keys[i]);
+      }
+    }
+  }
+
+  for (map<string, uint64_t>::iterator it = key_by_source.begin(); it != key_by_source.end(); ++it) {
+    if (failed.count(it->second)) {
+      continue;
+    }
+    const uint32_t name = scene.strings.intern(string(kTextureDir) + "/" + texture_name(it->second));
+    const vector<uint32_t>& materials = materials_by_texture[it->first];
+    for (size_t i = 0; i < materials.size(); ++i) {
+      scene.materials[materials[i]].processed_texture = name;
+    }
+  }
+
+  PROFILE_COUNTER("textures/sources", sources.size());
+  PROFILE_COUNTER("textures/unique", source_by_key.size());
+  PROFILE_COUNTER("textures/cache_hits", cache_hits);
+  PROFILE_COUNTER("textures/processed", pending.size() - failed.size());
+  return MS::kSuccess;
+}
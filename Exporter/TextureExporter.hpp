@@ -0,0 +1,17 @@
+#ifndef TEXTURE_EXPORTER_HPP
+#define TEXTURE_EXPORTER_HPP
+
+/**
+ * Processes the textures the materials of the scene use into .rtx files (see
+ * TextureProcessing.hpp), in the "textures" directory next to the output. The files are
+ * named by the hash of the image contents and the settings, so each image is processed once
+ * however many materials use it, and the ones already in the cache from earlier exports are
+ * reused. Sets the processed_texture of the materials to the path relative to the output.
+ */
+
+#include "SceneDescription.hpp"
+#include "../Stub/exporter_settings.hpp"
+
+MStatus export_textures(SceneDescription& scene, const std::string& output_dir, const ExporterSettings& settings);
+
+#endif
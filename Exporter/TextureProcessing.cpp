@@ -0,0 +1,552 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <emmintrin.h>
+#include "TextureProcessing.hpp"
+#include "ParallelFor.hpp"
+#include "../Reader/RdxFormat.hpp"
+#include "../Reader/RdxTexture.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+  const float kKaiserRadius = 3;      // in destination texels
+  const float kKaiserAlpha = 4;
+  const uint32_t kLinearToSrgbSize = 16384;
+
+  // sRGB <-> linear tables for the Kaiser filter
+  struct SrgbTables
+  {
+    SrgbTables()
+    {
+      for (uint32_t i = 0; i < 256; ++i) {
+        const float c = i / 255.0f;
+        to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+      }
+      for (uint32_t i = 0; i < kLinearToSrgbSize; ++i) {
+        const float l = (i + 0.5f) / kLinearToSrgbSize;
+        const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1 / 2.4f) - 0.055f;
+        to_srgb[i] = (uint8_t)(c * 255 + 0.5f);
+      }
+    }
+
+    float to_linear[256];
+    uint8_t to_srgb[kLinearToSrgbSize];
+  };
+  const SrgbTables kSrgb;
+
+  uint8_t linear_to_srgb(const float l)
+  {
+    return kSrgb.to_srgb[std::min<int>(std::max<int>((int)(l * kLinearToSrgbSize), 0), kLinearToSrgbSize - 1)];
+  }
+
+  uint8_t to_byte(const float v)
+  {
+    return (uint8_t)std::min<int>(std::max<int>((int)(v * 255 + 0.5f), 0), 255);
+  }
+
+  float bessel_i0(const float x)
+  {
+    float sum = 1, term = 1;
+    for (int k = 1; k < 20; ++k) {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  float kaiser_sinc(const float x)
+  {
+    const float t = x / kKaiserRadius;
+    if (fabsf(t) >= 1) {
+      return 0;
+    }
+    const float sinc = x == 0 ? 1 : sinf(3.14159265f * x) / (3.14159265f * x);
+    return sinc * bessel_i0(kKaiserAlpha * sqrtf(1 - t * t)) / bessel_i0(kKaiserAlpha);
+  }
+
+  // The source texels and weights of each destination texel, with clamped addressing
+  struct FilterTaps
+  {
+    void build(const uint32_t src_size, const uint32_t dst_size)
+    {
+      const float scale = (float)src_size / dst_size;
+      const float radius = src_size == dst_size ? 0.5f : kKaiserRadius * scale;
+      tap_count = (uint32_t)ceilf(2 * radius) + 1;
+      indices.resize(dst_size * tap_count);
+      weights.resize(dst_size * tap_count);
+      for (uint32_t i = 0; i < dst_size; ++i) {
+        const float center = (i + 0.5f) * scale;
+        const int first = (int)floorf(center - radius);
+        float sum = 0;
+        for (uint32_t k = 0; k < tap_count; ++k) {
+          const int src = first + (int)k;
+          const float w = src_size == dst_size ? (src == (int)i ? 1.0f : 0.0f) : kaiser_sinc((src + 0.5f - center) / scale);
+          indices[i * tap_count + k] = (uint32_t)std::min<int>(std::max<int>(src, 0), src_size - 1);
+          weights[i * tap_count + k] = w;
+          sum += w;
+        }
+        for (uint32_t k = 0; k < tap_count; ++k) {
+          weights[i * tap_count + k] /= sum;
+        }
+      }
+    }
+
+    uint32_t tap_count;
+    std::vector<uint32_t> indices;
+    std::vector<float> weights;
+  };
+
+  // Expands the endpoint like the decoder does
+  void decode_palette_color(float* rgb, const uint16_t c)
+  {
+    const uint32_t r = (c >> 11) & 31;
+    const uint32_t g = (c >> 5) & 63;
+    const uint32_t b = c & 31;
+    rgb[0] = (float)((r << 3) | (r >> 2));
+    rgb[1] = (float)((g << 2) | (g >> 4));
+    rgb[2] = (float)((b << 3) | (b >> 2));
+  }
+
+  uint16_t to_565(const float* rgb)
+  {
+    const int r = std::min<int>(std::max<int>((int)(rgb[0] * 31 / 255 + 0.5f), 0), 31);
+    const int g = std::min<int>(std::max<int>((int)(rgb[1] * 63 / 255 + 0.5f), 0), 63);
+    const int b = std::min<int>(std::max<int>((int)(rgb[2] * 31 / 255 + 0.5f), 0), 31);
+    return (uint16_t)(r << 11 | g << 5 | b);
+  }
+
+  // Picks the nearest four color mode palette entry for each pixel, and returns the error
+  float select_color_indices(uint32_t& indices, const uint8_t* rgba, const uint16_t c0, const uint16_t c1)
+  {
+    float palette[4][3];
+    decode_palette_color(palette[0], c0);
+    decode_palette_color(palette[1], c1);
+    for (int i = 0; i < 3; ++i) {
+      palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+      palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+    }
+    indices = 0;
+    float error = 0;
+    for (int p = 0; p < 16; ++p) {
+      float best = 1e30f;
+      uint32_t best_idx = 0;
+      for (uint32_t k = 0; k < 4; ++k) {
+        const float dr = rgba[4 * p + 0] - palette[k][0];
+        const float dg = rgba[4 * p + 1] - palette[k][1];
+        const float db = rgba[4 * p + 2] - palette[k][2];
+        const float d = dr * dr + dg * dg + db * db;
+        if (d < best) {
+          best = d;
+          best_idx = k;
+        }
+      }
+      indices |= best_idx << (2 * p);
+      error += best;
+    }
+    return error;
+  }
+
+  void write_color_block(uint8_t* block, uint16_t c0, uint16_t c1, uint32_t indices)
+  {
+    if (c0 == c1) {
+      // BC1 decodes equal endpoints in the three color mode, where index 3 is transparent
+      indices = 0;
+    } else if (c0 < c1) {
+      // the four color mode needs c0 > c1, swapping the endpoints swaps indices 0-1 and 2-3
+      std::swap(c0, c1);
+      indices ^= 0x55555555;
+    }
+    block[0] = (uint8_t)c0;
+    block[1] = (uint8_t)(c0 >> 8);
+    block[2] = (uint8_t)c1;
+    block[3] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+      block[4 + i] = (uint8_t)(indices >> (8 * i));
+    }
+  }
+
+  // Endpoints from the extremes along the principal axis of the colors, inset a bit, then
+  // refined once with a least squares fit to the chosen indices
+  void encode_color_block(uint8_t* block, const uint8_t* rgba)
+  {
+    float mean[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; ++p) {
+      for (int i = 0; i < 3; ++i) {
+        mean[i] += rgba[4 * p + i] / 16.0f;
+      }
+    }
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int p = 0; p < 16; ++p) {
+      const float r = rgba[4 * p + 0] - mean[0];
+      const float g = rgba[4 * p + 1] - mean[1];
+      const float b = rgba[4 * p + 2] - mean[2];
+      cov[0] += r * r;
+      cov[1] += r * g;
+      cov[2] += r * b;
+      cov[3] += g * g;
+      cov[4] += g * b;
+      cov[5] += b * b;
+    }
+    float axis[3] = { 0.9f, 1.0f, 0.7f };
+    for (int iter = 0; iter < 4; ++iter) {
+      const float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+      const float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+      const float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+      const float len = std::max<float>(fabsf(x), std::max<float>(fabsf(y), fabsf(z)));
+      if (len < 1e-6f) {
+        break;
+      }
+      axis[0] = x / len;
+      axis[1] = y / len;
+      axis[2] = z / len;
+    }
+
+    float min_proj = 1e30f, max_proj = -1e30f;
+    int min_p = 0, max_p = 0;
+    for (int p = 0; p < 16; ++p) {
+      const float proj = rgba[4 * p + 0] * axis[0] + rgba[4 * p + 1] * axis[1] + rgba[4 * p + 2] * axis[2];
+      if (proj < min_proj) {
+        min_proj = proj;
+        min_p = p;
+      }
+      if (proj > max_proj) {
+        max_proj = proj;
+        max_p = p;
+      }
+    }
+    float hi[3], lo[3];
+    for (int i = 0; i < 3; ++i) {
+      const float inset = (rgba[4 * max_p + i] - rgba[4 * min_p + i]) / 16.0f;
+      hi[i] = rgba[4 * max_p + i] - inset;
+      lo[i] = rgba[4 * min_p + i] + inset;
+    }
+    uint16_t c0 = to_565(hi), c1 = to_565(lo);
+    uint32_t indices;
+    float error = select_color_indices(indices, rgba, c0, c1);
+
+    // least squares endpoints for the indices: each pixel is a * c0 + b * c1
+    const float kA[4] = { 1, 0, 2 / 3.0f, 1 / 3.0f };
+    float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; ++p) {
+      const float a = kA[(indices >> (2 * p)) & 3];
+      const float b = 1 - a;
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      for (int i = 0; i < 3; ++i) {
+        ax[i] += a * rgba[4 * p + i];
+        bx[i] += b * rgba[4 * p + i];
+      }
+    }
+    const float det = aa * bb - ab * ab;
+    if (fabsf(det) > 1e-6f) {
+      for (int i = 0; i < 3; ++i) {
+        hi[i] = (ax[i] * bb - bx[i] * ab) / det;
+        lo[i] = (bx[i] * aa - ax[i] * ab) / det;
+      }
+      const uint16_t r0 = to_565(hi), r1 = to_565(lo);
+      uint32_t refit_indices;
+      const float refit_error = select_color_indices(refit_indices, rgba, r0, r1);
+      if (refit_error < error) {
+        c0 = r0;
+        c1 = r1;
+        indices = refit_indices;
+      }
+    }
+    write_color_block(block, c0, c1, indices);
+  }
+
+  void encode_alpha_block(uint8_t* block, const uint8_t* rgba)
+  {
+    uint32_t a0 = 0, a1 = 255;
+    for (int p = 0; p < 16; ++p) {
+      a0 = std::max<uint32_t>(a0, rgba[4 * p + 3]);
+      a1 = std::min<uint32_t>(a1, rgba[4 * p + 3]);
+    }
+    block[0] = (uint8_t)a0;
+    block[1] = (uint8_t)a1;
+    uint64_t indices = 0;
+    if (a0 > a1) {
+      // eight value mode, matching the palette of decode_bc3_block
+      uint32_t palette[8] = { a0, a1 };
+      for (uint32_t i = 1; i < 7; ++i) {
+        palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+      }
+      for (int p = 0; p < 16; ++p) {
+        const int a = rgba[4 * p + 3];
+        uint32_t best_idx = 0;
+        int best = 256;
+        for (uint32_t k = 0; k < 8; ++k) {
+          const int d = abs(a - (int)palette[k]);
+          if (d < best) {
+            best = d;
+            best_idx = k;
+          }
+        }
+        indices |= (uint64_t)best_idx << (3 * p);
+      }
+    }
+    for (int i = 0; i < 6; ++i) {
+      block[2 + i] = (uint8_t)(indices >> (8 * i));
+    }
+  }
+
+  // Copies the 4x4 block at bx, by, repeating the last row and column past the edges
+  void fetch_block(uint8_t* out, const TextureImage& image, const uint32_t bx, const uint32_t by)
+  {
+    for (uint32_t y = 0; y < 4; ++y) {
+      const uint32_t sy = std::min<uint32_t>(by * 4 + y, image.height - 1);
+      for (uint32_t x = 0; x < 4; ++x) {
+        const uint32_t sx = std::min<uint32_t>(bx * 4 + x, image.width - 1);
+        memcpy(out + (y * 4 + x) * 4, &image.rgba[(sy * image.width + sx) * 4], 4);
+      }
+    }
+  }
+
+  bool is_opaque(const TextureImage& image)
+  {
+    for (size_t i = 3; i < image.rgba.size(); i += 4) {
+      if (image.rgba[i] != 255) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  struct ProcessContext
+  {
+    std::vector<TextureJob>* jobs;
+    TextureFilter::Enum filter;
+    bool compress;
+  };
+
+  void process_texture(void* context, const uint32_t idx)
+  {
+    const ProcessContext& ctx = *(const ProcessContext*)context;
+    TextureJob& job = (*ctx.jobs)[idx];
+    std::vector<uint8_t> blob;
+    write_texture(blob, job.image, ctx.filter, ctx.compress);
+    std::vector<uint8_t>().swap(job.image.rgba);
+
+    // written to a temporary first, as other exports can share the texture cache
+    char suffix[32];
+    sprintf(suffix, ".%d.tmp", (int)getpid());
+    const std::string tmp(job.filename + suffix);
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (file == NULL) {
+      return;
+    }
+    const bool written = fwrite(&blob[0], 1, blob.size(), file) == blob.size();
+    if (fclose(file) != 0 || !written) {
+      remove(tmp.c_str());
+      return;
+    }
+    if (rename(tmp.c_str(), job.filename.c_str()) != 0) {
+      // another export got there first
+      remove(tmp.c_str());
+      FILE* existing = fopen(job.filename.c_str(), "rb");
+      if (existing == NULL) {
+        return;
+      }
+      fclose(existing);
+    }
+    job.ok = true;
+  }
+}
+
+void build_mip_chain(std::vector<TextureImage>& mips, const TextureImage& src, const TextureFilter::Enum filter)
+{
+  mips.clear();
+  mips.push_back(src);
+  while (mips.back().width > 1 || mips.back().height > 1) {
+    mips.push_back(TextureImage());
+    // filtering every level from the previous one keeps the cost linear in the pixel count
+    const TextureImage& prev = mips[mips.size() - 2];
+    if (filter == TextureFilter::kKaiser) {
+      downsample_kaiser(mips.back(), prev);
+    } else {
+      downsample_box(mips.back(), prev);
+    }
+  }
+}
+
+void downsample_box(TextureImage& dst, const TextureImage& src)
+{
+  dst.width = std::max<uint32_t>(src.width / 2, 1);
+  dst.height = std::max<uint32_t>(src.height / 2, 1);
+  dst.rgba.resize(dst.width * dst.height * 4);
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  for (uint32_t y = 0; y < dst.height; ++y) {
+    const uint8_t* row0 = &src.rgba[std::min<uint32_t>(2 * y, src.height - 1) * src.width * 4];
+    const uint8_t* row1 = &src.rgba[std::min<uint32_t>(2 * y + 1, src.height - 1) * src.width * 4];
+    uint8_t* out = &dst.rgba[y * dst.width * 4];
+    uint32_t x = 0;
+
+    // 8 source pixels from each row to 4 destination pixels, summed in 16 bits
+    for (; src.width >= 2 && x + 4 <= dst.width; x += 4) {
+      const __m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + 8 * x));
+      const __m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + 8 * x + 16));
+      const __m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + 8 * x));
+      const __m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + 8 * x + 16));
+      const __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+      const __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+      const __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+      const __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+      // each s holds two column sums, add the pairs
+      const __m128i r0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+      const __m128i r1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+      const __m128i avg0 = _mm_srli_epi16(_mm_add_epi16(r0, two), 2);
+      const __m128i avg1 = _mm_srli_epi16(_mm_add_epi16(r1, two), 2);
+      _mm_storeu_si128((__m128i*)(out + 4 * x), _mm_packus_epi16(avg0, avg1));
+    }
+
+    for (; x < dst.width; ++x) {
+      const uint32_t x0 = std::min<uint32_t>(2 * x, src.width - 1) * 4;
+      const uint32_t x1 = std::min<uint32_t>(2 * x + 1, src.width - 1) * 4;
+      for (uint32_t i = 0; i < 4; ++i) {
+        out[4 * x + i] = (uint8_t)((row0[x0 + i] + row0[x1 + i] + row1[x0 + i] + row1[x1 + i] + 2) >> 2);
+      }
+    }
+  }
+}
+
+void downsample_kaiser(TextureImage& dst, const TextureImage& src)
+{
+  dst.width = std::max<uint32_t>(src.width / 2, 1);
+  dst.height = std::max<uint32_t>(src.height / 2, 1);
+  dst.rgba.resize(dst.width * dst.height * 4);
+
+  FilterTaps taps_x, taps_y;
+  taps_x.build(src.width, dst.width);
+  taps_y.build(src.height, dst.height);
+
+  // horizontal pass into linear floats, then the vertical pass back to sRGB. A texel is 4 floats,
+  // so the taps are summed with SSE a texel at a time in the horizontal pass and a texel of the
+  // row at a time in the vertical one, in the same order as the scalar loops
+  std::vector<float> linear(src.width * 4);
+  std::vector<float> tmp(dst.width * src.height * 4);
+  for (uint32_t y = 0; y < src.height; ++y) {
+    const uint8_t* row = &src.rgba[y * src.width * 4];
+    for (uint32_t x = 0; x < src.width; ++x) {
+      linear[4 * x + 0] = kSrgb.to_linear[row[4 * x + 0]];
+      linear[4 * x + 1] = kSrgb.to_linear[row[4 * x + 1]];
+      linear[4 * x + 2] = kSrgb.to_linear[row[4 * x + 2]];
+      linear[4 * x + 3] = row[4 * x + 3] / 255.0f;
+    }
+    float* out = &tmp[y * dst.width * 4];
+    for (uint32_t x = 0; x < dst.width; ++x) {
+      const float* weights = &taps_x.weights[x * taps_x.tap_count];
+      const uint32_t* indices = &taps_x.indices[x * taps_x.tap_count];
+      __m128 sum = _mm_setzero_ps();
+      for (uint32_t k = 0; k < taps_x.tap_count; ++k) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&linear[4 * indices[k]])));
+      }
+      _mm_storeu_ps(out + 4 * x, sum);
+    }
+  }
+
+  std::vector<float> sum(dst.width * 4);
+  for (uint32_t y = 0; y < dst.height; ++y) {
+    std::fill(sum.begin(), sum.end(), 0.0f);
+    for (uint32_t k = 0; k < taps_y.tap_count; ++k) {
+      const float w = taps_y.weights[y * taps_y.tap_count + k];
+      const float* row = &tmp[taps_y.indices[y * taps_y.tap_count + k] * dst.width * 4];
+      const __m128 wv = _mm_set1_ps(w);
+      for (uint32_t i = 0; i < dst.width * 4; i += 4) {
+        _mm_storeu_ps(&sum[i], _mm_add_ps(_mm_loadu_ps(&sum[i]), _mm_mul_ps(wv, _mm_loadu_ps(row + i))));
+      }
+    }
+    uint8_t* out = &dst.rgba[y * dst.width * 4];
+    for (uint32_t x = 0; x < dst.width; ++x) {
+      out[4 * x + 0] = linear_to_srgb(sum[4 * x + 0]);
+      out[4 * x + 1] = linear_to_srgb(sum[4 * x + 1]);
+      out[4 * x + 2] = linear_to_srgb(sum[4 * x + 2]);
+      out[4 * x + 3] = to_byte(sum[4 * x + 3]);
+    }
+  }
+}
+
+void encode_bc1_block(uint8_t* block, const uint8_t* rgba)
+{
+  encode_color_block(block, rgba);
+}
+
+void encode_bc3_block(uint8_t* block, const uint8_t* rgba)
+{
+  encode_alpha_block(block, rgba);
+  encode_color_block(block + 8, rgba);
+}
+
+void write_texture(std::vector<uint8_t>& out, const TextureImage& image, const TextureFilter::Enum filter,
+                   const bool compress)
+{
+  std::vector<TextureImage> mips;
+  build_mip_chain(mips, image, filter);
+  const uint32_t format = !compress ? RdxTextureFormat::Rgba8 : is_opaque(image) ? RdxTextureFormat::Bc1 : RdxTextureFormat::Bc3;
+
+  RdxTextureHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kRdxTextureMagic;
+  header.version = kRdxTextureVersion;
+  header.format = format;
+  header.width = image.width;
+  header.height = image.height;
+  header.mip_count = (uint32_t)mips.size();
+
+  std::vector<RdxTextureMip> mip_entries(mips.size());
+  uint32_t offset = sizeof(RdxTextureHeader) + header.mip_count * sizeof(RdxTextureMip);
+  for (size_t i = 0; i < mips.size(); ++i) {
+    offset = (offset + kRdxAlignment - 1) & ~(kRdxAlignment - 1);
+    mip_entries[i].offset = offset;
+    mip_entries[i].size = texture_mip_size(format, mips[i].width, mips[i].height);
+    mip_entries[i].width = mips[i].width;
+    mip_entries[i].height = mips[i].height;
+    offset += mip_entries[i].size;
+  }
+
+  out.assign(offset, 0);
+  memcpy(&out[0], &header, sizeof(header));
+  memcpy(&out[sizeof(header)], &mip_entries[0], mip_entries.size() * sizeof(RdxTextureMip));
+  for (size_t i = 0; i < mips.size(); ++i) {
+    const TextureImage& mip = mips[i];
+    uint8_t* dst = &out[mip_entries[i].offset];
+    if (format == RdxTextureFormat::Rgba8) {
+      memcpy(dst, &mip.rgba[0], mip.rgba.size());
+      continue;
+    }
+    uint8_t block[64];
+    for (uint32_t by = 0; by < (mip.height + 3) / 4; ++by) {
+      for (uint32_t bx = 0; bx < (mip.width + 3) / 4; ++bx) {
+        fetch_block(block, mip, bx, by);
+        if (format == RdxTextureFormat::Bc1) {
+          encode_bc1_block(dst, block);
+          dst += 8;
+        } else {
+          encode_bc3_block(dst, block);
+          dst += 16;
+        }
+      }
+    }
+  }
+}
+
+void process_textures(std::vector<TextureJob>& jobs, const TextureFilter::Enum filter, const bool compress,
+                      const uint32_t thread_count)
+{
+  ProcessContext ctx;
+  ctx.jobs = &jobs;
+  ctx.filter = filter;
+  ctx.compress = compress;
+  parallel_for((uint32_t)jobs.size(), process_texture, &ctx, thread_count);
+}
@@ -0,0 +1,59 @@
+#ifndef TEXTURE_PROCESSING_HPP
+#define TEXTURE_PROCESSING_HPP
+
+/**
+ * Offline processing of the textures the materials use: mip chain generation and block
+ * compression into the .rtx layout of Reader/RdxFormat.hpp, so the runtime doesn't have to
+ * do either at load time. Images are 8 bit sRGB rgba, top row first. Decoding the source
+ * images is left to the caller, as the exporter uses Maya for it. Doesn't depend on Maya or
+ * stdafx.h.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct TextureImage
+{
+  TextureImage() : width(0), height(0) {}
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint8_t> rgba;
+};
+
+struct TextureFilter
+{
+  enum Enum
+  {
+    kBox,       // 2x2 average of the sRGB values, with SSE2
+    kKaiser,    // windowed sinc in linear space, sharper and without the darkening of kBox
+  };
+};
+
+// Each level is half the size of the previous, rounded down, until 1x1
+void build_mip_chain(std::vector<TextureImage>& mips, const TextureImage& src, const TextureFilter::Enum filter);
+void downsample_box(TextureImage& dst, const TextureImage& src);
+void downsample_kaiser(TextureImage& dst, const TextureImage& src);
+
+// Encodes 16 rgba pixels. BC1 ignores the alpha, and BC3 uses the four color mode for the colors
+void encode_bc1_block(uint8_t* block, const uint8_t* rgba);
+void encode_bc3_block(uint8_t* block, const uint8_t* rgba);
+
+// Builds the mip chain and writes it as an .rtx file image. When compressing, opaque images
+// are BC1 and the others BC3, otherwise the mips are stored as rgba
+void write_texture(std::vector<uint8_t>& out, const TextureImage& image, const TextureFilter::Enum filter,
+  const bool compress);
+
+struct TextureJob
+{
+  TextureJob() : ok(false) {}
+  TextureImage image;
+  std::string filename;
+  bool ok;
+};
+
+// Writes the .rtx of each job on thread_count threads, and frees the source images
+void process_textures(std::vector<TextureJob>& jobs, const TextureFilter::Enum filter, const bool compress,
+  const uint32_t thread_count);
+
+#endif
@@ -0,0 +1,186 @@
+#include <malloc.h>
+#include <string.h>
+#include <algorithm>
+#include <emmintrin.h>
+#include "VertexConversion.hpp"
+
+namespace
+{
+  const __m128 kSignMask = _mm_set1_ps(-0.0f);
+}
+
+SoaStream::SoaStream()
+  : arena_(Arena::current())
+  , data_(NULL)
+  , count_(0)
+  , components_(0)
+  , stride_(0)
+{
+}
+
+SoaStream::SoaStream(const SoaStream& rhs)
+  : arena_(Arena::current())
+  , data_(NULL)
+  , count_(0)
+  , components_(0)
+  , stride_(0)
+{
+  *this = rhs;
+}
+
+SoaStream& SoaStream::operator=(const SoaStream& rhs)
+{
+  if (this != &rhs) {
+    resize(rhs.count_, rhs.components_);
+    if (data_) {
+      memcpy(data_, rhs.data_, stride_ * components_ * sizeof(float));
+    }
+  }
+  return *this;
+}
+
+SoaStream::~SoaStream()
+{
+  if (!arena_) {
+    _aligned_free(data_);
+  }
+}
+
+void SoaStream::resize(const uint32_t count, const uint32_t components)
+{
+  const uint32_t stride = (count + 3) & ~3;
+  if (stride * components != stride_ * components_) {
+    const size_t size = stride * components * sizeof(float);
+    if (arena_) {
+      data_ = size ? (float*)arena_->allocate(size) : NULL;
+    } else {
+      _aligned_free(data_);
+      data_ = size ? (float*)_aligned_malloc(size, 16) : NULL;
+    }
+  }
+  count_ = count;
+  components_ = components;
+  stride_ = stride;
+}
+
+void convert_points(SoaStream& out, const double* points, const uint32_t count)
+{
+  out.resize(count, 3);
+  float* x = out.component(0);
+  float* y = out.component(1);
+  float* z = out.component(2);
+
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const double* p = points + 4 * i;
+    const __m128 xy01 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p + 0)), _mm_cvtpd_ps(_mm_loadu_pd(p + 4)));
+    const __m128 xy23 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p + 8)), _mm_cvtpd_ps(_mm_loadu_pd(p + 12)));
+    const __m128 zw01 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p + 2)), _mm_cvtpd_ps(_mm_loadu_pd(p + 6)));
+    const __m128 zw23 = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p + 10)), _mm_cvtpd_ps(_mm_loadu_pd(p + 14)));
+    _mm_store_ps(x + i, _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_store_ps(y + i, _mm_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 1, 3, 1)));
+    _mm_store_ps(z + i, _mm_xor_ps(_mm_shuffle_ps(zw01, zw23, _MM_SHUFFLE(2, 0, 2, 0)), kSignMask));
+  }
+
+  for (; i < count; ++i) {
+    x[i] = (float)points[4 * i + 0];
+    y[i] = (float)points[4 * i + 1];
+    z[i] = -(float)points[4 * i + 2];
+  }
+}
+
+void convert_vectors(SoaStream& out, const float* vectors, const uint32_t count, const bool flip)
+{
+  out.resize(count, 3);
+  float* x = out.component(0);
+  float* y = out.component(1);
+  float* z = out.component(2);
+
+  // xor with the sign bit to negate
+  const __m128 xy_sign = flip ? kSignMask : _mm_setzero_ps();
+  const __m128 z_sign = flip ? _mm_setzero_ps() : kSignMask;
+
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+    const float* v = vectors + 3 * i;
+    const __m128 a = _mm_loadu_ps(v + 0);
+    const __m128 b = _mm_loadu_ps(v + 4);
+    const __m128 c = _mm_loadu_ps(v + 8);
+
+    const __m128 x0x0x1x1 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0));
+    const __m128 x2x2x3x3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 y0y0y1y1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    const __m128 y2y2y3y3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    const __m128 z0z0z1z1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 z2z2z3z3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+
+    _mm_store_ps(x + i, _mm_xor_ps(_mm_shuffle_ps(x0x0x1x1, x2x2x3x3, _MM_SHUFFLE(2, 0, 2, 0)), xy_sign));
+    _mm_store_ps(y + i, _mm_xor_ps(_mm_shuffle_ps(y0y0y1y1, y2y2y3y3, _MM_SHUFFLE(2, 0, 2, 0)), xy_sign));
+    _mm_store_ps(z + i, _mm_xor_ps(_mm_shuffle_ps(z0z0z1z1, z2z2z3z3, _MM_SHUFFLE(2, 0, 2, 0)), z_sign));
+  }
+
+  const float mul = flip ? -1.0f : 1.0f;
+  for (; i < count; ++i) {
+    x[i] = mul * vectors[3 * i + 0];
+    y[i] = mul * vectors[3 * i + 1];
+    z[i] = -mul * vectors[3 * i + 2];
+  }
+}
+
+void convert_uvs(SoaStream& out, const float* us, const float* vs, const uint32_t count)
+{
+  out.resize(count, 2);
+  float* u = out.component(0);
+  float* v = out.component(1);
+
+  const __m128 one = _mm_set1_ps(1.0f);
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_store_ps(u + i, _mm_loadu_ps(us + i));
+    _mm_store_ps(v + i, _mm_sub_ps(one, _mm_loadu_ps(vs + i)));
+  }
+
+  for (; i < count; ++i) {
+    u[i] = us[i];
+    v[i] = 1.0f - vs[i];
+  }
+}
+
+void convert_colors(SoaStream& out, const float* colors, const uint32_t count)
+{
+  out.resize(count, 4);
+  float* r = out.component(0);
+  float* g = out.component(1);
+  float* b = out.component(2);
+  float* a = out.component(3);
+
+  uint32_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 c0 = _mm_loadu_ps(colors + 4 * i + 0);
+    __m128 c1 = _mm_loadu_ps(colors + 4 * i + 4);
+    __m128 c2 = _mm_loadu_ps(colors + 4 * i + 8);
+    __m128 c3 = _mm_loadu_ps(colors + 4 * i + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(r + i, c0);
+    _mm_store_ps(g + i, c1);
+    _mm_store_ps(b + i, c2);
+    _mm_store_ps(a + i, c3);
+  }
+
+  for (; i < count; ++i) {
+    r[i] = colors[4 * i + 0];
+    g[i] = colors[4 * i + 1];
+    b[i] = colors[4 * i + 2];
+    a[i] = colors[4 * i + 3];
+  }
+}
+
+VertexFormat make_vertex_format(const MeshStreams& streams, const bool tangents)
+{
+  VertexFormat format;
+  format.uv_sets = std::max<uint32_t>(1, (uint32_t)streams.uv_sets.size());
+  format.color_sets = (uint32_t)streams.color_sets.size();
+  format.tangents = tangents;
+  return format;
+}
@@ -0,0 +1,123 @@
+#ifndef VERTEX_CONVERSION_HPP
+#define VERTEX_CONVERSION_HPP
+
+/**
+ * Bulk conversion of the raw Maya arrays to the exporter's coordinate system. The kernels
+ * narrow doubles to floats, negate z for handedness, flip the normals of opposite meshes and
+ * flip v, 4 elements at a time with SSE2, and write the result to aligned SoA streams. The
+ * streams are allocated from the Arena that was current when they were created, if any.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "Arena.hpp"
+#include "MeshProcessing.hpp"
+
+// A structure of arrays, with every component 16 byte aligned and padded to a multiple of 4 elements
+class SoaStream
+{
+public:
+  SoaStream();
+  SoaStream(const SoaStream& rhs);
+  SoaStream& operator=(const SoaStream& rhs);
+  ~SoaStream();
+
+  void resize(const uint32_t count, const uint32_t components);
+
+  uint32_t size() const { return count_; }
+  uint32_t components() const { return components_; }
+  float* component(const uint32_t idx) { return data_ + idx * stride_; }
+  const float* component(const uint32_t idx) const { return data_ + idx * stride_; }
+
+private:
+  Arena* arena_;
+  float* data_;
+  uint32_t count_;
+  uint32_t components_;
+  uint32_t stride_;
+};
+
+struct MeshStreams
+{
+  uint32_t stream_index_count() const { return (uint32_t)(uv_sets.size() + color_sets.size()); }
+
+  SoaStream positions;
+  SoaStream normals;
+  ArenaVector<SoaStream>::Type uv_sets;
+  ArenaVector<SoaStream>::Type color_sets;
+};
+
+// Converts count points, stored as [x, y, z, w] doubles (MPointArray::get)
+void convert_points(SoaStream& out, const double* points, const uint32_t count);
+
+// Converts count vectors, stored as [x, y, z] floats (MFloatVectorArray::get). If flip is set
+// the vectors are negated as well
+void convert_vectors(SoaStream& out, const float* vectors, const uint32_t count, const bool flip);
+
+// Converts count uvs, stored as separate u and v arrays (MFnMesh::getUVs)
+void convert_uvs(SoaStream& out, const float* us, const float* vs, const uint32_t count);
+
+// Converts count colors, stored as [r, g, b, a] floats (MColorArray::get)
+void convert_colors(SoaStream& out, const float* colors, const uint32_t count);
+
+// The exported vertex format for the streams. There is always at least one uv set.
+VertexFormat make_vertex_format(const MeshStreams& streams, const bool tangents);
+
+// Creates the candidate vertices for the welder, in the format already set on candidates.
+// Corners is a vector of anything with position_index and normal_index members. stream_indices holds
+// streams.stream_index_count() indices per corner, first for each uv set and then for each
+// color set. Out of range indices give zero, or white for colors.
+template <class Corners>
+void gather_candidates(VertexBuffer& candidates, const MeshStreams& streams, const Corners& corners,
+                       const IndexBuffer& stream_indices)
+{
+  const float* px = streams.positions.component(0);
+  const float* py = streams.positions.component(1);
+  const float* pz = streams.positions.component(2);
+  const float* nx = streams.normals.component(0);
+  const float* ny = streams.normals.component(1);
+  const float* nz = streams.normals.component(2);
+  const uint32_t uv_sets = (uint32_t)streams.uv_sets.size();
+  const uint32_t color_sets = (uint32_t)streams.color_sets.size();
+  const uint32_t stream_index_count = streams.stream_index_count();
+
+  const VertexFormat& format = candidates.format;
+  candidates.data.clear();
+  candidates.resize((uint32_t)corners.size());
+  for (size_t i = 0; i < corners.size(); ++i) {
+    const typename Corners::value_type& corner = corners[i];
+    float* v = candidates.vertex((uint32_t)i);
+    const uint32_t pos_idx = corner.position_index;
+    if (pos_idx < streams.positions.size()) {
+      v[0] = px[pos_idx];
+      v[1] = py[pos_idx];
+      v[2] = pz[pos_idx];
+    }
+    const uint32_t normal_idx = corner.normal_index;
+    if (normal_idx < streams.normals.size()) {
+      v[3] = nx[normal_idx];
+      v[4] = ny[normal_idx];
+      v[5] = nz[normal_idx];
+    }
+
+    const uint32_t* indices = stream_index_count ? &stream_indices[i * stream_index_count] : NULL;
+    for (uint32_t j = 0; j < uv_sets; ++j) {
+      const SoaStream& uvs = streams.uv_sets[j];
+      if (indices[j] < uvs.size()) {
+        float* uv = v + format.uv_offset(j);
+        uv[0] = uvs.component(0)[indices[j]];
+        uv[1] = uvs.component(1)[indices[j]];
+      }
+    }
+    for (uint32_t j = 0; j < color_sets; ++j) {
+      const SoaStream& colors = streams.color_sets[j];
+      const uint32_t color_idx = indices[uv_sets + j];
+      float* color = v + format.color_offset(j);
+      for (uint32_t k = 0; k < 4; ++k) {
+        color[k] = color_idx < colors.size() ? colors.component(k)[color_idx] : 1.0f;
+      }
+    }
+  }
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <maya/MAnimControl.h>
 #include <maya/MFnAnimCurve.h>
 #include <maya/MArgList.h>
+#include <maya/MColorArray.h>
 #include <maya/MDagPath.h>
 #include <maya/MDagPathArray.h>
 #include <maya/MFileIO.h>
@@ -37,6 +38,7 @@
 #include <maya/MFnBlinnShader.h>
 #include <maya/MFnSet.h>
 #include <maya/MGlobal.h>
+#include <maya/MImage.h>
 #include <maya/MItDag.h>
 #include <maya/MItDependencyNodes.h>
 #include <maya/MItGeometry.h>
@@ -46,9 +48,16 @@
 #include <maya/MMatrix.h>
 #include <maya/MObject.h>
 #include <maya/MObjectArray.h>
+#include <maya/MObjectHandle.h>
 #include <maya/MPointArray.h>
 #include <maya/MPxFileTranslator.h>
 #include <maya/MFnSkinCluster.h>
+#include <maya/MFnGeometryFilter.h>
+#include <maya/MFnPointArrayData.h>
+#include <maya/MFnComponentListData.h>
+#include <maya/MFnSingleIndexedComponent.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MPlug.h>
 #include <maya/MStatus.h>
 #include <maya/MString.h>
 #include <maya/MTime.h>
@@ -60,6 +69,8 @@
 
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -67,6 +78,5 @@
 #include <D3DX10.h>
 
 #include <boost/shared_ptr.hpp>
-#include <celsus/ChunkIO.hpp>
 #include <celsus/celsus.hpp>
 #include <celsus/CelsusExtra.hpp>
\ No newline at end of file
@@ -27,6 +27,7 @@
 #include <vector>
 #include <math.h>
 #include <assert.h>
+#include "Arena.hpp"
 
 class VertexCacheData
 {
@@ -35,7 +36,7 @@ public:
 	float current_score;
 	int total_valence; // toatl number of triangles using this vertex
 	int remaining_valence; // number of triangles using it but not yet rendered
-	std::vector<int> tri_indices; // indices to the indices that use this vertex
+	ArenaVector<int>::Type tri_indices; // indices to the indices that use this vertex
 	bool calculated; // was the score calculated during this iteration?
 
 
@@ -195,12 +196,12 @@ public:
 	}
 
 protected:
-	std::vector<VertexCacheData> verts;
-	std::vector<TriangleCacheData> tris;
-	std::vector<int> inds;
+	ArenaVector<VertexCacheData>::Type verts;
+	ArenaVector<TriangleCacheData>::Type tris;
+	ArenaVector<int>::Type inds;
 	int best_tri; // the next triangle to add to the render list
 	VertexCache vertex_cache;
-	std::vector<int> draw_list;
+	ArenaVector<int>::Type draw_list;
 
 	float CalculateVertexScore(int vertex)
 	{
@@ -288,8 +289,16 @@ protected:
 
 			verts[index].total_valence++;
 			verts[index].remaining_valence++;
-			
-			verts[index].tri_indices.push_back(i/3);
+		}
+
+		// size the triangle lists up front, so they are allocated once
+		for (int i=0; i<(int)verts.size(); i++)
+		{
+			verts[i].tri_indices.reserve(verts[i].total_valence);
+		}
+		for (int i=0; i<(int)inds.size(); i++)
+		{
+			verts[inds[i]].tri_indices.push_back(i/3);
 		}
 
 		best_tri = FullScoreRecalculation();
@@ -301,12 +310,15 @@ protected:
 	{
 		// clear the draw list
 		draw_list.clear();
+		draw_list.reserve(tri_count);
 
 		// allocate and initialize vertices and triangles
 		verts.clear();
+		verts.reserve(vertex_count);
 		for (int i=0; i<vertex_count; i++) verts.push_back(VertexCacheData());
 		
 		tris.clear();
+		tris.reserve(tri_count);
 		for (int i=0; i<tri_count; i++)
 		{
 			TriangleCacheData dat;
@@ -319,6 +331,7 @@ protected:
 
 		// copy the indices
 		this->inds.clear();
+		this->inds.reserve(tri_count * 3);
 		for (int i=0; i<tri_count * 3; i++) this->inds.push_back(inds[i]);
 
 		vertex_cache.Clear();
@@ -0,0 +1,358 @@
+#ifndef RDX_FORMAT_HPP
+#define RDX_FORMAT_HPP
+
+/**
+ * The .rdx container, shared by the exporter's RdxWriter and RdxReader.
+ *
+ *   RdxFileHeader
+ *   RdxChunkEntry[chunk_count]
+ *   RdxBlockEntry[block_count]     (block compressed files only)
+ *   padding to kRdxAlignment
+ *   data                           (data_size bytes, or the compressed blocks)
+ *
+ * Chunk offsets are relative to the start of the data, and every chunk starts on a 16 byte
+ * boundary. In an uncompressed file the data can be mapped and used in place. A block
+ * compressed file splits the data into block_size pieces that are zlib compressed one by one,
+ * so a reader only inflates the blocks covering the chunks it touches. A block that doesn't
+ * compress is stored as is, and then its compressed size equals its data size.
+ *
+ * Everything is little endian, and the payload structs below are written as raw arrays, so
+ * their layout is part of the format.
+ *
+ * Files meant to be delivered as binary patches can use the patch layout, which readers don't
+ * need to know about: the chunks are grouped, each group starts on a block boundary, and a
+ * chunk starts a new group when it doesn't fit in its group's block or when its content picks
+ * it. An edit then only changes the blocks of its own group and maybe the next, and the other
+ * blocks compress to the same bytes wherever they end up in the file, so a patch built from
+ * block hashes stays proportional to the edit.
+ */
+
+#include <stdint.h>
+
+const uint32_t kRdxMagic = 0x31584452;      // "RDX1"
+const uint32_t kRdxVersion = 2;
+const uint32_t kRdxAlignment = 16;
+const uint32_t kRdxDefaultBlockSize = 256 * 1024;
+const uint32_t kRdxPatchBlockSize = 64 * 1024;
+
+struct RdxChunkId
+{
+  enum Enum
+  {
+    Mesh = 1,
+    Camera = 2,
+    Animation = 3,
+    Hierarchy = 4,
+    StringTable = 5,
+    Materials = 6,
+    SpatialIndex = 7,
+    CellManifest = 8,
+    MeshBatches = 9,
+    MorphTargets = 10,
+    Skins = 11,
+  };
+};
+
+struct RdxFileHeader
+{
+  enum Flags
+  {
+    kBlockCompressed = 1 << 0,
+  };
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint32_t chunk_count;
+  uint32_t block_size;      // data size of each block but the last, 0 when uncompressed
+  uint32_t block_count;
+  uint32_t data_offset;     // file offset of the data, or of the first compressed block
+  uint32_t data_size;       // uncompressed size of the data
+};
+
+struct RdxChunkEntry
+{
+  uint32_t id;              // RdxChunkId
+  uint32_t offset;
+  uint32_t size;
+  uint32_t reserved;
+};
+
+struct RdxBlockEntry
+{
+  uint32_t offset;          // file offset of the compressed block
+  uint32_t compressed_size;
+};
+
+// Hierarchy chunk: [version, count, RdxHierarchyNode[count]]
+struct RdxHierarchyNode
+{
+  uint32_t parent;        // index of the parent node, or kRdxInvalidIndex for the root
+  uint32_t name;          // string index of the full path name
+  uint32_t first_child;
+  uint32_t child_count;
+  float translation[3];
+  float rotation[4];      // quaternion, x y z w
+  float scale[3];
+};
+
+// StringTable chunk: [version, count, RdxStringEntry[count], char count, chars]
+// The suffix is stored in the char data, zero terminated, and starts with the '|' when the
+// entry has a prefix, so the full name is the suffixes concatenated.
+struct RdxStringEntry
+{
+  uint32_t prefix;          // index of the prefix entry, or kRdxInvalidIndex
+  uint32_t suffix_offset;
+  uint32_t length;          // length of the full name
+  uint32_t hash;            // FNV-1a hash of the full name
+};
+
+const uint32_t kRdxInvalidIndex = 0xffffffff;
+
+// Mesh chunk: [name, parent name, element count, RdxElementDesc[count], encoding,
+//              vertex count, vertex size, vertices, index count, index size, indices, bounds]
+// With RdxMeshEncoding::Encoded the vertices and indices are each [byte count, bytes, padding to 4],
+// in the encoding of Reader/RdxMeshCodec.hpp, and the sizes are those of the decoded data.
+struct RdxMeshEncoding
+{
+  enum Enum
+  {
+    Raw = 0,
+    Encoded = 1,
+  };
+};
+
+struct RdxElementDesc
+{
+  uint32_t semantic;        // string index
+  uint32_t semantic_index;
+  uint32_t format;          // DXGI_FORMAT
+  uint32_t input_slot;
+  uint32_t byte_offset;
+};
+
+// Bounds, at the end of the mesh chunk: [version, mode, flags, RdxAabb, RdxSphere, RdxObb if kRdxObbFlag]
+const uint32_t kRdxObbFlag = 1 << 0;
+
+struct RdxAabb
+{
+  float min[3];
+  float max[3];
+};
+
+struct RdxSphere
+{
+  float center[3];
+  float radius;
+};
+
+struct RdxObb
+{
+  float center[3];
+  float axes[3][3];
+  float extents[3];
+};
+
+// Animation chunk: [fps, start, end, track count, tracks], where each track is
+// [name, key count, RdxAnimationKey[key count]]. Times are in seconds.
+struct RdxAnimationKey
+{
+  float time;
+  float translation[3];
+  float rotation[4];
+  float scale[3];
+};
+
+// Camera chunk: [RdxCamera, curves if the camera is animated]
+struct RdxCamera
+{
+  uint32_t name;
+  float eye_pos[3];
+  float view_dir[3];
+  float up_dir[3];
+  float right_dir[3];
+  float aspect_ratio;
+  float horizontal_fov;
+  float vertical_fov;
+  float near_plane;
+  float far_plane;
+};
+
+// Camera curves: [version, sample count, start, step, channel count,
+// RdxCurveChannel[channel count], key count, RdxCurveKey[key count]]
+// Channel i animates float i of the RdxCamera after the name, sampled in world space on the
+// time grid of the Animation chunk: sample k is at start + k * step seconds. Each channel
+// keeps the samples that linear interpolation of its neighbours doesn't reproduce, so a
+// constant channel is a single key, and its values are quantized to 16 bits over its range.
+// The directions are interpolated per component, and need to be normalized.
+const uint32_t kRdxCameraChannels = 17;
+
+struct RdxCurveChannel
+{
+  uint32_t first_key;
+  uint32_t key_count;       // at least 1
+  float min;                // value = min + quantized value * scale
+  float scale;
+};
+
+struct RdxCurveKey
+{
+  uint16_t sample;          // increasing within a channel
+  uint16_t value;
+};
+
+// SpatialIndex chunk: [version, node count, item count, RdxBvhNode[node count], mesh ids[item count]]
+// A BVH over the mesh aabbs. The nodes are depth first, so an inner node's first child follows
+// it. Mesh ids are the order of the Mesh chunks in the file, listed in leaf order.
+struct RdxBvhNode
+{
+  float min[3];
+  float max[3];
+  uint32_t offset;          // leaf: first item, inner: index of the second child
+  uint32_t count;           // item count, 0 for inner nodes
+};
+
+// CellManifest chunk: [version, cell size, pack name, cell count, RdxCell[cell count]]
+// Streaming exports split the meshes into square cells on the xz plane. Each cell is an .rdx
+// file holding the Mesh chunks of the meshes centered in it and a SpatialIndex over them, and
+// the cells are stored back to back in the pack file, kRdxCellAlignment aligned. The string
+// indices in a cell refer to the file with the manifest, which also holds the hierarchy, the
+// materials and the meshes larger than a cell.
+const uint32_t kRdxCellAlignment = 4096;
+
+struct RdxCell
+{
+  int32_t x;                // the cell covers [x, x + 1) * cell size
+  int32_t z;
+  RdxAabb bounds;           // of the cell's meshes, which can stick out of the cell
+  uint32_t mesh_count;
+  uint32_t size;            // of the cell's .rdx file
+  uint64_t offset;          // of the cell's .rdx file in the pack
+};
+
+// MeshBatches chunk: [version, batch count, RdxMeshBatch[batch count], range count,
+//                     RdxMeshBatchRange[range count]]
+// Static meshes are exported in world space, and the ones sharing a material and a vertex
+// format can be merged into batch meshes, which the runtime draws with a single call. Batch
+// meshes are regular Mesh chunks, with the empty name as the parent. Each batch lists the
+// meshes merged into it as ranges of its buffers, with their names and bounds, so they can
+// still be culled one by one. Batches refer to their Mesh chunk by name, as spatial ordering
+// and streaming cells move the chunks.
+struct RdxMeshBatch
+{
+  uint32_t mesh;            // string index of the batch mesh's name
+  uint32_t first_range;
+  uint32_t range_count;
+  uint32_t reserved;
+};
+
+struct RdxMeshBatchRange
+{
+  uint32_t name;            // string index of the merged mesh's name
+  uint32_t parent;          // string index of its parent transform's path
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t first_vertex;    // the range only uses these vertices of the batch
+  uint32_t vertex_count;
+  RdxAabb aabb;
+};
+
+// MorphTargets chunk: [version, mesh count, RdxMorphMesh[mesh count], target count,
+//                      RdxMorphTarget[target count], delta count, vertex indices[delta count],
+//                      RdxMorphDelta[delta count]]
+// The blend shape targets of the meshes, as position deltas of the exported (welded) vertices.
+// Only the vertices a target moves are stored, and the targets of all the meshes share one
+// index stream and one delta stream, so the runtime can upload each as a single buffer and
+// accumulate the active targets with one compute dispatch per target:
+//   position[vertex index[i]] += weight * delta[i] / 32767 * scale
+// for i in [first_delta, first_delta + delta_count). The deltas are in the space of the
+// mesh's vertices. Meshes are referred to by name, as spatial ordering and streaming cells
+// move the chunks.
+struct RdxMorphMesh
+{
+  uint32_t mesh;            // string index of the mesh's name
+  uint32_t vertex_count;
+  uint32_t first_target;
+  uint32_t target_count;
+};
+
+struct RdxMorphTarget
+{
+  uint32_t name;            // string index of the target's name
+  uint32_t first_delta;
+  uint32_t delta_count;
+  float scale;              // the largest delta component
+};
+
+// DXGI_FORMAT_R16G16B16A16_SNORM, w is 0
+struct RdxMorphDelta
+{
+  int16_t position[4];
+};
+
+// Skins chunk: [version, skin count, RdxSkin[skin count], joint count, RdxSkinJoint[joint count]]
+// Skinned meshes have BLENDINDICES (DXGI_FORMAT_R8G8B8A8_UINT) and BLENDWEIGHT
+// (DXGI_FORMAT_R8G8B8A8_UNORM) elements, holding the kRdxMaxInfluences largest influences of
+// each vertex, largest first, with the weights summing to 255. The indices are into the palette
+// of the mesh's skin, which is its joint range, and the exporter splits meshes so a palette has
+// at most 256 joints (fewer if so set on export). Skinned vertices are in the world space bind
+// pose, and the parent transform of a skinned mesh doesn't apply: palette entry i skins with
+//   inverse_bind[first_joint + i] * world matrix of joint[first_joint + i]
+// The matrices are row major, for row vectors like D3DX. Skins refer to their Mesh chunk by
+// name, as spatial ordering and streaming cells move the chunks.
+const uint32_t kRdxMaxInfluences = 4;
+
+struct RdxSkin
+{
+  uint32_t mesh;            // string index of the mesh's name
+  uint32_t first_joint;
+  uint32_t joint_count;
+  uint32_t reserved;
+};
+
+struct RdxSkinJoint
+{
+  uint32_t name;            // string index of the joint's full path name
+  float inverse_bind[4][4];
+};
+
+// Processed textures (.rtx) are separate files, written to a texture cache next to the .rdx
+// and named by the hash of the source image and the processing settings, so materials and
+// scenes sharing an image share the file. The Materials chunk refers to them by file name.
+//   RdxTextureHeader, RdxTextureMip[mip_count], padding to kRdxAlignment, mips
+// The mips are largest first, each starting kRdxAlignment aligned. Rows are top to bottom,
+// and block compressed mips store rows of 4x4 blocks, the last ones padded for sizes that
+// aren't a multiple of 4.
+const uint32_t kRdxTextureMagic = 0x31585452;   // "RTX1"
+const uint32_t kRdxTextureVersion = 1;
+
+struct RdxTextureFormat
+{
+  enum Enum
+  {
+    Rgba8 = 0,                // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+    Bc1 = 1,                  // DXGI_FORMAT_BC1_UNORM_SRGB, for opaque images
+    Bc3 = 2,                  // DXGI_FORMAT_BC3_UNORM_SRGB
+  };
+};
+
+struct RdxTextureHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;          // RdxTextureFormat
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_count;
+  uint32_t reserved[2];
+};
+
+struct RdxTextureMip
+{
+  uint32_t offset;          // from the start of the file
+  uint32_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+#endif
@@ -0,0 +1,399 @@
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include "RdxImage.hpp"
+#include "RdxReader.hpp"
+
+namespace
+{
+  // A position in one of the sections, before the sections are laid out
+  struct Ref
+  {
+    Ref() : section(0), offset(0) {}
+    Ref(const uint32_t section, const uint32_t offset) : section(section), offset(offset) {}
+    Ref field(const uint32_t ofs) const { return Ref(section, offset + ofs); }
+    uint32_t section;
+    uint32_t offset;
+  };
+
+  // Collects the sections and the pointers between them, and lays them out in finish
+  class ImageBuilder
+  {
+  public:
+    ImageBuilder() : sections_(RdxImageSection::kNumSections) {}
+
+    Ref alloc(const uint32_t section, const uint32_t size, const uint32_t alignment)
+    {
+      std::vector<uint8_t>& data = sections_[section];
+      const uint32_t offset = align(data.size(), alignment);
+      data.resize(offset + size, 0);
+      return Ref(section, offset);
+    }
+
+    Ref add(const uint32_t section, const void* src, const uint32_t size, const uint32_t alignment)
+    {
+      const Ref ref = alloc(section, size, alignment);
+      set(ref, src, size);
+      return ref;
+    }
+
+    void set(const Ref& ref, const void* src, const uint32_t size)
+    {
+      if (size > 0) {
+        memcpy(&sections_[ref.section][ref.offset], src, size);
+      }
+    }
+
+    // The RdxPtr at slot will point to target
+    void link(const Ref& slot, const Ref& target)
+    {
+      links_.push_back(std::make_pair(slot, target));
+    }
+
+    void finish(std::vector<uint8_t>& image, const Ref& scene)
+    {
+      uint32_t offsets[RdxImageSection::kNumSections];
+      uint32_t ofs = align(sizeof(RdxImageHeader) + RdxImageSection::kNumSections * sizeof(RdxImageSection), kRdxImageAlignment);
+      for (uint32_t i = 0; i < RdxImageSection::kNumSections; ++i) {
+        offsets[i] = ofs;
+        ofs = align(ofs + (uint32_t)sections_[i].size(), kRdxImageAlignment);
+      }
+      const uint32_t fixup_offset = ofs;
+      const uint32_t image_size = fixup_offset + (uint32_t)links_.size() * sizeof(uint32_t);
+
+      image.assign(image_size, 0);
+      RdxImageHeader* header = (RdxImageHeader*)&image[0];
+      header->magic = kRdxImageMagic;
+      header->version = kRdxImageVersion;
+      header->flags = 0;
+      header->image_size = image_size;
+      header->section_count = RdxImageSection::kNumSections;
+      header->fixup_offset = fixup_offset;
+      header->fixup_count = (uint32_t)links_.size();
+      header->scene_offset = offsets[scene.section] + scene.offset;
+
+      RdxImageSection* sections = (RdxImageSection*)&image[sizeof(RdxImageHeader)];
+      for (uint32_t i = 0; i < RdxImageSection::kNumSections; ++i) {
+        sections[i].type = i;
+        sections[i].alignment = kRdxImageAlignment;
+        sections[i].offset = offsets[i];
+        sections[i].size = (uint32_t)sections_[i].size();
+        if (!sections_[i].empty()) {
+          memcpy(&image[offsets[i]], &sections_[i][0], sections_[i].size());
+        }
+      }
+
+      // the slots hold image offsets until fixup_image adds the base address
+      uint32_t* fixups = (uint32_t*)&image[fixup_offset];
+      for (size_t i = 0; i < links_.size(); ++i) {
+        const Ref& slot = links_[i].first;
+        const Ref& target = links_[i].second;
+        const uint32_t slot_offset = offsets[slot.section] + slot.offset;
+        ((RdxPtr<uint8_t>*)&image[slot_offset])->value = offsets[target.section] + target.offset;
+        fixups[i] = slot_offset;
+      }
+    }
+
+  private:
+    static uint32_t align(const size_t value, const uint32_t alignment)
+    {
+      return (uint32_t)((value + alignment - 1) & ~(size_t)(alignment - 1));
+    }
+
+    std::vector< std::vector<uint8_t> > sections_;
+    std::vector< std::pair<Ref, Ref> > links_;
+  };
+
+  // Adds an array to the section, and points the slot at it. Empty arrays are left NULL.
+  template <class T>
+  Ref add_array(ImageBuilder& builder, const Ref& slot, const uint32_t section, const T* data,
+                const uint32_t count, const uint32_t alignment)
+  {
+    if (count == 0) {
+      return Ref();
+    }
+    const Ref ref = data != NULL ?
+      builder.add(section, data, count * sizeof(T), alignment) :
+      builder.alloc(section, count * sizeof(T), alignment);
+    builder.link(slot, ref);
+    return ref;
+  }
+
+  // The count Ts at ptr are inside the image. Empty arrays can be NULL
+  template <class T>
+  bool in_image(const RdxPtr<T>& ptr, const uint64_t count, const uint8_t* image, const uint32_t size)
+  {
+    if (count == 0) {
+      return true;
+    }
+    const uintptr_t offset = (uintptr_t)ptr.get() - (uintptr_t)image;
+    return (uintptr_t)ptr.get() >= (uintptr_t)image && offset < size && count * sizeof(T) <= size - offset;
+  }
+
+  // Checks every array of the fixed up scene against the counts that describe it, so the
+  // runtime can index them without bounds checks
+  bool validate_scene(const RdxImageScene& scene, const uint8_t* image, const uint32_t size)
+  {
+    if (!(in_image(scene.meshes, scene.mesh_count, image, size) &&
+      in_image(scene.nodes, scene.node_count, image, size) &&
+      in_image(scene.tracks, scene.track_count, image, size) &&
+      in_image(scene.cameras, scene.camera_count, image, size) &&
+      in_image(scene.strings, scene.string_count, image, size) &&
+      in_image(scene.chunks, scene.chunk_count, image, size))) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < scene.mesh_count; ++i) {
+      const RdxImageMesh& mesh = scene.meshes[i];
+      if (!(in_image(mesh.elements, mesh.element_count, image, size) &&
+        in_image(mesh.vertices, (uint64_t)mesh.vertex_count * mesh.vertex_size, image, size) &&
+        in_image(mesh.indices, mesh.index_count, image, size))) {
+        return false;
+      }
+    }
+    for (uint32_t i = 0; i < scene.track_count; ++i) {
+      if (!in_image(scene.tracks[i].keys, scene.tracks[i].key_count, image, size)) {
+        return false;
+      }
+    }
+    for (uint32_t i = 0; i < scene.string_count; ++i) {
+      const RdxImageString& str = scene.strings[i];
+      if (!in_image(str.str, (uint64_t)str.length + 1, image, size) || str.str[str.length] != 0) {
+        return false;
+      }
+    }
+    for (uint32_t i = 0; i < scene.chunk_count; ++i) {
+      if (!in_image(scene.chunks[i].data, scene.chunks[i].size, image, size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+bool bake_image(std::vector<uint8_t>& image, RdxFile& file)
+{
+  // parse everything first, so the arrays in the scene section can be sized up front
+  RdxStringTableView strings;
+  RdxHierarchyView hierarchy;
+  std::vector<RdxMeshView> meshes;
+  std::vector<RdxAnimationView> animations;
+  std::vector<RdxCamera> cameras;
+  std::vector<RdxChunk> raw_chunks;
+  uint32_t track_count = 0;
+  bool has_strings = false;
+  bool has_hierarchy = false;
+
+  for (uint32_t i = 0; i < file.chunk_count(); ++i) {
+    RdxChunk chunk;
+    if (!file.get_chunk(chunk, i)) {
+      return false;
+    }
+    switch (chunk.id) {
+      case RdxChunkId::Mesh:
+        meshes.push_back(RdxMeshView());
+        if (!read_mesh(meshes.back(), chunk)) {
+          return false;
+        }
+        break;
+      case RdxChunkId::Animation:
+        animations.push_back(RdxAnimationView());
+        if (!read_animation(animations.back(), chunk)) {
+          return false;
+        }
+        track_count += (uint32_t)animations.back().tracks.size();
+        break;
+      case RdxChunkId::Camera: {
+        const RdxCamera* camera = NULL;
+        if (!read_camera(camera, chunk)) {
+          return false;
+        }
+        cameras.push_back(*camera);
+        break;
+      }
+      case RdxChunkId::Hierarchy:
+        if (has_hierarchy || !read_hierarchy(hierarchy, chunk)) {
+          return false;
+        }
+        has_hierarchy = true;
+        break;
+      case RdxChunkId::StringTable:
+        if (has_strings || !read_string_table(strings, chunk)) {
+          return false;
+        }
+        has_strings = true;
+        break;
+      default:
+        raw_chunks.push_back(chunk);
+        break;
+    }
+  }
+
+  ImageBuilder builder;
+  const Ref scene_ref = builder.alloc(RdxImageSection::kScene, sizeof(RdxImageScene), 16);
+  RdxImageScene scene;
+  memset(&scene, 0, sizeof(scene));
+  scene.mesh_count = (uint32_t)meshes.size();
+  scene.node_count = hierarchy.nodes.count;
+  scene.track_count = track_count;
+  scene.camera_count = (uint32_t)cameras.size();
+  scene.string_count = strings.entries.count;
+  scene.chunk_count = (uint32_t)raw_chunks.size();
+  if (!animations.empty()) {
+    scene.fps = animations[0].fps;
+    scene.start = animations[0].start;
+    scene.end = animations[0].end;
+  }
+  builder.set(scene_ref, &scene, sizeof(scene));
+
+  // strings, as full names so the runtime never walks the prefix chains
+  const Ref strings_ref = add_array<RdxImageString>(builder, scene_ref.field(offsetof(RdxImageScene, strings)),
+    RdxImageSection::kScene, NULL, scene.string_count, 16);
+  std::string name;
+  for (uint32_t i = 0; i < scene.string_count; ++i) {
+    if (!strings.get(name, i)) {
+      return false;
+    }
+    const Ref ref = strings_ref.field(i * sizeof(RdxImageString));
+    RdxImageString str;
+    str.hash = strings.entries[i].hash;
+    str.length = (uint32_t)name.size();
+    str.str.value = 0;
+    builder.set(ref, &str, sizeof(str));
+    builder.link(ref.field(offsetof(RdxImageString, str)),
+      builder.add(RdxImageSection::kStrings, name.c_str(), str.length + 1, 1));
+  }
+
+  add_array(builder, scene_ref.field(offsetof(RdxImageScene, nodes)), RdxImageSection::kScene,
+    hierarchy.nodes.data, hierarchy.nodes.count, 16);
+  add_array(builder, scene_ref.field(offsetof(RdxImageScene, cameras)), RdxImageSection::kScene,
+    cameras.empty() ? NULL : &cameras[0], scene.camera_count, 16);
+
+  const Ref meshes_ref = add_array<RdxImageMesh>(builder, scene_ref.field(offsetof(RdxImageScene, meshes)),
+    RdxImageSection::kScene, NULL, scene.mesh_count, 16);
+  std::vector<float> decoded_vertices;
+  std::vector<uint32_t> decoded_indices;
+  for (uint32_t i = 0; i < scene.mesh_count; ++i) {
+    const RdxMeshView& view = meshes[i];
+    const Ref ref = meshes_ref.field(i * sizeof(RdxImageMesh));
+    RdxImageMesh mesh;
+    memset(&mesh, 0, sizeof(mesh));
+    mesh.name = view.name;
+    mesh.parent = view.parent;
+    mesh.vertex_count = view.vertex_count;
+    mesh.vertex_size = view.vertex_size;
+    mesh.index_count = view.index_count;
+    mesh.element_count = view.elements.count;
+    mesh.aabb = *view.aabb;
+    mesh.sphere = *view.sphere;
+    mesh.bounds_flags = view.bounds_flags;
+    if (view.obb != NULL) {
+      mesh.obb = *view.obb;
+    }
+    builder.set(ref, &mesh, sizeof(mesh));
+
+    add_array(builder, ref.field(offsetof(RdxImageMesh, elements)), RdxImageSection::kScene,
+      view.elements.data, view.elements.count, 16);
+
+    // the image holds the meshes decoded, so they are usable in place
+    const uint8_t* vertices = view.vertices;
+    const uint32_t* indices = view.indices.data;
+    if (view.encoding != RdxMeshEncoding::Raw) {
+      if (!decode_mesh(decoded_vertices, decoded_indices, view)) {
+        return false;
+      }
+      vertices = decoded_vertices.empty() ? NULL : (const uint8_t*)&decoded_vertices[0];
+      indices = decoded_indices.empty() ? NULL : &decoded_indices[0];
+    }
+    add_array(builder, ref.field(offsetof(RdxImageMesh, vertices)), RdxImageSection::kVertices,
+      vertices, view.vertex_count * view.vertex_size, 64);
+    add_array(builder, ref.field(offsetof(RdxImageMesh, indices)), RdxImageSection::kIndices,
+      indices, view.index_count, 16);
+  }
+
+  const Ref tracks_ref = add_array<RdxImageTrack>(builder, scene_ref.field(offsetof(RdxImageScene, tracks)),
+    RdxImageSection::kScene, NULL, scene.track_count, 16);
+  uint32_t track_idx = 0;
+  for (size_t i = 0; i < animations.size(); ++i) {
+    for (size_t j = 0; j < animations[i].tracks.size(); ++j, ++track_idx) {
+      const RdxTrackView& view = animations[i].tracks[j];
+      const Ref ref = tracks_ref.field(track_idx * sizeof(RdxImageTrack));
+      RdxImageTrack track;
+      track.name = view.name;
+      track.key_count = view.keys.count;
+      track.keys.value = 0;
+      builder.set(ref, &track, sizeof(track));
+      add_array(builder, ref.field(offsetof(RdxImageTrack, keys)), RdxImageSection::kAnimation,
+        view.keys.data, view.keys.count, 16);
+    }
+  }
+
+  const Ref chunks_ref = add_array<RdxImageChunk>(builder, scene_ref.field(offsetof(RdxImageScene, chunks)),
+    RdxImageSection::kScene, NULL, scene.chunk_count, 16);
+  for (uint32_t i = 0; i < scene.chunk_count; ++i) {
+    const Ref ref = chunks_ref.field(i * sizeof(RdxImageChunk));
+    RdxImageChunk chunk;
+    chunk.id = raw_chunks[i].id;
+    chunk.size = raw_chunks[i].size;
+    chunk.data.value = 0;
+    builder.set(ref, &chunk, sizeof(chunk));
+    add_array(builder, ref.field(offsetof(RdxImageChunk, data)), RdxImageSection::kChunks,
+      raw_chunks[i].data, raw_chunks[i].size, 16);
+  }
+
+  builder.finish(image, scene_ref);
+  return true;
+}
+
+RdxImageScene* fixup_image(uint8_t* image, const uint32_t size)
+{
+  if (image == NULL || (uintptr_t)image % kRdxImageAlignment || size < sizeof(RdxImageHeader)) {
+    return NULL;
+  }
+
+  RdxImageHeader* header = (RdxImageHeader*)image;
+  if (header->magic != kRdxImageMagic || header->version != kRdxImageVersion ||
+    (header->flags & RdxImageHeader::kFixedUp) || header->image_size != size) {
+    return NULL;
+  }
+
+  // sizes are checked in 64 bits, so a corrupt count can't wrap around
+  if (sizeof(RdxImageHeader) + (uint64_t)header->section_count * sizeof(RdxImageSection) > size ||
+    header->fixup_offset % sizeof(uint32_t) ||
+    header->fixup_offset + (uint64_t)header->fixup_count * sizeof(uint32_t) > size ||
+    header->scene_offset % 16 || (uint64_t)header->scene_offset + sizeof(RdxImageScene) > size) {
+    return NULL;
+  }
+
+  const RdxImageSection* sections = (const RdxImageSection*)(image + sizeof(RdxImageHeader));
+  for (uint32_t i = 0; i < header->section_count; ++i) {
+    const RdxImageSection& section = sections[i];
+    if (section.alignment == 0 || section.offset % section.alignment ||
+      (uint64_t)section.offset + section.size > size) {
+      return NULL;
+    }
+  }
+
+  // one pass over the fixup table, checking that both the slot and its target are in the
+  // image. A failed image is left partially patched, and must be discarded.
+  const uint32_t* fixups = (const uint32_t*)(image + header->fixup_offset);
+  for (uint32_t i = 0; i < header->fixup_count; ++i) {
+    const uint32_t slot = fixups[i];
+    if (slot % sizeof(uint64_t) || (uint64_t)slot + sizeof(uint64_t) > size) {
+      return NULL;
+    }
+    RdxPtr<uint8_t>* ptr = (RdxPtr<uint8_t>*)(image + slot);
+    if (ptr->value == 0 || ptr->value >= size) {
+      return NULL;
+    }
+    ptr->value += (uintptr_t)image;
+  }
+
+  RdxImageScene* scene = (RdxImageScene*)(image + header->scene_offset);
+  if (!validate_scene(*scene, image, size)) {
+    return NULL;
+  }
+  header->flags |= RdxImageHeader::kFixedUp;
+  return scene;
+}
@@ -0,0 +1,148 @@
+#ifndef RDX_IMAGE_HPP
+#define RDX_IMAGE_HPP
+
+/**
+ * Load in place image of an exported scene (.rdi). The image holds the scene in its final
+ * runtime layout, so loading is a read into a 64 byte aligned buffer followed by
+ * fixup_image, which turns the image relative offsets into pointers in a single pass over
+ * the fixup table.
+ *
+ *   RdxImageHeader
+ *   RdxImageSection[section_count]
+ *   sections, each 64 byte aligned
+ *   fixup table: the image offsets of all the RdxPtr slots
+ *
+ * The scene section starts with the RdxImageScene root. Vertex buffers are 64 byte aligned and
+ * index buffers and animation keys 16 byte aligned, so they can be handed straight to the GPU
+ * or used with SSE. Strings are stored as full, zero terminated names. Chunks without a
+ * runtime layout (materials) are carried over as is.
+ *
+ * bake_image builds an image from an .rdx file, so images can be made from existing exports.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "RdxFormat.hpp"
+
+class RdxFile;
+
+const uint32_t kRdxImageMagic = 0x49584452;     // "RDXI"
+const uint32_t kRdxImageVersion = 1;
+const uint32_t kRdxImageAlignment = 64;
+
+// An image relative offset until the image is fixed up, and then the address. Always 64 bits,
+// so 32 and 64 bit runtimes load the same image.
+template <class T>
+struct RdxPtr
+{
+  T* get() const { return (T*)(uintptr_t)value; }
+  T* operator->() const { return get(); }
+  T& operator[](const uint32_t idx) const { return get()[idx]; }
+  uint64_t value;
+};
+
+struct RdxImageSection
+{
+  enum Type
+  {
+    kScene,
+    kVertices,
+    kIndices,
+    kAnimation,
+    kStrings,
+    kChunks,
+    kNumSections
+  };
+
+  uint32_t type;
+  uint32_t alignment;
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct RdxImageHeader
+{
+  enum Flags
+  {
+    kFixedUp = 1 << 0,
+  };
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t flags;
+  uint32_t image_size;
+  uint32_t section_count;
+  uint32_t fixup_offset;
+  uint32_t fixup_count;
+  uint32_t scene_offset;
+};
+
+struct RdxImageMesh
+{
+  uint32_t name;            // index into RdxImageScene::strings
+  uint32_t parent;
+  uint32_t vertex_count;
+  uint32_t vertex_size;
+  uint32_t index_count;
+  uint32_t element_count;
+  RdxPtr<RdxElementDesc> elements;
+  RdxPtr<uint8_t> vertices;
+  RdxPtr<uint32_t> indices;
+  RdxAabb aabb;
+  RdxSphere sphere;
+  uint32_t bounds_flags;
+  uint32_t pad;
+  RdxObb obb;               // valid when bounds_flags has kRdxObbFlag
+};
+
+struct RdxImageTrack
+{
+  uint32_t name;
+  uint32_t key_count;
+  RdxPtr<RdxAnimationKey> keys;
+};
+
+struct RdxImageString
+{
+  uint32_t hash;            // FNV-1a, as in the string table
+  uint32_t length;
+  RdxPtr<char> str;
+};
+
+struct RdxImageChunk
+{
+  uint32_t id;              // RdxChunkId
+  uint32_t size;
+  RdxPtr<uint8_t> data;
+};
+
+struct RdxImageScene
+{
+  uint32_t mesh_count;
+  uint32_t node_count;
+  uint32_t track_count;
+  uint32_t camera_count;
+  uint32_t string_count;
+  uint32_t chunk_count;
+  uint32_t fps;
+  float start;
+  float end;
+  uint32_t pad;
+  RdxPtr<RdxImageMesh> meshes;
+  RdxPtr<RdxHierarchyNode> nodes;
+  RdxPtr<RdxImageTrack> tracks;
+  RdxPtr<RdxCamera> cameras;
+  RdxPtr<RdxImageString> strings;
+  RdxPtr<RdxImageChunk> chunks;
+};
+
+// Builds the image of all the chunks in the file
+bool bake_image(std::vector<uint8_t>& image, RdxFile& file);
+
+// Validates the image and patches its pointers in place. The image must be 64 byte aligned and
+// must outlive the returned scene. Returns NULL if the image is invalid. Every array of the scene
+// is checked to be inside the image for its count, and every string to be terminated, but the
+// contents aren't: indices and string indices are only as good as the exporter that wrote them.
+RdxImageScene* fixup_image(uint8_t* image, const uint32_t size);
+
+#endif
@@ -0,0 +1,500 @@
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include "RdxMeshCodec.hpp"
+
+namespace
+{
+  const uint32_t kFifoSize = 16;
+  const uint32_t kFreeTriangle = 15;
+  const uint32_t kExplicitVertex = 15;
+  const uint32_t kDecodeBatch = 256;
+
+  int16_t to_snorm16(const float value)
+  {
+    return (int16_t)floorf(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f + 0.5f);
+  }
+
+  float sign_not_zero(const float value)
+  {
+    return value >= 0 ? 1.0f : -1.0f;
+  }
+
+  // Projects the unit vector onto the octahedron, and folds the lower half over the upper one
+  void encode_octahedral(int16_t* out, const float* n)
+  {
+    const float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = l1 > 0 ? n[0] / l1 : 0;
+    float y = l1 > 0 ? n[1] / l1 : 0;
+    if (n[2] < 0) {
+      const float fx = x;
+      x = (1 - fabsf(y)) * sign_not_zero(fx);
+      y = (1 - fabsf(fx)) * sign_not_zero(y);
+    }
+    out[0] = to_snorm16(x);
+    out[1] = to_snorm16(y);
+  }
+
+  void decode_octahedral(float* n, const int16_t* in)
+  {
+    float x = std::max(-1.0f, in[0] / 32767.0f);
+    float y = std::max(-1.0f, in[1] / 32767.0f);
+    const float z = 1 - fabsf(x) - fabsf(y);
+    if (z < 0) {
+      const float fx = x;
+      x = (1 - fabsf(y)) * sign_not_zero(fx);
+      y = (1 - fabsf(fx)) * sign_not_zero(y);
+    }
+    const float len = sqrtf(x * x + y * y + z * z);
+    const float scale = len > 0 ? 1 / len : 0;
+    n[0] = x * scale;
+    n[1] = y * scale;
+    n[2] = z * scale;
+  }
+
+  bool valid_stream(const RdxVertexStream& stream, const uint32_t vertex_size)
+  {
+    switch (stream.kind) {
+      case RdxVertexStream::kFloat: break;
+      case RdxVertexStream::kQuantizedPosition: if (stream.float_count != 3) return false; break;
+      case RdxVertexStream::kOctahedralNormal: if (stream.float_count != 3) return false; break;
+      case RdxVertexStream::kOctahedralTangent: if (stream.float_count != 4) return false; break;
+      default: return false;
+    }
+    return stream.float_count > 0 && stream.float_offset <= vertex_size && stream.float_count <= vertex_size - stream.float_offset;
+  }
+
+  void encode_element(uint8_t* out, const float* v, const RdxVertexStream& stream, const RdxQuantization& grid)
+  {
+    switch (stream.kind) {
+      case RdxVertexStream::kQuantizedPosition: {
+        uint16_t q[3];
+        for (int i = 0; i < 3; ++i) {
+          const float t = grid.step[i] > 0 ? floorf((v[i] - grid.min[i]) / grid.step[i] + 0.5f) : 0;
+          q[i] = (uint16_t)std::max(0.0f, std::min(65535.0f, t));
+        }
+        memcpy(out, q, sizeof(q));
+        break;
+      }
+      case RdxVertexStream::kOctahedralNormal: {
+        int16_t oct[2];
+        encode_octahedral(oct, v);
+        memcpy(out, oct, sizeof(oct));
+        break;
+      }
+      case RdxVertexStream::kOctahedralTangent: {
+        int16_t oct[3];
+        encode_octahedral(oct, v);
+        oct[2] = v[3] < 0 ? -32767 : 32767;
+        memcpy(out, oct, sizeof(oct));
+        break;
+      }
+      default:
+        memcpy(out, v, stream.float_count * sizeof(float));
+        break;
+    }
+  }
+
+  // Decodes count interleaved elements of the stream into consecutive vertices
+  void decode_elements(float* vertices, const uint32_t vertex_size, const uint8_t* elements, const uint32_t count,
+                       const RdxVertexStream& stream, const RdxQuantization& grid)
+  {
+    const uint32_t element_size = encoded_stream_size(stream);
+    float* v = vertices + stream.float_offset;
+    switch (stream.kind) {
+      case RdxVertexStream::kQuantizedPosition:
+        for (uint32_t i = 0; i < count; ++i, v += vertex_size, elements += element_size) {
+          uint16_t q[3];
+          memcpy(q, elements, sizeof(q));
+          v[0] = grid.min[0] + q[0] * grid.step[0];
+          v[1] = grid.min[1] + q[1] * grid.step[1];
+          v[2] = grid.min[2] + q[2] * grid.step[2];
+        }
+        break;
+      case RdxVertexStream::kOctahedralNormal:
+        for (uint32_t i = 0; i < count; ++i, v += vertex_size, elements += element_size) {
+          int16_t oct[2];
+          memcpy(oct, elements, sizeof(oct));
+          decode_octahedral(v, oct);
+        }
+        break;
+      case RdxVertexStream::kOctahedralTangent:
+        for (uint32_t i = 0; i < count; ++i, v += vertex_size, elements += element_size) {
+          int16_t oct[3];
+          memcpy(oct, elements, sizeof(oct));
+          decode_octahedral(v, oct);
+          v[3] = oct[2] < 0 ? -1.0f : 1.0f;
+        }
+        break;
+      default:
+        for (uint32_t i = 0; i < count; ++i, v += vertex_size, elements += element_size) {
+          memcpy(v, elements, element_size);
+        }
+        break;
+    }
+  }
+
+  template <class T>
+  void append(std::vector<uint8_t>& out, const T& value)
+  {
+    const uint8_t* p = (const uint8_t*)&value;
+    out.insert(out.end(), p, p + sizeof(T));
+  }
+
+  void write_varint(std::vector<uint8_t>& out, const uint32_t delta)
+  {
+    const int32_t d = (int32_t)delta;
+    uint32_t value = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+    while (value >= 0x80) {
+      out.push_back((uint8_t)(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+  }
+
+  bool read_varint(uint32_t& delta, const uint8_t*& cur, const uint8_t* end)
+  {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+      if (cur == end) {
+        return false;
+      }
+      const uint8_t b = *cur++;
+      value |= (uint32_t)(b & 0x7f) << shift;
+      if (!(b & 0x80)) {
+        delta = (value >> 1) ^ (0 - (value & 1));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The encoder and decoder state, which has to evolve the same way on both sides
+  class IndexFifos
+  {
+  public:
+    IndexFifos() : edge_offset_(0), vertex_offset_(0)
+    {
+      memset(edges_, 0xff, sizeof(edges_));
+      memset(vertices_, 0xff, sizeof(vertices_));
+    }
+
+    void push_edge(const uint32_t a, const uint32_t b)
+    {
+      edges_[edge_offset_][0] = a;
+      edges_[edge_offset_][1] = b;
+      edge_offset_ = (edge_offset_ + 1) & (kFifoSize - 1);
+    }
+
+    void push_vertex(const uint32_t v)
+    {
+      vertices_[vertex_offset_] = v;
+      vertex_offset_ = (vertex_offset_ + 1) & (kFifoSize - 1);
+    }
+
+    // age 0 is the newest entry
+    const uint32_t* edge(const uint32_t age) const { return edges_[(edge_offset_ - 1 - age) & (kFifoSize - 1)]; }
+    uint32_t vertex(const uint32_t age) const { return vertices_[(vertex_offset_ - 1 - age) & (kFifoSize - 1)]; }
+
+  private:
+    uint32_t edges_[kFifoSize][2];
+    uint32_t vertices_[kFifoSize];
+    uint32_t edge_offset_;
+    uint32_t vertex_offset_;
+  };
+}
+
+uint32_t encoded_stream_size(const RdxVertexStream& stream)
+{
+  switch (stream.kind) {
+    case RdxVertexStream::kQuantizedPosition: return 3 * sizeof(uint16_t);
+    case RdxVertexStream::kOctahedralNormal: return 2 * sizeof(int16_t);
+    case RdxVertexStream::kOctahedralTangent: return 3 * sizeof(int16_t);
+    default: return stream.float_count * sizeof(float);
+  }
+}
+
+uint64_t min_encoded_vertices_size(const uint32_t vertex_count, const uint32_t vertex_size)
+{
+  // 2 int16 for 3 floats
+  const uint64_t vertex_bytes = ((uint64_t)vertex_size * 4 + 2) / 3;
+  return sizeof(uint32_t) + sizeof(RdxQuantization) + vertex_bytes * vertex_count;
+}
+
+bool encode_vertices(std::vector<uint8_t>& out, const float* vertices, const uint32_t vertex_count,
+                     const uint32_t vertex_size, const std::vector<RdxVertexStream>& streams)
+{
+  out.clear();
+  RdxQuantization grid;
+  float max[3];
+  for (int i = 0; i < 3; ++i) {
+    grid.min[i] = FLT_MAX;
+    max[i] = -FLT_MAX;
+  }
+  for (size_t s = 0; s < streams.size(); ++s) {
+    if (!valid_stream(streams[s], vertex_size)) {
+      return false;
+    }
+    if (streams[s].kind != RdxVertexStream::kQuantizedPosition) {
+      continue;
+    }
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      const float* p = vertices + i * vertex_size + streams[s].float_offset;
+      for (int j = 0; j < 3; ++j) {
+        grid.min[j] = std::min(grid.min[j], p[j]);
+        max[j] = std::max(max[j], p[j]);
+      }
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (grid.min[i] > max[i]) {
+      grid.min[i] = max[i] = 0;
+    }
+    grid.step[i] = (max[i] - grid.min[i]) / 65535.0f;
+  }
+
+  append(out, (uint32_t)streams.size());
+  for (size_t s = 0; s < streams.size(); ++s) {
+    append(out, streams[s]);
+  }
+  append(out, grid);
+
+  std::vector<uint8_t> element;
+  for (size_t s = 0; s < streams.size(); ++s) {
+    const RdxVertexStream& stream = streams[s];
+    const uint32_t element_size = encoded_stream_size(stream);
+    element.assign(element_size, 0);
+    std::vector<uint8_t> prev(element_size, 0);
+    const size_t planes = out.size();
+    out.resize(planes + (size_t)element_size * vertex_count);
+    for (uint32_t i = 0; i < vertex_count; ++i) {
+      encode_element(&element[0], vertices + i * vertex_size + stream.float_offset, stream, grid);
+      for (uint32_t b = 0; b < element_size; ++b) {
+        out[planes + (size_t)b * vertex_count + i] = (uint8_t)(element[b] - prev[b]);
+      }
+      prev.swap(element);
+    }
+  }
+  return true;
+}
+
+bool decode_vertices(float* vertices, const uint32_t vertex_count, const uint32_t vertex_size,
+                     const uint8_t* data, const uint32_t size)
+{
+  uint32_t stream_count = 0;
+  if (size < sizeof(uint32_t) + sizeof(RdxQuantization)) {
+    return false;
+  }
+  memcpy(&stream_count, data, sizeof(uint32_t));
+  if (stream_count > (size - sizeof(uint32_t) - sizeof(RdxQuantization)) / sizeof(RdxVertexStream)) {
+    return false;
+  }
+
+  std::vector<RdxVertexStream> streams(stream_count);
+  if (stream_count > 0) {
+    memcpy(&streams[0], data + sizeof(uint32_t), stream_count * sizeof(RdxVertexStream));
+  }
+  RdxQuantization grid;
+  const uint32_t header_size = sizeof(uint32_t) + stream_count * sizeof(RdxVertexStream) + sizeof(RdxQuantization);
+  memcpy(&grid, data + header_size - sizeof(RdxQuantization), sizeof(RdxQuantization));
+
+  if ((uint64_t)size < min_encoded_vertices_size(vertex_count, vertex_size)) {
+    return false;
+  }
+
+  // each float of the vertex is in exactly one stream
+  std::vector<bool> covered(vertex_size, false);
+  uint64_t planes_size = 0;
+  for (uint32_t s = 0; s < stream_count; ++s) {
+    if (!valid_stream(streams[s], vertex_size)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < streams[s].float_count; ++i) {
+      if (covered[streams[s].float_offset + i]) {
+        return false;
+      }
+      covered[streams[s].float_offset + i] = true;
+    }
+    planes_size += (uint64_t)encoded_stream_size(streams[s]) * vertex_count;
+  }
+  if (std::find(covered.begin(), covered.end(), false) != covered.end() || planes_size != size - header_size) {
+    return false;
+  }
+
+  // the deltas are undone a plane at a time into a batch of interleaved elements, which are
+  // then decoded with the loop for their kind
+  const uint8_t* planes = data + header_size;
+  std::vector<uint8_t> elements;
+  std::vector<uint8_t> acc;
+  for (uint32_t s = 0; s < stream_count; ++s) {
+    const RdxVertexStream& stream = streams[s];
+    const uint32_t element_size = encoded_stream_size(stream);
+    elements.resize(kDecodeBatch * element_size);
+    acc.assign(element_size, 0);
+    for (uint32_t first = 0; first < vertex_count; first += kDecodeBatch) {
+      const uint32_t count = std::min<uint32_t>(kDecodeBatch, vertex_count - first);
+      for (uint32_t b = 0; b < element_size; ++b) {
+        const uint8_t* plane = planes + (size_t)b * vertex_count + first;
+        uint8_t* out = &elements[b];
+        uint8_t value = acc[b];
+        for (uint32_t i = 0; i < count; ++i, out += element_size) {
+          value = (uint8_t)(value + plane[i]);
+          *out = value;
+        }
+        acc[b] = value;
+      }
+      decode_elements(vertices + (size_t)first * vertex_size, vertex_size, &elements[0], count, stream, grid);
+    }
+    planes += (size_t)element_size * vertex_count;
+  }
+  return true;
+}
+
+bool encode_indices(std::vector<uint8_t>& out, const uint32_t* indices, const uint32_t index_count)
+{
+  out.clear();
+  if (index_count % 3) {
+    return false;
+  }
+
+  const uint32_t triangle_count = index_count / 3;
+  std::vector<uint8_t> data;
+  out.resize(triangle_count);
+  IndexFifos fifos;
+  uint32_t next = 0;
+  uint32_t last = 0;
+  for (uint32_t t = 0; t < triangle_count; ++t) {
+    const uint32_t* tri = indices + 3 * t;
+
+    // look for a recent edge, rotating the triangle so the edge comes first
+    uint32_t edge_age = kFreeTriangle;
+    uint32_t rotation = 0;
+    for (uint32_t age = 0; age < kFreeTriangle && edge_age == kFreeTriangle; ++age) {
+      const uint32_t* edge = fifos.edge(age);
+      for (uint32_t r = 0; r < 3; ++r) {
+        if (edge[0] == tri[r] && edge[1] == tri[(r + 1) % 3]) {
+          edge_age = age;
+          rotation = r;
+          break;
+        }
+      }
+    }
+
+    if (edge_age != kFreeTriangle) {
+      const uint32_t a = tri[rotation];
+      const uint32_t b = tri[(rotation + 1) % 3];
+      const uint32_t c = tri[(rotation + 2) % 3];
+      uint32_t vertex_code = kExplicitVertex;
+      if (c == next) {
+        vertex_code = 0;
+        ++next;
+        fifos.push_vertex(c);
+      } else {
+        for (uint32_t age = 0; age < kExplicitVertex - 1; ++age) {
+          if (fifos.vertex(age) == c) {
+            vertex_code = age + 1;
+            break;
+          }
+        }
+        if (vertex_code == kExplicitVertex) {
+          write_varint(data, c - last);
+          last = c;
+          fifos.push_vertex(c);
+        }
+      }
+      out[t] = (uint8_t)(edge_age << 4 | vertex_code);
+      fifos.push_edge(c, b);
+      fifos.push_edge(a, c);
+    } else {
+      uint32_t flags = 0;
+      for (uint32_t k = 0; k < 3; ++k) {
+        if (tri[k] == next) {
+          flags |= 1 << k;
+          ++next;
+        } else {
+          write_varint(data, tri[k] - last);
+          last = tri[k];
+        }
+        fifos.push_vertex(tri[k]);
+      }
+      out[t] = (uint8_t)(kFreeTriangle << 4 | flags);
+      fifos.push_edge(tri[1], tri[0]);
+      fifos.push_edge(tri[2], tri[1]);
+      fifos.push_edge(tri[0], tri[2]);
+    }
+  }
+
+  out.insert(out.end(), data.begin(), data.end());
+  return true;
+}
+
+uint64_t min_encoded_indices_size(const uint32_t index_count)
+{
+  return index_count / 3;
+}
+
+bool decode_indices(uint32_t* indices, const uint32_t index_count, const uint32_t vertex_count,
+                    const uint8_t* data, const uint32_t size)
+{
+  const uint32_t triangle_count = index_count / 3;
+  if (index_count % 3 || size < min_encoded_indices_size(index_count)) {
+    return false;
+  }
+
+  const uint8_t* codes = data;
+  const uint8_t* cur = data + triangle_count;
+  const uint8_t* end = data + size;
+  IndexFifos fifos;
+  uint32_t next = 0;
+  uint32_t last = 0;
+  for (uint32_t t = 0; t < triangle_count; ++t) {
+    uint32_t* tri = indices + 3 * t;
+    const uint32_t code = codes[t];
+    if ((code >> 4) != kFreeTriangle) {
+      const uint32_t* edge = fifos.edge(code >> 4);
+      const uint32_t a = edge[0];
+      const uint32_t b = edge[1];
+      uint32_t c = 0;
+      const uint32_t vertex_code = code & 15;
+      if (vertex_code == 0) {
+        c = next++;
+        fifos.push_vertex(c);
+      } else if (vertex_code < kExplicitVertex) {
+        c = fifos.vertex(vertex_code - 1);
+      } else {
+        uint32_t delta = 0;
+        if (!read_varint(delta, cur, end)) {
+          return false;
+        }
+        c = last += delta;
+        fifos.push_vertex(c);
+      }
+      tri[0] = a;
+      tri[1] = b;
+      tri[2] = c;
+      fifos.push_edge(c, b);
+      fifos.push_edge(a, c);
+    } else {
+      for (uint32_t k = 0; k < 3; ++k) {
+        if (code & (1 << k)) {
+          tri[k] = next++;
+        } else {
+          uint32_t delta = 0;
+          if (!read_varint(delta, cur, end)) {
+            return false;
+          }
+          tri[k] = last += delta;
+        }
+        fifos.push_vertex(tri[k]);
+      }
+      fifos.push_edge(tri[1], tri[0]);
+      fifos.push_edge(tri[2], tri[1]);
+      fifos.push_edge(tri[0], tri[2]);
+    }
+    if (tri[0] >= vertex_count || tri[1] >= vertex_count || tri[2] >= vertex_count) {
+      return false;
+    }
+  }
+  return cur == end;
+}
@@ -0,0 +1,76 @@
+#ifndef RDX_MESH_CODEC_HPP
+#define RDX_MESH_CODEC_HPP
+
+/**
+ * Encoding of the vertex and index data of kRdxMeshEncoded Mesh chunks. Both decode back to
+ * the raw layout, so the element descs still describe the decoded vertices.
+ *
+ * Vertices: [stream count, RdxVertexStream[stream count], RdxQuantization, planes]
+ *   Each stream is a run of floats in the vertex. Positions are quantized to 16 bits on the
+ *   grid of the RdxQuantization, normals and tangents are octahedral 16 bit snorms, and the
+ *   other streams keep their float bits. The encoded elements are split into byte planes,
+ *   each plane holding byte k of every vertex, and each byte is stored as the difference to
+ *   the same byte of the previous vertex. With the vertices in first use order that leaves
+ *   mostly small values, which is what the block compression of the container is good at.
+ *
+ * Indices: [triangle codes[index count / 3], varints]
+ *   Each triangle is coded against a fifo of the last 16 edges and a fifo of the last 16
+ *   vertices, as in the meshoptimizer index codec. A code with a high nibble below 15 reuses
+ *   that edge (0 is the newest), and its low nibble gives the third vertex: 0 is the next
+ *   unseen vertex, 1..14 the vertex fifo entry 0..13, and 15 a varint. A high nibble of 15
+ *   codes all three vertices, where bit k of the low nibble marks vertex k as the next unseen
+ *   one, and the others are varints. Varints are zigzag LEB128 deltas to the last varint
+ *   vertex. Triangles can come back rotated, which keeps their winding.
+ */
+
+#include <stdint.h>
+#include <vector>
+
+struct RdxVertexStream
+{
+  enum Kind
+  {
+    kFloat = 0,                 // float_count floats, stored as is
+    kQuantizedPosition = 1,     // 3 floats, stored as 3 uint16
+    kOctahedralNormal = 2,      // 3 floats, stored as 2 int16
+    kOctahedralTangent = 3,     // 4 floats, the last the handedness, stored as 3 int16
+  };
+
+  uint32_t kind;
+  uint32_t float_offset;        // in the decoded vertex
+  uint32_t float_count;
+};
+
+// The grid of the quantized positions: p = min + q * step
+struct RdxQuantization
+{
+  float min[3];
+  float step[3];
+};
+
+// Encoded size of one vertex of the stream
+uint32_t encoded_stream_size(const RdxVertexStream& stream);
+
+// Vertices are vertex_count vertices of vertex_size floats, described by the streams
+bool encode_vertices(std::vector<uint8_t>& out, const float* vertices, const uint32_t vertex_count,
+  const uint32_t vertex_size, const std::vector<RdxVertexStream>& streams);
+
+// The smallest encoded size of vertex_count vertices of vertex_size floats. The streams cover
+// every float of the vertex, and the octahedral normals take the fewest bytes per float
+uint64_t min_encoded_vertices_size(const uint32_t vertex_count, const uint32_t vertex_size);
+
+// Decodes into vertex_count vertices of vertex_size floats. Fails if the streams don't cover the
+// vertex or the data is short
+bool decode_vertices(float* vertices, const uint32_t vertex_count, const uint32_t vertex_size,
+  const uint8_t* data, const uint32_t size);
+
+bool encode_indices(std::vector<uint8_t>& out, const uint32_t* indices, const uint32_t index_count);
+
+// The smallest encoded size of index_count indices, which is a code per triangle
+uint64_t min_encoded_indices_size(const uint32_t index_count);
+
+// Fails if the data is short or an index is vertex_count or more
+bool decode_indices(uint32_t* indices, const uint32_t index_count, const uint32_t vertex_count,
+  const uint8_t* data, const uint32_t size);
+
+#endif
@@ -0,0 +1,630 @@
+#include <malloc.h>
+#include <string.h>
+#include <algorithm>
+#include <windows.h>
+#include <zlib.h>
+#include "RdxReader.hpp"
+#include "RdxMeshCodec.hpp"
+
+namespace
+{
+  const uint32_t kHierarchyVersion = 1;
+  const uint32_t kStringTableVersion = 1;
+  const uint32_t kBoundsVersion = 1;
+  const uint32_t kSpatialIndexVersion = 1;
+  const uint32_t kCellManifestVersion = 1;
+  const uint32_t kMeshBatchesVersion = 1;
+  const uint32_t kCameraCurvesVersion = 1;
+  const uint32_t kMorphTargetsVersion = 1;
+  const uint32_t kSkinsVersion = 1;
+
+  // Reads from a chunk, failing instead of reading past its end. Arrays are returned in place.
+  class Cursor
+  {
+  public:
+    Cursor(const RdxChunk& chunk) : cur_(chunk.data), left_(chunk.size) {}
+
+    template <class T>
+    bool read(T& value)
+    {
+      if (left_ < sizeof(T)) {
+        return false;
+      }
+      memcpy(&value, cur_, sizeof(T));
+      cur_ += sizeof(T);
+      left_ -= sizeof(T);
+      return true;
+    }
+
+    template <class T>
+    bool read_array(RdxArray<T>& arr, const uint32_t count)
+    {
+      if (count > left_ / sizeof(T)) {
+        return false;
+      }
+      arr.data = (const T*)cur_;
+      arr.count = count;
+      cur_ += count * sizeof(T);
+      left_ -= count * sizeof(T);
+      return true;
+    }
+
+    template <class T>
+    bool read_ptr(const T*& ptr)
+    {
+      RdxArray<T> arr;
+      if (!read_array(arr, 1)) {
+        return false;
+      }
+      ptr = arr.data;
+      return true;
+    }
+
+    // [byte count, bytes, padding to 4]
+    bool read_padded(RdxArray<uint8_t>& arr)
+    {
+      uint32_t count = 0;
+      if (!read(count) || count > left_ || !read_array(arr, (uint32_t)(((uint64_t)count + 3) & ~(uint64_t)3))) {
+        return false;
+      }
+      arr.count = count;
+      return true;
+    }
+
+    uint32_t left() const { return left_; }
+
+  private:
+    const uint8_t* cur_;
+    uint32_t left_;
+  };
+
+  // The counts of an encoded mesh fit in its encoded bytes, which bounds what decoding allocates
+  bool encoded_counts_fit(const RdxMeshView& mesh)
+  {
+    return mesh.vertex_size % sizeof(float) == 0 && mesh.index_count % 3 == 0 &&
+      min_encoded_vertices_size(mesh.vertex_count, mesh.vertex_size / sizeof(float)) <= mesh.encoded_vertices.count &&
+      min_encoded_indices_size(mesh.index_count) <= mesh.encoded_indices.count;
+  }
+}
+
+RdxFile::RdxFile()
+  : file_handle_(INVALID_HANDLE_VALUE)
+  , mapping_handle_(NULL)
+  , base_(NULL)
+  , size_(0)
+  , header_(NULL)
+  , chunks_(NULL)
+  , blocks_(NULL)
+  , data_(NULL)
+  , inflated_(NULL)
+  , inflated_blocks_(0)
+{
+}
+
+RdxFile::~RdxFile()
+{
+  close();
+}
+
+bool RdxFile::open(const char* filename)
+{
+  close();
+  file_handle_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    return fail(std::string("Unable to open ") + filename);
+  }
+
+  DWORD size_high = 0;
+  size_ = GetFileSize(file_handle_, &size_high);
+  if (size_high != 0 || size_ < sizeof(RdxFileHeader)) {
+    return fail("Invalid file size");
+  }
+
+  mapping_handle_ = CreateFileMappingA(file_handle_, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping_handle_ == NULL) {
+    return fail("Unable to create the file mapping");
+  }
+  base_ = (const uint8_t*)MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+  if (base_ == NULL) {
+    return fail("Unable to map the file");
+  }
+  return validate();
+}
+
+bool RdxFile::open_memory(const uint8_t* data, const uint32_t size)
+{
+  close();
+  base_ = data;
+  size_ = size;
+  if (base_ == NULL || size_ < sizeof(RdxFileHeader)) {
+    return fail("Invalid file size");
+  }
+  return validate();
+}
+
+void RdxFile::close()
+{
+  if (mapping_handle_ != NULL) {
+    if (base_ != NULL) {
+      UnmapViewOfFile(base_);
+    }
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+  }
+  _aligned_free(inflated_);
+
+  file_handle_ = INVALID_HANDLE_VALUE;
+  mapping_handle_ = NULL;
+  base_ = NULL;
+  size_ = 0;
+  header_ = NULL;
+  chunks_ = NULL;
+  blocks_ = NULL;
+  data_ = NULL;
+  inflated_ = NULL;
+  block_loaded_.clear();
+  inflated_blocks_ = 0;
+}
+
+bool RdxFile::fail(const std::string& msg)
+{
+  close();
+  error_ = msg;
+  return false;
+}
+
+bool RdxFile::validate()
+{
+  // All the sizes are checked in 64 bits, so a corrupt count can't wrap around
+  const RdxFileHeader* header = (const RdxFileHeader*)base_;
+  if (header->magic != kRdxMagic) {
+    return fail("Not an rdx file");
+  }
+  if (header->version != kRdxVersion) {
+    return fail("Unsupported rdx version");
+  }
+
+  const bool block_compressed = (header->flags & RdxFileHeader::kBlockCompressed) != 0;
+  const uint64_t tables_end = sizeof(RdxFileHeader) + (uint64_t)header->chunk_count * sizeof(RdxChunkEntry) +
+    (uint64_t)header->block_count * sizeof(RdxBlockEntry);
+  if (tables_end > header->data_offset || header->data_offset > size_ || header->data_offset % kRdxAlignment) {
+    return fail("Invalid chunk or block table size");
+  }
+
+  for (uint32_t i = 0; i < header->chunk_count; ++i) {
+    const RdxChunkEntry& chunk = ((const RdxChunkEntry*)(base_ + sizeof(RdxFileHeader)))[i];
+    if (chunk.offset % kRdxAlignment || (uint64_t)chunk.offset + chunk.size > header->data_size) {
+      return fail("Invalid chunk size");
+    }
+  }
+
+  if (block_compressed) {
+    if (header->block_size == 0 ||
+      header->block_count != (uint32_t)(((uint64_t)header->data_size + header->block_size - 1) / header->block_size)) {
+      return fail("Invalid block count");
+    }
+    const RdxBlockEntry* blocks = (const RdxBlockEntry*)(base_ + sizeof(RdxFileHeader) + header->chunk_count * sizeof(RdxChunkEntry));
+    for (uint32_t i = 0; i < header->block_count; ++i) {
+      const uint32_t block_data_size = std::min<uint32_t>(header->block_size, header->data_size - i * header->block_size);
+      if ((uint64_t)blocks[i].offset + blocks[i].compressed_size > size_ || blocks[i].compressed_size > block_data_size) {
+        return fail("Invalid block size");
+      }
+    }
+    blocks_ = blocks;
+  } else {
+    if (header->block_count != 0 || (uint64_t)header->data_offset + header->data_size > size_) {
+      return fail("Invalid data size");
+    }
+    data_ = base_ + header->data_offset;
+  }
+
+  header_ = header;
+  chunks_ = (const RdxChunkEntry*)(base_ + sizeof(RdxFileHeader));
+  return true;
+}
+
+uint32_t RdxFile::find_chunk(const RdxChunkId::Enum id, const uint32_t start) const
+{
+  for (uint32_t i = start; i < chunk_count(); ++i) {
+    if (chunks_[i].id == (uint32_t)id) {
+      return i;
+    }
+  }
+  return kRdxInvalidIndex;
+}
+
+bool RdxFile::get_chunk(RdxChunk& chunk, const uint32_t idx)
+{
+  if (idx >= chunk_count()) {
+    error_ = "Invalid chunk index";
+    return false;
+  }
+
+  const RdxChunkEntry& entry = chunks_[idx];
+  if (compressed() && entry.size > 0) {
+    const uint32_t first = entry.offset / header_->block_size;
+    const uint32_t last = (entry.offset + entry.size - 1) / header_->block_size;
+    if (!inflate_blocks(first, last)) {
+      return false;
+    }
+  }
+
+  chunk.id = entry.id;
+  chunk.data = (compressed() ? inflated_ : data_) + entry.offset;
+  chunk.size = entry.size;
+  return true;
+}
+
+bool RdxFile::inflate_blocks(const uint32_t first, const uint32_t last)
+{
+  if (inflated_ == NULL) {
+    inflated_ = (uint8_t*)_aligned_malloc(std::max<uint32_t>(header_->data_size, 1), kRdxAlignment);
+    if (inflated_ == NULL) {
+      error_ = "Out of memory";
+      return false;
+    }
+    block_loaded_.resize(header_->block_count, false);
+  }
+
+  for (uint32_t i = first; i <= last; ++i) {
+    if (block_loaded_[i]) {
+      continue;
+    }
+    const RdxBlockEntry& block = blocks_[i];
+    const uint32_t offset = i * header_->block_size;
+    const uint32_t size = std::min<uint32_t>(header_->block_size, header_->data_size - offset);
+    if (block.compressed_size == size) {
+      memcpy(inflated_ + offset, base_ + block.offset, size);
+    } else {
+      uLongf inflated_size = size;
+      if (uncompress(inflated_ + offset, &inflated_size, base_ + block.offset, block.compressed_size) != Z_OK ||
+        inflated_size != size) {
+        error_ = "Corrupt compressed block";
+        return false;
+      }
+    }
+    block_loaded_[i] = true;
+    ++inflated_blocks_;
+  }
+  return true;
+}
+
+bool RdxStringTableView::get(std::string& str, const uint32_t idx) const
+{
+  if (idx >= entries.count) {
+    return false;
+  }
+
+  // collect the suffixes from the entry up to the first prefix
+  uint32_t suffixes[256];
+  uint32_t depth = 0;
+  for (uint32_t cur = idx; cur != kRdxInvalidIndex; cur = entries[cur].prefix) {
+    if (cur >= entries.count || depth == sizeof(suffixes) / sizeof(suffixes[0])) {
+      return false;
+    }
+    suffixes[depth++] = cur;
+  }
+
+  str.clear();
+  str.reserve(entries[idx].length);
+  while (depth > 0) {
+    const RdxStringEntry& entry = entries[suffixes[--depth]];
+    if (entry.suffix_offset >= chars.count) {
+      return false;
+    }
+    const char* suffix = chars.data + entry.suffix_offset;
+    str.append(suffix, strnlen(suffix, chars.count - entry.suffix_offset));
+  }
+  return str.size() == entries[idx].length;
+}
+
+bool read_mesh(RdxMeshView& mesh, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t element_count = 0;
+  if (!(cursor.read(mesh.name) && cursor.read(mesh.parent) &&
+    cursor.read(element_count) && cursor.read_array(mesh.elements, element_count))) {
+    return false;
+  }
+
+  if (!(cursor.read(mesh.encoding) && cursor.read(mesh.vertex_count) && cursor.read(mesh.vertex_size)) ||
+    mesh.vertex_size == 0) {
+    return false;
+  }
+  for (uint32_t i = 0; i < mesh.elements.count; ++i) {
+    if (mesh.elements[i].byte_offset >= mesh.vertex_size) {
+      return false;
+    }
+  }
+
+  uint32_t index_size = 0;
+  if (mesh.encoding == RdxMeshEncoding::Raw) {
+    RdxArray<uint8_t> vertices;
+    if ((uint64_t)mesh.vertex_count * mesh.vertex_size > cursor.left() ||
+      !cursor.read_array(vertices, mesh.vertex_count * mesh.vertex_size) ||
+      !(cursor.read(mesh.index_count) && cursor.read(index_size)) || index_size != sizeof(uint32_t) ||
+      !cursor.read_array(mesh.indices, mesh.index_count)) {
+      return false;
+    }
+    mesh.vertices = vertices.data;
+  } else if (mesh.encoding == RdxMeshEncoding::Encoded) {
+    // the decoded vertices are floats
+    if (mesh.vertex_size % sizeof(float) ||
+      !cursor.read_padded(mesh.encoded_vertices) ||
+      !(cursor.read(mesh.index_count) && cursor.read(index_size)) || index_size != sizeof(uint32_t) ||
+      !cursor.read_padded(mesh.encoded_indices) || !encoded_counts_fit(mesh)) {
+      return false;
+    }
+    mesh.vertices = NULL;
+    mesh.indices = RdxArray<uint32_t>();
+  } else {
+    return false;
+  }
+
+  uint32_t bounds_version = 0;
+  if (!(cursor.read(bounds_version) && bounds_version == kBoundsVersion &&
+    cursor.read(mesh.bounds_mode) && cursor.read(mesh.bounds_flags) &&
+    cursor.read_ptr(mesh.aabb) && cursor.read_ptr(mesh.sphere))) {
+    return false;
+  }
+  mesh.obb = NULL;
+  return (mesh.bounds_flags & kRdxObbFlag) ? cursor.read_ptr(mesh.obb) : true;
+}
+
+bool decode_mesh(std::vector<float>& vertices, std::vector<uint32_t>& indices, const RdxMeshView& mesh)
+{
+  // the counts are checked before sizing the buffers, as the view doesn't have to come from read_mesh
+  if (mesh.encoding == RdxMeshEncoding::Encoded && !encoded_counts_fit(mesh)) {
+    return false;
+  }
+  const uint32_t vertex_floats = mesh.vertex_size / sizeof(float);
+  vertices.resize((size_t)mesh.vertex_count * vertex_floats);
+  indices.resize(mesh.index_count);
+  if (mesh.encoding == RdxMeshEncoding::Raw) {
+    if (!vertices.empty()) {
+      memcpy(&vertices[0], mesh.vertices, vertices.size() * sizeof(float));
+    }
+    if (!indices.empty()) {
+      memcpy(&indices[0], mesh.indices.data, indices.size() * sizeof(uint32_t));
+    }
+    return true;
+  }
+
+  return
+    decode_vertices(vertices.empty() ? NULL : &vertices[0], mesh.vertex_count, vertex_floats,
+      mesh.encoded_vertices.data, mesh.encoded_vertices.count) &&
+    decode_indices(indices.empty() ? NULL : &indices[0], mesh.index_count, mesh.vertex_count,
+      mesh.encoded_indices.data, mesh.encoded_indices.count);
+}
+
+bool read_animation(RdxAnimationView& animation, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t track_count = 0;
+  if (!(cursor.read(animation.fps) && cursor.read(animation.start) && cursor.read(animation.end) &&
+    cursor.read(track_count))) {
+    return false;
+  }
+
+  // each track is at least a name and a key count
+  if (track_count > cursor.left() / (2 * sizeof(uint32_t))) {
+    return false;
+  }
+  animation.tracks.resize(track_count);
+  for (uint32_t i = 0; i < track_count; ++i) {
+    RdxTrackView& track = animation.tracks[i];
+    uint32_t key_count = 0;
+    if (!(cursor.read(track.name) && cursor.read(key_count) && cursor.read_array(track.keys, key_count))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool read_string_table(RdxStringTableView& strings, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t count = 0;
+  uint32_t char_count = 0;
+  return
+    cursor.read(version) && version == kStringTableVersion &&
+    cursor.read(count) && cursor.read_array(strings.entries, count) &&
+    cursor.read(char_count) && cursor.read_array(strings.chars, char_count);
+}
+
+bool read_hierarchy(RdxHierarchyView& hierarchy, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t count = 0;
+  return
+    cursor.read(version) && version == kHierarchyVersion &&
+    cursor.read(count) && cursor.read_array(hierarchy.nodes, count);
+}
+
+bool read_camera(const RdxCamera*& camera, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  return cursor.read_ptr(camera);
+}
+
+bool read_camera_curves(RdxCameraCurvesView& curves, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  const RdxCamera* camera = NULL;
+  if (!cursor.read_ptr(camera)) {
+    return false;
+  }
+  curves = RdxCameraCurvesView();
+  uint32_t version = 0;
+  if (!cursor.read(version)) {
+    return true;
+  }
+  uint32_t channel_count = 0;
+  uint32_t key_count = 0;
+  if (!(version == kCameraCurvesVersion &&
+    cursor.read(curves.sample_count) && curves.sample_count > 0 && curves.sample_count <= 0x10000 &&
+    cursor.read(curves.start) && cursor.read(curves.step) &&
+    cursor.read(channel_count) && channel_count == kRdxCameraChannels &&
+    cursor.read_array(curves.channels, channel_count) &&
+    cursor.read(key_count) && cursor.read_array(curves.keys, key_count))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < channel_count; ++i) {
+    const RdxCurveChannel& channel = curves.channels[i];
+    if (channel.key_count == 0 || (uint64_t)channel.first_key + channel.key_count > key_count) {
+      return false;
+    }
+    const RdxCurveKey* keys = &curves.keys[channel.first_key];
+    if (keys[channel.key_count - 1].sample >= curves.sample_count) {
+      return false;
+    }
+    for (uint32_t j = 1; j < channel.key_count; ++j) {
+      if (keys[j].sample <= keys[j - 1].sample) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+float evaluate_curve(const RdxCameraCurvesView& curves, const uint32_t channel, const float time)
+{
+  const RdxCurveChannel& curve = curves.channels[channel];
+  const RdxCurveKey* first = &curves.keys[curve.first_key];
+  const RdxCurveKey* last = first + curve.key_count - 1;
+  const float sample = curves.step > 0 ? (time - curves.start) / curves.step : 0;
+  if (sample <= first->sample) {
+    return curve.min + first->value * curve.scale;
+  }
+  if (sample >= last->sample) {
+    return curve.min + last->value * curve.scale;
+  }
+  // the keys around the sample
+  const RdxCurveKey* lo = first;
+  const RdxCurveKey* hi = last;
+  while (hi - lo > 1) {
+    const RdxCurveKey* mid = lo + (hi - lo) / 2;
+    if (mid->sample <= sample) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  const float t = (sample - lo->sample) / (hi->sample - lo->sample);
+  return curve.min + (lo->value + t * (hi->value - lo->value)) * curve.scale;
+}
+
+bool read_spatial_index(RdxSpatialIndexView& index, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t node_count = 0;
+  uint32_t item_count = 0;
+  if (!(cursor.read(version) && version == kSpatialIndexVersion &&
+    cursor.read(node_count) && cursor.read(item_count) &&
+    cursor.read_array(index.nodes, node_count) && cursor.read_array(index.mesh_ids, item_count))) {
+    return false;
+  }
+
+  // the second child of an inner node comes after its first one
+  for (uint32_t i = 0; i < node_count; ++i) {
+    const RdxBvhNode& node = index.nodes[i];
+    if (node.count > 0 ? (uint64_t)node.offset + node.count > item_count : node.offset <= i + 1 || node.offset >= node_count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool read_cell_manifest(RdxCellManifestView& manifest, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t count = 0;
+  return
+    cursor.read(version) && version == kCellManifestVersion &&
+    cursor.read(manifest.cell_size) && cursor.read(manifest.pack_name) &&
+    cursor.read(count) && cursor.read_array(manifest.cells, count);
+}
+
+bool read_mesh_batches(RdxMeshBatchesView& batches, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t batch_count = 0;
+  uint32_t range_count = 0;
+  if (!(cursor.read(version) && version == kMeshBatchesVersion &&
+    cursor.read(batch_count) && cursor.read_array(batches.batches, batch_count) &&
+    cursor.read(range_count) && cursor.read_array(batches.ranges, range_count))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < batch_count; ++i) {
+    const RdxMeshBatch& batch = batches.batches[i];
+    if ((uint64_t)batch.first_range + batch.range_count > range_count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool read_morph_targets(RdxMorphTargetsView& morphs, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t mesh_count = 0;
+  uint32_t target_count = 0;
+  uint32_t delta_count = 0;
+  if (!(cursor.read(version) && version == kMorphTargetsVersion &&
+    cursor.read(mesh_count) && cursor.read_array(morphs.meshes, mesh_count) &&
+    cursor.read(target_count) && cursor.read_array(morphs.targets, target_count) &&
+    cursor.read(delta_count) && cursor.read_array(morphs.vertex_indices, delta_count) &&
+    cursor.read_array(morphs.deltas, delta_count))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < mesh_count; ++i) {
+    const RdxMorphMesh& mesh = morphs.meshes[i];
+    if ((uint64_t)mesh.first_target + mesh.target_count > target_count) {
+      return false;
+    }
+    for (uint32_t j = mesh.first_target; j < mesh.first_target + mesh.target_count; ++j) {
+      const RdxMorphTarget& target = morphs.targets[j];
+      if ((uint64_t)target.first_delta + target.delta_count > delta_count) {
+        return false;
+      }
+      for (uint32_t k = target.first_delta; k < target.first_delta + target.delta_count; ++k) {
+        if (morphs.vertex_indices[k] >= mesh.vertex_count) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool read_skins(RdxSkinsView& skins, const RdxChunk& chunk)
+{
+  Cursor cursor(chunk);
+  uint32_t version = 0;
+  uint32_t skin_count = 0;
+  uint32_t joint_count = 0;
+  if (!(cursor.read(version) && version == kSkinsVersion &&
+    cursor.read(skin_count) && cursor.read_array(skins.skins, skin_count) &&
+    cursor.read(joint_count) && cursor.read_array(skins.joints, joint_count))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < skin_count; ++i) {
+    const RdxSkin& skin = skins.skins[i];
+    if (skin.joint_count > 256 || (uint64_t)skin.first_joint + skin.joint_count > joint_count) {
+      return false;
+    }
+  }
+  return true;
+}
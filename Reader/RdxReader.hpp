@@ -0,0 +1,206 @@
+#ifndef RDX_READER_HPP
+#define RDX_READER_HPP
+
+/**
+ * Reader for .rdx files. The file is memory mapped, and the header, chunk table and block
+ * table are validated when it's opened, so get_chunk only has to check the chunk index.
+ * Chunk data is used in place in uncompressed files. In block compressed files the blocks
+ * are inflated on first use into a buffer owned by the RdxFile, so opening a file and
+ * reading one chunk only inflates the blocks that chunk covers.
+ *
+ * The read_ functions parse a chunk into views that point straight into the chunk data, and
+ * fail if any of the counts in the chunk would read past its end. The views stay valid until
+ * the RdxFile is closed.
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "RdxFormat.hpp"
+
+template <class T>
+struct RdxArray
+{
+  RdxArray() : data(NULL), count(0) {}
+  const T& operator[](const uint32_t idx) const { return data[idx]; }
+  bool empty() const { return count == 0; }
+  const T* data;
+  uint32_t count;
+};
+
+struct RdxChunk
+{
+  RdxChunk() : id(0), data(NULL), size(0) {}
+  uint32_t id;
+  const uint8_t* data;
+  uint32_t size;
+};
+
+class RdxFile
+{
+public:
+  RdxFile();
+  ~RdxFile();
+
+  bool open(const char* filename);
+  // Uses a file image that is already in memory, and that must outlive the RdxFile
+  bool open_memory(const uint8_t* data, const uint32_t size);
+  void close();
+
+  // Description of the last error
+  const std::string& error() const { return error_; }
+
+  bool compressed() const { return blocks_ != NULL; }
+  uint32_t chunk_count() const { return header_ ? header_->chunk_count : 0; }
+  const RdxChunkEntry& chunk_entry(const uint32_t idx) const { return chunks_[idx]; }
+
+  // Returns the index of the first chunk with the id at or after start, or kRdxInvalidIndex
+  uint32_t find_chunk(const RdxChunkId::Enum id, const uint32_t start = 0) const;
+  bool get_chunk(RdxChunk& chunk, const uint32_t idx);
+
+  uint32_t block_count() const { return compressed() ? header_->block_count : 0; }
+  uint32_t inflated_blocks() const { return inflated_blocks_; }
+
+private:
+  RdxFile(const RdxFile&);
+  RdxFile& operator=(const RdxFile&);
+
+  bool validate();
+  bool inflate_blocks(const uint32_t first, const uint32_t last);
+  bool fail(const std::string& msg);
+
+  // the mapping's HANDLEs, kept as void* so windows.h isn't needed here
+  void* file_handle_;
+  void* mapping_handle_;
+  const uint8_t* base_;
+  uint32_t size_;
+
+  const RdxFileHeader* header_;
+  const RdxChunkEntry* chunks_;
+  const RdxBlockEntry* blocks_;
+  const uint8_t* data_;
+
+  uint8_t* inflated_;
+  std::vector<bool> block_loaded_;
+  uint32_t inflated_blocks_;
+  std::string error_;
+};
+
+struct RdxMeshView
+{
+  RdxMeshView() : name(0), parent(0), encoding(0), vertex_count(0), vertex_size(0), vertices(NULL), index_count(0), bounds_mode(0), bounds_flags(0), aabb(NULL), sphere(NULL), obb(NULL) {}
+  uint32_t name;            // string index of the sub mesh name
+  uint32_t parent;          // string index of the parent transform's path
+  RdxArray<RdxElementDesc> elements;
+  uint32_t encoding;        // RdxMeshEncoding
+  uint32_t vertex_count;
+  uint32_t vertex_size;
+  const uint8_t* vertices;  // NULL when encoded
+  uint32_t index_count;
+  RdxArray<uint32_t> indices;               // empty when encoded
+  RdxArray<uint8_t> encoded_vertices;       // empty unless encoded
+  RdxArray<uint8_t> encoded_indices;
+  uint32_t bounds_mode;
+  uint32_t bounds_flags;
+  const RdxAabb* aabb;
+  const RdxSphere* sphere;
+  const RdxObb* obb;        // NULL when the mesh has no oriented box
+};
+
+struct RdxTrackView
+{
+  uint32_t name;            // string index of the transform's path
+  RdxArray<RdxAnimationKey> keys;
+};
+
+struct RdxAnimationView
+{
+  RdxAnimationView() : fps(0), start(0), end(0) {}
+  uint32_t fps;
+  float start;
+  float end;
+  std::vector<RdxTrackView> tracks;
+};
+
+struct RdxStringTableView
+{
+  // Rebuilds the full name from the prefix chain
+  bool get(std::string& str, const uint32_t idx) const;
+  RdxArray<RdxStringEntry> entries;
+  RdxArray<char> chars;
+};
+
+struct RdxHierarchyView
+{
+  RdxArray<RdxHierarchyNode> nodes;
+};
+
+// Empty for a static camera
+struct RdxCameraCurvesView
+{
+  RdxCameraCurvesView() : sample_count(0), start(0), step(0) {}
+  bool empty() const { return channels.empty(); }
+  uint32_t sample_count;
+  float start;                          // seconds
+  float step;
+  RdxArray<RdxCurveChannel> channels;   // kRdxCameraChannels of them
+  RdxArray<RdxCurveKey> keys;
+};
+
+struct RdxSpatialIndexView
+{
+  RdxArray<RdxBvhNode> nodes;
+  RdxArray<uint32_t> mesh_ids;      // in leaf order
+};
+
+struct RdxCellManifestView
+{
+  RdxCellManifestView() : cell_size(0), pack_name(0) {}
+  float cell_size;
+  uint32_t pack_name;               // string index of the pack's file name, relative to this file
+  RdxArray<RdxCell> cells;
+};
+
+struct RdxMeshBatchesView
+{
+  RdxArray<RdxMeshBatch> batches;
+  RdxArray<RdxMeshBatchRange> ranges;
+};
+
+struct RdxMorphTargetsView
+{
+  RdxArray<RdxMorphMesh> meshes;
+  RdxArray<RdxMorphTarget> targets;
+  RdxArray<uint32_t> vertex_indices;
+  RdxArray<RdxMorphDelta> deltas;
+};
+
+struct RdxSkinsView
+{
+  RdxArray<RdxSkin> skins;
+  RdxArray<RdxSkinJoint> joints;
+};
+
+bool read_mesh(RdxMeshView& mesh, const RdxChunk& chunk);
+// Copies the mesh's vertices and indices, decoding them if the mesh is encoded
+bool decode_mesh(std::vector<float>& vertices, std::vector<uint32_t>& indices, const RdxMeshView& mesh);
+bool read_animation(RdxAnimationView& animation, const RdxChunk& chunk);
+bool read_string_table(RdxStringTableView& strings, const RdxChunk& chunk);
+bool read_hierarchy(RdxHierarchyView& hierarchy, const RdxChunk& chunk);
+bool read_camera(const RdxCamera*& camera, const RdxChunk& chunk);
+// Also checks that the channels' keys stay in the key array and their times increase
+bool read_camera_curves(RdxCameraCurvesView& curves, const RdxChunk& chunk);
+// The channel's value at the time, held at the ends. The curves can't be empty
+float evaluate_curve(const RdxCameraCurvesView& curves, const uint32_t channel, const float time);
+// Also checks that the node links and leaf ranges stay in the arrays
+bool read_spatial_index(RdxSpatialIndexView& index, const RdxChunk& chunk);
+bool read_cell_manifest(RdxCellManifestView& manifest, const RdxChunk& chunk);
+// Also checks that the batches' ranges stay in the range array
+bool read_mesh_batches(RdxMeshBatchesView& batches, const RdxChunk& chunk);
+// Also checks that the targets' deltas stay in the delta arrays, and their vertex indices in
+// their mesh
+bool read_morph_targets(RdxMorphTargetsView& morphs, const RdxChunk& chunk);
+// Also checks that the skins' palettes stay in the joint array and fit 8 bit indices
+bool read_skins(RdxSkinsView& skins, const RdxChunk& chunk);
+
+#endif
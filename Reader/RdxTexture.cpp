@@ -0,0 +1,141 @@
+#include <string.h>
+#include "RdxTexture.hpp"
+
+namespace
+{
+  void decode_565(uint8_t* rgb, const uint16_t c)
+  {
+    const uint32_t r = (c >> 11) & 31;
+    const uint32_t g = (c >> 5) & 63;
+    const uint32_t b = c & 31;
+    rgb[0] = (uint8_t)((r << 3) | (r >> 2));
+    rgb[1] = (uint8_t)((g << 2) | (g >> 4));
+    rgb[2] = (uint8_t)((b << 3) | (b >> 2));
+  }
+
+  // The colors of a BC1 or BC3 block. BC3 always uses the four color mode
+  void decode_color_block(uint8_t* rgba, const uint8_t* block, const bool allow_transparent)
+  {
+    const uint16_t c0 = (uint16_t)(block[0] | block[1] << 8);
+    const uint16_t c1 = (uint16_t)(block[2] | block[3] << 8);
+    uint8_t palette[4][4];
+    decode_565(palette[0], c0);
+    decode_565(palette[1], c1);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for (int i = 0; i < 3; ++i) {
+      if (c0 > c1 || !allow_transparent) {
+        palette[2][i] = (uint8_t)((2 * palette[0][i] + palette[1][i] + 1) / 3);
+        palette[3][i] = (uint8_t)((palette[0][i] + 2 * palette[1][i] + 1) / 3);
+      } else {
+        palette[2][i] = (uint8_t)((palette[0][i] + palette[1][i]) / 2);
+        palette[3][i] = 0;
+      }
+    }
+    if (c0 <= c1 && allow_transparent) {
+      palette[3][3] = 0;
+    }
+
+    const uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+    for (int i = 0; i < 16; ++i) {
+      memcpy(rgba + 4 * i, palette[(indices >> (2 * i)) & 3], 4);
+    }
+  }
+}
+
+bool open_texture(RdxTextureView& view, const uint8_t* data, const uint32_t size)
+{
+  if (size < sizeof(RdxTextureHeader)) {
+    return false;
+  }
+  const RdxTextureHeader* header = (const RdxTextureHeader*)data;
+  if (header->magic != kRdxTextureMagic || header->version != kRdxTextureVersion || header->format > RdxTextureFormat::Bc3 ||
+    header->mip_count == 0 || header->mip_count > 32 ||
+    sizeof(RdxTextureHeader) + header->mip_count * sizeof(RdxTextureMip) > size) {
+    return false;
+  }
+  const RdxTextureMip* mips = (const RdxTextureMip*)(data + sizeof(RdxTextureHeader));
+  for (uint32_t i = 0; i < header->mip_count; ++i) {
+    const RdxTextureMip& mip = mips[i];
+    if (mip.offset > size || mip.size > size - mip.offset ||
+      mip.size != texture_mip_size(header->format, mip.width, mip.height)) {
+      return false;
+    }
+  }
+  view.header = header;
+  view.mips = mips;
+  view.data = data;
+  return true;
+}
+
+uint32_t texture_mip_size(const uint32_t format, const uint32_t width, const uint32_t height)
+{
+  if (format == RdxTextureFormat::Rgba8) {
+    return width * height * 4;
+  }
+  const uint32_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+  return blocks * (format == RdxTextureFormat::Bc1 ? 8 : 16);
+}
+
+void decode_bc1_block(uint8_t* rgba, const uint8_t* block)
+{
+  decode_color_block(rgba, block, true);
+}
+
+void decode_bc3_block(uint8_t* rgba, const uint8_t* block)
+{
+  decode_color_block(rgba, block + 8, false);
+
+  const uint32_t a0 = block[0];
+  const uint32_t a1 = block[1];
+  uint8_t palette[8] = { (uint8_t)a0, (uint8_t)a1 };
+  if (a0 > a1) {
+    for (uint32_t i = 1; i < 7; ++i) {
+      palette[i + 1] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+    }
+  } else {
+    for (uint32_t i = 1; i < 5; ++i) {
+      palette[i + 1] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 5; i >= 0; --i) {
+    indices = indices << 8 | block[2 + i];
+  }
+  for (int i = 0; i < 16; ++i) {
+    rgba[4 * i + 3] = palette[(indices >> (3 * i)) & 7];
+  }
+}
+
+void decode_texture_mip(std::vector<uint8_t>& rgba, const RdxTextureView& view, const uint32_t mip_idx)
+{
+  const RdxTextureMip& mip = view.mips[mip_idx];
+  const uint8_t* src = view.data + mip.offset;
+  rgba.resize(mip.width * mip.height * 4);
+  if (view.header->format == RdxTextureFormat::Rgba8) {
+    memcpy(&rgba[0], src, rgba.size());
+    return;
+  }
+
+  const uint32_t block_size = view.header->format == RdxTextureFormat::Bc1 ? 8 : 16;
+  const uint32_t blocks_x = (mip.width + 3) / 4;
+  const uint32_t blocks_y = (mip.height + 3) / 4;
+  uint8_t block[64];
+  for (uint32_t by = 0; by < blocks_y; ++by) {
+    for (uint32_t bx = 0; bx < blocks_x; ++bx, src += block_size) {
+      if (block_size == 8) {
+        decode_bc1_block(block, src);
+      } else {
+        decode_bc3_block(block, src);
+      }
+      // the padding of the last blocks is dropped
+      for (uint32_t y = 0; y < 4 && by * 4 + y < mip.height; ++y) {
+        for (uint32_t x = 0; x < 4 && bx * 4 + x < mip.width; ++x) {
+          memcpy(&rgba[((by * 4 + y) * mip.width + bx * 4 + x) * 4], block + (y * 4 + x) * 4, 4);
+        }
+      }
+    }
+  }
+}
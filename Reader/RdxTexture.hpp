@@ -0,0 +1,35 @@
+#ifndef RDX_TEXTURE_HPP
+#define RDX_TEXTURE_HPP
+
+/**
+ * Views of processed texture (.rtx) files, laid out as described in RdxFormat.hpp, and
+ * software decoding of their mips. The runtime hands the mips to the GPU as they are; the
+ * decoders are for tools and for checking the exporter's output.
+ */
+
+#include <stdint.h>
+#include <vector>
+#include "RdxFormat.hpp"
+
+struct RdxTextureView
+{
+  RdxTextureView() : header(NULL), mips(NULL) {}
+  const RdxTextureHeader* header;
+  const RdxTextureMip* mips;
+  const uint8_t* data;          // the start of the file, which the mip offsets are relative to
+};
+
+// Fails if the header is wrong or a mip doesn't fit the data
+bool open_texture(RdxTextureView& view, const uint8_t* data, const uint32_t size);
+
+// Size of a mip in the format
+uint32_t texture_mip_size(const uint32_t format, const uint32_t width, const uint32_t height);
+
+// Decodes a 4x4 block into 16 rgba pixels
+void decode_bc1_block(uint8_t* rgba, const uint8_t* block);
+void decode_bc3_block(uint8_t* rgba, const uint8_t* block);
+
+// Decodes the mip into rgba pixels, top row first
+void decode_texture_mip(std::vector<uint8_t>& rgba, const RdxTextureView& view, const uint32_t mip);
+
+#endif
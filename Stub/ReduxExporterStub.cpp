@@ -76,27 +76,13 @@ void ReduxExporterStub::parse_options(const MString& options)
 {
   cout << "options: " << options.asChar() << endl;
 
-  ExporterSettings settings;
-
   //	each option is in the form -
   //	[Option] = [Value];
-  MStringArray option_list;
-  options.split(';', option_list);
-
-  for (uint32_t i = 0; i < option_list.length(); ++i) {
-    MStringArray cur_option;
-    option_list[i].split('=', cur_option);
-
-    if (cur_option[0] == "bounding_box") {
-      settings.compute_bounding_box = !!cur_option[1].asInt();
-      cout << "bounding box " << settings.compute_bounding_box << endl;
-    } else if (cur_option[0] == "vertex_cache") {
-      settings.use_vertex_cache = !!cur_option[1].asInt();
-      cout << "use_vertex_cache " << settings.use_vertex_cache << endl;
-    }
-
+  // the options not given keep their defaults, rather than the ones of the last export
+  settings_ = ExporterSettings();
+  if (!parse_exporter_options(settings_, options.asChar())) {
+    cout << "Ignoring the unknown options in: " << options.asChar() << endl;
   }
-
 }
 
 //-------------------------------------------------------------------	writer
@@ -125,14 +111,14 @@ MStatus	ReduxExporterStub::writer(const MFileObject& file, const MString& option
   SCOPED_DELETER(&FreeLibrary, exporter_dll);
 
   // Find the exporter function
-  typedef bool(*ExportMainFn)(const char*);
+  typedef bool(*ExportMainFn)(const char*, const ExporterSettings&);
   ExportMainFn export_main = reinterpret_cast<ExportMainFn>(GetProcAddress(exporter_dll, "export_main"));
   if (NULL == export_main) {
     cerr << "[ERROR] Unable to find export_main function" << endl;
     return MS::kFailure;
   }
 
-  return export_main(file.fullName().asChar()) ? MS::kSuccess : MS::kFailure;
+  return export_main(file.fullName().asChar(), settings_) ? MS::kSuccess : MS::kFailure;
 }
 
 MString ReduxExporterStub::defaultExtension () const {
@@ -1,6 +1,8 @@
 #ifndef REDUX_EXPORTER_STUB
 #define REDUX_EXPORTER_STUB
 
+#include "exporter_settings.hpp"
+
 class ReduxExporterStub : public MPxFileTranslator
 {
 public:
@@ -19,6 +21,8 @@ public:
 	static void* creator();
 private:
   void    parse_options(const MString& options);
+
+  ExporterSettings settings_;
 };
 
 #endif // #ifndef REDUX_EXPORTER_STUB
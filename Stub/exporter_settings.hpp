@@ -1,12 +1,145 @@
 #ifndef _EXPORTER_SETTINGS_HPP_
 #define _EXPORTER_SETTINGS_HPP_
 
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
 struct ExporterSettings
 {
-  bool  compute_bounding_box;
-  bool  use_vertex_cache;
+  ExporterSettings()
+    : compute_bounding_box(true)
+    , use_vertex_cache(true)
+    , write_trace(false)
+    , bounds_mode(2)
+    , export_tangents(true)
+    , export_vertex_colors(true)
+    , write_material_json(false)
+    , compress(true)
+    , load_in_place(false)
+    , spatial_order(false)
+    , stream_cell_size(0)
+    , encode_meshes(false)
+    , texture_mode(0)
+    , kaiser_mips(false)
+    , batch_meshes(false)
+    , palette_joints(64)
+    , patch_layout(false)
+  {
+  }
+
+  bool  compute_bounding_box;  // write an oriented bounding box in addition to the aabb and sphere
+  bool  use_vertex_cache;      // reorder the triangles of each mesh and batch range for the post transform cache
+  bool  write_trace;    // write a chrome://tracing file next to the stats report
+  int   bounds_mode;    // 0 = sphere around the aabb, 1 = approximate sphere, 2 = exact (Miniball) sphere
+  bool  export_tangents;
+  bool  export_vertex_colors;
+  bool  write_material_json;  // debug dump of the Materials chunk
+  bool  compress;       // block compress the file, otherwise it can be mapped and used in place
+  bool  load_in_place;  // write a fixed up .rdi image in the runtime layout instead of the .rdx
+  bool  spatial_order;  // write the meshes in the leaf order of the spatial index
+  float stream_cell_size;   // split the meshes into streaming cells of this size, 0 = off
+  bool  encode_meshes;  // quantize and delta code the mesh buffers
+  int   texture_mode;   // 0 = reference the source images, 1 = BC compressed .rtx, 2 = rgba .rtx
+  bool  kaiser_mips;    // build the .rtx mips with the Kaiser filter instead of the box filter
+  bool  batch_meshes;   // merge the static meshes sharing a material into batches
+  int   palette_joints; // split skinned meshes so each part uses at most this many joints, 12 to 256
+  bool  patch_layout;   // lay out the compressed blocks for binary patches, and write their hashes
 };
 
+// Applies an option string of the form "name=value;name=value;", as built by ReduxExporter.mel.
+// This is shared by the stub and the batch exporter, so it only uses the standard library.
+// Returns false if any of the options is unknown
+inline bool parse_exporter_options(ExporterSettings& settings, const std::string& options)
+{
+  bool res = true;
+  size_t start = 0;
+  while (start < options.size()) {
+    size_t end = options.find(';', start);
+    if (end == std::string::npos) {
+      end = options.size();
+    }
+    const std::string option(options, start, end - start);
+    start = end + 1;
+    if (option.empty()) {
+      continue;
+    }
 
-#endif // #ifndef _EXPORTER_SETTINGS_HPP_
+    const size_t eq = option.find('=');
+    const std::string name(option, 0, eq);
+    const std::string value(eq == std::string::npos ? std::string() : option.substr(eq + 1));
+    const bool flag = atoi(value.c_str()) != 0;
+    if (name == "bounding_box") {
+      settings.compute_bounding_box = flag;
+    } else if (name == "vertex_cache") {
+      settings.use_vertex_cache = flag;
+    } else if (name == "trace") {
+      settings.write_trace = flag;
+    } else if (name == "bounds_mode") {
+      settings.bounds_mode = std::min<int>(std::max<int>(atoi(value.c_str()), 0), 2);
+    } else if (name == "tangents") {
+      settings.export_tangents = flag;
+    } else if (name == "vertex_colors") {
+      settings.export_vertex_colors = flag;
+    } else if (name == "material_json") {
+      settings.write_material_json = flag;
+    } else if (name == "compress") {
+      settings.compress = flag;
+    } else if (name == "load_in_place") {
+      settings.load_in_place = flag;
+    } else if (name == "spatial_order") {
+      settings.spatial_order = flag;
+    } else if (name == "stream_cell_size") {
+      settings.stream_cell_size = std::max<float>((float)atof(value.c_str()), 0);
+    } else if (name == "encode_meshes") {
+      settings.encode_meshes = flag;
+    } else if (name == "textures") {
+      settings.texture_mode = std::min<int>(std::max<int>(atoi(value.c_str()), 0), 2);
+    } else if (name == "kaiser_mips") {
+      settings.kaiser_mips = flag;
+    } else if (name == "batch_meshes") {
+      settings.batch_meshes = flag;
+    } else if (name == "palette_joints") {
+      settings.palette_joints = std::min<int>(std::max<int>(atoi(value.c_str()), 12), 256);
+    } else if (name == "patch_layout") {
+      settings.patch_layout = flag;
+    } else {
+      std::cout << "unknown option " << name << std::endl;
+      res = false;
+      continue;
+    }
+    std::cout << name << " " << value << std::endl;
+  }
+  return res;
+}
 
+// Builds the option string for the settings, with every option in a fixed order, so equal
+// settings give equal strings
+inline std::string format_exporter_options(const ExporterSettings& settings)
+{
+  std::ostringstream str;
+  str << "bounding_box=" << settings.compute_bounding_box
+    << ";vertex_cache=" << settings.use_vertex_cache
+    << ";trace=" << settings.write_trace
+    << ";bounds_mode=" << settings.bounds_mode
+    << ";tangents=" << settings.export_tangents
+    << ";vertex_colors=" << settings.export_vertex_colors
+    << ";material_json=" << settings.write_material_json
+    << ";compress=" << settings.compress
+    << ";load_in_place=" << settings.load_in_place
+    << ";spatial_order=" << settings.spatial_order
+    << ";stream_cell_size=" << settings.stream_cell_size
+    << ";encode_meshes=" << settings.encode_meshes
+    << ";textures=" << settings.texture_mode
+    << ";kaiser_mips=" << settings.kaiser_mips
+    << ";batch_meshes=" << settings.batch_meshes
+    << ";palette_joints=" << settings.palette_joints
+    << ";patch_layout=" << settings.patch_layout
+    << ";";
+  return str.str();
+}
+
+
+#endif // #ifndef _EXPORTER_SETTINGS_HPP_